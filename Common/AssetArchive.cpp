@@ -0,0 +1,398 @@
+//***************************************************************************************
+// AssetArchive.cpp
+//***************************************************************************************
+
+#include "AssetArchive.h"
+#include "FileUtil.h"
+#include "Hash.h"
+#include "LzCompression.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	// Both overloads of NormalizePath funnel their characters through this, one UTF-8
+	// byte at a time.
+	std::string NormalizeUtf8(const std::string& path)
+	{
+		std::string normalized;
+		normalized.reserve(path.size());
+
+		std::size_t begin = 0;
+		while(begin <= path.size())
+		{
+			std::size_t end = begin;
+			while(end < path.size() && path[end] != '/' && path[end] != '\\')
+				++end;
+
+			std::size_t length = end - begin;
+			bool skip = length == 0 || (length == 1 && path[begin] == '.');
+			if(!skip)
+			{
+				if(!normalized.empty())
+					normalized += '/';
+
+				for(std::size_t i = begin; i < end; ++i)
+				{
+					char c = path[i];
+					normalized += (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+				}
+			}
+
+			begin = end + 1;
+		}
+
+		return normalized;
+	}
+
+	void AppendUtf8(uint32 c, std::string& s)
+	{
+		if(c < 0x80)
+		{
+			s += (char)c;
+		}
+		else if(c < 0x800)
+		{
+			s += (char)(0xc0 | (c >> 6));
+			s += (char)(0x80 | (c & 0x3f));
+		}
+		else if(c < 0x10000)
+		{
+			s += (char)(0xe0 | (c >> 12));
+			s += (char)(0x80 | ((c >> 6) & 0x3f));
+			s += (char)(0x80 | (c & 0x3f));
+		}
+		else
+		{
+			s += (char)(0xf0 | (c >> 18));
+			s += (char)(0x80 | ((c >> 12) & 0x3f));
+			s += (char)(0x80 | ((c >> 6) & 0x3f));
+			s += (char)(0x80 | (c & 0x3f));
+		}
+	}
+
+	bool Less(const AssetArchive::Entry& entry, uint64 hash)
+	{
+		return entry.Hash < hash;
+	}
+
+	uint64 AlignUp(uint64 value, uint64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+HRESULT AssetArchive::Open(const wchar_t* filename)
+{
+	Close();
+
+	HRESULT hr = mFile.Open(filename);
+	if(FAILED(hr))
+		return hr;
+
+	const uint8* data = mFile.Data();
+	uint64 size = mFile.Size();
+
+	Header header;
+	if(size < sizeof(Header))
+	{
+		Close();
+		return E_FAIL;
+	}
+
+	std::memcpy(&header, data, sizeof(Header));
+	uint64 namesOffset = sizeof(Header) + (uint64)header.EntryCount * sizeof(Entry);
+	if(header.Magic != Magic || header.Version != Version || namesOffset + header.NamesSize > size)
+	{
+		Close();
+		return E_FAIL;
+	}
+
+	// Everything Find and Read touch is checked once here instead of on every lookup.
+	const Entry* entries = reinterpret_cast<const Entry*>(data + sizeof(Header));
+	for(uint32 i = 0; i < header.EntryCount; ++i)
+	{
+		const Entry& entry = entries[i];
+
+		bool valid =
+			(uint64)entry.NameOffset + entry.NameLength <= header.NamesSize &&
+			entry.Offset <= size && entry.StoredSize <= size - entry.Offset &&
+			(i == 0 || entries[i - 1].Hash <= entry.Hash);
+
+		if(entry.Method == Compression::None)
+			valid = valid && entry.StoredSize == entry.Size;
+		else
+			valid = valid && entry.Method == Compression::Lz;
+
+		if(!valid)
+		{
+			Close();
+			return E_FAIL;
+		}
+	}
+
+	mEntries = entries;
+	mNames = reinterpret_cast<const char*>(data + namesOffset);
+	mEntryCount = header.EntryCount;
+
+	return S_OK;
+}
+
+void AssetArchive::Close()
+{
+	mFile.Close();
+	mEntries = nullptr;
+	mNames = nullptr;
+	mEntryCount = 0;
+}
+
+const AssetArchive::Entry* AssetArchive::Find(const std::string& path)const
+{
+	if(!IsOpen())
+		return nullptr;
+
+	std::string normalized = NormalizePath(path);
+	uint64 hash = HashPath(normalized);
+
+	const Entry* end = mEntries + mEntryCount;
+	for(const Entry* entry = std::lower_bound(mEntries, end, hash, Less); entry != end && entry->Hash == hash; ++entry)
+	{
+		if(entry->NameLength == normalized.size() &&
+			std::memcmp(mNames + entry->NameOffset, normalized.data(), normalized.size()) == 0)
+			return entry;
+	}
+
+	return nullptr;
+}
+
+const AssetArchive::Entry* AssetArchive::Find(const std::wstring& path)const
+{
+	return IsOpen() ? Find(NormalizePath(path)) : nullptr;
+}
+
+std::string AssetArchive::EntryPath(const Entry& entry)const
+{
+	return std::string(mNames + entry.NameOffset, entry.NameLength);
+}
+
+const std::uint8_t* AssetArchive::Data(const Entry& entry)const
+{
+	return entry.Method == Compression::None ? mFile.Data() + entry.Offset : nullptr;
+}
+
+bool AssetArchive::Read(const Entry& entry, std::vector<std::uint8_t>& bytes)const
+{
+	const uint8* stored = mFile.Data() + entry.Offset;
+
+	if(entry.Method == Compression::None)
+	{
+		bytes.assign(stored, stored + entry.Size);
+		return true;
+	}
+
+	bytes.resize((std::size_t)entry.Size);
+	return LzCompression::Decompress(stored, (std::size_t)entry.StoredSize, bytes.data(), bytes.size());
+}
+
+std::string AssetArchive::NormalizePath(const std::string& path)
+{
+	return NormalizeUtf8(path);
+}
+
+std::string AssetArchive::NormalizePath(const std::wstring& path)
+{
+	std::string utf8;
+	utf8.reserve(path.size());
+
+	for(std::size_t i = 0; i < path.size(); ++i)
+	{
+		uint32 c = (uint32)path[i];
+
+		// wchar_t is UTF-16 on Windows; join surrogate pairs.
+		if(c >= 0xd800 && c < 0xdc00 && i + 1 < path.size())
+		{
+			uint32 low = (uint32)path[i + 1];
+			if(low >= 0xdc00 && low < 0xe000)
+			{
+				c = 0x10000 + ((c - 0xd800) << 10) + (low - 0xdc00);
+				++i;
+			}
+		}
+
+		AppendUtf8(c, utf8);
+	}
+
+	return NormalizeUtf8(utf8);
+}
+
+AssetArchive::uint64 AssetArchive::HashPath(const std::string& normalizedPath)
+{
+	return Hash::Fnv1a(normalizedPath.data(), normalizedPath.size());
+}
+
+HRESULT AssetFile::Open(const AssetArchive* archive, const std::wstring& filename)
+{
+	Close();
+
+	const AssetArchive::Entry* entry = archive != nullptr ? archive->Find(filename) : nullptr;
+	if(entry == nullptr)
+	{
+		HRESULT hr = mFile.Open(filename.c_str());
+		if(FAILED(hr))
+			return hr;
+
+		mData = mFile.Data();
+		mSize = mFile.Size();
+		return S_OK;
+	}
+
+	mData = archive->Data(*entry);
+	mSize = (std::size_t)entry->Size;
+	if(mData == nullptr)
+	{
+		if(!archive->Read(*entry, mBuffer))
+		{
+			Close();
+			return E_FAIL;
+		}
+
+		mData = mBuffer.data();
+	}
+
+	return S_OK;
+}
+
+void AssetFile::Close()
+{
+	mFile.Close();
+	mBuffer.clear();
+	mBuffer.shrink_to_fit();
+	mData = nullptr;
+	mSize = 0;
+}
+
+void AssetArchiveWriter::Add(const std::string& path, std::vector<std::uint8_t> data, bool compress, uint32 alignment)
+{
+	Pending pending;
+	pending.Path = AssetArchive::NormalizePath(path);
+	pending.Size = data.size();
+	pending.Alignment = std::max(alignment, 1u);
+
+	std::vector<std::uint8_t> compressed;
+	if(compress && !data.empty())
+		LzCompression::Compress(data.data(), data.size(), compressed);
+
+	if(!compressed.empty() && compressed.size() <= data.size() - data.size() / 8)
+	{
+		pending.Stored = std::move(compressed);
+		pending.Method = AssetArchive::Compression::Lz;
+	}
+	else
+	{
+		pending.Stored = std::move(data);
+	}
+
+	auto it = mEntriesByPath.find(pending.Path);
+	if(it != mEntriesByPath.end())
+	{
+		mEntries[it->second] = std::move(pending);
+	}
+	else
+	{
+		mEntriesByPath[pending.Path] = mEntries.size();
+		mEntries.push_back(std::move(pending));
+	}
+}
+
+bool AssetArchiveWriter::AddFile(const std::wstring& filename, const std::string& path, bool compress, uint32 alignment)
+{
+	std::vector<std::uint8_t> bytes;
+	if(!FileUtil::ReadFile(filename, bytes))
+		return false;
+
+	Add(path, std::move(bytes), compress, alignment);
+	return true;
+}
+
+bool AssetArchiveWriter::Write(const std::wstring& filename)const
+{
+	using Entry = AssetArchive::Entry;
+
+	std::vector<uint64> hashes(mEntries.size());
+	std::vector<std::size_t> order(mEntries.size());
+	for(std::size_t i = 0; i < mEntries.size(); ++i)
+	{
+		hashes[i] = AssetArchive::HashPath(mEntries[i].Path);
+		order[i] = i;
+	}
+
+	std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b)
+	{
+		if(hashes[a] != hashes[b])
+			return hashes[a] < hashes[b];
+		return mEntries[a].Path < mEntries[b].Path;
+	});
+
+	std::string names;
+	std::vector<Entry> entries(mEntries.size());
+	for(std::size_t i = 0; i < order.size(); ++i)
+	{
+		const Pending& pending = mEntries[order[i]];
+
+		Entry& entry = entries[i];
+		entry.Hash = hashes[order[i]];
+		entry.NameOffset = (uint32)names.size();
+		entry.NameLength = (uint32)pending.Path.size();
+		entry.Method = pending.Method;
+		entry.Alignment = pending.Alignment;
+		entry.StoredSize = pending.Stored.size();
+		entry.Size = pending.Size;
+
+		names += pending.Path;
+	}
+
+	AssetArchive::Header header;
+	header.Magic = AssetArchive::Magic;
+	header.Version = AssetArchive::Version;
+	header.EntryCount = (uint32)entries.size();
+	header.NamesSize = (uint32)names.size();
+
+	uint64 offset = sizeof(header) + entries.size() * sizeof(Entry) + names.size();
+	for(Entry& entry : entries)
+	{
+		entry.Offset = AlignUp(offset, entry.Alignment);
+		offset = entry.Offset + entry.StoredSize;
+	}
+
+	std::ofstream fout(filename, std::ios::binary | std::ios::trunc);
+	if(!fout)
+		return false;
+
+	fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	fout.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+	fout.write(names.data(), names.size());
+
+	uint64 position = sizeof(header) + entries.size() * sizeof(Entry) + names.size();
+	const char zeros[256] = {};
+	for(std::size_t i = 0; i < entries.size(); ++i)
+	{
+		const Pending& pending = mEntries[order[i]];
+
+		for(uint64 padding = entries[i].Offset - position; padding > 0; )
+		{
+			uint64 count = std::min<uint64>(padding, sizeof(zeros));
+			fout.write(zeros, (std::streamsize)count);
+			padding -= count;
+		}
+
+		fout.write(reinterpret_cast<const char*>(pending.Stored.data()), pending.Stored.size());
+		position = entries[i].Offset + entries[i].StoredSize;
+	}
+
+	return (bool)fout;
+}
@@ -0,0 +1,183 @@
+//***************************************************************************************
+// AssetArchive.h
+//
+// A single file pack of assets that is memory mapped once at startup instead of opening
+// every loose file.  The file starts with a header and a table of contents sorted by the
+// 64-bit hash of each entry's path, so a lookup is a binary search that only touches the
+// first pages of the file.  Paths are compared after NormalizePath, which lets callers
+// keep using the loose file names ("Textures//bricks.dds", L"Textures\\bricks.dds").
+//
+// Entry data starts at the alignment it was added with, so stored entries can be read
+// (or parsed, like DDS layouts) straight out of the mapping.  Entries can be stored LZ
+// compressed instead (LzCompression), which Read undoes.
+//
+// AssetFile opens an asset from an archive, falling back to the loose file, and
+// AssetArchiveWriter builds archives.
+//***************************************************************************************
+
+#pragma once
+
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class AssetArchive
+{
+public:
+
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	enum class Compression : uint32
+	{
+		None = 0,
+		Lz = 1
+	};
+
+#pragma pack(push, 1)
+
+	struct Header
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 EntryCount;
+		uint32 NamesSize;	// Bytes of paths right after the table of contents
+	};
+
+	// One record of the table of contents, as stored in the file.
+	struct Entry
+	{
+		uint64 Hash;
+		uint64 Offset;		// From the start of the file
+		uint64 StoredSize;	// Bytes in the file
+		uint64 Size;		// Bytes once decompressed
+		uint32 NameOffset;	// Into the paths
+		uint32 NameLength;
+		Compression Method;
+		uint32 Alignment;
+	};
+
+#pragma pack(pop)
+
+	static const uint32 Magic = 0x4b415049;	// "IPAK"
+	static const uint32 Version = 1;
+
+	AssetArchive() = default;
+
+	AssetArchive(const AssetArchive& rhs) = delete;
+	AssetArchive& operator=(const AssetArchive& rhs) = delete;
+
+	///<summary>
+	/// Maps filename and validates its table of contents.
+	///</summary>
+	HRESULT Open(const wchar_t* filename);
+
+	void Close();
+
+	bool IsOpen()const { return mEntries != nullptr; }
+
+	///<summary>
+	/// The entry of path, or nullptr if the archive does not have it.
+	///</summary>
+	const Entry* Find(const std::string& path)const;
+	const Entry* Find(const std::wstring& path)const;
+
+	uint32 EntryCount()const { return mEntryCount; }
+	const Entry& GetEntry(uint32 index)const { return mEntries[index]; }
+	std::string EntryPath(const Entry& entry)const;
+
+	///<summary>
+	/// The bytes of an uncompressed entry inside the mapping, or nullptr if it is compressed.
+	///</summary>
+	const std::uint8_t* Data(const Entry& entry)const;
+
+	///<summary>
+	/// Copies or decompresses the entry into bytes.  Returns false if its data is corrupt.
+	///</summary>
+	bool Read(const Entry& entry, std::vector<std::uint8_t>& bytes)const;
+
+	///<summary>
+	/// Path as stored in archives: ASCII lower case with '/' separators, no repeated or
+	/// leading separators and no "./" components.
+	///</summary>
+	static std::string NormalizePath(const std::string& path);
+	static std::string NormalizePath(const std::wstring& path);
+
+	static uint64 HashPath(const std::string& normalizedPath);
+
+private:
+	MappedFile mFile;
+	const Entry* mEntries = nullptr;
+	const char* mNames = nullptr;
+	uint32 mEntryCount = 0;
+};
+
+// The bytes of one asset: inside the archive mapping for stored entries, decompressed
+// into a buffer for compressed ones, or a mapping of the loose file.
+class AssetFile
+{
+public:
+	AssetFile() = default;
+
+	AssetFile(const AssetFile& rhs) = delete;
+	AssetFile& operator=(const AssetFile& rhs) = delete;
+
+	AssetFile(AssetFile&& rhs) = default;
+	AssetFile& operator=(AssetFile&& rhs) = default;
+
+	///<summary>
+	/// Opens filename from archive if it has it, otherwise maps the loose file.  archive
+	/// may be null.
+	///</summary>
+	HRESULT Open(const AssetArchive* archive, const std::wstring& filename);
+
+	void Close();
+
+	const std::uint8_t* Data()const { return mData; }
+	std::size_t Size()const { return mSize; }
+
+private:
+	MappedFile mFile;
+	std::vector<std::uint8_t> mBuffer;
+	const std::uint8_t* mData = nullptr;
+	std::size_t mSize = 0;
+};
+
+class AssetArchiveWriter
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	///<summary>
+	/// Adds data as path, replacing an earlier entry of the same path.  With compress the
+	/// entry is stored LZ compressed if that saves at least an eighth; alignment (a power
+	/// of two) is where its stored bytes start.
+	///</summary>
+	void Add(const std::string& path, std::vector<std::uint8_t> data, bool compress, uint32 alignment = 16);
+
+	///<summary>
+	/// Adds the file at filename as path.  Returns false if it cannot be read.
+	///</summary>
+	bool AddFile(const std::wstring& filename, const std::string& path, bool compress, uint32 alignment = 16);
+
+	///<summary>
+	/// Writes the archive.
+	///</summary>
+	bool Write(const std::wstring& filename)const;
+
+private:
+	struct Pending
+	{
+		std::string Path;
+		std::vector<std::uint8_t> Stored;
+		std::uint64_t Size = 0;
+		AssetArchive::Compression Method = AssetArchive::Compression::None;
+		uint32 Alignment = 16;
+	};
+
+	std::vector<Pending> mEntries;
+	std::unordered_map<std::string, std::size_t> mEntriesByPath;
+};
@@ -0,0 +1,301 @@
+//***************************************************************************************
+// AssetCooker.cpp
+//***************************************************************************************
+
+#include "AssetCooker.h"
+#include "ThreadPool.h"
+#include "VirtualFileSystem.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	const uint32 GeometryMagic = 0x304f4547;	// "GEO0"
+	const uint32 GeometryVersion = 1;
+
+	class ByteWriter
+	{
+	public:
+		explicit ByteWriter(std::vector<uint8>& out) : mOut(out) {}
+
+		void Bytes(const void* data, std::size_t size)
+		{
+			const uint8* bytes = static_cast<const uint8*>(data);
+			mOut.insert(mOut.end(), bytes, bytes + size);
+		}
+
+		template<typename T>
+		void Value(const T& value)
+		{
+			Bytes(&value, sizeof(T));
+		}
+
+		// A count followed by the elements, which must be trivially copyable.
+		template<typename T>
+		void Array(const T* data, std::size_t count)
+		{
+			Value((uint64)count);
+			Bytes(data, count * sizeof(T));
+		}
+
+	private:
+		std::vector<uint8>& mOut;
+	};
+
+	// Reads what ByteWriter wrote.  Any read past the end fails, and so does every read
+	// after it.
+	class ByteReader
+	{
+	public:
+		ByteReader(const uint8* data, std::size_t size) : mData(data), mSize(size) {}
+
+		bool Bytes(void* data, std::size_t size)
+		{
+			if(mFailed || size > mSize - mPosition)
+			{
+				mFailed = true;
+				return false;
+			}
+
+			if(size > 0)
+				std::memcpy(data, mData + mPosition, size);
+			mPosition += size;
+			return true;
+		}
+
+		template<typename T>
+		bool Value(T& value)
+		{
+			return Bytes(&value, sizeof(T));
+		}
+
+		template<typename T>
+		bool Array(std::vector<T>& elements)
+		{
+			uint64 count = 0;
+			if(!Value(count) || count > (mSize - mPosition) / sizeof(T))
+			{
+				mFailed = true;
+				return false;
+			}
+
+			elements.resize((std::size_t)count);
+			return Bytes(elements.data(), elements.size() * sizeof(T));
+		}
+
+		bool AtEnd()const { return !mFailed && mPosition == mSize; }
+
+	private:
+		const uint8* mData;
+		std::size_t mSize;
+		std::size_t mPosition = 0;
+		bool mFailed = false;
+	};
+}
+
+AssetCooker::AssetCooker(DerivedDataCache& cache) :
+	mCache(cache)
+{
+}
+
+void AssetCooker::Register(const std::string& extension, Importer importer)
+{
+	mImporters[Extension(extension)] = std::move(importer);
+}
+
+const AssetCooker::Importer* AssetCooker::FindImporter(const std::string& filename)const
+{
+	auto it = mImporters.find(Extension(filename));
+	return it != mImporters.end() ? &it->second : nullptr;
+}
+
+bool AssetCooker::Cook(const std::string& filename, const std::string& settings, std::vector<std::uint8_t>& artifact,
+	bool* cached)const
+{
+	const Importer* importer = FindImporter(filename);
+	if(importer == nullptr)
+		return false;
+
+	std::vector<uint8> source;
+	if(!VirtualFileSystem::Default().ReadFile(filename, source))
+		return false;
+
+	uint64 key = DerivedDataCache::KeyBuilder()
+		.Add(importer->Name)
+		.Add((uint64)importer->Version)
+		.Add(settings)
+		.Add(source.data(), source.size())
+		.Key();
+
+	return mCache.GetOrBuild(importer->Name, key,
+		[&](std::vector<uint8>& data)
+		{
+			return importer->Cook(filename, source, settings, data);
+		},
+		artifact, cached);
+}
+
+AssetCooker::BatchReport AssetCooker::CookAll(const std::vector<std::string>& filenames)const
+{
+	std::atomic<uint32> cooked{ 0 };
+	std::atomic<uint32> hits{ 0 };
+	std::atomic<uint32> failed{ 0 };
+
+	// One file per chunk; importers that parallelize internally share the same pool.
+	ThreadPool::Default().ParallelFor((uint32)filenames.size(), 1, [&](uint32 begin, uint32 end)
+	{
+		for(uint32 i = begin; i < end; ++i)
+		{
+			if(FindImporter(filenames[i]) == nullptr)
+				continue;
+
+			std::vector<uint8> artifact;
+			bool cached = false;
+			if(!Cook(filenames[i], std::string(), artifact, &cached))
+			{
+				// Batch cooks run from build scripts, so failures also go to stderr.
+				std::string message = filenames[i] + " could not be cooked\n";
+				OutputDebugStringA(message.c_str());
+				std::fputs(message.c_str(), stderr);
+				++failed;
+			}
+			else if(cached)
+			{
+				++hits;
+			}
+			else
+			{
+				++cooked;
+			}
+		}
+	});
+
+	BatchReport report;
+	report.Cooked = cooked;
+	report.Cached = hits;
+	report.Failed = failed;
+	return report;
+}
+
+std::vector<std::string> AssetCooker::ListFiles(const std::string& directory)
+{
+	std::vector<std::string> files;
+
+	WIN32_FIND_DATAA data;
+	HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &data);
+	if(find == INVALID_HANDLE_VALUE)
+		return files;
+
+	do
+	{
+		if(!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+			files.push_back(directory + "//" + data.cFileName);
+	} while(FindNextFileA(find, &data));
+
+	FindClose(find);
+	return files;
+}
+
+void AssetCooker::WriteGeometry(const MeshGeometry& geo, std::vector<std::uint8_t>& artifact)
+{
+	artifact.clear();
+	ByteWriter writer(artifact);
+
+	writer.Value(GeometryMagic);
+	writer.Value(GeometryVersion);
+	writer.Value((uint32)geo.VertexByteStride);
+	writer.Value((uint32)geo.IndexFormat);
+
+	writer.Array(static_cast<const uint8*>(geo.VertexBufferCPU->GetBufferPointer()), geo.VertexBufferByteSize);
+	writer.Array(static_cast<const uint8*>(geo.IndexBufferCPU->GetBufferPointer()), geo.IndexBufferByteSize);
+
+	// Sorted, so the same geometry always makes the same bytes.
+	std::vector<const std::pair<const std::string, SubmeshGeometry>*> drawArgs;
+	for(const auto& arg : geo.DrawArgs)
+		drawArgs.push_back(&arg);
+	std::sort(drawArgs.begin(), drawArgs.end(), [](const auto* a, const auto* b) { return a->first < b->first; });
+
+	writer.Value((uint64)drawArgs.size());
+	for(const auto* arg : drawArgs)
+	{
+		writer.Array(arg->first.data(), arg->first.size());
+		writer.Value(arg->second);
+	}
+
+	writer.Array(geo.Meshlets.Meshlets.data(), geo.Meshlets.Meshlets.size());
+	writer.Array(geo.Meshlets.MeshletVertices.data(), geo.Meshlets.MeshletVertices.size());
+	writer.Array(geo.Meshlets.MeshletTriangles.data(), geo.Meshlets.MeshletTriangles.size());
+}
+
+bool AssetCooker::ReadGeometry(const std::vector<std::uint8_t>& artifact, const std::string& name, MeshGeometry& geo)
+{
+	ByteReader reader(artifact.data(), artifact.size());
+
+	uint32 magic = 0;
+	uint32 version = 0;
+	uint32 stride = 0;
+	uint32 indexFormat = 0;
+	std::vector<uint8> vertices;
+	std::vector<uint8> indices;
+	uint64 drawArgCount = 0;
+
+	if(!reader.Value(magic) || magic != GeometryMagic || !reader.Value(version) || version != GeometryVersion ||
+		!reader.Value(stride) || !reader.Value(indexFormat) || !reader.Array(vertices) || !reader.Array(indices) ||
+		!reader.Value(drawArgCount))
+		return false;
+
+	geo.DrawArgs.clear();
+	for(uint64 i = 0; i < drawArgCount; ++i)
+	{
+		std::vector<char> argName;
+		SubmeshGeometry submesh;
+		if(!reader.Array(argName) || !reader.Value(submesh))
+			return false;
+
+		std::string key(argName.begin(), argName.end());
+		if(key.empty() || key.compare(0, 4, "_lod") == 0)
+			key = name + key;
+
+		geo.DrawArgs[key] = submesh;
+	}
+
+	if(!reader.Array(geo.Meshlets.Meshlets) || !reader.Array(geo.Meshlets.MeshletVertices) ||
+		!reader.Array(geo.Meshlets.MeshletTriangles) || !reader.AtEnd())
+		return false;
+
+	ThrowIfFailed(D3DCreateBlob((UINT)vertices.size(), &geo.VertexBufferCPU));
+	CopyMemory(geo.VertexBufferCPU->GetBufferPointer(), vertices.data(), vertices.size());
+
+	ThrowIfFailed(D3DCreateBlob((UINT)indices.size(), &geo.IndexBufferCPU));
+	CopyMemory(geo.IndexBufferCPU->GetBufferPointer(), indices.data(), indices.size());
+
+	geo.Name = name;
+	geo.VertexByteStride = stride;
+	geo.VertexBufferByteSize = (UINT)vertices.size();
+	geo.IndexFormat = (DXGI_FORMAT)indexFormat;
+	geo.IndexBufferByteSize = (UINT)indices.size();
+
+	return true;
+}
+
+std::string AssetCooker::Extension(const std::string& filename)
+{
+	std::size_t dot = filename.find_last_of('.');
+	std::size_t separator = filename.find_last_of("/\\");
+	bool hasExtension = dot != std::string::npos && (separator == std::string::npos || dot > separator);
+	std::string extension = hasExtension ? filename.substr(dot) : std::string();
+
+	for(char& c : extension)
+	{
+		if(c >= 'A' && c <= 'Z')
+			c = (char)(c - 'A' + 'a');
+	}
+
+	return extension;
+}
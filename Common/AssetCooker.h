@@ -0,0 +1,105 @@
+//***************************************************************************************
+// AssetCooker.h
+//
+// Turns source assets into the data the engine uses at runtime (cooked artifacts) through
+// importers registered by file extension, and keeps the results in a DerivedDataCache.
+// Sources are read through VirtualFileSystem, so they may be inside zip archives.
+// An artifact's key covers the bytes of its source file, the importer's name and
+// version, and the settings it was cooked with, so it is rebuilt exactly when one of
+// those changes.  Bump an importer's Version whenever the code that produces its output
+// changes.
+//
+// Cook is meant to be called lazily from loading workers; CookAll is the batch step,
+// which cooks a list of files in parallel on ThreadPool::Default() so later runs find
+// everything in the cache.
+//
+// WriteGeometry and ReadGeometry store the CPU side of a MeshGeometry as an artifact.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "DerivedDataCache.h"
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class AssetCooker
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	struct Importer
+	{
+		std::string Name;
+		uint32 Version = 1;
+
+		// Cooks the source file at filename with settings into artifact.  source holds the
+		// file's bytes, which importers that stream the file themselves may ignore.
+		std::function<bool(const std::string& filename, const std::vector<std::uint8_t>& source,
+			const std::string& settings, std::vector<std::uint8_t>& artifact)> Cook;
+	};
+
+	struct BatchReport
+	{
+		uint32 Cooked = 0;
+		uint32 Cached = 0;
+		uint32 Failed = 0;
+	};
+
+	///<summary>
+	/// cache must outlive the cooker.
+	///</summary>
+	explicit AssetCooker(DerivedDataCache& cache);
+
+	AssetCooker(const AssetCooker& rhs) = delete;
+	AssetCooker& operator=(const AssetCooker& rhs) = delete;
+
+	///<summary>
+	/// Cooks files ending in extension (".obj", case insensitive) with importer.  Not
+	/// thread safe; register everything before cooking.
+	///</summary>
+	void Register(const std::string& extension, Importer importer);
+
+	const Importer* FindImporter(const std::string& filename)const;
+
+	///<summary>
+	/// The artifact of filename cooked with settings, from the cache when nothing changed.
+	/// Returns false if there is no importer for it, it cannot be read or cooking fails.
+	/// Safe to call from several threads at once.
+	///</summary>
+	bool Cook(const std::string& filename, const std::string& settings, std::vector<std::uint8_t>& artifact,
+		bool* cached = nullptr)const;
+
+	///<summary>
+	/// Cooks every file with default settings, in parallel, leaving the artifacts in the
+	/// cache.  Files without an importer are skipped.
+	///</summary>
+	BatchReport CookAll(const std::vector<std::string>& filenames)const;
+
+	///<summary>
+	/// Files directly in directory (no subdirectories), as directory + "//" + name.
+	///</summary>
+	static std::vector<std::string> ListFiles(const std::string& directory);
+
+	///<summary>
+	/// Serializes the buffers, draw arguments and meshlets of geo.  The GPU resources are
+	/// not part of it.
+	///</summary>
+	static void WriteGeometry(const MeshGeometry& geo, std::vector<std::uint8_t>& artifact);
+
+	///<summary>
+	/// Fills geo from WriteGeometry's output and names it name; draw arguments stored
+	/// without a name ("" and "_lodN") take that name as well.  Returns false if the
+	/// artifact is malformed.
+	///</summary>
+	static bool ReadGeometry(const std::vector<std::uint8_t>& artifact, const std::string& name, MeshGeometry& geo);
+
+private:
+	static std::string Extension(const std::string& filename);
+
+	DerivedDataCache& mCache;
+	std::unordered_map<std::string, Importer> mImporters;
+};
@@ -0,0 +1,129 @@
+//***************************************************************************************
+// AssetLoader.cpp
+//***************************************************************************************
+
+#include "AssetLoader.h"
+#include <exception>
+
+using Microsoft::WRL::ComPtr;
+
+AssetLoader::AssetLoader(ID3D12Device* device, ThreadPool& pool) :
+	mPool(pool)
+{
+	ThrowIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT,
+		IID_PPV_ARGS(mUploadAlloc.GetAddressOf())));
+
+	ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+		mUploadAlloc.Get(), nullptr, IID_PPV_ARGS(mUploadList.GetAddressOf())));
+
+	// Poll resets the list before recording into it, so start in the closed state.
+	ThrowIfFailed(mUploadList->Close());
+
+	ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)));
+}
+
+AssetLoader::~AssetLoader()
+{
+	// Running tasks still push onto mCompleted.
+	std::unique_lock<std::mutex> lock(mMutex);
+	mWorkDone.wait(lock, [this]() { return mRunning == 0; });
+}
+
+void AssetLoader::Load(std::function<void()> work, CompletionHandler onLoaded)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		++mRunning;
+		++mPending;
+	}
+
+	mPool.Submit([this, work = std::move(work), onLoaded = std::move(onLoaded)]() mutable
+	{
+		// Queues the handler and releases the destructor however work ends.
+		struct Finish
+		{
+			AssetLoader* Loader;
+			CompletionHandler& OnLoaded;
+
+			~Finish()
+			{
+				std::lock_guard<std::mutex> lock(Loader->mMutex);
+				Loader->mCompleted.push_back(std::move(OnLoaded));
+				--Loader->mRunning;
+				Loader->mWorkDone.notify_all();
+			}
+		} finish = { this, onLoaded };
+
+		// An exception must not reach the worker thread.  The handler still runs and sees
+		// the state work left unfinished, which it treats as a failed load.
+		try
+		{
+			work();
+		}
+		catch(const std::exception& e)
+		{
+			std::string message = std::string("Asset load failed: ") + e.what() + "\n";
+			OutputDebugStringA(message.c_str());
+		}
+		catch(...)
+		{
+			OutputDebugStringA("Asset load failed with an unknown exception\n");
+		}
+	});
+}
+
+void AssetLoader::Record(CompletionHandler onReady)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	++mPending;
+	mCompleted.push_back(std::move(onReady));
+}
+
+AssetLoader::uint32 AssetLoader::Poll(ID3D12CommandQueue* queue)
+{
+	// The allocator can only be reset once the previous batch is done with it.
+	if(mFence->GetCompletedValue() < mBatchFence)
+		return 0;
+
+	mSubmittedUploads.clear();
+
+	std::deque<CompletionHandler> completed;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		completed.swap(mCompleted);
+	}
+
+	if(completed.empty())
+		return 0;
+
+	ThrowIfFailed(mUploadAlloc->Reset());
+	ThrowIfFailed(mUploadList->Reset(mUploadAlloc.Get(), nullptr));
+
+	for(auto& onLoaded : completed)
+		onLoaded(mUploadList.Get());
+
+	ThrowIfFailed(mUploadList->Close());
+	ID3D12CommandList* cmdsLists[] = { mUploadList.Get() };
+	queue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	ThrowIfFailed(queue->Signal(mFence.Get(), ++mBatchFence));
+
+	mSubmittedUploads.swap(mRecordingUploads);
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mPending -= (uint32)completed.size();
+	}
+
+	return (uint32)completed.size();
+}
+
+void AssetLoader::Retain(ComPtr<ID3D12Resource> uploadBuffer)
+{
+	mRecordingUploads.push_back(std::move(uploadBuffer));
+}
+
+AssetLoader::uint32 AssetLoader::PendingCount()const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mPending;
+}
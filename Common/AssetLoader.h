@@ -0,0 +1,93 @@
+//***************************************************************************************
+// AssetLoader.h
+//
+// Background asset loading.  Load queues the slow part of an asset (reading the file,
+// parsing, decoding, optimizing) as a task on a ThreadPool.  When the task is done its
+// completion handler goes on a completion queue, which the render thread drains with
+// Poll once per frame.  The handlers run on that thread and record their GPU uploads
+// into one command list shared by the whole batch, which Poll submits at the end.
+//
+// Upload buffers handed to Retain stay alive until the batch they were recorded in has
+// executed.  Until a handler has run the app keeps drawing whatever placeholder it
+// chose for the asset.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "ThreadPool.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class AssetLoader
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	// Runs on the thread that calls Poll.  uploadList is open for recording.
+	using CompletionHandler = std::function<void(ID3D12GraphicsCommandList* uploadList)>;
+
+	explicit AssetLoader(ID3D12Device* device, ThreadPool& pool = ThreadPool::Default());
+
+	// Waits for loads that are still running; their handlers are dropped.
+	~AssetLoader();
+
+	AssetLoader(const AssetLoader& rhs) = delete;
+	AssetLoader& operator=(const AssetLoader& rhs) = delete;
+
+	///<summary>
+	/// Runs work on a worker thread, then onLoaded during the first Poll after work has
+	/// finished.  work must not touch the GPU; state is passed from work to onLoaded by
+	/// whatever both capture.  If work throws, the exception is logged and onLoaded still
+	/// runs, so it has to treat state that work never finished as a failed load.
+	///</summary>
+	void Load(std::function<void()> work, CompletionHandler onLoaded);
+
+	///<summary>
+	/// Runs onReady during the next Poll, for GPU work that needs nothing from a worker,
+	/// such as copies between resources.
+	///</summary>
+	void Record(CompletionHandler onReady);
+
+	///<summary>
+	/// Runs the handlers of finished loads in the order they finished and executes their
+	/// uploads on queue as one command list.  While the previous batch is still executing
+	/// nothing is done, so Poll never blocks.  Returns the number of handlers run.
+	///</summary>
+	uint32 Poll(ID3D12CommandQueue* queue);
+
+	///<summary>
+	/// Keeps uploadBuffer alive until the batch being recorded has executed.  Only valid
+	/// inside a completion handler.
+	///</summary>
+	void Retain(Microsoft::WRL::ComPtr<ID3D12Resource> uploadBuffer);
+
+	///<summary>
+	/// Loads whose handlers have not run yet.
+	///</summary>
+	uint32 PendingCount()const;
+
+private:
+	ThreadPool& mPool;
+
+	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> mUploadAlloc;
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> mUploadList;
+	Microsoft::WRL::ComPtr<ID3D12Fence> mFence;
+	UINT64 mBatchFence = 0;
+
+	// Upload buffers of the batch being recorded and of the last submitted one.
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> mRecordingUploads;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12Resource>> mSubmittedUploads;
+
+	mutable std::mutex mMutex;
+	std::condition_variable mWorkDone;
+	std::deque<CompletionHandler> mCompleted;
+	uint32 mRunning = 0;
+	uint32 mPending = 0;
+};
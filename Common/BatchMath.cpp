@@ -0,0 +1,225 @@
+//***************************************************************************************
+// BatchMath.cpp
+//***************************************************************************************
+
+#include "BatchMath.h"
+#include "BatchMathKernels.h"
+
+#if BATCHMATH_X86
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+#if BATCHMATH_X86
+	struct SseLanes
+	{
+		using V = __m128;
+		static const uint32 Width = 4;
+
+		static V Splat(float x) { return _mm_set1_ps(x); }
+		static V Add(V a, V b) { return _mm_add_ps(a, b); }
+		static V Sub(V a, V b) { return _mm_sub_ps(a, b); }
+		static V Mul(V a, V b) { return _mm_mul_ps(a, b); }
+		static V MulAdd(V a, V b, V c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+		static V Div(V a, V b) { return _mm_div_ps(a, b); }
+		static V Abs(V a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+		static V Max(V a, V b) { return _mm_max_ps(a, b); }
+		static V Sqrt(V a) { return _mm_sqrt_ps(a); }
+		static uint32 NegativeMask(V a) { return static_cast<uint32>(_mm_movemask_ps(_mm_cmplt_ps(a, _mm_setzero_ps()))); }
+
+		static void LoadAffine(const XMFLOAT4X4* m, std::size_t stride, V x[12])
+		{
+			const XMFLOAT4X4* m1 = Advance(m, stride, 1);
+			const XMFLOAT4X4* m2 = Advance(m, stride, 2);
+			const XMFLOAT4X4* m3 = Advance(m, stride, 3);
+
+			// Row r of the four matrices, transposed, is column c of row r in each lane.
+			for(uint32 r = 0; r < 4; ++r)
+			{
+				__m128 c0 = _mm_loadu_ps(m->m[r]);
+				__m128 c1 = _mm_loadu_ps(m1->m[r]);
+				__m128 c2 = _mm_loadu_ps(m2->m[r]);
+				__m128 c3 = _mm_loadu_ps(m3->m[r]);
+				_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+				x[3 * r] = c0;
+				x[3 * r + 1] = c1;
+				x[3 * r + 2] = c2;
+			}
+		}
+
+		static void StoreAffine(const V x[12], XMFLOAT4X4* m)
+		{
+			for(uint32 r = 0; r < 4; ++r)
+			{
+				__m128 c0 = x[3 * r];
+				__m128 c1 = x[3 * r + 1];
+				__m128 c2 = x[3 * r + 2];
+				__m128 c3 = _mm_set1_ps(r == 3 ? 1.0f : 0.0f);
+				_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+				_mm_storeu_ps(m[0].m[r], c0);
+				_mm_storeu_ps(m[1].m[r], c1);
+				_mm_storeu_ps(m[2].m[r], c2);
+				_mm_storeu_ps(m[3].m[r], c3);
+			}
+		}
+
+		static V Load(const float* p, std::size_t stride)
+		{
+			return _mm_set_ps(*Advance(p, stride, 3), *Advance(p, stride, 2), *Advance(p, stride, 1), *p);
+		}
+
+		static void Store(V v, float* p, std::size_t stride)
+		{
+			float lanes[4];
+			_mm_storeu_ps(lanes, v);
+			for(uint32 j = 0; j < 4; ++j)
+				*AdvanceFloat(p, stride, j) = lanes[j];
+		}
+	};
+#endif
+
+	bool CpuSupportsAvx2()
+	{
+#if BATCHMATH_X86 && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if(info[0] < 7)
+			return false;
+
+		// AVX and FMA, and an OS that saves the YMM registers on context switches.
+		__cpuid(info, 1);
+		const int fma = 1 << 12;
+		const int osxsave = 1 << 27;
+		const int avx = 1 << 28;
+		if((info[2] & (fma | osxsave | avx)) != (fma | osxsave | avx))
+			return false;
+		if((_xgetbv(0) & 6) != 6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#elif BATCHMATH_X86 && defined(__GNUC__)
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+		return false;
+#endif
+	}
+
+	const BatchMathKernels* KernelsFor(BatchMath::Path path)
+	{
+		switch(path)
+		{
+		case BatchMath::Path::Avx2:
+			return Avx2BatchMathKernels();
+		case BatchMath::Path::Sse:
+			return SseBatchMathKernels();
+		default:
+			return ScalarBatchMathKernels();
+		}
+	}
+
+	struct ActiveKernels
+	{
+		BatchMath::Path Path;
+		const BatchMathKernels* Kernels;
+	};
+
+	ActiveKernels& Active()
+	{
+		static ActiveKernels active = { BatchMath::BestPath(), KernelsFor(BatchMath::BestPath()) };
+		return active;
+	}
+}
+
+const BatchMathKernels* ScalarBatchMathKernels()
+{
+	static const BatchMathKernels kernels = MakeBatchMathKernels<ScalarLanes>();
+	return &kernels;
+}
+
+const BatchMathKernels* SseBatchMathKernels()
+{
+#if BATCHMATH_X86
+	static const BatchMathKernels kernels = MakeBatchMathKernels<SseLanes>();
+	return &kernels;
+#else
+	return nullptr;
+#endif
+}
+
+BatchMath::Path BatchMath::BestPath()
+{
+	static const Path best = CpuSupportsAvx2() && Avx2BatchMathKernels() != nullptr ? Path::Avx2 :
+		SseBatchMathKernels() != nullptr ? Path::Sse : Path::Scalar;
+	return best;
+}
+
+BatchMath::Path BatchMath::ActivePath()
+{
+	return Active().Path;
+}
+
+void BatchMath::SetPath(Path path)
+{
+	if(path > BestPath())
+		path = BestPath();
+
+	Active().Path = path;
+	Active().Kernels = KernelsFor(path);
+}
+
+void BatchMath::MultiplyAffine(const XMFLOAT4X4* a, std::size_t aStride,
+	const XMFLOAT4X4* b, std::size_t bStride, XMFLOAT4X4* out, uint32 count)
+{
+	Active().Kernels->MultiplyAffine(a, aStride, b, bStride, out, count);
+}
+
+void BatchMath::InverseAffine(const XMFLOAT4X4* m, std::size_t stride, XMFLOAT4X4* out, uint32 count)
+{
+	Active().Kernels->InverseAffine(m, stride, out, count);
+}
+
+void BatchMath::ComposeTransforms(const InstanceTransform* t, std::size_t stride, XMFLOAT4X4* out, uint32 count)
+{
+	Active().Kernels->ComposeTransforms(t, stride, out, count);
+}
+
+void BatchMath::InverseTransforms(const InstanceTransform* t, std::size_t stride, XMFLOAT4X4* out, uint32 count)
+{
+	Active().Kernels->InverseTransforms(t, stride, out, count);
+}
+
+void BatchMath::StoreTransposed(const XMFLOAT4X4* m, std::size_t stride, XMFLOAT4X4* out, uint32 count)
+{
+	// DirectXMath's transpose is already a register shuffle; there is nothing to batch.
+	for(uint32 i = 0; i < count; ++i)
+		XMStoreFloat4x4(&out[i], XMMatrixTranspose(XMLoadFloat4x4(Advance(m, stride, i))));
+}
+
+void BatchMath::TransformBoxes(const BoundingBox* boxes, std::size_t boxStride,
+	const XMFLOAT4X4* m, std::size_t stride, BoundingBox* out, uint32 count)
+{
+	Active().Kernels->TransformBoxes(boxes, boxStride, m, stride, out, count);
+}
+
+void BatchMath::TransformSpheres(const BoundingSphere* spheres, std::size_t sphereStride,
+	const XMFLOAT4X4* m, std::size_t stride, BoundingSphere* out, uint32 count)
+{
+	Active().Kernels->TransformSpheres(spheres, sphereStride, m, stride, out, count);
+}
+
+void BatchMath::CullBoxes(const FrustumPlanes& planes, const BoundingBox* boxes, std::size_t boxStride,
+	std::uint8_t* visible, uint32 count)
+{
+	Active().Kernels->CullBoxes(planes, boxes, boxStride, visible, count);
+}
@@ -0,0 +1,131 @@
+//***************************************************************************************
+// BatchMath.h
+//
+// Math kernels that transform many matrices, boxes and spheres per call, or cull many
+// boxes against a frustum.  Each kernel loads 8 (AVX2) or 4 (SSE) items at once and
+// transposes them into structure of arrays lanes, so every instruction works on the same
+// element of several matrices, then transposes the results back.  The leftover items,
+// and CPUs without SSE, take a scalar path.  The path is picked once from what the CPU
+// supports.
+//
+// Matrices follow DirectXMath: row vectors, translation in row 3.  The kernels are for
+// affine matrices; the fourth column of the inputs is ignored and written as
+// (0, 0, 0, 1).  Inverses skip the general 4x4 inverse and determinant: the 3x3 part is
+// inverted through its adjugate and the translation follows from it.
+// InstanceTransforms are expanded into matrices, or their inverses, straight from the
+// scale, rotation and translation.
+//
+// Inputs are read through a byte stride so they can come straight out of arrays of
+// larger structs (Instance); a stride of 0 uses the same item for every output.
+// Outputs are packed arrays, and may overwrite a packed input.
+//
+// BatchMath only needs DirectXMath's types, so it also builds outside Windows where the
+// kernels can be benchmarked and checked against DirectXMath.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include "InstanceTransform.h"
+#include <cstddef>
+#include <cstdint>
+
+class BatchMath
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	///<summary>
+	/// Frustum planes (a, b, c, d), with a point inside a plane where
+	/// a x + b y + c z + d >= 0.  Each coefficient has its own array, so one register load
+	/// reads it for four or eight planes; the two entries after the six planes are
+	/// (0, 0, 0, 1), which nothing is outside of.
+	///</summary>
+	struct FrustumPlanes
+	{
+		static const uint32 Count = 6;
+
+		alignas(32) float A[8];
+		alignas(32) float B[8];
+		alignas(32) float C[8];
+		alignas(32) float D[8];
+	};
+
+	enum class Path
+	{
+		Scalar,
+		Sse,
+		Avx2
+	};
+
+	///<summary>
+	/// The fastest path this CPU supports.
+	///</summary>
+	static Path BestPath();
+
+	static Path ActivePath();
+
+	///<summary>
+	/// Switches every kernel to path, or to BestPath if the CPU does not support it.  For
+	/// benchmarks and tests; not safe while kernels are running on other threads.
+	///</summary>
+	static void SetPath(Path path);
+
+	///<summary>
+	/// out[i] = a[i] * b[i].
+	///</summary>
+	static void MultiplyAffine(const DirectX::XMFLOAT4X4* a, std::size_t aStride,
+		const DirectX::XMFLOAT4X4* b, std::size_t bStride, DirectX::XMFLOAT4X4* out, uint32 count);
+
+	///<summary>
+	/// out[i] = inverse(m[i]).  Singular matrices give infinities and NaNs, as with
+	/// XMMatrixInverse.
+	///</summary>
+	static void InverseAffine(const DirectX::XMFLOAT4X4* m, std::size_t stride,
+		DirectX::XMFLOAT4X4* out, uint32 count);
+
+	///<summary>
+	/// out[i] = t[i].Matrix(): the rotation as a 3x3 matrix, its rows scaled, and the
+	/// translation.
+	///</summary>
+	static void ComposeTransforms(const InstanceTransform* t, std::size_t stride,
+		DirectX::XMFLOAT4X4* out, uint32 count);
+
+	///<summary>
+	/// out[i] = t[i].InverseMatrix(): the transposed rotation with its columns divided by
+	/// the scale, and the translation through it negated.
+	///</summary>
+	static void InverseTransforms(const InstanceTransform* t, std::size_t stride,
+		DirectX::XMFLOAT4X4* out, uint32 count);
+
+	///<summary>
+	/// out[i] = transpose(m[i]), for uploading to HLSL's column major layout.  Unlike the
+	/// other kernels this one keeps all four columns.
+	///</summary>
+	static void StoreTransposed(const DirectX::XMFLOAT4X4* m, std::size_t stride,
+		DirectX::XMFLOAT4X4* out, uint32 count);
+
+	///<summary>
+	/// out[i] = the box around boxes[i] transformed by m[i], computed from the center and
+	/// the absolute values of the 3x3 part (Arvo) instead of from the eight corners.
+	///</summary>
+	static void TransformBoxes(const DirectX::BoundingBox* boxes, std::size_t boxStride,
+		const DirectX::XMFLOAT4X4* m, std::size_t stride, DirectX::BoundingBox* out, uint32 count);
+
+	///<summary>
+	/// out[i] = spheres[i] transformed by m[i].  The radius is scaled by the longest row of
+	/// the 3x3 part, like BoundingSphere::Transform.
+	///</summary>
+	static void TransformSpheres(const DirectX::BoundingSphere* spheres, std::size_t sphereStride,
+		const DirectX::XMFLOAT4X4* m, std::size_t stride, DirectX::BoundingSphere* out, uint32 count);
+
+	///<summary>
+	/// visible[i] = 0 if boxes[i] is entirely outside one of the planes, 1 otherwise.  Like
+	/// BoundingFrustum::Contains against DISJOINT, a box near a corner of the frustum may
+	/// pass without touching it.
+	///</summary>
+	static void CullBoxes(const FrustumPlanes& planes, const DirectX::BoundingBox* boxes, std::size_t boxStride,
+		std::uint8_t* visible, uint32 count);
+};
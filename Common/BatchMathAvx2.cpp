@@ -0,0 +1,149 @@
+//***************************************************************************************
+// BatchMathAvx2.cpp
+//
+// The AVX2 path of BatchMath.  Only this file uses AVX2 and FMA instructions; BatchMath
+// calls into it after checking the CPU.  GCC and Clang compile the kernels below for
+// AVX2 through a target pragma, so no file needs special compiler flags; MSVC accepts
+// the intrinsics as is.
+//***************************************************************************************
+
+// Everything that is not a kernel, DirectXMath's inline functions included, is parsed
+// before the target pragma so it keeps the baseline instruction set.  The kernel
+// templates come after it, and are instantiated here for AVX2 only.
+#include "BatchMath.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,fma"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#endif
+#define BATCHMATH_TARGET_PRAGMA 1
+#endif
+
+#include "BatchMathKernels.h"
+
+#if BATCHMATH_X86
+
+#include <immintrin.h>
+
+using namespace DirectX;
+
+namespace
+{
+	struct Avx2Lanes
+	{
+		using V = __m256;
+		static const uint32 Width = 8;
+
+		static V Splat(float x) { return _mm256_set1_ps(x); }
+		static V Add(V a, V b) { return _mm256_add_ps(a, b); }
+		static V Sub(V a, V b) { return _mm256_sub_ps(a, b); }
+		static V Mul(V a, V b) { return _mm256_mul_ps(a, b); }
+		static V MulAdd(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); }
+		static V Div(V a, V b) { return _mm256_div_ps(a, b); }
+		static V Abs(V a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+		static V Max(V a, V b) { return _mm256_max_ps(a, b); }
+		static V Sqrt(V a) { return _mm256_sqrt_ps(a); }
+		static uint32 NegativeMask(V a) { return static_cast<uint32>(_mm256_movemask_ps(_mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_LT_OQ))); }
+
+		// Two 4x4 transposes per row, one for matrices 0-3 and one for 4-7, joined into
+		// the low and high halves of each lane register.
+		static void LoadAffine(const XMFLOAT4X4* m, std::size_t stride, V x[12])
+		{
+			const XMFLOAT4X4* matrices[8];
+			for(uint32 j = 0; j < 8; ++j)
+				matrices[j] = Advance(m, stride, j);
+
+			for(uint32 r = 0; r < 4; ++r)
+			{
+				__m128 lo0 = _mm_loadu_ps(matrices[0]->m[r]);
+				__m128 lo1 = _mm_loadu_ps(matrices[1]->m[r]);
+				__m128 lo2 = _mm_loadu_ps(matrices[2]->m[r]);
+				__m128 lo3 = _mm_loadu_ps(matrices[3]->m[r]);
+				_MM_TRANSPOSE4_PS(lo0, lo1, lo2, lo3);
+
+				__m128 hi0 = _mm_loadu_ps(matrices[4]->m[r]);
+				__m128 hi1 = _mm_loadu_ps(matrices[5]->m[r]);
+				__m128 hi2 = _mm_loadu_ps(matrices[6]->m[r]);
+				__m128 hi3 = _mm_loadu_ps(matrices[7]->m[r]);
+				_MM_TRANSPOSE4_PS(hi0, hi1, hi2, hi3);
+
+				x[3 * r] = _mm256_insertf128_ps(_mm256_castps128_ps256(lo0), hi0, 1);
+				x[3 * r + 1] = _mm256_insertf128_ps(_mm256_castps128_ps256(lo1), hi1, 1);
+				x[3 * r + 2] = _mm256_insertf128_ps(_mm256_castps128_ps256(lo2), hi2, 1);
+			}
+		}
+
+		static void StoreAffine(const V x[12], XMFLOAT4X4* m)
+		{
+			for(uint32 r = 0; r < 4; ++r)
+			{
+				__m128 w = _mm_set1_ps(r == 3 ? 1.0f : 0.0f);
+
+				__m128 lo0 = _mm256_castps256_ps128(x[3 * r]);
+				__m128 lo1 = _mm256_castps256_ps128(x[3 * r + 1]);
+				__m128 lo2 = _mm256_castps256_ps128(x[3 * r + 2]);
+				__m128 lo3 = w;
+				_MM_TRANSPOSE4_PS(lo0, lo1, lo2, lo3);
+
+				__m128 hi0 = _mm256_extractf128_ps(x[3 * r], 1);
+				__m128 hi1 = _mm256_extractf128_ps(x[3 * r + 1], 1);
+				__m128 hi2 = _mm256_extractf128_ps(x[3 * r + 2], 1);
+				__m128 hi3 = w;
+				_MM_TRANSPOSE4_PS(hi0, hi1, hi2, hi3);
+
+				_mm_storeu_ps(m[0].m[r], lo0);
+				_mm_storeu_ps(m[1].m[r], lo1);
+				_mm_storeu_ps(m[2].m[r], lo2);
+				_mm_storeu_ps(m[3].m[r], lo3);
+				_mm_storeu_ps(m[4].m[r], hi0);
+				_mm_storeu_ps(m[5].m[r], hi1);
+				_mm_storeu_ps(m[6].m[r], hi2);
+				_mm_storeu_ps(m[7].m[r], hi3);
+			}
+		}
+
+		static V Load(const float* p, std::size_t stride)
+		{
+			return _mm256_set_ps(*Advance(p, stride, 7), *Advance(p, stride, 6), *Advance(p, stride, 5),
+				*Advance(p, stride, 4), *Advance(p, stride, 3), *Advance(p, stride, 2), *Advance(p, stride, 1), *p);
+		}
+
+		static void Store(V v, float* p, std::size_t stride)
+		{
+			float lanes[8];
+			_mm256_storeu_ps(lanes, v);
+			for(uint32 j = 0; j < 8; ++j)
+				*AdvanceFloat(p, stride, j) = lanes[j];
+		}
+	};
+}
+
+const BatchMathKernels* Avx2BatchMathKernels()
+{
+	static const BatchMathKernels kernels = MakeBatchMathKernels<Avx2Lanes>();
+	return &kernels;
+}
+
+#else
+
+const BatchMathKernels* Avx2BatchMathKernels()
+{
+	return nullptr;
+}
+
+#endif
+
+#if defined(BATCHMATH_TARGET_PRAGMA)
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+#endif
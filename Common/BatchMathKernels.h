@@ -0,0 +1,449 @@
+//***************************************************************************************
+// BatchMathKernels.h
+//
+// The kernels behind BatchMath, written once over a lane type (one float, four in an
+// SSE register or eight in an AVX register) and included only by BatchMath.cpp and
+// BatchMathAvx2.cpp.  The templates are in an anonymous namespace on purpose: the AVX2
+// file is compiled for AVX2, and a shared instantiation could otherwise be the copy the
+// linker keeps for the scalar path too.
+//***************************************************************************************
+
+#pragma once
+
+#include "BatchMath.h"
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BATCHMATH_X86 1
+#else
+#define BATCHMATH_X86 0
+#endif
+
+// One path's kernels; each handles any count, finishing leftovers on the scalar path.
+struct BatchMathKernels
+{
+	void (*MultiplyAffine)(const DirectX::XMFLOAT4X4* a, std::size_t aStride,
+		const DirectX::XMFLOAT4X4* b, std::size_t bStride, DirectX::XMFLOAT4X4* out, std::uint32_t count);
+	void (*InverseAffine)(const DirectX::XMFLOAT4X4* m, std::size_t stride,
+		DirectX::XMFLOAT4X4* out, std::uint32_t count);
+	void (*ComposeTransforms)(const InstanceTransform* t, std::size_t stride,
+		DirectX::XMFLOAT4X4* out, std::uint32_t count);
+	void (*InverseTransforms)(const InstanceTransform* t, std::size_t stride,
+		DirectX::XMFLOAT4X4* out, std::uint32_t count);
+	void (*TransformBoxes)(const DirectX::BoundingBox* boxes, std::size_t boxStride,
+		const DirectX::XMFLOAT4X4* m, std::size_t stride, DirectX::BoundingBox* out, std::uint32_t count);
+	void (*TransformSpheres)(const DirectX::BoundingSphere* spheres, std::size_t sphereStride,
+		const DirectX::XMFLOAT4X4* m, std::size_t stride, DirectX::BoundingSphere* out, std::uint32_t count);
+	void (*CullBoxes)(const BatchMath::FrustumPlanes& planes, const DirectX::BoundingBox* boxes, std::size_t boxStride,
+		std::uint8_t* visible, std::uint32_t count);
+};
+
+// Null where the path is not compiled in (anything but x86 and x64).
+const BatchMathKernels* ScalarBatchMathKernels();
+const BatchMathKernels* SseBatchMathKernels();
+const BatchMathKernels* Avx2BatchMathKernels();
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	template<class T>
+	const T* Advance(const T* p, std::size_t stride, uint32 i)
+	{
+		return reinterpret_cast<const T*>(reinterpret_cast<const char*>(p) + stride * i);
+	}
+
+	inline float* AdvanceFloat(float* p, std::size_t stride, uint32 i)
+	{
+		return reinterpret_cast<float*>(reinterpret_cast<char*>(p) + stride * i);
+	}
+
+	// A lane type provides Width, the register type V and the arithmetic below, plus:
+	//   LoadAffine  - rows 0-3, columns 0-2 of Width matrices; element (r, c) of each
+	//                 matrix goes to lane j of x[3 * r + c].
+	//   StoreAffine - the reverse, into Width packed matrices with column 3 = (0, 0, 0, 1).
+	//   Load/Store  - one float per lane, lane j at p + j * stride bytes.
+	//   NegativeMask - bit j set where lane j is less than zero.
+	struct ScalarLanes
+	{
+		using V = float;
+		static const uint32 Width = 1;
+
+		static V Splat(float x) { return x; }
+		static V Add(V a, V b) { return a + b; }
+		static V Sub(V a, V b) { return a - b; }
+		static V Mul(V a, V b) { return a * b; }
+		static V MulAdd(V a, V b, V c) { return a * b + c; }
+		static V Div(V a, V b) { return a / b; }
+		static V Abs(V a) { return std::fabs(a); }
+		static V Max(V a, V b) { return a > b ? a : b; }
+		static V Sqrt(V a) { return std::sqrt(a); }
+		static uint32 NegativeMask(V a) { return a < 0.0f ? 1 : 0; }
+
+		static void LoadAffine(const DirectX::XMFLOAT4X4* m, std::size_t /*stride*/, V x[12])
+		{
+			for(uint32 r = 0; r < 4; ++r)
+			{
+				for(uint32 c = 0; c < 3; ++c)
+					x[3 * r + c] = m->m[r][c];
+			}
+		}
+
+		static void StoreAffine(const V x[12], DirectX::XMFLOAT4X4* m)
+		{
+			for(uint32 r = 0; r < 4; ++r)
+			{
+				for(uint32 c = 0; c < 3; ++c)
+					m->m[r][c] = x[3 * r + c];
+				m->m[r][3] = r == 3 ? 1.0f : 0.0f;
+			}
+		}
+
+		static V Load(const float* p, std::size_t /*stride*/) { return *p; }
+		static void Store(V v, float* p, std::size_t /*stride*/) { *p = v; }
+	};
+
+	template<class L>
+	void MultiplyAffine(const typename L::V a[12], const typename L::V b[12], typename L::V r[12])
+	{
+		for(uint32 i = 0; i < 4; ++i)
+		{
+			for(uint32 j = 0; j < 3; ++j)
+			{
+				typename L::V sum = L::Mul(a[3 * i + 2], b[6 + j]);
+				sum = L::MulAdd(a[3 * i + 1], b[3 + j], sum);
+				sum = L::MulAdd(a[3 * i], b[j], sum);
+				r[3 * i + j] = i == 3 ? L::Add(sum, b[9 + j]) : sum;
+			}
+		}
+	}
+
+	template<class L>
+	void InverseAffine(const typename L::V x[12], typename L::V r[12])
+	{
+		using V = typename L::V;
+
+		// Cofactors of the first row, which also give the determinant.
+		V c00 = L::Sub(L::Mul(x[4], x[8]), L::Mul(x[5], x[7]));
+		V c01 = L::Sub(L::Mul(x[5], x[6]), L::Mul(x[3], x[8]));
+		V c02 = L::Sub(L::Mul(x[3], x[7]), L::Mul(x[4], x[6]));
+		V det = L::MulAdd(x[0], c00, L::MulAdd(x[1], c01, L::Mul(x[2], c02)));
+		V invDet = L::Div(L::Splat(1.0f), det);
+
+		// The inverse of the 3x3 part is its adjugate over the determinant.
+		r[0] = L::Mul(c00, invDet);
+		r[1] = L::Mul(L::Sub(L::Mul(x[2], x[7]), L::Mul(x[1], x[8])), invDet);
+		r[2] = L::Mul(L::Sub(L::Mul(x[1], x[5]), L::Mul(x[2], x[4])), invDet);
+		r[3] = L::Mul(c01, invDet);
+		r[4] = L::Mul(L::Sub(L::Mul(x[0], x[8]), L::Mul(x[2], x[6])), invDet);
+		r[5] = L::Mul(L::Sub(L::Mul(x[2], x[3]), L::Mul(x[0], x[5])), invDet);
+		r[6] = L::Mul(c02, invDet);
+		r[7] = L::Mul(L::Sub(L::Mul(x[1], x[6]), L::Mul(x[0], x[7])), invDet);
+		r[8] = L::Mul(L::Sub(L::Mul(x[0], x[4]), L::Mul(x[1], x[3])), invDet);
+
+		// Translation: -t * inverse(3x3).
+		for(uint32 j = 0; j < 3; ++j)
+		{
+			V t = L::MulAdd(x[9], r[j], L::MulAdd(x[10], r[3 + j], L::Mul(x[11], r[6 + j])));
+			r[9 + j] = L::Sub(L::Splat(0.0f), t);
+		}
+	}
+
+	// The rotation matrix of Width quaternions, row r column c in x[3 * r + c].  Dividing
+	// by the squared length keeps quaternions that drifted from unit length rotating.
+	template<class L>
+	void LoadRotation(const InstanceTransform* t, std::size_t stride, typename L::V x[9])
+	{
+		using V = typename L::V;
+
+		V qx = L::Load(&t->Rotation.x, stride);
+		V qy = L::Load(&t->Rotation.y, stride);
+		V qz = L::Load(&t->Rotation.z, stride);
+		V qw = L::Load(&t->Rotation.w, stride);
+
+		V k = L::Div(L::Splat(2.0f), L::MulAdd(qx, qx, L::MulAdd(qy, qy, L::MulAdd(qz, qz, L::Mul(qw, qw)))));
+		V kx = L::Mul(k, qx);
+		V ky = L::Mul(k, qy);
+		V kz = L::Mul(k, qz);
+
+		V xx = L::Mul(kx, qx), yy = L::Mul(ky, qy), zz = L::Mul(kz, qz);
+		V xy = L::Mul(kx, qy), xz = L::Mul(kx, qz), yz = L::Mul(ky, qz);
+		V xw = L::Mul(kx, qw), yw = L::Mul(ky, qw), zw = L::Mul(kz, qw);
+		V one = L::Splat(1.0f);
+
+		// As XMMatrixRotationQuaternion.
+		x[0] = L::Sub(one, L::Add(yy, zz));
+		x[1] = L::Add(xy, zw);
+		x[2] = L::Sub(xz, yw);
+		x[3] = L::Sub(xy, zw);
+		x[4] = L::Sub(one, L::Add(xx, zz));
+		x[5] = L::Add(yz, xw);
+		x[6] = L::Add(xz, yw);
+		x[7] = L::Sub(yz, xw);
+		x[8] = L::Sub(one, L::Add(xx, yy));
+	}
+
+	// p transformed as a point: p * (3x3) + translation.
+	template<class L>
+	typename L::V TransformCoord(const typename L::V p[3], const typename L::V x[12], uint32 j)
+	{
+		return L::MulAdd(p[0], x[j], L::MulAdd(p[1], x[3 + j], L::MulAdd(p[2], x[6 + j], x[9 + j])));
+	}
+
+	template<class L>
+	uint32 MultiplyAffineLanes(const DirectX::XMFLOAT4X4* a, std::size_t aStride,
+		const DirectX::XMFLOAT4X4* b, std::size_t bStride, DirectX::XMFLOAT4X4* out, uint32 count)
+	{
+		uint32 i = 0;
+		for(; i + L::Width <= count; i += L::Width)
+		{
+			typename L::V x[12], y[12], r[12];
+			L::LoadAffine(Advance(a, aStride, i), aStride, x);
+			L::LoadAffine(Advance(b, bStride, i), bStride, y);
+			MultiplyAffine<L>(x, y, r);
+			L::StoreAffine(r, out + i);
+		}
+		return i;
+	}
+
+	template<class L>
+	uint32 InverseAffineLanes(const DirectX::XMFLOAT4X4* m, std::size_t stride,
+		DirectX::XMFLOAT4X4* out, uint32 count)
+	{
+		uint32 i = 0;
+		for(; i + L::Width <= count; i += L::Width)
+		{
+			typename L::V x[12], r[12];
+			L::LoadAffine(Advance(m, stride, i), stride, x);
+			InverseAffine<L>(x, r);
+			L::StoreAffine(r, out + i);
+		}
+		return i;
+	}
+
+	template<class L>
+	uint32 ComposeTransformsLanes(const InstanceTransform* t, std::size_t stride, DirectX::XMFLOAT4X4* out, uint32 count)
+	{
+		uint32 i = 0;
+		for(; i + L::Width <= count; i += L::Width)
+		{
+			const InstanceTransform* first = Advance(t, stride, i);
+
+			typename L::V x[12];
+			LoadRotation<L>(first, stride, x);
+
+			// Scale * rotation scales row r of the rotation by scale r.
+			for(uint32 r = 0; r < 3; ++r)
+			{
+				typename L::V scale = L::Load(&first->Scale.x + r, stride);
+				for(uint32 c = 0; c < 3; ++c)
+					x[3 * r + c] = L::Mul(x[3 * r + c], scale);
+				x[9 + r] = L::Load(&first->Translation.x + r, stride);
+			}
+
+			L::StoreAffine(x, out + i);
+		}
+		return i;
+	}
+
+	template<class L>
+	uint32 InverseTransformsLanes(const InstanceTransform* t, std::size_t stride, DirectX::XMFLOAT4X4* out, uint32 count)
+	{
+		using V = typename L::V;
+
+		uint32 i = 0;
+		for(; i + L::Width <= count; i += L::Width)
+		{
+			const InstanceTransform* first = Advance(t, stride, i);
+
+			V rotation[9], r[12];
+			LoadRotation<L>(first, stride, rotation);
+
+			// inverse(S * R * T) = inverse(T) * transpose(R) * inverse(S).
+			for(uint32 c = 0; c < 3; ++c)
+			{
+				V invScale = L::Div(L::Splat(1.0f), L::Load(&first->Scale.x + c, stride));
+				for(uint32 row = 0; row < 3; ++row)
+					r[3 * row + c] = L::Mul(rotation[3 * c + row], invScale);
+			}
+
+			V translation[3];
+			for(uint32 k = 0; k < 3; ++k)
+				translation[k] = L::Load(&first->Translation.x + k, stride);
+
+			for(uint32 c = 0; c < 3; ++c)
+			{
+				V p = L::MulAdd(translation[0], r[c], L::MulAdd(translation[1], r[3 + c], L::Mul(translation[2], r[6 + c])));
+				r[9 + c] = L::Sub(L::Splat(0.0f), p);
+			}
+
+			L::StoreAffine(r, out + i);
+		}
+		return i;
+	}
+
+	template<class L>
+	uint32 TransformBoxesLanes(const DirectX::BoundingBox* boxes, std::size_t boxStride,
+		const DirectX::XMFLOAT4X4* m, std::size_t stride, DirectX::BoundingBox* out, uint32 count)
+	{
+		uint32 i = 0;
+		for(; i + L::Width <= count; i += L::Width)
+		{
+			typename L::V x[12], center[3], extents[3];
+			L::LoadAffine(Advance(m, stride, i), stride, x);
+
+			const DirectX::BoundingBox* box = Advance(boxes, boxStride, i);
+			for(uint32 k = 0; k < 3; ++k)
+			{
+				center[k] = L::Load(&box->Center.x + k, boxStride);
+				extents[k] = L::Load(&box->Extents.x + k, boxStride);
+			}
+
+			// Each new extent is the sum of the old extents scaled by the absolute values
+			// of its column, which bounds all eight transformed corners at once.
+			for(uint32 j = 0; j < 3; ++j)
+			{
+				typename L::V extent = L::MulAdd(extents[0], L::Abs(x[j]),
+					L::MulAdd(extents[1], L::Abs(x[3 + j]), L::Mul(extents[2], L::Abs(x[6 + j]))));
+
+				L::Store(TransformCoord<L>(center, x, j), &out[i].Center.x + j, sizeof(DirectX::BoundingBox));
+				L::Store(extent, &out[i].Extents.x + j, sizeof(DirectX::BoundingBox));
+			}
+		}
+		return i;
+	}
+
+	template<class L>
+	uint32 TransformSpheresLanes(const DirectX::BoundingSphere* spheres, std::size_t sphereStride,
+		const DirectX::XMFLOAT4X4* m, std::size_t stride, DirectX::BoundingSphere* out, uint32 count)
+	{
+		uint32 i = 0;
+		for(; i + L::Width <= count; i += L::Width)
+		{
+			typename L::V x[12], center[3];
+			L::LoadAffine(Advance(m, stride, i), stride, x);
+
+			const DirectX::BoundingSphere* sphere = Advance(spheres, sphereStride, i);
+			for(uint32 k = 0; k < 3; ++k)
+				center[k] = L::Load(&sphere->Center.x + k, sphereStride);
+			typename L::V radius = L::Load(&sphere->Radius, sphereStride);
+
+			typename L::V scale = L::Splat(0.0f);
+			for(uint32 r = 0; r < 3; ++r)
+			{
+				typename L::V lengthSq = L::MulAdd(x[3 * r], x[3 * r],
+					L::MulAdd(x[3 * r + 1], x[3 * r + 1], L::Mul(x[3 * r + 2], x[3 * r + 2])));
+				scale = L::Max(scale, lengthSq);
+			}
+
+			for(uint32 j = 0; j < 3; ++j)
+				L::Store(TransformCoord<L>(center, x, j), &out[i].Center.x + j, sizeof(DirectX::BoundingSphere));
+			L::Store(L::Mul(radius, L::Sqrt(scale)), &out[i].Radius, sizeof(DirectX::BoundingSphere));
+		}
+		return i;
+	}
+
+	template<class L>
+	uint32 CullBoxesLanes(const BatchMath::FrustumPlanes& planes, const DirectX::BoundingBox* boxes, std::size_t boxStride,
+		std::uint8_t* visible, uint32 count)
+	{
+		uint32 i = 0;
+		for(; i + L::Width <= count; i += L::Width)
+		{
+			typename L::V center[3], extents[3];
+			const DirectX::BoundingBox* box = Advance(boxes, boxStride, i);
+			for(uint32 k = 0; k < 3; ++k)
+			{
+				center[k] = L::Load(&box->Center.x + k, boxStride);
+				extents[k] = L::Load(&box->Extents.x + k, boxStride);
+			}
+
+			// A box is outside a plane when its center is further behind it than the box
+			// reaches along the plane normal.
+			uint32 outside = 0;
+			for(uint32 p = 0; p < BatchMath::FrustumPlanes::Count; ++p)
+			{
+				typename L::V distance = L::MulAdd(center[0], L::Splat(planes.A[p]),
+					L::MulAdd(center[1], L::Splat(planes.B[p]), L::MulAdd(center[2], L::Splat(planes.C[p]), L::Splat(planes.D[p]))));
+				typename L::V reach = L::MulAdd(extents[0], L::Splat(std::fabs(planes.A[p])),
+					L::MulAdd(extents[1], L::Splat(std::fabs(planes.B[p])), L::Mul(extents[2], L::Splat(std::fabs(planes.C[p])))));
+				outside |= L::NegativeMask(L::Add(distance, reach));
+			}
+
+			for(uint32 j = 0; j < L::Width; ++j)
+				visible[i + j] = (outside >> j) & 1 ? 0 : 1;
+		}
+		return i;
+	}
+
+	// Runs the lanes of L, then the scalar lanes for whatever is left.
+	template<class L>
+	void MultiplyAffineAll(const DirectX::XMFLOAT4X4* a, std::size_t aStride,
+		const DirectX::XMFLOAT4X4* b, std::size_t bStride, DirectX::XMFLOAT4X4* out, uint32 count)
+	{
+		uint32 done = MultiplyAffineLanes<L>(a, aStride, b, bStride, out, count);
+		MultiplyAffineLanes<ScalarLanes>(Advance(a, aStride, done), aStride, Advance(b, bStride, done), bStride,
+			out + done, count - done);
+	}
+
+	template<class L>
+	void InverseAffineAll(const DirectX::XMFLOAT4X4* m, std::size_t stride, DirectX::XMFLOAT4X4* out, uint32 count)
+	{
+		uint32 done = InverseAffineLanes<L>(m, stride, out, count);
+		InverseAffineLanes<ScalarLanes>(Advance(m, stride, done), stride, out + done, count - done);
+	}
+
+	template<class L>
+	void ComposeTransformsAll(const InstanceTransform* t, std::size_t stride, DirectX::XMFLOAT4X4* out, uint32 count)
+	{
+		uint32 done = ComposeTransformsLanes<L>(t, stride, out, count);
+		ComposeTransformsLanes<ScalarLanes>(Advance(t, stride, done), stride, out + done, count - done);
+	}
+
+	template<class L>
+	void InverseTransformsAll(const InstanceTransform* t, std::size_t stride, DirectX::XMFLOAT4X4* out, uint32 count)
+	{
+		uint32 done = InverseTransformsLanes<L>(t, stride, out, count);
+		InverseTransformsLanes<ScalarLanes>(Advance(t, stride, done), stride, out + done, count - done);
+	}
+
+	template<class L>
+	void TransformBoxesAll(const DirectX::BoundingBox* boxes, std::size_t boxStride,
+		const DirectX::XMFLOAT4X4* m, std::size_t stride, DirectX::BoundingBox* out, uint32 count)
+	{
+		uint32 done = TransformBoxesLanes<L>(boxes, boxStride, m, stride, out, count);
+		TransformBoxesLanes<ScalarLanes>(Advance(boxes, boxStride, done), boxStride, Advance(m, stride, done), stride,
+			out + done, count - done);
+	}
+
+	template<class L>
+	void TransformSpheresAll(const DirectX::BoundingSphere* spheres, std::size_t sphereStride,
+		const DirectX::XMFLOAT4X4* m, std::size_t stride, DirectX::BoundingSphere* out, uint32 count)
+	{
+		uint32 done = TransformSpheresLanes<L>(spheres, sphereStride, m, stride, out, count);
+		TransformSpheresLanes<ScalarLanes>(Advance(spheres, sphereStride, done), sphereStride, Advance(m, stride, done), stride,
+			out + done, count - done);
+	}
+
+	template<class L>
+	void CullBoxesAll(const BatchMath::FrustumPlanes& planes, const DirectX::BoundingBox* boxes, std::size_t boxStride,
+		std::uint8_t* visible, uint32 count)
+	{
+		uint32 done = CullBoxesLanes<L>(planes, boxes, boxStride, visible, count);
+		CullBoxesLanes<ScalarLanes>(planes, Advance(boxes, boxStride, done), boxStride, visible + done, count - done);
+	}
+
+	template<class L>
+	BatchMathKernels MakeBatchMathKernels()
+	{
+		BatchMathKernels kernels;
+		kernels.MultiplyAffine = &MultiplyAffineAll<L>;
+		kernels.InverseAffine = &InverseAffineAll<L>;
+		kernels.ComposeTransforms = &ComposeTransformsAll<L>;
+		kernels.InverseTransforms = &InverseTransformsAll<L>;
+		kernels.TransformBoxes = &TransformBoxesAll<L>;
+		kernels.TransformSpheres = &TransformSpheresAll<L>;
+		kernels.CullBoxes = &CullBoxesAll<L>;
+		return kernels;
+	}
+}
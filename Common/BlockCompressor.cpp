@@ -0,0 +1,682 @@
+//***************************************************************************************
+// BlockCompressor.cpp
+//***************************************************************************************
+
+#include "BlockCompressor.h"
+#include "FileUtil.h"
+#include "ThreadPool.h"
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	using uint8 = std::uint8_t;
+	using uint16 = std::uint16_t;
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	// Rows of blocks per ParallelFor chunk.
+	const uint32 GrainSize = 4;
+
+	// The 16 texels of a block, rows first, split by channel so four texels fill one
+	// XMVECTOR.
+	struct Block
+	{
+		XMFLOAT4A R[4];
+		XMFLOAT4A G[4];
+		XMFLOAT4A B[4];
+		XMFLOAT4A A[4];
+	};
+
+	float& Texel(XMFLOAT4A* channel, uint32 i)
+	{
+		return (&channel[i / 4].x)[i % 4];
+	}
+
+	float Texel(const XMFLOAT4A* channel, uint32 i)
+	{
+		return (&channel[i / 4].x)[i % 4];
+	}
+
+	void LoadBlock(const BlockCompressor::Image& image, uint32 blockX, uint32 blockY, Block& block)
+	{
+		for(uint32 y = 0; y < 4; ++y)
+		{
+			uint32 sy = std::min(blockY * 4 + y, image.Height - 1);
+			const uint8* row = image.Pixels + (std::size_t)sy * image.RowPitch;
+
+			for(uint32 x = 0; x < 4; ++x)
+			{
+				uint32 sx = std::min(blockX * 4 + x, image.Width - 1);
+				const uint8* texel = row + sx * 4;
+
+				uint32 i = y * 4 + x;
+				Texel(block.R, i) = texel[0];
+				Texel(block.G, i) = texel[1];
+				Texel(block.B, i) = texel[2];
+				Texel(block.A, i) = texel[3];
+			}
+		}
+	}
+
+	float SumLanes(FXMVECTOR v)
+	{
+		return XMVectorGetX(XMVector4Dot(v, XMVectorSplatOne()));
+	}
+
+	//
+	// BC1 color blocks.
+	//
+
+	uint16 QuantizeColor(FXMVECTOR color)
+	{
+		const XMVECTORF32 scale = { { { 31.0f / 255.0f, 63.0f / 255.0f, 31.0f / 255.0f, 0.0f } } };
+		const XMVECTORF32 maxValue = { { { 31.0f, 63.0f, 31.0f, 0.0f } } };
+
+		XMFLOAT4 q;
+		XMStoreFloat4(&q, XMVectorClamp(XMVectorRound(XMVectorMultiply(color, scale)), XMVectorZero(), maxValue));
+		return (uint16)(((uint32)q.x << 11) | ((uint32)q.y << 5) | (uint32)q.z);
+	}
+
+	// The color the hardware decodes for a quantized endpoint.
+	XMVECTOR ExpandColor(uint16 color)
+	{
+		uint32 r = (color >> 11) & 31;
+		uint32 g = (color >> 5) & 63;
+		uint32 b = color & 31;
+		return XMVectorSet((float)((r << 3) | (r >> 2)), (float)((g << 2) | (g >> 4)), (float)((b << 3) | (b >> 2)), 0.0f);
+	}
+
+	void ColorEndpoints(const Block& block, BlockCompressor::Quality quality, XMVECTOR& c0, XMVECTOR& c1)
+	{
+		XMVECTOR minColor = XMVectorReplicate(255.0f);
+		XMVECTOR maxColor = XMVectorZero();
+		XMVECTOR sum = XMVectorZero();
+
+		for(uint32 i = 0; i < 16; ++i)
+		{
+			XMVECTOR color = XMVectorSet(Texel(block.R, i), Texel(block.G, i), Texel(block.B, i), 0.0f);
+			minColor = XMVectorMin(minColor, color);
+			maxColor = XMVectorMax(maxColor, color);
+			sum = XMVectorAdd(sum, color);
+		}
+
+		if(quality == BlockCompressor::Quality::Fast)
+		{
+			XMVECTOR inset = XMVectorScale(XMVectorSubtract(maxColor, minColor), 1.0f / 16.0f);
+			c0 = XMVectorSubtract(maxColor, inset);
+			c1 = XMVectorAdd(minColor, inset);
+			return;
+		}
+
+		// Covariance of the channels, four texels at a time.
+		XMVECTOR mean = XMVectorScale(sum, 1.0f / 16.0f);
+		XMVECTOR meanR = XMVectorSplatX(mean);
+		XMVECTOR meanG = XMVectorSplatY(mean);
+		XMVECTOR meanB = XMVectorSplatZ(mean);
+
+		XMVECTOR rr = XMVectorZero(), rg = XMVectorZero(), rb = XMVectorZero();
+		XMVECTOR gg = XMVectorZero(), gb = XMVectorZero(), bb = XMVectorZero();
+		for(uint32 i = 0; i < 4; ++i)
+		{
+			XMVECTOR r = XMVectorSubtract(XMLoadFloat4A(&block.R[i]), meanR);
+			XMVECTOR g = XMVectorSubtract(XMLoadFloat4A(&block.G[i]), meanG);
+			XMVECTOR b = XMVectorSubtract(XMLoadFloat4A(&block.B[i]), meanB);
+
+			rr = XMVectorMultiplyAdd(r, r, rr);
+			rg = XMVectorMultiplyAdd(r, g, rg);
+			rb = XMVectorMultiplyAdd(r, b, rb);
+			gg = XMVectorMultiplyAdd(g, g, gg);
+			gb = XMVectorMultiplyAdd(g, b, gb);
+			bb = XMVectorMultiplyAdd(b, b, bb);
+		}
+
+		float varianceR = SumLanes(rr);
+		float varianceG = SumLanes(gg);
+		float varianceB = SumLanes(bb);
+		XMMATRIX covariance(
+			varianceR, SumLanes(rg), SumLanes(rb), 0.0f,
+			SumLanes(rg), varianceG, SumLanes(gb), 0.0f,
+			SumLanes(rb), SumLanes(gb), varianceB, 0.0f,
+			0.0f, 0.0f, 0.0f, 0.0f);
+
+		// Principal axis by power iteration, starting from the covariance row of the
+		// channel that varies most.  The bounding box diagonal would not do: when channels
+		// are anticorrelated it can be orthogonal to the axis.
+		XMVECTOR axis = covariance.r[0];
+		if(varianceG > varianceR && varianceG >= varianceB)
+			axis = covariance.r[1];
+		else if(varianceB > varianceR && varianceB > varianceG)
+			axis = covariance.r[2];
+		for(uint32 i = 0; i < 8; ++i)
+		{
+			XMVECTOR next = XMVector3TransformNormal(axis, covariance);
+			float length = XMVectorGetX(XMVector3Length(next));
+			if(length < 1e-6f)
+				break;
+
+			axis = XMVectorScale(next, 1.0f / length);
+		}
+
+		axis = XMVector3Normalize(axis);
+		if(XMVector3Equal(axis, XMVectorZero()) || XMVector3IsNaN(axis))
+		{
+			c0 = c1 = mean;
+			return;
+		}
+
+		// Extent of the texels along the axis.
+		XMVECTOR axisR = XMVectorSplatX(axis);
+		XMVECTOR axisG = XMVectorSplatY(axis);
+		XMVECTOR axisB = XMVectorSplatZ(axis);
+
+		XMVECTOR minT = XMVectorReplicate(FLT_MAX);
+		XMVECTOR maxT = XMVectorReplicate(-FLT_MAX);
+		for(uint32 i = 0; i < 4; ++i)
+		{
+			XMVECTOR t = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4A(&block.R[i]), meanR), axisR);
+			t = XMVectorMultiplyAdd(XMVectorSubtract(XMLoadFloat4A(&block.G[i]), meanG), axisG, t);
+			t = XMVectorMultiplyAdd(XMVectorSubtract(XMLoadFloat4A(&block.B[i]), meanB), axisB, t);
+
+			minT = XMVectorMin(minT, t);
+			maxT = XMVectorMax(maxT, t);
+		}
+
+		XMFLOAT4 minLanes, maxLanes;
+		XMStoreFloat4(&minLanes, minT);
+		XMStoreFloat4(&maxLanes, maxT);
+		float t0 = std::max(std::max(maxLanes.x, maxLanes.y), std::max(maxLanes.z, maxLanes.w));
+		float t1 = std::min(std::min(minLanes.x, minLanes.y), std::min(minLanes.z, minLanes.w));
+
+		c0 = XMVectorClamp(XMVectorMultiplyAdd(axis, XMVectorReplicate(t0), mean), XMVectorZero(), XMVectorReplicate(255.0f));
+		c1 = XMVectorClamp(XMVectorMultiplyAdd(axis, XMVectorReplicate(t1), mean), XMVectorZero(), XMVectorReplicate(255.0f));
+	}
+
+	// Picks the nearest palette color from c0 to c1 for every texel and returns the
+	// squared error.  steps is 3 for the four color mode, whose palette is spaced in
+	// thirds, and 2 for the three color mode, which has c0, c1 and their midpoint (its
+	// fourth entry, transparent black, is never picked).  The palette lies on a line, so
+	// the nearest color is the one nearest to the texel's projection onto it.
+	float ColorIndices(const Block& block, FXMVECTOR c0, FXMVECTOR c1, uint32 steps, uint32& indices)
+	{
+		// Steps from c0 to c1, in the order of the BC1 index.
+		static const uint32 ThirdToIndex[4] = { 0, 2, 3, 1 };
+		static const uint32 HalfToIndex[3] = { 0, 2, 1 };
+		const uint32* stepToIndex = steps == 3 ? ThirdToIndex : HalfToIndex;
+
+		XMVECTOR dir = XMVectorSubtract(c1, c0);
+		float lengthSq = XMVectorGetX(XMVector3LengthSq(dir));
+		XMVECTOR scale = XMVectorReplicate(lengthSq > 0.0f ? (float)steps / lengthSq : 0.0f);
+
+		XMVECTOR c0R = XMVectorSplatX(c0), c0G = XMVectorSplatY(c0), c0B = XMVectorSplatZ(c0);
+		XMVECTOR dirR = XMVectorSplatX(dir), dirG = XMVectorSplatY(dir), dirB = XMVectorSplatZ(dir);
+
+		indices = 0;
+		XMVECTOR error = XMVectorZero();
+		for(uint32 i = 0; i < 4; ++i)
+		{
+			XMVECTOR r = XMVectorSubtract(XMLoadFloat4A(&block.R[i]), c0R);
+			XMVECTOR g = XMVectorSubtract(XMLoadFloat4A(&block.G[i]), c0G);
+			XMVECTOR b = XMVectorSubtract(XMLoadFloat4A(&block.B[i]), c0B);
+
+			XMVECTOR t = XMVectorMultiply(r, dirR);
+			t = XMVectorMultiplyAdd(g, dirG, t);
+			t = XMVectorMultiplyAdd(b, dirB, t);
+			XMVECTOR step = XMVectorClamp(XMVectorRound(XMVectorMultiply(t, scale)), XMVectorZero(),
+				XMVectorReplicate((float)steps));
+
+			// Distance to the chosen palette color.
+			XMVECTOR w = XMVectorScale(step, 1.0f / (float)steps);
+			r = XMVectorNegativeMultiplySubtract(w, dirR, r);
+			g = XMVectorNegativeMultiplySubtract(w, dirG, g);
+			b = XMVectorNegativeMultiplySubtract(w, dirB, b);
+			error = XMVectorMultiplyAdd(r, r, error);
+			error = XMVectorMultiplyAdd(g, g, error);
+			error = XMVectorMultiplyAdd(b, b, error);
+
+			XMFLOAT4 lanes;
+			XMStoreFloat4(&lanes, step);
+			indices |= stepToIndex[(uint32)lanes.x] << (8 * i + 0);
+			indices |= stepToIndex[(uint32)lanes.y] << (8 * i + 2);
+			indices |= stepToIndex[(uint32)lanes.z] << (8 * i + 4);
+			indices |= stepToIndex[(uint32)lanes.w] << (8 * i + 6);
+		}
+
+		return SumLanes(error);
+	}
+
+	// Endpoints that minimize the squared error for the given indices, or false if the
+	// indices do not determine them (all texels on one step).
+	bool RefitColorEndpoints(const Block& block, uint32 indices, XMVECTOR& c0, XMVECTOR& c1)
+	{
+		static const float IndexToWeight[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+		float alpha2 = 0.0f, beta2 = 0.0f, alphaBeta = 0.0f;
+		XMVECTOR alphaX = XMVectorZero();
+		XMVECTOR betaX = XMVectorZero();
+
+		for(uint32 i = 0; i < 16; ++i)
+		{
+			float alpha = IndexToWeight[(indices >> (2 * i)) & 3];
+			float beta = 1.0f - alpha;
+			XMVECTOR color = XMVectorSet(Texel(block.R, i), Texel(block.G, i), Texel(block.B, i), 0.0f);
+
+			alpha2 += alpha * alpha;
+			beta2 += beta * beta;
+			alphaBeta += alpha * beta;
+			alphaX = XMVectorMultiplyAdd(XMVectorReplicate(alpha), color, alphaX);
+			betaX = XMVectorMultiplyAdd(XMVectorReplicate(beta), color, betaX);
+		}
+
+		float det = alpha2 * beta2 - alphaBeta * alphaBeta;
+		if(std::abs(det) < 1e-6f)
+			return false;
+
+		float invDet = 1.0f / det;
+		c0 = XMVectorScale(XMVectorSubtract(XMVectorScale(alphaX, beta2), XMVectorScale(betaX, alphaBeta)), invDet);
+		c1 = XMVectorScale(XMVectorSubtract(XMVectorScale(betaX, alpha2), XMVectorScale(alphaX, alphaBeta)), invDet);
+		c0 = XMVectorClamp(c0, XMVectorZero(), XMVectorReplicate(255.0f));
+		c1 = XMVectorClamp(c1, XMVectorZero(), XMVectorReplicate(255.0f));
+		return true;
+	}
+
+	// Quantizes the endpoints and picks indices.  The first endpoint is kept the larger
+	// for the four color mode (BC3 color blocks always use that mode) and the smaller for
+	// the three color mode, which only BC1 has.
+	float EncodeColorEndpoints(const Block& block, FXMVECTOR c0, FXMVECTOR c1, bool threeColor,
+		uint16& q0, uint16& q1, uint32& indices)
+	{
+		q0 = QuantizeColor(c0);
+		q1 = QuantizeColor(c1);
+		if(threeColor ? q0 > q1 : q0 < q1)
+			std::swap(q0, q1);
+
+		if(q0 == q1)
+		{
+			// A single color; every index 0 decodes to it in either mode.
+			indices = 0;
+			uint32 unused;
+			return ColorIndices(block, ExpandColor(q0), ExpandColor(q0), 3, unused);
+		}
+
+		return ColorIndices(block, ExpandColor(q0), ExpandColor(q1), threeColor ? 2 : 3, indices);
+	}
+
+	void EncodeColorBlock(const Block& block, BlockCompressor::Quality quality, bool allowThreeColor, uint8* out)
+	{
+		XMVECTOR c0, c1;
+		ColorEndpoints(block, quality, c0, c1);
+
+		uint16 q0, q1;
+		uint32 indices;
+		float error = EncodeColorEndpoints(block, c0, c1, false, q0, q1, indices);
+
+		if(quality == BlockCompressor::Quality::High)
+		{
+			for(uint32 iteration = 0; iteration < 2 && error > 0.0f; ++iteration)
+			{
+				if(!RefitColorEndpoints(block, indices, c0, c1))
+					break;
+
+				uint16 r0, r1;
+				uint32 refitIndices;
+				float refitError = EncodeColorEndpoints(block, c0, c1, false, r0, r1, refitIndices);
+				if(refitError >= error)
+					break;
+
+				q0 = r0;
+				q1 = r1;
+				indices = refitIndices;
+				error = refitError;
+			}
+
+			// Texels at both ends and halfway between them fit the three color mode
+			// exactly, where the four color mode would be a sixth of the way off.
+			if(allowThreeColor && error > 0.0f)
+			{
+				ColorEndpoints(block, quality, c0, c1);
+
+				uint16 t0, t1;
+				uint32 threeIndices;
+				float threeError = EncodeColorEndpoints(block, c0, c1, true, t0, t1, threeIndices);
+				if(threeError < error)
+				{
+					q0 = t0;
+					q1 = t1;
+					indices = threeIndices;
+				}
+			}
+		}
+
+		std::memcpy(out + 0, &q0, 2);
+		std::memcpy(out + 2, &q1, 2);
+		std::memcpy(out + 4, &indices, 4);
+	}
+
+	//
+	// BC4 single channel blocks.
+	//
+
+	// The eight values a block with endpoints a0 and a1 decodes to.
+	void Bc4Palette(uint32 a0, uint32 a1, uint32 palette[8])
+	{
+		palette[0] = a0;
+		palette[1] = a1;
+
+		if(a0 > a1)
+		{
+			for(uint32 i = 2; i < 8; ++i)
+				palette[i] = ((8 - i) * a0 + (i - 1) * a1 + 3) / 7;
+		}
+		else
+		{
+			for(uint32 i = 2; i < 6; ++i)
+				palette[i] = ((6 - i) * a0 + (i - 1) * a1 + 2) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	// Nearest palette value of every texel, searched exhaustively.
+	uint32 Bc4NearestIndices(const XMFLOAT4A* channel, uint32 a0, uint32 a1, uint64& indices)
+	{
+		uint32 palette[8];
+		Bc4Palette(a0, a1, palette);
+
+		indices = 0;
+		uint32 error = 0;
+		for(uint32 i = 0; i < 16; ++i)
+		{
+			int value = (int)Texel(channel, i);
+
+			uint32 best = 0;
+			int bestError = INT_MAX;
+			for(uint32 p = 0; p < 8; ++p)
+			{
+				int d = value - (int)palette[p];
+				if(d * d < bestError)
+				{
+					best = p;
+					bestError = d * d;
+				}
+			}
+
+			indices |= (uint64)best << (3 * i);
+			error += (uint32)bestError;
+		}
+
+		return error;
+	}
+
+	// Indices of the eight value mode from the texels' positions between a1 and a0.
+	void Bc4ProjectedIndices(const XMFLOAT4A* channel, uint32 a0, uint32 a1, uint64& indices)
+	{
+		// Sevenths of a0 to the index; 7 is a0, 0 is a1.
+		static const uint32 StepToIndex[8] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+
+		XMVECTOR base = XMVectorReplicate((float)a1);
+		XMVECTOR scale = XMVectorReplicate(7.0f / (float)(a0 - a1));
+
+		indices = 0;
+		for(uint32 i = 0; i < 4; ++i)
+		{
+			XMVECTOR t = XMVectorMultiply(XMVectorSubtract(XMLoadFloat4A(&channel[i]), base), scale);
+			XMVECTOR step = XMVectorClamp(XMVectorRound(t), XMVectorZero(), XMVectorReplicate(7.0f));
+
+			XMFLOAT4 steps;
+			XMStoreFloat4(&steps, step);
+			indices |= (uint64)StepToIndex[(uint32)steps.x] << (12 * i + 0);
+			indices |= (uint64)StepToIndex[(uint32)steps.y] << (12 * i + 3);
+			indices |= (uint64)StepToIndex[(uint32)steps.z] << (12 * i + 6);
+			indices |= (uint64)StepToIndex[(uint32)steps.w] << (12 * i + 9);
+		}
+	}
+
+	void EncodeBc4Block(const XMFLOAT4A* channel, BlockCompressor::Quality quality, uint8* out)
+	{
+		XMVECTOR minValue = XMLoadFloat4A(&channel[0]);
+		XMVECTOR maxValue = minValue;
+		for(uint32 i = 1; i < 4; ++i)
+		{
+			minValue = XMVectorMin(minValue, XMLoadFloat4A(&channel[i]));
+			maxValue = XMVectorMax(maxValue, XMLoadFloat4A(&channel[i]));
+		}
+
+		XMFLOAT4 minLanes, maxLanes;
+		XMStoreFloat4(&minLanes, minValue);
+		XMStoreFloat4(&maxLanes, maxValue);
+		uint32 lo = (uint32)std::min(std::min(minLanes.x, minLanes.y), std::min(minLanes.z, minLanes.w));
+		uint32 hi = (uint32)std::max(std::max(maxLanes.x, maxLanes.y), std::max(maxLanes.z, maxLanes.w));
+
+		// Eight value mode over the full range.
+		uint32 a0 = hi;
+		uint32 a1 = lo;
+		uint64 indices = 0;
+
+		if(a0 > a1)
+		{
+			if(quality == BlockCompressor::Quality::High)
+			{
+				uint32 error = Bc4NearestIndices(channel, a0, a1, indices);
+
+				// Six value mode over the texels other than 0 and 255, which it has exactly.
+				uint32 innerLo = 255, innerHi = 0;
+				for(uint32 i = 0; i < 16; ++i)
+				{
+					uint32 value = (uint32)Texel(channel, i);
+					if(value != 0 && value != 255)
+					{
+						innerLo = std::min(innerLo, value);
+						innerHi = std::max(innerHi, value);
+					}
+				}
+
+				if(innerLo > innerHi)
+					innerLo = innerHi = 0;
+
+				uint64 sixIndices;
+				uint32 sixError = Bc4NearestIndices(channel, innerLo, innerHi, sixIndices);
+				if(sixError < error)
+				{
+					a0 = innerLo;
+					a1 = innerHi;
+					indices = sixIndices;
+				}
+			}
+			else
+			{
+				Bc4ProjectedIndices(channel, a0, a1, indices);
+			}
+		}
+
+		out[0] = (uint8)a0;
+		out[1] = (uint8)a1;
+		for(uint32 i = 0; i < 6; ++i)
+			out[2 + i] = (uint8)(indices >> (8 * i));
+	}
+
+	void EncodeBlock(const Block& block, BlockCompressor::Format format, BlockCompressor::Quality quality, uint8* out)
+	{
+		switch(format)
+		{
+		case BlockCompressor::Format::BC1:
+			EncodeColorBlock(block, quality, true, out);
+			break;
+
+		case BlockCompressor::Format::BC3:
+			EncodeBc4Block(block.A, quality, out);
+			EncodeColorBlock(block, quality, false, out + 8);
+			break;
+
+		case BlockCompressor::Format::BC5:
+			EncodeBc4Block(block.R, quality, out);
+			EncodeBc4Block(block.G, quality, out + 8);
+			break;
+		}
+	}
+
+	//
+	// DDS files.
+	//
+
+#pragma pack(push, 1)
+
+	struct DdsPixelFormat
+	{
+		uint32 Size;
+		uint32 Flags;
+		uint32 FourCC;
+		uint32 RGBBitCount;
+		uint32 RBitMask;
+		uint32 GBitMask;
+		uint32 BBitMask;
+		uint32 ABitMask;
+	};
+
+	struct DdsHeader
+	{
+		uint32 Size;
+		uint32 Flags;
+		uint32 Height;
+		uint32 Width;
+		uint32 PitchOrLinearSize;
+		uint32 Depth;
+		uint32 MipMapCount;
+		uint32 Reserved1[11];
+		DdsPixelFormat PixelFormat;
+		uint32 Caps;
+		uint32 Caps2;
+		uint32 Caps3;
+		uint32 Caps4;
+		uint32 Reserved2;
+	};
+
+	struct DdsHeaderDxt10
+	{
+		uint32 DxgiFormat;
+		uint32 ResourceDimension;
+		uint32 MiscFlag;
+		uint32 ArraySize;
+		uint32 MiscFlags2;
+	};
+
+#pragma pack(pop)
+
+	const uint32 DdsMagic = 0x20534444;	// "DDS "
+	const uint32 DdsFourCCDx10 = 0x30315844;	// "DX10"
+
+	const uint32 DdsdCaps = 0x1;
+	const uint32 DdsdHeight = 0x2;
+	const uint32 DdsdWidth = 0x4;
+	const uint32 DdsdPixelFormat = 0x1000;
+	const uint32 DdsdMipMapCount = 0x20000;
+	const uint32 DdsdLinearSize = 0x80000;
+	const uint32 DdpfFourCC = 0x4;
+	const uint32 DdsCapsComplex = 0x8;
+	const uint32 DdsCapsTexture = 0x1000;
+	const uint32 DdsCapsMipMap = 0x400000;
+	const uint32 DdsDimensionTexture2D = 3;
+
+	template<typename T>
+	void Append(std::vector<uint8>& file, const T& value)
+	{
+		const uint8* bytes = reinterpret_cast<const uint8*>(&value);
+		file.insert(file.end(), bytes, bytes + sizeof(T));
+	}
+}
+
+std::size_t BlockCompressor::BlockBytes(Format format)
+{
+	return format == Format::BC1 ? 8 : 16;
+}
+
+std::size_t BlockCompressor::CompressedSize(Format format, uint32 width, uint32 height)
+{
+	return (std::size_t)((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(format);
+}
+
+DXGI_FORMAT BlockCompressor::DxgiFormat(Format format, bool srgb)
+{
+	switch(format)
+	{
+	case Format::BC1: return srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+	case Format::BC3: return srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+	case Format::BC5: return DXGI_FORMAT_BC5_UNORM;
+	}
+
+	return DXGI_FORMAT_UNKNOWN;
+}
+
+void BlockCompressor::Compress(const Image& image, Format format, Quality quality, std::vector<std::uint8_t>& blocks)
+{
+	uint32 blocksWide = (image.Width + 3) / 4;
+	uint32 blocksHigh = (image.Height + 3) / 4;
+	std::size_t blockBytes = BlockBytes(format);
+
+	blocks.resize(CompressedSize(format, image.Width, image.Height));
+	if(blocks.empty())
+		return;
+
+	ThreadPool::Default().ParallelFor(blocksHigh, GrainSize, [&](uint32 begin, uint32 end)
+	{
+		Block block;
+		for(uint32 by = begin; by < end; ++by)
+		{
+			uint8* out = blocks.data() + (std::size_t)by * blocksWide * blockBytes;
+			for(uint32 bx = 0; bx < blocksWide; ++bx, out += blockBytes)
+			{
+				LoadBlock(image, bx, by, block);
+				EncodeBlock(block, format, quality, out);
+			}
+		}
+	});
+}
+
+void BlockCompressor::WriteDDS(DXGI_FORMAT format, uint32 width, uint32 height,
+	const std::vector<std::vector<std::uint8_t>>& mips, std::vector<std::uint8_t>& file)
+{
+	DdsHeader header = {};
+	header.Size = sizeof(DdsHeader);
+	header.Flags = DdsdCaps | DdsdHeight | DdsdWidth | DdsdPixelFormat | DdsdMipMapCount | DdsdLinearSize;
+	header.Height = height;
+	header.Width = width;
+	header.PitchOrLinearSize = mips.empty() ? 0 : (uint32)mips[0].size();
+	header.MipMapCount = (uint32)mips.size();
+	header.PixelFormat.Size = sizeof(DdsPixelFormat);
+	header.PixelFormat.Flags = DdpfFourCC;
+	header.PixelFormat.FourCC = DdsFourCCDx10;
+	header.Caps = DdsCapsTexture | (mips.size() > 1 ? DdsCapsComplex | DdsCapsMipMap : 0);
+
+	DdsHeaderDxt10 extension = {};
+	extension.DxgiFormat = (uint32)format;
+	extension.ResourceDimension = DdsDimensionTexture2D;
+	extension.ArraySize = 1;
+
+	std::size_t size = sizeof(DdsMagic) + sizeof(header) + sizeof(extension);
+	for(const auto& mip : mips)
+		size += mip.size();
+
+	file.clear();
+	file.reserve(size);
+	Append(file, DdsMagic);
+	Append(file, header);
+	Append(file, extension);
+
+	for(const auto& mip : mips)
+		file.insert(file.end(), mip.begin(), mip.end());
+}
+
+bool BlockCompressor::SaveDDS(const std::wstring& filename, DXGI_FORMAT format, uint32 width, uint32 height,
+	const std::vector<std::vector<std::uint8_t>>& mips)
+{
+	std::vector<std::uint8_t> file;
+	WriteDDS(format, width, height, mips, file);
+
+	return FileUtil::WriteFileAtomic(filename, { { file.data(), file.size() } });
+}
@@ -0,0 +1,88 @@
+//***************************************************************************************
+// BlockCompressor.h
+//
+// CPU compression of 8-bit RGBA images into the block formats the DDS loader reads:
+//   -BC1 for opaque color, 4 bits per texel.
+//   -BC3 for color with alpha: a BC1 color block plus a BC4 alpha block, 8 bits per texel.
+//   -BC5 for tangent space normal maps: BC4 blocks of x and y, 8 bits per texel.  Blue
+//    samples as zero and NormalSampleToWorldSpace rebuilds z from x and y when the
+//    material says its normal map is two channel.
+//
+// Quality picks how the two endpoint colors of a BC1 block are found:
+//   -Fast: the corners of the block's bounding box, inset by a sixteenth.
+//   -Normal: the extent of the texels along the block's principal axis.
+//   -High: Normal, then the endpoints are refit by least squares to the chosen indices.
+//    BC1 blocks also try the three color mode, and BC4 blocks the six value mode with
+//    exact 0 and 255.
+// Texels are matched to the palette four at a time with DirectXMath, so it uses SSE/NEON
+// where available, and rows of blocks are spread over ThreadPool::Default().
+//
+// WriteDDS lays the compressed mips of a texture out as a DDS file with the DX10 header,
+// which CreateDDSTextureFromFile12 loads directly.
+//***************************************************************************************
+
+#pragma once
+
+#include <dxgiformat.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class BlockCompressor
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	enum class Format
+	{
+		BC1,	// RGB, 8 bytes per block
+		BC3,	// RGBA, 16 bytes per block
+		BC5		// RG, 16 bytes per block
+	};
+
+	enum class Quality
+	{
+		Fast,
+		Normal,
+		High
+	};
+
+	// Texels as 4 bytes each, red first.  Rows are RowPitch bytes apart.
+	struct Image
+	{
+		uint32 Width = 0;
+		uint32 Height = 0;
+		uint32 RowPitch = 0;
+		const std::uint8_t* Pixels = nullptr;
+	};
+
+	static std::size_t BlockBytes(Format format);
+
+	///<summary>
+	/// Size of width x height texels compressed, with the edges padded to whole blocks.
+	///</summary>
+	static std::size_t CompressedSize(Format format, uint32 width, uint32 height);
+
+	///<summary>
+	/// The DXGI format of the compressed data.  BC5 has no sRGB variant and ignores srgb.
+	///</summary>
+	static DXGI_FORMAT DxgiFormat(Format format, bool srgb);
+
+	///<summary>
+	/// Compresses image into blocks, rows of blocks first.  Blocks that overhang the edges
+	/// repeat the last row and column.
+	///</summary>
+	static void Compress(const Image& image, Format format, Quality quality, std::vector<std::uint8_t>& blocks);
+
+	///<summary>
+	/// Writes a DDS file holding a 2D texture of the block compressed format, with mips[i]
+	/// the data of mip i.  mips[0] is width x height.
+	///</summary>
+	static void WriteDDS(DXGI_FORMAT format, uint32 width, uint32 height,
+		const std::vector<std::vector<std::uint8_t>>& mips, std::vector<std::uint8_t>& file);
+
+	static bool SaveDDS(const std::wstring& filename, DXGI_FORMAT format, uint32 width, uint32 height,
+		const std::vector<std::vector<std::uint8_t>>& mips);
+};
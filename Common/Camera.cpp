@@ -126,6 +126,9 @@ void Camera::SetLens(float fovY, float aspect, float zn, float zf)
 
 	XMMATRIX P = XMMatrixPerspectiveFovLH(mFovY, mAspect, mNearZ, mFarZ);
 	XMStoreFloat4x4(&mProj, P);
+
+	BoundingFrustum::CreateFromMatrix(mViewFrustum, P);
+	mDerivedDirty = true;
 }
 
 void Camera::LookAt(FXMVECTOR pos, FXMVECTOR target, FXMVECTOR worldUp)
@@ -176,6 +179,23 @@ XMFLOAT4X4 Camera::GetProj4x4f()const
 	return mProj;
 }
 
+const CameraTransforms& Camera::GetTransforms()const
+{
+	UpdateDerived();
+	return mTransforms;
+}
+
+const BatchMath::FrustumPlanes& Camera::GetFrustumPlanes()const
+{
+	UpdateDerived();
+	return mFrustumPlanes;
+}
+
+const BoundingFrustum& Camera::GetViewFrustum()const
+{
+	return mViewFrustum;
+}
+
 void Camera::Strafe(float d)
 {
 	// mPosition += d*mRight
@@ -269,7 +289,51 @@ void Camera::UpdateViewMatrix()
 		mView(3, 3) = 1.0f;
 
 		mViewDirty = false;
+		mDerivedDirty = true;
 	}
 }
 
+void Camera::UpdateDerived()const
+{
+	assert(!mViewDirty);
+	if(!mDerivedDirty)
+		return;
+
+	// The view is built from an orthonormal basis and the lens is a perspective, so
+	// every inverse has a closed form.
+	mTransforms = CameraTransforms(Transform(mView, Transform::Kind::Rigid),
+		Transform(mProj, Transform::Kind::Perspective));
+
+	// A world point p is inside when each clip coordinate is within -w <= x, y <= w and
+	// 0 <= z <= w.  With c0..c3 the columns of view-projection those read
+	// dot(p, c3 +- c0) >= 0, dot(p, c3 +- c1) >= 0, dot(p, c2) >= 0 and dot(p, c3 - c2) >= 0.
+	const XMFLOAT4X4& m = mTransforms.ViewProj.Float4x4();
+	const float sign[6] = { 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f };
+	const int column[6] = { 0, 0, 1, 1, 2, 2 };
+
+	for(int p = 0; p < 6; ++p)
+	{
+		int c = column[p];
+		float plane[4];
+		for(int r = 0; r < 4; ++r)
+			plane[r] = p == 4 ? m(r, c) : m(r, 3) + sign[p] * m(r, c);
+
+		float invLength = 1.0f / sqrtf(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		mFrustumPlanes.A[p] = plane[0] * invLength;
+		mFrustumPlanes.B[p] = plane[1] * invLength;
+		mFrustumPlanes.C[p] = plane[2] * invLength;
+		mFrustumPlanes.D[p] = plane[3] * invLength;
+	}
+
+	for(int p = 6; p < 8; ++p)
+	{
+		mFrustumPlanes.A[p] = 0.0f;
+		mFrustumPlanes.B[p] = 0.0f;
+		mFrustumPlanes.C[p] = 0.0f;
+		mFrustumPlanes.D[p] = 1.0f;
+	}
+
+	mDerivedDirty = false;
+}
+
 
@@ -6,12 +6,17 @@
 //    so that the view matrix can be constructed.  
 //   -It keeps track of the viewing frustum of the camera so that the projection
 //    matrix can be obtained.
+//   -It caches everything derived from the view and projection (their product, the
+//    inverses and the world space frustum planes), rebuilt at most once per change
+//    however many passes read it.
 //***************************************************************************************
 
 #ifndef CAMERA_H
 #define CAMERA_H
 
 #include "d3dUtil.h"
+#include "Transform.h"
+#include "BatchMath.h"
 
 class Camera
 {
@@ -61,6 +66,17 @@ public:
 	DirectX::XMFLOAT4X4 GetView4x4f()const;
 	DirectX::XMFLOAT4X4 GetProj4x4f()const;
 
+	// View, projection, view-projection and their closed-form inverses.  Like GetView,
+	// these need UpdateViewMatrix after the camera moves.
+	const CameraTransforms& GetTransforms()const;
+
+	// The frustum in world space as normalized planes (left, right, bottom, top, near,
+	// far), laid out for BatchMath::CullBoxes.
+	const BatchMath::FrustumPlanes& GetFrustumPlanes()const;
+
+	// The frustum in view space, for culling in an object's local space.
+	const DirectX::BoundingFrustum& GetViewFrustum()const;
+
 	// Strafe/Walk the camera a distance d.
 	void Strafe(float d);
 	void Walk(float d);
@@ -93,6 +109,14 @@ private:
 	// Cache View/Proj matrices.
 	DirectX::XMFLOAT4X4 mView = MathHelper::Identity4x4();
 	DirectX::XMFLOAT4X4 mProj = MathHelper::Identity4x4();
+	DirectX::BoundingFrustum mViewFrustum;
+
+	// Derived from mView and mProj when first read after either changes.
+	void UpdateDerived()const;
+
+	mutable bool mDerivedDirty = true;
+	mutable CameraTransforms mTransforms;
+	mutable BatchMath::FrustumPlanes mFrustumPlanes;
 };
 
 #endif // CAMERA_H
\ No newline at end of file
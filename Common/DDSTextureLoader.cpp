@@ -21,9 +21,12 @@
 #include <assert.h>
 #include <algorithm>
 #include <memory>
+#include <utility>
+#include <vector>
 #include <wrl.h>
 
 #include "DDSTextureLoader.h" 
+#include "MappedFile.h"
 
 using namespace Microsoft::WRL;
 
@@ -1669,16 +1672,12 @@ static HRESULT CreateTextureFromDDS( _In_ ID3D11Device* d3dDevice,
     return hr;
 }
 
-static HRESULT CreateTextureFromDDS12(
-	_In_ ID3D12Device* device,
-	_In_opt_ ID3D12GraphicsCommandList* cmdList,
+static HRESULT GetTextureLayout12(
 	_In_ const DDS_HEADER* header,
 	_In_reads_bytes_(bitSize) const uint8_t* bitData,
 	_In_ size_t bitSize,
 	_In_ size_t maxsize,
-	_In_ bool forceSRGB,
-	ComPtr<ID3D12Resource>& texture,
-	ComPtr<ID3D12Resource>& textureUploadHeap)
+	_Out_ DDS_TEXTURE_LAYOUT12& layout)
 {
 	HRESULT hr = S_OK;
 
@@ -1835,15 +1834,8 @@ static HRESULT CreateTextureFromDDS12(
 		return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
 	}
 
-	// Create the texture
-	std::unique_ptr<D3D12_SUBRESOURCE_DATA[]> initData(
-		new (std::nothrow) D3D12_SUBRESOURCE_DATA[mipCount * arraySize]
-		);
-
-	if (!initData)
-	{
-		return E_OUTOFMEMORY;
-	}
+	// Lay out the subresources within bitData
+	std::vector<D3D12_SUBRESOURCE_DATA> initData(mipCount * arraySize);
 
 	size_t skipMip = 0;
 	size_t twidth = 0;
@@ -1852,25 +1844,27 @@ static HRESULT CreateTextureFromDDS12(
 
 	hr = FillInitData12(
 		width, height, depth, mipCount, arraySize, format, maxsize, bitSize, bitData,
-		twidth, theight, tdepth, skipMip, initData.get()
+		twidth, theight, tdepth, skipMip, initData.data()
 		);
 
-	if (SUCCEEDED(hr))
+	if (FAILED(hr))
 	{
-		hr = CreateD3DResources12(
-			device, cmdList,
-			resDim, twidth, theight, tdepth,
-			mipCount - skipMip,
-			arraySize,
-			format,
-			false, // forceSRGB
-			isCubeMap,
-			initData.get(),
-			texture, 
-			textureUploadHeap);
+		return hr;
 	}
 
-	return hr;
+	initData.resize((mipCount - skipMip) * arraySize);
+
+	layout.dimension = static_cast<D3D12_RESOURCE_DIMENSION>(resDim);
+	layout.format = format;
+	layout.width = twidth;
+	layout.height = theight;
+	layout.depth = tdepth;
+	layout.mipCount = mipCount - skipMip;
+	layout.arraySize = arraySize;
+	layout.isCubeMap = isCubeMap;
+	layout.subresources = std::move(initData);
+
+	return S_OK;
 }
 
 //--------------------------------------------------------------------------------------
@@ -1918,25 +1912,26 @@ HRESULT DirectX::CreateDDSTextureFromMemory( ID3D11Device* d3dDevice,
 }
 
 _Use_decl_annotations_
-HRESULT DirectX::CreateDDSTextureFromMemory12(
-	ID3D12Device* device,
-	_In_ ID3D12GraphicsCommandList* cmdList,
-	_In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
-	_In_ size_t ddsDataSize,
-	ComPtr<ID3D12Resource>& texture,
-	ComPtr<ID3D12Resource>& textureUploadHeap,
-	_In_ size_t maxsize,
-	_Out_opt_ DDS_ALPHA_MODE* alphaMode
+HRESULT DirectX::GetDDSTextureLayout12(
+	const uint8_t* ddsData,
+	size_t ddsDataSize,
+	DDS_TEXTURE_LAYOUT12& layout,
+	size_t maxsize
 	)
 {
-	if (alphaMode)
-		(*alphaMode) = DDS_ALPHA_MODE_UNKNOWN;
+	layout = DDS_TEXTURE_LAYOUT12();
 
-	if (!device || !cmdList || !ddsData || !ddsDataSize)
+	if (!ddsData)
 	{
 		return E_INVALIDARG;
 	}
 
+	// Need at least enough data to fill the header and magic number to be a valid DDS
+	if (ddsDataSize < (sizeof(DDS_HEADER) + sizeof(uint32_t)))
+	{
+		return E_FAIL;
+	}
+
 	uint32_t dwMagicNumber = *(const uint32_t*)(ddsData);
 	if (dwMagicNumber != DDS_MAGIC)
 	{
@@ -1970,22 +1965,93 @@ HRESULT DirectX::CreateDDSTextureFromMemory12(
 		+ sizeof(DDS_HEADER)
 		+ (bDXT10Header ? sizeof(DDS_HEADER_DXT10) : 0);
 
-	HRESULT hr = CreateTextureFromDDS12(
-		device,
-		cmdList,
+	HRESULT hr = GetTextureLayout12(
 		header,
 		ddsData + offset,
 		ddsDataSize - offset,
 		maxsize,
-		false,
-		texture,
-		textureUploadHeap
+		layout
 		);
 
+	if (FAILED(hr))
+	{
+		layout = DDS_TEXTURE_LAYOUT12();
+		return hr;
+	}
+
+	layout.alphaMode = GetAlphaMode(header);
+	return S_OK;
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::CreateDDSTextureFromLayout12(
+	ID3D12Device* device,
+	ID3D12GraphicsCommandList* cmdList,
+	const DDS_TEXTURE_LAYOUT12& layout,
+	ComPtr<ID3D12Resource>& texture,
+	ComPtr<ID3D12Resource>& textureUploadHeap
+	)
+{
+	if (!device || !cmdList)
+	{
+		return E_INVALIDARG;
+	}
+
+	if (layout.subresources.empty() ||
+		layout.subresources.size() != layout.mipCount * layout.arraySize)
+	{
+		return E_INVALIDARG;
+	}
+
+	// UpdateSubresources takes a mutable array; it only reads from it.
+	std::vector<D3D12_SUBRESOURCE_DATA> initData(layout.subresources);
+
+	return CreateD3DResources12(
+		device, cmdList,
+		layout.dimension, layout.width, layout.height, layout.depth,
+		layout.mipCount,
+		layout.arraySize,
+		layout.format,
+		false, // forceSRGB
+		layout.isCubeMap,
+		initData.data(),
+		texture,
+		textureUploadHeap);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::CreateDDSTextureFromMemory12(
+	ID3D12Device* device,
+	_In_ ID3D12GraphicsCommandList* cmdList,
+	_In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+	_In_ size_t ddsDataSize,
+	ComPtr<ID3D12Resource>& texture,
+	ComPtr<ID3D12Resource>& textureUploadHeap,
+	_In_ size_t maxsize,
+	_Out_opt_ DDS_ALPHA_MODE* alphaMode
+	)
+{
+	if (alphaMode)
+		(*alphaMode) = DDS_ALPHA_MODE_UNKNOWN;
+
+	if (!device || !cmdList || !ddsData || !ddsDataSize)
+	{
+		return E_INVALIDARG;
+	}
+
+	DDS_TEXTURE_LAYOUT12 layout;
+	HRESULT hr = GetDDSTextureLayout12(ddsData, ddsDataSize, layout, maxsize);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	hr = CreateDDSTextureFromLayout12(device, cmdList, layout, texture, textureUploadHeap);
+
 	if (SUCCEEDED(hr))
 	{
 		if (alphaMode)
-			(*alphaMode) = GetAlphaMode(header);
+			(*alphaMode) = layout.alphaMode;
 	}
 
 	return hr;
@@ -2160,19 +2226,23 @@ HRESULT DirectX::CreateDDSTextureFromFile12(_In_ ID3D12Device* device,
 		return E_INVALIDARG;
 	}
 
-	DDS_HEADER* header = nullptr;
-	uint8_t* bitData = nullptr;
-	size_t bitSize = 0;
+	// The subresources are views into the mapping, so nothing is copied until the upload
+	// heap is filled.  The mapping is released when ddsFile goes out of scope.
+	MappedFile ddsFile;
+	HRESULT hr = ddsFile.Open(szFileName);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
 
-	std::unique_ptr<uint8_t[]> ddsData;
-	HRESULT hr = LoadTextureDataFromFile(szFileName, ddsData, &header, &bitData, &bitSize);
+	DDS_TEXTURE_LAYOUT12 layout;
+	hr = GetDDSTextureLayout12(ddsFile.Data(), ddsFile.Size(), layout, maxsize);
 	if (FAILED(hr))
 	{
 		return hr;
 	}
 
-	hr = CreateTextureFromDDS12(device, cmdList, header,
-		bitData, bitSize, maxsize, false, texture, textureUploadHeap);
+	hr = CreateDDSTextureFromLayout12(device, cmdList, layout, texture, textureUploadHeap);
 
 	if (SUCCEEDED(hr))
 	{
@@ -2222,7 +2292,7 @@ HRESULT DirectX::CreateDDSTextureFromFile12(_In_ ID3D12Device* device,
 #endif
 */
 		if (alphaMode)
-			*alphaMode = GetAlphaMode(header);
+			*alphaMode = layout.alphaMode;
 	}
 
 	return hr;
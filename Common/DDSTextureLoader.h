@@ -32,6 +32,8 @@
 
 #pragma warning(pop)
 
+#include <vector>
+
 #if defined(_MSC_VER) && (_MSC_VER<1610) && !defined(_In_reads_)
 #define _In_reads_(exp)
 #define _Out_writes_(exp)
@@ -83,6 +85,48 @@ namespace DirectX
                                       _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
                                     );
 
+	// Texture description of a DDS file and the location of each subresource within it.
+	// Computing a layout validates the header against the data size and needs no device,
+	// so it can run on any thread.  The subresources point into the DDS data the layout
+	// was computed from, which has to stay valid until the upload has been recorded.
+	struct DDS_TEXTURE_LAYOUT12
+	{
+		D3D12_RESOURCE_DIMENSION dimension = D3D12_RESOURCE_DIMENSION_UNKNOWN;
+		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+
+		// Size of the most detailed mip that was kept, and the mips kept.
+		size_t width = 0;
+		size_t height = 0;
+		size_t depth = 0;
+		size_t mipCount = 0;
+
+		// Six faces per cube for cube maps.
+		size_t arraySize = 0;
+		bool isCubeMap = false;
+
+		DDS_ALPHA_MODE alphaMode = DDS_ALPHA_MODE_UNKNOWN;
+
+		// mipCount entries per array slice, slices one after the other.
+		std::vector<D3D12_SUBRESOURCE_DATA> subresources;
+	};
+
+	// Mips larger than maxsize in any dimension are skipped (0 keeps them all).
+	HRESULT GetDDSTextureLayout12(_In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
+		                          _In_ size_t ddsDataSize,
+		                          _Out_ DDS_TEXTURE_LAYOUT12& layout,
+		                          _In_ size_t maxsize = 0
+		                          );
+
+	// Creates the texture and records its upload into cmdList.  The DDS data behind the
+	// layout is copied into textureUploadHeap here and may be released on return.
+	HRESULT CreateDDSTextureFromLayout12(_In_ ID3D12Device* device,
+		                                 _In_ ID3D12GraphicsCommandList* cmdList,
+		                                 _In_ const DDS_TEXTURE_LAYOUT12& layout,
+		                                 _Out_ Microsoft::WRL::ComPtr<ID3D12Resource>& texture,
+		                                 _Out_ Microsoft::WRL::ComPtr<ID3D12Resource>& textureUploadHeap
+		                                 );
+
+	// Memory maps the file rather than reading it, and unmaps it once the upload is recorded.
 	HRESULT CreateDDSTextureFromFile12(_In_ ID3D12Device* device,
 		                               _In_ ID3D12GraphicsCommandList* cmdList,
 		                               _In_z_ const wchar_t* szFileName,
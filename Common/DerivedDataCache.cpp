@@ -0,0 +1,134 @@
+//***************************************************************************************
+// DerivedDataCache.cpp
+//***************************************************************************************
+
+#include "DerivedDataCache.h"
+#include "FileUtil.h"
+#include "Hash.h"
+#include "LzCompression.h"
+#include <cstring>
+#include <cwchar>
+
+namespace
+{
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	const uint32 Magic = 0x30434444;	// "DDC0"
+	const uint32 Version = 1;
+
+#pragma pack(push, 1)
+
+	struct FileHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint64 Key;
+		uint64 Size;		// Bytes of the artifact
+		uint64 StoredSize;	// Bytes that follow the header
+		uint32 Compressed;
+	};
+
+#pragma pack(pop)
+}
+
+DerivedDataCache::KeyBuilder& DerivedDataCache::KeyBuilder::Add(const void* data, std::size_t size)
+{
+	// A word at a time, so hashing whole source files stays cheap.  The length goes in
+	// first so consecutive Adds cannot run into each other.
+	mHash = Hash::Fnv1aWords(data, size, (mHash ^ (uint64)size) * Hash::FnvPrime);
+	return *this;
+}
+
+DerivedDataCache::KeyBuilder& DerivedDataCache::KeyBuilder::Add(const std::string& text)
+{
+	return Add(text.data(), text.size());
+}
+
+DerivedDataCache::KeyBuilder& DerivedDataCache::KeyBuilder::Add(uint64 value)
+{
+	return Add(&value, sizeof(value));
+}
+
+DerivedDataCache::DerivedDataCache(const std::wstring& directory) :
+	mDirectory(directory)
+{
+	// Fails harmlessly if the directory exists; if it cannot be created, every Put fails
+	// and the cache just misses.
+	FileUtil::MakeDirectory(mDirectory);
+}
+
+bool DerivedDataCache::Get(const std::string& bucket, uint64 key, std::vector<std::uint8_t>& data)const
+{
+	std::vector<uint8> file;
+	if(!FileUtil::ReadFile(Filename(bucket, key), file) || file.size() < sizeof(FileHeader))
+		return false;
+
+	FileHeader header;
+	std::memcpy(&header, file.data(), sizeof(header));
+	if(header.Magic != Magic || header.Version != Version || header.Key != key ||
+		header.StoredSize != file.size() - sizeof(header))
+		return false;
+
+	const uint8* stored = file.data() + sizeof(header);
+	if(!header.Compressed)
+	{
+		if(header.Size != header.StoredSize)
+			return false;
+
+		data.assign(stored, stored + header.StoredSize);
+		return true;
+	}
+
+	data.resize((std::size_t)header.Size);
+	return LzCompression::Decompress(stored, (std::size_t)header.StoredSize, data.data(), data.size());
+}
+
+bool DerivedDataCache::Put(const std::string& bucket, uint64 key, const std::vector<std::uint8_t>& data)const
+{
+	std::vector<uint8> compressed;
+	if(!data.empty())
+		LzCompression::Compress(data.data(), data.size(), compressed);
+
+	bool compress = !compressed.empty() && compressed.size() <= data.size() - data.size() / 8;
+	const std::vector<uint8>& stored = compress ? compressed : data;
+
+	FileHeader header;
+	header.Magic = Magic;
+	header.Version = Version;
+	header.Key = key;
+	header.Size = data.size();
+	header.StoredSize = stored.size();
+	header.Compressed = compress ? 1 : 0;
+
+	return FileUtil::WriteFileAtomic(Filename(bucket, key),
+		{ { &header, sizeof(header) }, { stored.data(), stored.size() } });
+}
+
+bool DerivedDataCache::GetOrBuild(const std::string& bucket, uint64 key, const BuildFunction& build,
+	std::vector<std::uint8_t>& data, bool* cached)const
+{
+	bool hit = Get(bucket, key, data);
+	if(cached != nullptr)
+		*cached = hit;
+
+	if(hit)
+		return true;
+
+	data.clear();
+	if(!build(data))
+		return false;
+
+	// A cache that cannot be written only costs the next run a rebuild.
+	Put(bucket, key, data);
+	return true;
+}
+
+std::wstring DerivedDataCache::Filename(const std::string& bucket, uint64 key)const
+{
+	wchar_t hex[17];
+	std::swprintf(hex, 17, L"%016llx", (unsigned long long)key);
+
+	return mDirectory + L"/" + std::wstring(bucket.begin(), bucket.end()) + L"_" + hex + L".ddc";
+}
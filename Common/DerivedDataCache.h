@@ -0,0 +1,81 @@
+//***************************************************************************************
+// DerivedDataCache.h
+//
+// Local on-disk cache of data derived from source assets (cooked meshes and the like),
+// so it is only rebuilt when something it depends on changes.  Every artifact is stored
+// under a bucket, which names the kind of data, and a 64-bit key built with KeyBuilder
+// from everything that went into it: the source bytes, the importer and its version,
+// and the settings used.  Nothing is ever invalidated explicitly; changed inputs simply
+// make a different key, and stale files can be deleted at any time.
+//
+// Each artifact is one file, <directory>/<bucket>_<key in hex>.ddc, LZ compressed when
+// that pays off.  Put writes a temporary file and renames it over the final one, so
+// concurrent cooks of the same artifact, in threads or processes, never leave a torn
+// file behind; Get verifies the file's header and size and treats anything else as a miss.
+//***************************************************************************************
+
+#pragma once
+
+#include "Hash.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class DerivedDataCache
+{
+public:
+
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	// Hashes everything an artifact is derived from into its key.
+	class KeyBuilder
+	{
+	public:
+		KeyBuilder& Add(const void* data, std::size_t size);
+		KeyBuilder& Add(const std::string& text);
+		KeyBuilder& Add(uint64 value);
+
+		uint64 Key()const { return mHash; }
+
+	private:
+		uint64 mHash = Hash::FnvOffset;
+	};
+
+	// Builds an artifact into data, returning false if it cannot.
+	using BuildFunction = std::function<bool(std::vector<std::uint8_t>& data)>;
+
+	///<summary>
+	/// Uses directory (created if missing) for the cache files.
+	///</summary>
+	explicit DerivedDataCache(const std::wstring& directory);
+
+	DerivedDataCache(const DerivedDataCache& rhs) = delete;
+	DerivedDataCache& operator=(const DerivedDataCache& rhs) = delete;
+
+	///<summary>
+	/// Reads the artifact of key into data.  Returns false if it is not cached (or the
+	/// cached file is unreadable).
+	///</summary>
+	bool Get(const std::string& bucket, uint64 key, std::vector<std::uint8_t>& data)const;
+
+	///<summary>
+	/// Stores data as the artifact of key.  Returns false if it could not be written.
+	///</summary>
+	bool Put(const std::string& bucket, uint64 key, const std::vector<std::uint8_t>& data)const;
+
+	///<summary>
+	/// Gets the artifact of key, building and storing it on a miss.  Returns false only if
+	/// build fails; cached is set to whether the artifact came from the cache.
+	///</summary>
+	bool GetOrBuild(const std::string& bucket, uint64 key, const BuildFunction& build,
+		std::vector<std::uint8_t>& data, bool* cached = nullptr)const;
+
+	const std::wstring& Directory()const { return mDirectory; }
+
+private:
+	std::wstring Filename(const std::string& bucket, uint64 key)const;
+
+	std::wstring mDirectory;
+};
@@ -0,0 +1,984 @@
+//***************************************************************************************
+// FbxLoader.cpp
+//***************************************************************************************
+
+#include "FbxLoader.h"
+#include "Hash.h"
+#include "Inflate.h"
+#include "TangentSpace.h"
+#include "ThreadPool.h"
+#include "VirtualFileSystem.h"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+
+using namespace DirectX;
+
+namespace
+{
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+	using int32 = std::int32_t;
+	using int64 = std::int64_t;
+
+	// "Kaydara FBX Binary  \0\x1a\0" followed by the version number.
+	const char BinaryMagic[] = "Kaydara FBX Binary  ";
+	const std::size_t HeaderSize = 27;
+
+	// Records nest a handful of levels deep; anything deeper is a corrupt file.
+	const int MaxRecordDepth = 32;
+
+	template<typename T>
+	T ReadValue(const uint8* p)
+	{
+		T value;
+		std::memcpy(&value, p, sizeof(T));
+		return value;
+	}
+
+	struct Property
+	{
+		char Type = 0;
+
+		// Scalar and string bytes, or the elements of an array once it is inflated.
+		const uint8* Data = nullptr;
+		std::size_t Size = 0;
+
+		// Arrays only.
+		uint32 Count = 0;
+		uint32 Encoding = 0;
+		std::vector<uint8> Inflated;
+	};
+
+	struct Record
+	{
+		std::string Name;
+		std::vector<Property> Properties;
+		std::vector<Record> Children;
+
+		const Record* Find(const char* name)const
+		{
+			for(const Record& child : Children)
+			{
+				if(child.Name == name)
+					return &child;
+			}
+			return nullptr;
+		}
+	};
+
+	std::size_t ArrayElementSize(char type)
+	{
+		switch(type)
+		{
+		case 'f': case 'i': return 4;
+		case 'd': case 'l': return 8;
+		case 'b': return 1;
+		default: return 0;
+		}
+	}
+
+	// Parses the record tree in place.  Versions 7500 and later widen the record
+	// header's offsets and counts to 64 bits.
+	class RecordParser
+	{
+	public:
+		RecordParser(const uint8* data, std::size_t size, uint32 version) :
+			mData(data), mSize(size), mWide(version >= 7500)
+		{
+		}
+
+		// Parses the record at offset, or returns with isNull set at the null record that
+		// ends a list.
+		bool Parse(std::size_t& offset, Record& record, bool& isNull, int depth)
+		{
+			if(depth > MaxRecordDepth)
+				return false;
+
+			std::size_t headerSize = mWide ? 25 : 13;
+			if(offset > mSize || mSize - offset < headerSize)
+				return false;
+
+			const uint8* p = mData + offset;
+			uint64 endOffset = mWide ? ReadValue<uint64>(p) : ReadValue<uint32>(p);
+			uint64 propertyCount = mWide ? ReadValue<uint64>(p + 8) : ReadValue<uint32>(p + 4);
+			uint64 propertyListSize = mWide ? ReadValue<uint64>(p + 16) : ReadValue<uint32>(p + 8);
+			std::size_t nameLength = p[headerSize - 1];
+
+			isNull = endOffset == 0;
+			if(isNull)
+			{
+				offset += headerSize;
+				return true;
+			}
+
+			std::size_t nameStart = offset + headerSize;
+			if(endOffset > mSize || endOffset < nameStart + nameLength ||
+				propertyListSize > endOffset - nameStart - nameLength)
+				return false;
+
+			record.Name.assign(reinterpret_cast<const char*>(mData + nameStart), nameLength);
+
+			std::size_t propertyStart = nameStart + nameLength;
+			std::size_t propertyEnd = propertyStart + (std::size_t)propertyListSize;
+			if(propertyCount > propertyListSize)
+				return false;
+
+			record.Properties.resize((std::size_t)propertyCount);
+			std::size_t p0 = propertyStart;
+			for(Property& property : record.Properties)
+			{
+				if(!ParseProperty(p0, propertyEnd, property))
+					return false;
+			}
+
+			// Children run up to the end offset, closed by a null record.
+			std::size_t child = propertyEnd;
+			while(child < endOffset)
+			{
+				Record r;
+				bool childIsNull = false;
+				if(!Parse(child, r, childIsNull, depth + 1))
+					return false;
+				if(childIsNull)
+					break;
+				record.Children.push_back(std::move(r));
+			}
+
+			offset = (std::size_t)endOffset;
+			return true;
+		}
+
+	private:
+		bool ParseProperty(std::size_t& offset, std::size_t end, Property& property)
+		{
+			if(offset >= end)
+				return false;
+
+			property.Type = (char)mData[offset++];
+			std::size_t available = end - offset;
+
+			std::size_t size = 0;
+			switch(property.Type)
+			{
+			case 'C': size = 1; break;
+			case 'Y': size = 2; break;
+			case 'I': case 'F': size = 4; break;
+			case 'D': case 'L': size = 8; break;
+			case 'S': case 'R':
+				if(available < 4)
+					return false;
+				size = ReadValue<uint32>(mData + offset);
+				offset += 4;
+				available -= 4;
+				break;
+			case 'f': case 'd': case 'l': case 'i': case 'b':
+			{
+				if(available < 12)
+					return false;
+				property.Count = ReadValue<uint32>(mData + offset);
+				property.Encoding = ReadValue<uint32>(mData + offset + 4);
+				size = ReadValue<uint32>(mData + offset + 8);
+				offset += 12;
+				available -= 12;
+
+				// DEFLATE expands at most about 1032:1, which bounds what a corrupt count
+				// can make us allocate.
+				uint64 rawSize = (uint64)property.Count * ArrayElementSize(property.Type);
+				if(property.Encoding > 1 || (property.Encoding == 0 && rawSize != size) ||
+					(property.Encoding == 1 && rawSize / 1032 > size))
+					return false;
+				break;
+			}
+			default:
+				return false;
+			}
+
+			if(size > available)
+				return false;
+
+			property.Data = mData + offset;
+			property.Size = size;
+			offset += size;
+			return true;
+		}
+
+		const uint8* mData;
+		std::size_t mSize;
+		bool mWide;
+	};
+
+	void CollectCompressedArrays(Record& record, std::vector<Property*>& arrays)
+	{
+		for(Property& property : record.Properties)
+		{
+			if(property.Encoding == 1)
+				arrays.push_back(&property);
+		}
+		for(Record& child : record.Children)
+			CollectCompressedArrays(child, arrays);
+	}
+
+	// Arrays are zlib streams: a two byte header, DEFLATE data and an Adler-32 trailer.
+	bool InflateArray(Property& property)
+	{
+		std::size_t rawSize = (std::size_t)property.Count * ArrayElementSize(property.Type);
+		property.Inflated.resize(rawSize);
+
+		const uint8* z = property.Data;
+		if(property.Size < 2 || (z[0] & 0x0f) != 8 || ((z[0] << 8) | z[1]) % 31 != 0 || (z[1] & 0x20) != 0)
+			return false;
+
+		if(!Inflate::Decompress(z + 2, property.Size - 2, property.Inflated.data(), rawSize))
+			return false;
+
+		property.Data = property.Inflated.data();
+		property.Size = rawSize;
+		property.Encoding = 0;
+		return true;
+	}
+
+	bool IsString(const Record& record, std::size_t i)
+	{
+		return i < record.Properties.size() && record.Properties[i].Type == 'S';
+	}
+
+	std::string ToString(const Property& property)
+	{
+		if(property.Type != 'S' && property.Type != 'R')
+			return std::string();
+		return std::string(reinterpret_cast<const char*>(property.Data), property.Size);
+	}
+
+	int64 ToInt(const Property& property)
+	{
+		switch(property.Type)
+		{
+		case 'C': return property.Data[0];
+		case 'Y': return ReadValue<std::int16_t>(property.Data);
+		case 'I': return ReadValue<int32>(property.Data);
+		case 'L': return ReadValue<int64>(property.Data);
+		case 'F': return (int64)ReadValue<float>(property.Data);
+		case 'D': return (int64)ReadValue<double>(property.Data);
+		default: return 0;
+		}
+	}
+
+	double ToDouble(const Property& property)
+	{
+		switch(property.Type)
+		{
+		case 'F': return ReadValue<float>(property.Data);
+		case 'D': return ReadValue<double>(property.Data);
+		default: return (double)ToInt(property);
+		}
+	}
+
+	// Converts an array property of any element type.
+	template<typename T>
+	void ToArray(const Property& property, std::vector<T>& values)
+	{
+		values.resize(property.Encoding == 0 ? property.Count : 0);
+		for(std::size_t i = 0; i < values.size(); ++i)
+		{
+			const uint8* p = property.Data + i * ArrayElementSize(property.Type);
+			switch(property.Type)
+			{
+			case 'f': values[i] = (T)ReadValue<float>(p); break;
+			case 'd': values[i] = (T)ReadValue<double>(p); break;
+			case 'i': values[i] = (T)ReadValue<int32>(p); break;
+			case 'l': values[i] = (T)ReadValue<int64>(p); break;
+			case 'b': values[i] = (T)p[0]; break;
+			default: values[i] = T(); break;
+			}
+		}
+	}
+
+	template<typename T>
+	bool ReadChildArray(const Record& record, const char* name, std::vector<T>& values)
+	{
+		values.clear();
+		const Record* child = record.Find(name);
+		if(child == nullptr || child->Properties.empty())
+			return false;
+
+		// FBX 6 writes arrays as a list of scalar properties.
+		if(ArrayElementSize(child->Properties[0].Type) == 0)
+		{
+			values.reserve(child->Properties.size());
+			for(const Property& property : child->Properties)
+				values.push_back((T)ToDouble(property));
+			return true;
+		}
+
+		ToArray(child->Properties[0], values);
+		return true;
+	}
+
+	std::string ReadChildString(const Record& record, const char* name)
+	{
+		const Record* child = record.Find(name);
+		return child && IsString(*child, 0) ? ToString(child->Properties[0]) : std::string();
+	}
+
+	// FBX 7 objects are (id, "Name\0\x01Class", type); FBX 6 objects have no id and are
+	// referred to by their name string instead.
+	int64 ObjectId(const Property& property)
+	{
+		if(property.Type != 'S')
+			return ToInt(property);
+
+		return (int64)Hash::Fnv1a(property.Data, property.Size);
+	}
+
+	std::string ObjectName(const Record& object)
+	{
+		std::size_t i = IsString(object, 0) ? 0 : 1;
+		if(!IsString(object, i))
+			return std::string();
+		std::string name = ToString(object.Properties[i]);
+		return name.substr(0, name.find('\0'));
+	}
+
+	std::string ObjectType(const Record& object)
+	{
+		return object.Properties.size() > 1 ? ToString(object.Properties.back()) : std::string();
+	}
+
+	// The values of the property name of an object, from its Properties70 block ("P":
+	// name, type, label, flags, values) or an FBX 6 Properties60 block ("Property":
+	// name, type, flags, values).  Returns nullptr unless count values follow.
+	const Property* FindPropertyValues(const Record& object, const char* name, std::size_t count)
+	{
+		const Record* properties = object.Find("Properties70");
+		const char* entryName = "P";
+		std::size_t first = 4;
+		if(properties == nullptr)
+		{
+			properties = object.Find("Properties60");
+			entryName = "Property";
+			first = 3;
+		}
+		if(properties == nullptr)
+			return nullptr;
+
+		for(const Record& p : properties->Children)
+		{
+			if(p.Name == entryName && p.Properties.size() >= first + count && IsString(p, 0) &&
+				ToString(p.Properties[0]) == name)
+				return &p.Properties[first];
+		}
+		return nullptr;
+	}
+
+	XMFLOAT3 PropertyVector(const Record& object, const char* name, XMFLOAT3 defaultValue)
+	{
+		const Property* v = FindPropertyValues(object, name, 3);
+		if(v == nullptr)
+			return defaultValue;
+		return XMFLOAT3((float)ToDouble(v[0]), (float)ToDouble(v[1]), (float)ToDouble(v[2]));
+	}
+
+	double PropertyScalar(const Record& object, const char* name, double defaultValue)
+	{
+		const Property* v = FindPropertyValues(object, name, 1);
+		return v ? ToDouble(v[0]) : defaultValue;
+	}
+
+	// Euler angles in degrees, applied in the given order (0 = XYZ: X first, ...).  The
+	// engine's rotation matrices act on row vectors, so they multiply in that order.
+	XMMATRIX EulerRotation(const XMFLOAT3& degrees, int order)
+	{
+		XMMATRIX rx = XMMatrixRotationX(XMConvertToRadians(degrees.x));
+		XMMATRIX ry = XMMatrixRotationY(XMConvertToRadians(degrees.y));
+		XMMATRIX rz = XMMatrixRotationZ(XMConvertToRadians(degrees.z));
+
+		switch(order)
+		{
+		case 1: return rx * rz * ry;
+		case 2: return ry * rz * rx;
+		case 3: return ry * rx * rz;
+		case 4: return rz * rx * ry;
+		case 5: return rz * ry * rx;
+		default: return rx * ry * rz;
+		}
+	}
+
+	XMMATRIX Translation(const XMFLOAT3& t)
+	{
+		return XMMatrixTranslation(t.x, t.y, t.z);
+	}
+
+	// The FBX node transform
+	//   T * Roff * Rp * Rpre * R * Rpost^-1 * Rp^-1 * Soff * Sp * S * Sp^-1
+	// written for row vectors.
+	XMMATRIX LocalTransform(const Record& model)
+	{
+		const XMFLOAT3 zero(0.0f, 0.0f, 0.0f);
+
+		XMFLOAT3 t = PropertyVector(model, "Lcl Translation", zero);
+		XMFLOAT3 r = PropertyVector(model, "Lcl Rotation", zero);
+		XMFLOAT3 s = PropertyVector(model, "Lcl Scaling", XMFLOAT3(1.0f, 1.0f, 1.0f));
+		XMFLOAT3 preRotation = PropertyVector(model, "PreRotation", zero);
+		XMFLOAT3 postRotation = PropertyVector(model, "PostRotation", zero);
+		XMFLOAT3 rotationPivot = PropertyVector(model, "RotationPivot", zero);
+		XMFLOAT3 rotationOffset = PropertyVector(model, "RotationOffset", zero);
+		XMFLOAT3 scalingPivot = PropertyVector(model, "ScalingPivot", zero);
+		XMFLOAT3 scalingOffset = PropertyVector(model, "ScalingOffset", zero);
+		int rotationOrder = (int)PropertyScalar(model, "RotationOrder", 0.0);
+
+		XMMATRIX rp = Translation(rotationPivot);
+		XMMATRIX sp = Translation(scalingPivot);
+
+		return
+			XMMatrixInverse(nullptr, sp) * XMMatrixScaling(s.x, s.y, s.z) * sp * Translation(scalingOffset) *
+			XMMatrixInverse(nullptr, rp) * XMMatrixTranspose(EulerRotation(postRotation, 0)) *
+			EulerRotation(r, rotationOrder) * EulerRotation(preRotation, 0) * rp * Translation(rotationOffset) *
+			Translation(t);
+	}
+
+	// Offset applied to the node's geometry only, not inherited by its children.
+	XMMATRIX GeometricTransform(const Record& model)
+	{
+		const XMFLOAT3 zero(0.0f, 0.0f, 0.0f);
+
+		XMFLOAT3 t = PropertyVector(model, "GeometricTranslation", zero);
+		XMFLOAT3 r = PropertyVector(model, "GeometricRotation", zero);
+		XMFLOAT3 s = PropertyVector(model, "GeometricScaling", XMFLOAT3(1.0f, 1.0f, 1.0f));
+
+		return XMMatrixScaling(s.x, s.y, s.z) * EulerRotation(r, 0) * Translation(t);
+	}
+
+	// Resolves a layer element (normals, texture coordinates) value for one polygon
+	// corner through its mapping and reference modes.
+	struct LayerElement
+	{
+		enum class Mapping { PolygonVertex, ControlPoint, Polygon, AllSame };
+
+		Mapping Mode = Mapping::PolygonVertex;
+		bool Indexed = false;
+		int Components = 0;
+		std::vector<double> Direct;
+		std::vector<int32> Index;
+
+		bool Valid()const { return Components > 0; }
+
+		// The element of corner polygonVertex of polygon, at controlPoint, or nullptr.
+		const double* Get(uint32 polygonVertex, uint32 polygon, uint32 controlPoint)const
+		{
+			std::size_t i = 0;
+			switch(Mode)
+			{
+			case Mapping::PolygonVertex: i = polygonVertex; break;
+			case Mapping::ControlPoint: i = controlPoint; break;
+			case Mapping::Polygon: i = polygon; break;
+			case Mapping::AllSame: i = 0; break;
+			}
+
+			if(Indexed)
+			{
+				if(i >= Index.size() || Index[i] < 0)
+					return nullptr;
+				i = (std::size_t)Index[i];
+			}
+
+			if((i + 1) * Components > Direct.size())
+				return nullptr;
+			return &Direct[i * Components];
+		}
+	};
+
+	bool ReadMapping(const Record& element, LayerElement::Mapping& mode)
+	{
+		std::string mapping = ReadChildString(element, "MappingInformationType");
+		if(mapping == "ByPolygonVertex")
+			mode = LayerElement::Mapping::PolygonVertex;
+		else if(mapping == "ByVertice" || mapping == "ByVertex" || mapping == "ByControlPoint")
+			mode = LayerElement::Mapping::ControlPoint;
+		else if(mapping == "ByPolygon")
+			mode = LayerElement::Mapping::Polygon;
+		else if(mapping == "AllSame")
+			mode = LayerElement::Mapping::AllSame;
+		else
+			return false;
+		return true;
+	}
+
+	// Reads the first layer's element, e.g. ("LayerElementUV", "UV", "UVIndex").
+	LayerElement ReadLayerElement(const Record& geometry, const char* elementName,
+		const char* directName, const char* indexName, int components)
+	{
+		LayerElement layer;
+
+		const Record* element = geometry.Find(elementName);
+		if(element == nullptr || !ReadMapping(*element, layer.Mode))
+			return layer;
+
+		std::string reference = ReadChildString(*element, "ReferenceInformationType");
+		layer.Indexed = reference == "IndexToDirect" || reference == "Index";
+
+		if(!ReadChildArray(*element, directName, layer.Direct))
+			return layer;
+		if(layer.Indexed && !ReadChildArray(*element, indexName, layer.Index))
+			return layer;
+
+		layer.Components = components;
+		return layer;
+	}
+
+	// Exact attribute bits of a polygon corner; corners sharing them become one vertex.
+	struct CornerKey
+	{
+		uint32 ControlPoint;
+		float N[3];
+		float T[2];
+
+		bool operator==(const CornerKey& rhs)const
+		{
+			return std::memcmp(this, &rhs, sizeof(CornerKey)) == 0;
+		}
+	};
+
+	struct CornerKeyHash
+	{
+		size_t operator()(const CornerKey& k)const
+		{
+			return (size_t)Hash::Mix(Hash::Fnv1a(&k, sizeof(CornerKey)));
+		}
+	};
+
+	// Objects of the scene by id, filled from the Objects and Connections sections.
+	struct Scene
+	{
+		std::unordered_map<int64, const Record*> Geometries;
+		std::unordered_map<int64, int> Nodes;
+		std::unordered_map<int64, int> Materials;
+		std::unordered_map<int64, std::string> Textures;
+
+		std::vector<const Record*> NodeRecords;
+		std::vector<std::vector<int64>> NodeGeometries;
+		std::vector<std::vector<int>> NodeMaterials;
+	};
+}
+
+bool FbxLoader::Load(const std::string& filename, FbxModel& model)
+{
+	return Load(filename, model, ImportSettings());
+}
+
+bool FbxLoader::Load(const std::string& filename, FbxModel& model, const ImportSettings& settings)
+{
+	std::vector<uint8> bytes;
+	if(!VirtualFileSystem::Default().ReadFile(filename, bytes))
+		return false;
+
+	return Load(bytes.data(), bytes.size(), model, settings);
+}
+
+bool FbxLoader::Load(const std::uint8_t* data, std::size_t size, FbxModel& model, const ImportSettings& settings)
+{
+	model = FbxModel();
+
+	if(size < HeaderSize || std::memcmp(data, BinaryMagic, sizeof(BinaryMagic) - 1) != 0)
+		return false;
+
+	//
+	// Parse the top level records, then inflate every compressed array in parallel.
+	//
+
+	uint32 version = ReadValue<uint32>(data + 23);
+	RecordParser parser(data, size, version);
+
+	Record root;
+	std::size_t offset = HeaderSize;
+	while(offset < size)
+	{
+		Record record;
+		bool isNull = false;
+		if(!parser.Parse(offset, record, isNull, 0))
+			return false;
+		if(isNull)
+			break;
+		root.Children.push_back(std::move(record));
+	}
+
+	std::vector<Property*> compressed;
+	CollectCompressedArrays(root, compressed);
+
+	std::atomic<bool> inflated{ true };
+	ThreadPool::Default().ParallelFor((uint32)compressed.size(), 4, [&](uint32 begin, uint32 end)
+	{
+		for(uint32 i = begin; i < end; ++i)
+		{
+			if(!InflateArray(*compressed[i]))
+				inflated = false;
+		}
+	});
+
+	if(!inflated)
+		return false;
+
+	const Record* objects = root.Find("Objects");
+	const Record* connections = root.Find("Connections");
+	if(objects == nullptr)
+		return false;
+
+	//
+	// Gather the objects, then wire them up through the connections.
+	//
+
+	Scene scene;
+	for(const Record& object : objects->Children)
+	{
+		if(object.Properties.empty())
+			continue;
+
+		int64 id = ObjectId(object.Properties[0]);
+		if(object.Name == "Geometry")
+		{
+			if(ObjectType(object) == "Mesh")
+				scene.Geometries[id] = &object;
+		}
+		else if(object.Name == "Model")
+		{
+			FbxNode node;
+			node.Name = ObjectName(object);
+			XMStoreFloat4x4(&node.LocalTransform, LocalTransform(object));
+
+			scene.Nodes[id] = (int)model.Nodes.size();
+			scene.NodeRecords.push_back(&object);
+			scene.NodeGeometries.emplace_back();
+			scene.NodeMaterials.emplace_back();
+			model.Nodes.push_back(node);
+
+			// FBX 6 keeps a mesh's geometry inside its model.
+			if(ObjectType(object) == "Mesh" && object.Find("Vertices") != nullptr)
+			{
+				scene.Geometries[id] = &object;
+				scene.NodeGeometries.back().push_back(id);
+			}
+		}
+		else if(object.Name == "Material")
+		{
+			FbxMaterial mat;
+			mat.Name = ObjectName(object);
+
+			XMFLOAT3 diffuse = PropertyVector(object, "DiffuseColor",
+				PropertyVector(object, "Diffuse", XMFLOAT3(1.0f, 1.0f, 1.0f)));
+			float diffuseFactor = (float)PropertyScalar(object, "DiffuseFactor", 1.0);
+			mat.DiffuseAlbedo = XMFLOAT4(diffuse.x*diffuseFactor, diffuse.y*diffuseFactor, diffuse.z*diffuseFactor,
+				(float)PropertyScalar(object, "Opacity", 1.0 - PropertyScalar(object, "TransparencyFactor", 0.0)));
+
+			mat.FresnelR0 = PropertyVector(object, "SpecularColor", PropertyVector(object, "Specular", mat.FresnelR0));
+
+			// Map the Phong exponent onto our roughness parameter.
+			const Property* shininess = FindPropertyValues(object, "ShininessExponent", 1);
+			if(shininess == nullptr)
+				shininess = FindPropertyValues(object, "Shininess", 1);
+			if(shininess != nullptr)
+				mat.Roughness = sqrtf(2.0f / (std::max((float)ToDouble(*shininess), 0.0f) + 2.0f));
+
+			scene.Materials[id] = (int)model.Materials.size();
+			model.Materials.push_back(mat);
+		}
+		else if(object.Name == "Texture")
+		{
+			std::string file = ReadChildString(object, "RelativeFilename");
+			if(file.empty())
+				file = ReadChildString(object, "FileName");
+			scene.Textures[id] = file;
+		}
+	}
+
+	static const std::vector<Record> noConnections;
+	for(const Record& c : connections ? connections->Children : noConnections)
+	{
+		if((c.Name != "C" && c.Name != "Connect") || c.Properties.size() < 3 || !IsString(c, 0))
+			continue;
+
+		std::string type = ToString(c.Properties[0]);
+		int64 child = ObjectId(c.Properties[1]);
+		int64 parent = ObjectId(c.Properties[2]);
+
+		auto parentNode = scene.Nodes.find(parent);
+		auto parentMaterial = scene.Materials.find(parent);
+		if(parentNode != scene.Nodes.end())
+		{
+			int n = parentNode->second;
+
+			auto childNode = scene.Nodes.find(child);
+			auto childMaterial = scene.Materials.find(child);
+			if(childNode != scene.Nodes.end())
+				model.Nodes[childNode->second].Parent = n;
+			else if(scene.Geometries.count(child))
+				scene.NodeGeometries[n].push_back(child);
+			else if(childMaterial != scene.Materials.end())
+				scene.NodeMaterials[n].push_back(childMaterial->second);
+		}
+		else if(parentMaterial != scene.Materials.end() && scene.Textures.count(child))
+		{
+			// Object-property connections name the material channel the texture feeds.
+			FbxMaterial& mat = model.Materials[parentMaterial->second];
+			std::string channel = type == "OP" && IsString(c, 3) ? ToString(c.Properties[3]) : std::string();
+			const std::string& file = scene.Textures[child];
+
+			if(channel == "NormalMap" || channel == "Bump")
+				mat.NormalMapFile = file;
+			else if(channel == "DiffuseColor" || (channel.empty() && mat.DiffuseMapFile.empty()))
+				mat.DiffuseMapFile = file;
+		}
+	}
+
+	//
+	// Global transforms, parents first.  A parent chain longer than the node count can
+	// only be a cycle, which is cut at the root.
+	//
+
+	std::vector<bool> resolved(model.Nodes.size(), false);
+	std::function<void(int, int)> resolve = [&](int n, int depth)
+	{
+		if(resolved[n])
+			return;
+
+		FbxNode& node = model.Nodes[n];
+		XMMATRIX global = XMLoadFloat4x4(&node.LocalTransform);
+		if(node.Parent >= 0 && depth < (int)model.Nodes.size())
+		{
+			resolve(node.Parent, depth + 1);
+			global = global * XMLoadFloat4x4(&model.Nodes[node.Parent].GlobalTransform);
+		}
+		XMStoreFloat4x4(&node.GlobalTransform, global);
+		resolved[n] = true;
+	};
+	for(int n = 0; n < (int)model.Nodes.size(); ++n)
+		resolve(n, 0);
+
+	//
+	// Build the mesh: every geometry instanced by a node, its corners welded and its
+	// triangles binned per material.
+	//
+
+	const float zSign = settings.ConvertToLeftHanded ? -1.0f : 1.0f;
+
+	auto& vertices = model.Mesh.Vertices;
+	std::vector<bool> needsNormal;
+
+	// Bin 0 takes polygons without a material.
+	std::vector<std::vector<uint32>> subsetIndices(model.Materials.size() + 1);
+
+	std::vector<double> controlPoints;
+	std::vector<int32> polygonVertices;
+	std::vector<int32> polygonMaterials;
+	std::vector<uint32> polygon;
+
+	for(int n = 0; n < (int)model.Nodes.size(); ++n)
+	{
+		for(int64 geometryId : scene.NodeGeometries[n])
+		{
+			const Record& geometry = *scene.Geometries[geometryId];
+			if(!ReadChildArray(geometry, "Vertices", controlPoints) ||
+				!ReadChildArray(geometry, "PolygonVertexIndex", polygonVertices))
+				continue;
+
+			model.Nodes[n].HasMesh = true;
+
+			XMMATRIX toModel = XMMatrixIdentity();
+			if(settings.ApplyNodeTransforms)
+				toModel = GeometricTransform(*scene.NodeRecords[n]) * XMLoadFloat4x4(&model.Nodes[n].GlobalTransform);
+			XMMATRIX normalToModel = XMMatrixTranspose(XMMatrixInverse(nullptr, toModel));
+
+			// Mirrored transforms flip the winding as well.
+			bool flipWinding = settings.ConvertToLeftHanded != (XMVectorGetX(XMMatrixDeterminant(toModel)) < 0.0f);
+
+			LayerElement normals = ReadLayerElement(geometry, "LayerElementNormal", "Normals", "NormalsIndex", 3);
+			LayerElement texCoords = ReadLayerElement(geometry, "LayerElementUV", "UV", "UVIndex", 2);
+
+			// Materials are indices into the materials connected to the node, per polygon
+			// or one for all of them.
+			polygonMaterials.clear();
+			LayerElement::Mapping materialMode = LayerElement::Mapping::AllSame;
+			const Record* materialElement = geometry.Find("LayerElementMaterial");
+			if(materialElement != nullptr && ReadMapping(*materialElement, materialMode))
+				ReadChildArray(*materialElement, "Materials", polygonMaterials);
+
+			const std::vector<int>& nodeMaterials = scene.NodeMaterials[n];
+			const uint32 controlPointCount = (uint32)(controlPoints.size() / 3);
+
+			std::unordered_map<CornerKey, uint32, CornerKeyHash> weldMap;
+
+			uint32 polygonIndex = 0;
+			for(uint32 pv = 0; pv < (uint32)polygonVertices.size(); ++pv)
+			{
+				// The last corner of each polygon is stored as ~index.
+				int32 raw = polygonVertices[pv];
+				bool last = raw < 0;
+				uint32 cp = (uint32)(last ? ~raw : raw);
+				if(cp >= controlPointCount)
+					return false;
+
+				CornerKey key = {};
+				key.ControlPoint = cp;
+
+				const double* normal = normals.Valid() ? normals.Get(pv, polygonIndex, cp) : nullptr;
+				if(normal != nullptr)
+				{
+					XMVECTOR N = XMVectorSet((float)normal[0], (float)normal[1], (float)normal[2], 0.0f);
+					N = XMVector3Normalize(XMVector3TransformNormal(N, normalToModel));
+					key.N[0] = XMVectorGetX(N);
+					key.N[1] = XMVectorGetY(N);
+					key.N[2] = XMVectorGetZ(N) * zSign;
+				}
+
+				const double* texC = texCoords.Valid() ? texCoords.Get(pv, polygonIndex, cp) : nullptr;
+				if(texC != nullptr)
+				{
+					key.T[0] = (float)texC[0];
+					key.T[1] = settings.FlipV ? 1.0f - (float)texC[1] : (float)texC[1];
+				}
+
+				auto it = weldMap.find(key);
+				uint32 index;
+				if(it != weldMap.end())
+				{
+					index = it->second;
+				}
+				else
+				{
+					XMVECTOR P = XMVectorSet((float)controlPoints[3 * cp + 0], (float)controlPoints[3 * cp + 1],
+						(float)controlPoints[3 * cp + 2], 1.0f);
+					P = XMVector3TransformCoord(P, toModel);
+
+					GeometryGenerator::Vertex v;
+					v.Position = XMFLOAT3(XMVectorGetX(P), XMVectorGetY(P), XMVectorGetZ(P) * zSign);
+					v.Normal = XMFLOAT3(key.N[0], key.N[1], key.N[2]);
+					v.TexC = XMFLOAT2(key.T[0], key.T[1]);
+
+					index = (uint32)vertices.size();
+					vertices.push_back(v);
+					needsNormal.push_back(normal == nullptr);
+					weldMap.emplace(key, index);
+				}
+				polygon.push_back(index);
+
+				if(!last)
+					continue;
+
+				int material = -1;
+				std::size_t m = materialMode == LayerElement::Mapping::Polygon ? polygonIndex : 0;
+				if(m < polygonMaterials.size() && polygonMaterials[m] >= 0 &&
+					(std::size_t)polygonMaterials[m] < nodeMaterials.size())
+					material = nodeMaterials[polygonMaterials[m]];
+				else if(polygonMaterials.empty() && !nodeMaterials.empty())
+					material = nodeMaterials[0];
+
+				// Fan triangulate the polygon.
+				auto& indices = subsetIndices[material + 1];
+				for(size_t k = 1; k + 1 < polygon.size(); ++k)
+				{
+					indices.push_back(polygon[0]);
+					indices.push_back(polygon[flipWinding ? k + 1 : k]);
+					indices.push_back(polygon[flipWinding ? k : k + 1]);
+				}
+
+				polygon.clear();
+				++polygonIndex;
+			}
+
+			// A trailing polygon without its end marker is dropped.
+			polygon.clear();
+		}
+	}
+
+	//
+	// Generate smooth normals for the corners that have none.  Corners of a control
+	// point without normals weld into one vertex, so they average its faces.
+	//
+
+	bool anyMissingNormals = std::find(needsNormal.begin(), needsNormal.end(), true) != needsNormal.end();
+	if(anyMissingNormals)
+	{
+		std::vector<XMFLOAT3> accum(vertices.size(), XMFLOAT3(0.0f, 0.0f, 0.0f));
+		for(auto& indices : subsetIndices)
+		{
+			for(size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				XMVECTOR p0 = XMLoadFloat3(&vertices[indices[i + 0]].Position);
+				XMVECTOR p1 = XMLoadFloat3(&vertices[indices[i + 1]].Position);
+				XMVECTOR p2 = XMLoadFloat3(&vertices[indices[i + 2]].Position);
+
+				// Unnormalized cross product is weighted by twice the triangle area.
+				XMVECTOR faceN = XMVector3Cross(p1 - p0, p2 - p0);
+				for(int k = 0; k < 3; ++k)
+				{
+					uint32 v = indices[i + k];
+					if(needsNormal[v])
+						XMStoreFloat3(&accum[v], XMLoadFloat3(&accum[v]) + faceN);
+				}
+			}
+		}
+
+		for(size_t v = 0; v < vertices.size(); ++v)
+		{
+			if(needsNormal[v])
+				XMStoreFloat3(&vertices[v].Normal, XMVector3Normalize(XMLoadFloat3(&accum[v])));
+		}
+	}
+
+	//
+	// Concatenate the per material index lists into subsets.
+	//
+
+	size_t totalIndexCount = 0;
+	for(auto& indices : subsetIndices)
+		totalIndexCount += indices.size();
+
+	model.Mesh.Indices32.reserve(totalIndexCount);
+
+	for(size_t i = 0; i < subsetIndices.size(); ++i)
+	{
+		auto& indices = subsetIndices[i];
+		if(indices.empty())
+			continue;
+
+		FbxSubset subset;
+		subset.MaterialName = i > 0 ? model.Materials[i - 1].Name : std::string();
+		subset.StartIndexLocation = (uint32)model.Mesh.Indices32.size();
+		subset.IndexCount = (uint32)indices.size();
+
+		XMVECTOR vMin = XMVectorReplicate(+FLT_MAX);
+		XMVECTOR vMax = XMVectorReplicate(-FLT_MAX);
+		for(uint32 index : indices)
+		{
+			XMVECTOR P = XMLoadFloat3(&vertices[index].Position);
+			vMin = XMVectorMin(vMin, P);
+			vMax = XMVectorMax(vMax, P);
+		}
+		XMStoreFloat3(&subset.Bounds.Center, 0.5f*(vMin + vMax));
+		XMStoreFloat3(&subset.Bounds.Extents, 0.5f*(vMax - vMin));
+
+		model.Mesh.Indices32.insert(model.Mesh.Indices32.end(), indices.begin(), indices.end());
+		model.Subsets.push_back(subset);
+	}
+
+	//
+	// Tangents are regenerated rather than read so they match the engine's conventions
+	// after the handedness conversion.  Split vertices are appended, so the subset
+	// ranges stay valid.
+	//
+
+	TangentSpace::VertexLayout tangentLayout;
+	tangentLayout.Position = offsetof(GeometryGenerator::Vertex, Position);
+	tangentLayout.Normal = offsetof(GeometryGenerator::Vertex, Normal);
+	tangentLayout.TexC = offsetof(GeometryGenerator::Vertex, TexC);
+	tangentLayout.Tangent = offsetof(GeometryGenerator::Vertex, TangentU);
+	tangentLayout.TangentSign = offsetof(GeometryGenerator::Vertex, TangentSign);
+	TangentSpace::Generate(model.Mesh.Vertices, model.Mesh.Indices32, tangentLayout);
+
+	return !model.Mesh.Indices32.empty();
+}
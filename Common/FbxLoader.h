@@ -0,0 +1,103 @@
+//***************************************************************************************
+// FbxLoader.h
+//
+// Importer for binary FBX files (versions 6.x and 7.x) that needs no FBX SDK.
+//   -The file is read into memory and its record tree is parsed in place.  Array
+//    properties (vertices, indices, layer elements, ...) stored with zlib are inflated
+//    afterwards, all of them in parallel on ThreadPool::Default().  Files are read
+//    through VirtualFileSystem, so models can be loaded from inside zip archives.
+//   -Every mesh of the scene is imported, with the node hierarchy's transforms applied.
+//    Normals and texture coordinates are read in any mapping (by polygon vertex, by
+//    control point, by polygon, all same) and reference (direct, index to direct) mode;
+//    missing normals are generated from the faces.
+//   -Polygons are fan triangulated and corners are welded on exact (control point,
+//    normal, texture coordinate), so the output is a properly indexed mesh.
+//   -Triangles are grouped into one subset per material, which carries the diffuse
+//    color and the diffuse and normal map file names connected to it.
+//   -Tangents are generated with TangentSpace once the mesh is converted to the
+//    engine's conventions.
+//
+// ASCII FBX, animation, skinning and the file's axis system settings are not read;
+// positions are taken as stored.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <DirectXCollision.h>
+#include <string>
+#include <vector>
+
+class FbxLoader
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	struct FbxMaterial
+	{
+		std::string Name;
+
+		DirectX::XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
+		DirectX::XMFLOAT3 FresnelR0 = { 0.01f, 0.01f, 0.01f };
+		float Roughness = 0.5f;
+
+		// Texture paths as written by the exporter, relative to the .fbx file.
+		std::string DiffuseMapFile;
+		std::string NormalMapFile;
+	};
+
+	// A contiguous range of the index buffer that uses one material.
+	struct FbxSubset
+	{
+		std::string MaterialName;
+		uint32 StartIndexLocation = 0;
+		uint32 IndexCount = 0;
+		DirectX::BoundingBox Bounds;
+	};
+
+	// A node ("Model") of the scene hierarchy.
+	struct FbxNode
+	{
+		std::string Name;
+
+		// Index into FbxModel::Nodes, or -1 for children of the scene root.
+		int Parent = -1;
+
+		DirectX::XMFLOAT4X4 LocalTransform;
+		DirectX::XMFLOAT4X4 GlobalTransform;
+
+		bool HasMesh = false;
+	};
+
+	struct FbxModel
+	{
+		GeometryGenerator::MeshData Mesh;
+		std::vector<FbxSubset> Subsets;
+		std::vector<FbxMaterial> Materials;
+		std::vector<FbxNode> Nodes;
+	};
+
+	struct ImportSettings
+	{
+		// Transforms each mesh by its node's global transform (and geometric offset);
+		// otherwise meshes are left in the space of their control points.
+		bool ApplyNodeTransforms = true;
+
+		// FBX is right handed with v pointing up; the engine is left handed with v down.
+		bool ConvertToLeftHanded = true;
+		bool FlipV = true;
+	};
+
+	///<summary>
+	/// Loads filename into model.  Returns false if the file could not be read, is not a
+	/// binary FBX file or contained no polygons.
+	///</summary>
+	static bool Load(const std::string& filename, FbxModel& model);
+	static bool Load(const std::string& filename, FbxModel& model, const ImportSettings& settings);
+
+	///<summary>
+	/// Loads the FBX file held in data.
+	///</summary>
+	static bool Load(const std::uint8_t* data, std::size_t size, FbxModel& model, const ImportSettings& settings);
+};
@@ -0,0 +1,127 @@
+//***************************************************************************************
+// FileUtil.cpp
+//***************************************************************************************
+
+#include "FileUtil.h"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+#ifdef _WIN32
+	// The Windows streams and file functions take UTF-16 paths as they are.
+	const std::wstring& NativePath(const std::wstring& path)
+	{
+		return path;
+	}
+
+	unsigned long ProcessId()
+	{
+		return GetCurrentProcessId();
+	}
+#else
+	// Elsewhere paths are bytes; the engine's paths are ASCII.
+	std::string NativePath(const std::wstring& path)
+	{
+		return std::string(path.begin(), path.end());
+	}
+
+	unsigned long ProcessId()
+	{
+		return (unsigned long)getpid();
+	}
+#endif
+
+	// Unique among the writers of this process; the process id separates processes.
+	std::wstring TemporaryName(const std::wstring& filename)
+	{
+		static std::atomic<unsigned long> counter{ 0 };
+		return filename + L"." + std::to_wstring(ProcessId()) + L"_" + std::to_wstring(++counter) + L".tmp";
+	}
+
+	bool Rename(const std::wstring& from, const std::wstring& to)
+	{
+#ifdef _WIN32
+		return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		// rename replaces an existing target atomically.
+		return std::rename(NativePath(from).c_str(), NativePath(to).c_str()) == 0;
+#endif
+	}
+}
+
+bool FileUtil::ReadFile(const std::wstring& filename, std::vector<std::uint8_t>& bytes)
+{
+	std::ifstream fin(NativePath(filename), std::ios::binary | std::ios::ate);
+	if(!fin)
+		return false;
+
+	std::streamoff size = fin.tellg();
+	if(size < 0)
+		return false;
+
+	bytes.resize((std::size_t)size);
+	fin.seekg(0, std::ios::beg);
+	return (bool)fin.read(reinterpret_cast<char*>(bytes.data()), size);
+}
+
+bool FileUtil::WriteFileAtomic(const std::wstring& filename, const std::vector<Piece>& pieces)
+{
+	std::wstring temporary = TemporaryName(filename);
+	{
+		std::ofstream fout(NativePath(temporary), std::ios::binary | std::ios::trunc);
+		if(!fout)
+			return false;
+
+		for(const Piece& piece : pieces)
+			fout.write(static_cast<const char*>(piece.Data), (std::streamsize)piece.Size);
+
+		fout.close();
+		if(!fout)
+		{
+			RemoveFile(temporary);
+			return false;
+		}
+	}
+
+	if(!Rename(temporary, filename))
+	{
+		RemoveFile(temporary);
+		return false;
+	}
+
+	return true;
+}
+
+bool FileUtil::MakeDirectory(const std::wstring& directory)
+{
+#ifdef _WIN32
+	if(CreateDirectoryW(directory.c_str(), nullptr))
+		return true;
+	DWORD attributes = GetFileAttributesW(directory.c_str());
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+	std::string path = NativePath(directory);
+	if(mkdir(path.c_str(), 0777) == 0)
+		return true;
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+bool FileUtil::RemoveFile(const std::wstring& filename)
+{
+#ifdef _WIN32
+	return DeleteFileW(filename.c_str()) != 0;
+#else
+	return std::remove(NativePath(filename).c_str()) == 0;
+#endif
+}
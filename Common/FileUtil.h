@@ -0,0 +1,51 @@
+//***************************************************************************************
+// FileUtil.h
+//
+// Whole-file reads and writes on the local file system, for the caches and tools that
+// load a file into memory in one go.  Files inside archives go through
+// VirtualFileSystem instead.
+//
+// WriteFileAtomic writes a temporary file next to the target and renames it over the
+// target, so a reader, or another process writing the same file, never sees a torn file.
+// Everything platform specific lives in FileUtil.cpp.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class FileUtil
+{
+public:
+
+	// A run of bytes to write.
+	struct Piece
+	{
+		const void* Data;
+		std::size_t Size;
+	};
+
+	///<summary>
+	/// Reads a whole file.  Returns false if it could not be opened or read.
+	///</summary>
+	static bool ReadFile(const std::wstring& filename, std::vector<std::uint8_t>& bytes);
+
+	///<summary>
+	/// Replaces filename with the pieces, in order.  Returns false, leaving any existing
+	/// file untouched, if it could not be written.
+	///</summary>
+	static bool WriteFileAtomic(const std::wstring& filename, const std::vector<Piece>& pieces);
+
+	///<summary>
+	/// Creates directory unless it exists.  Returns false if it does not exist afterwards.
+	///</summary>
+	static bool MakeDirectory(const std::wstring& directory);
+
+	///<summary>
+	/// Deletes filename.  Returns false if it could not be deleted.
+	///</summary>
+	static bool RemoveFile(const std::wstring& filename);
+};
@@ -3,14 +3,351 @@
 //***************************************************************************************
 
 #include "GeometryGenerator.h"
+#include "ThreadPool.h"
 #include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <unordered_map>
 
 using namespace DirectX;
 
+namespace
+{
+	using Vertex = GeometryGenerator::Vertex;
+	using MeshSize = GeometryGenerator::MeshSize;
+	using MeshSpan = GeometryGenerator::MeshSpan;
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	// Rows of the parallel shapes are handed out in chunks of about this many vertices,
+	// so small meshes are generated on the calling thread.
+	const uint32 ParallelGrainVertices = 4096;
+
+	uint32 RowGrain(uint32 rowVertexCount)
+	{
+		return std::max(1u, ParallelGrainVertices / std::max(rowVertexCount, 1u));
+	}
+
+	MeshSize MakeSize(uint32 vertexCount, uint32 indexCount)
+	{
+		MeshSize size;
+		size.VertexCount = vertexCount;
+		size.IndexCount = indexCount;
+		return size;
+	}
+
+	// Each subdivision splits every triangle into four, so it is capped.
+	uint32 CapSubdivisions(uint32 numSubdivisions)
+	{
+		return std::min<uint32>(numSubdivisions, 6u);
+	}
+
+	// A mesh of vertexCount vertices, edgeCount edges and triangleCount triangles after n
+	// subdivisions.  Each subdivision adds a vertex per edge, splits every edge in two,
+	// adds three edges inside every triangle and splits every triangle in four.
+	MeshSize SubdividedSize(uint32 vertexCount, uint32 edgeCount, uint32 triangleCount, uint32 numSubdivisions)
+	{
+		for(uint32 i = 0; i < numSubdivisions; ++i)
+		{
+			vertexCount += edgeCount;
+			edgeCount = 2*edgeCount + 3*triangleCount;
+			triangleCount *= 4;
+		}
+
+		return MakeSize(vertexCount, 3*triangleCount);
+	}
+
+	void WriteAttribute(unsigned char* vertex, std::size_t offset, const void* value, std::size_t size)
+	{
+		if(offset != GeometryGenerator::VertexLayout::Skip)
+			std::memcpy(vertex + offset, value, size);
+	}
+
+	void WriteVertex(const MeshSpan& out, uint32 i, const Vertex& v)
+	{
+		unsigned char* vertex = static_cast<unsigned char*>(out.Vertices) + i*out.Layout.Stride;
+
+		WriteAttribute(vertex, out.Layout.Position, &v.Position, sizeof(v.Position));
+		WriteAttribute(vertex, out.Layout.Normal, &v.Normal, sizeof(v.Normal));
+		WriteAttribute(vertex, out.Layout.TangentU, &v.TangentU, sizeof(v.TangentU));
+		WriteAttribute(vertex, out.Layout.TexC, &v.TexC, sizeof(v.TexC));
+		WriteAttribute(vertex, out.Layout.TangentSign, &v.TangentSign, sizeof(v.TangentSign));
+	}
+
+	void WriteIndex(const MeshSpan& out, uint32 k, uint32 index)
+	{
+		index += out.BaseVertex;
+
+		if(out.Indices16 != nullptr)
+		{
+			assert(index <= 0xFFFF);
+			out.Indices16[k] = static_cast<GeometryGenerator::uint16>(index);
+		}
+		else
+			out.Indices32[k] = index;
+	}
+
+	// Writes triangle t, the indices 3t to 3t+2.
+	void WriteTriangle(const MeshSpan& out, uint32 t, uint32 i0, uint32 i1, uint32 i2)
+	{
+		WriteIndex(out, 3*t+0, i0);
+		WriteIndex(out, 3*t+1, i1);
+		WriteIndex(out, 3*t+2, i2);
+	}
+
+	// Sizes the vectors of meshData and returns a span over them, for the MeshData
+	// versions of the generators.
+	MeshSpan AllocateSpan(GeometryGenerator::MeshData& meshData, const MeshSize& size)
+	{
+		meshData.Vertices.resize(size.VertexCount);
+		meshData.Indices32.resize(size.IndexCount);
+
+		MeshSpan span;
+		span.Vertices = meshData.Vertices.data();
+		span.Indices32 = meshData.Indices32.data();
+		return span;
+	}
+
+	Vertex MidPoint(const Vertex& v0, const Vertex& v1)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&v0.Position);
+		XMVECTOR p1 = XMLoadFloat3(&v1.Position);
+
+		XMVECTOR n0 = XMLoadFloat3(&v0.Normal);
+		XMVECTOR n1 = XMLoadFloat3(&v1.Normal);
+
+		XMVECTOR tan0 = XMLoadFloat3(&v0.TangentU);
+		XMVECTOR tan1 = XMLoadFloat3(&v1.TangentU);
+
+		XMVECTOR tex0 = XMLoadFloat2(&v0.TexC);
+		XMVECTOR tex1 = XMLoadFloat2(&v1.TexC);
+
+		// Compute the midpoints of all the attributes.  Vectors need to be normalized
+		// since linear interpolating can make them not unit length.
+		XMVECTOR pos = 0.5f*(p0 + p1);
+		XMVECTOR normal = XMVector3Normalize(0.5f*(n0 + n1));
+		XMVECTOR tangent = XMVector3Normalize(0.5f*(tan0+tan1));
+		XMVECTOR tex = 0.5f*(tex0 + tex1);
+
+		Vertex v;
+		XMStoreFloat3(&v.Position, pos);
+		XMStoreFloat3(&v.Normal, normal);
+		XMStoreFloat3(&v.TangentU, tangent);
+		XMStoreFloat2(&v.TexC, tex);
+
+		return v;
+	}
+
+	// Triangles are split into ranges of this many for the parallel passes of Subdivide.
+	const uint32 SubdivideRangeTriangles = 2048;
+
+	uint64 EdgeKey(uint32 a, uint32 b)
+	{
+		return a < b ? ((uint64)a << 32) | b : ((uint64)b << 32) | a;
+	}
+
+	// The edges a range of triangles uses, in the order it first uses them.
+	struct EdgeRange
+	{
+		std::unordered_map<uint64, uint32> Slots;
+		std::vector<uint64> Edges;
+
+		// Index of the midpoint vertex of each of Edges.
+		std::vector<uint32> Midpoints;
+	};
+
+	//       v1
+	//       *
+	//      / \
+	//     /   \
+	//  m0*-----*m1
+	//   / \   / \
+	//  /   \ /   \
+	// *-----*-----*
+	// v0    m2     v2
+	//
+	// Splits every triangle into four.  Each edge gets one midpoint vertex, shared by the
+	// triangles on both sides, so the result stays indexed: the new vertices are appended
+	// in the order the triangles first use their edges.  The triangles are split into
+	// fixed ranges that find their edges and write their children in parallel; only the
+	// numbering of the midpoints runs serially, which keeps the output independent of
+	// the number of threads.
+	void Subdivide(GeometryGenerator::MeshData& meshData)
+	{
+		// Edge k of a triangle runs from corner EdgeCorners[k][0] to EdgeCorners[k][1],
+		// and its midpoint is mk.
+		static const uint32 EdgeCorners[3][2] = { { 0, 1 }, { 1, 2 }, { 0, 2 } };
+
+		const std::vector<uint32>& indices = meshData.Indices32;
+		uint32 vertexCount = (uint32)meshData.Vertices.size();
+		uint32 triangleCount = (uint32)indices.size()/3;
+		uint32 rangeCount = (triangleCount + SubdivideRangeTriangles - 1)/SubdivideRangeTriangles;
+
+		ThreadPool& pool = ThreadPool::Default();
+
+		// Slot of each triangle edge in its range's Edges.
+		std::vector<uint32> edgeSlots(3*triangleCount);
+		std::vector<EdgeRange> ranges(rangeCount);
+
+		pool.ParallelFor(rangeCount, 1, [&](uint32 begin, uint32 end)
+		{
+			for(uint32 r = begin; r < end; ++r)
+			{
+				EdgeRange& range = ranges[r];
+				uint32 first = r*SubdivideRangeTriangles;
+				uint32 last = std::min(first + SubdivideRangeTriangles, triangleCount);
+
+				range.Slots.reserve(3*(last - first));
+				for(uint32 t = first; t < last; ++t)
+				{
+					for(uint32 k = 0; k < 3; ++k)
+					{
+						uint64 key = EdgeKey(indices[t*3 + EdgeCorners[k][0]], indices[t*3 + EdgeCorners[k][1]]);
+						auto slot = range.Slots.emplace(key, (uint32)range.Edges.size());
+						if(slot.second)
+							range.Edges.push_back(key);
+
+						edgeSlots[t*3+k] = slot.first->second;
+					}
+				}
+			}
+		});
+
+		// Number the midpoints.  An edge seen by an earlier range keeps that range's vertex.
+		std::unordered_map<uint64, uint32> midpoints;
+		std::vector<uint64> newEdges;
+		midpoints.reserve(3*triangleCount/2 + 1);
+		newEdges.reserve(3*triangleCount/2 + 1);
+
+		for(EdgeRange& range : ranges)
+		{
+			range.Midpoints.resize(range.Edges.size());
+			for(size_t e = 0; e < range.Edges.size(); ++e)
+			{
+				auto midpoint = midpoints.emplace(range.Edges[e], vertexCount + (uint32)newEdges.size());
+				if(midpoint.second)
+					newEdges.push_back(range.Edges[e]);
+
+				range.Midpoints[e] = midpoint.first->second;
+			}
+
+			range.Slots = std::unordered_map<uint64, uint32>();
+		}
+
+		//
+		// Add new geometry.
+		//
+
+		std::vector<Vertex>& vertices = meshData.Vertices;
+		vertices.resize(vertexCount + newEdges.size());
+
+		pool.ParallelFor((uint32)newEdges.size(), ParallelGrainVertices, [&](uint32 begin, uint32 end)
+		{
+			for(uint32 e = begin; e < end; ++e)
+				vertices[vertexCount + e] = MidPoint(vertices[(uint32)(newEdges[e] >> 32)], vertices[(uint32)newEdges[e]]);
+		});
+
+		std::vector<uint32> subdivided(12*triangleCount);
+
+		pool.ParallelFor(rangeCount, 1, [&](uint32 begin, uint32 end)
+		{
+			for(uint32 r = begin; r < end; ++r)
+			{
+				const EdgeRange& range = ranges[r];
+				uint32 first = r*SubdivideRangeTriangles;
+				uint32 last = std::min(first + SubdivideRangeTriangles, triangleCount);
+
+				for(uint32 t = first; t < last; ++t)
+				{
+					uint32 v0 = indices[t*3+0];
+					uint32 v1 = indices[t*3+1];
+					uint32 v2 = indices[t*3+2];
+					uint32 m0 = range.Midpoints[edgeSlots[t*3+0]];
+					uint32 m1 = range.Midpoints[edgeSlots[t*3+1]];
+					uint32 m2 = range.Midpoints[edgeSlots[t*3+2]];
+
+					const uint32 children[12] =
+					{
+						v0, m0, m2,
+						m0, m1, m2,
+						m2, m1, v2,
+						m0, v1, m1
+					};
+					std::copy(children, children + 12, &subdivided[t*12]);
+				}
+			}
+		});
+
+		meshData.Indices32.swap(subdivided);
+	}
+
+	// Writes the base mesh subdivided numSubdivisions times.  finish maps each vertex
+	// before it is written.
+	template<class FinishFn>
+	void WriteSubdivided(const Vertex* vertices, uint32 vertexCount, const uint32* indices, uint32 triangleCount,
+		uint32 numSubdivisions, const MeshSpan& out, const FinishFn& finish)
+	{
+		GeometryGenerator::MeshData meshData;
+		meshData.Vertices.assign(vertices, vertices + vertexCount);
+		meshData.Indices32.assign(indices, indices + 3*triangleCount);
+
+		for(uint32 i = 0; i < numSubdivisions; ++i)
+			Subdivide(meshData);
+
+		ThreadPool::Default().ParallelFor((uint32)meshData.Vertices.size(), ParallelGrainVertices, [&](uint32 begin, uint32 end)
+		{
+			for(uint32 i = begin; i < end; ++i)
+				WriteVertex(out, i, finish(meshData.Vertices[i]));
+		});
+
+		for(uint32 t = 0; t < (uint32)meshData.Indices32.size()/3; ++t)
+			WriteTriangle(out, t, meshData.Indices32[t*3+0], meshData.Indices32[t*3+1], meshData.Indices32[t*3+2]);
+	}
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::BoxSize(uint32 numSubdivisions)
+{
+	// Each face is a quad of four vertices and five edges, the diagonal included; faces
+	// share no vertices because their normals differ.
+	return SubdividedSize(24, 30, 12, CapSubdivisions(numSubdivisions));
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::SphereSize(uint32 sliceCount, uint32 stackCount)
+{
+	// The poles, stackCount-1 rings, and a fan at each pole around the quads between rings.
+	return MakeSize(2 + (stackCount-1)*(sliceCount+1), 6*sliceCount*(stackCount-1));
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GeosphereSize(uint32 numSubdivisions)
+{
+	return SubdividedSize(12, 30, 20, CapSubdivisions(numSubdivisions));
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::CylinderSize(uint32 sliceCount, uint32 stackCount)
+{
+	// stackCount+1 rings, then a ring and a center vertex for each cap.
+	return MakeSize((stackCount+1)*(sliceCount+1) + 2*(sliceCount+2), 6*sliceCount*stackCount + 6*sliceCount);
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GridSize(uint32 m, uint32 n)
+{
+	return MakeSize(m*n, (m-1)*(n-1)*6);
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::QuadSize()
+{
+	return MakeSize(4, 6);
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions)
 {
     MeshData meshData;
+    CreateBox(width, height, depth, numSubdivisions, AllocateSpan(meshData, BoxSize(numSubdivisions)));
+    return meshData;
+}
 
+void GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions, const MeshSpan& out)
+{
     //
 	// Create the vertices.
 	//
@@ -20,7 +357,7 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float heig
 	float w2 = 0.5f*width;
 	float h2 = 0.5f*height;
 	float d2 = 0.5f*depth;
-    
+
 	// Fill in the front face vertex data.
 	v[0] = Vertex(-w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
 	v[1] = Vertex(-w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
@@ -57,8 +394,6 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float heig
 	v[22] = Vertex(+w2, +h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
 	v[23] = Vertex(+w2, -h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f);
 
-	meshData.Vertices.assign(&v[0], &v[24]);
- 
 	//
 	// Create the indices.
 	//
@@ -89,21 +424,19 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float heig
 	i[30] = 20; i[31] = 21; i[32] = 22;
 	i[33] = 20; i[34] = 22; i[35] = 23;
 
-	meshData.Indices32.assign(&i[0], &i[36]);
-
-    // Put a cap on the number of subdivisions.
-    numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
-
-    for(uint32 i = 0; i < numSubdivisions; ++i)
-        Subdivide(meshData);
-
-    return meshData;
+	WriteSubdivided(v, 24, i, 12, CapSubdivisions(numSubdivisions), out,
+		[](const Vertex& vertex) { return vertex; });
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount)
 {
     MeshData meshData;
+    CreateSphere(radius, sliceCount, stackCount, AllocateSpan(meshData, SphereSize(sliceCount, stackCount)));
+    return meshData;
+}
 
+void GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, const MeshSpan& out)
+{
 	//
 	// Compute the vertices stating at the top pole and moving down the stacks.
 	//
@@ -114,47 +447,19 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
 	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
 
-	meshData.Vertices.push_back( topVertex );
-
 	float phiStep   = XM_PI/stackCount;
 	float thetaStep = 2.0f*XM_PI/sliceCount;
 
-	// Compute vertices for each stack ring (do not count the poles as rings).
-	for(uint32 i = 1; i <= stackCount-1; ++i)
-	{
-		float phi = i*phiStep;
-
-		// Vertices of ring.
-        for(uint32 j = 0; j <= sliceCount; ++j)
-		{
-			float theta = j*thetaStep;
-
-			Vertex v;
-
-			// spherical to cartesian
-			v.Position.x = radius*sinf(phi)*cosf(theta);
-			v.Position.y = radius*cosf(phi);
-			v.Position.z = radius*sinf(phi)*sinf(theta);
-
-			// Partial derivative of P with respect to theta
-			v.TangentU.x = -radius*sinf(phi)*sinf(theta);
-			v.TangentU.y = 0.0f;
-			v.TangentU.z = +radius*sinf(phi)*cosf(theta);
-
-			XMVECTOR T = XMLoadFloat3(&v.TangentU);
-			XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
+	// Offset the indices to the index of the first vertex in the first ring.
+	// This is just skipping the top pole vertex.
+	uint32 baseIndex = 1;
+	uint32 ringVertexCount = sliceCount + 1;
 
-			XMVECTOR p = XMLoadFloat3(&v.Position);
-			XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
+	// South pole vertex is written last.
+	uint32 southPoleIndex = baseIndex + (stackCount-1)*ringVertexCount;
 
-			v.TexC.x = theta / XM_2PI;
-			v.TexC.y = phi / XM_PI;
-
-			meshData.Vertices.push_back( v );
-		}
-	}
-
-	meshData.Vertices.push_back( bottomVertex );
+	WriteVertex(out, 0, topVertex);
+	WriteVertex(out, southPoleIndex, bottomVertex);
 
 	//
 	// Compute indices for top stack.  The top stack was written first to the vertex buffer
@@ -162,230 +467,160 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	//
 
     for(uint32 i = 1; i <= sliceCount; ++i)
-	{
-		meshData.Indices32.push_back(0);
-		meshData.Indices32.push_back(i+1);
-		meshData.Indices32.push_back(i);
-	}
-	
-	//
-	// Compute indices for inner stacks (not connected to poles).
-	//
+		WriteTriangle(out, i-1, 0, i+1, i);
 
-	// Offset the indices to the index of the first vertex in the first ring.
-	// This is just skipping the top pole vertex.
-    uint32 baseIndex = 1;
-    uint32 ringVertexCount = sliceCount + 1;
-	for(uint32 i = 0; i < stackCount-2; ++i)
+	// Compute vertices for each stack ring (do not count the poles as rings), together
+	// with the indices of the inner stack (not connected to poles) below the ring.  The
+	// rings write disjoint ranges, so large spheres build them in parallel.
+	ThreadPool::Default().ParallelFor(stackCount-1, RowGrain(ringVertexCount), [&](uint32 begin, uint32 end)
 	{
-		for(uint32 j = 0; j < sliceCount; ++j)
+		for(uint32 r = begin; r < end; ++r)
 		{
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
+			float phi = (r+1)*phiStep;
+			uint32 ringIndex = baseIndex + r*ringVertexCount;
 
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j+1);
-		}
-	}
+			// Vertices of ring.
+			for(uint32 j = 0; j <= sliceCount; ++j)
+			{
+				float theta = j*thetaStep;
 
-	//
-	// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
-	// and connects the bottom pole to the bottom ring.
-	//
+				Vertex v;
 
-	// South pole vertex was added last.
-	uint32 southPoleIndex = (uint32)meshData.Vertices.size()-1;
+				// spherical to cartesian
+				v.Position.x = radius*sinf(phi)*cosf(theta);
+				v.Position.y = radius*cosf(phi);
+				v.Position.z = radius*sinf(phi)*sinf(theta);
 
-	// Offset the indices to the index of the first vertex in the last ring.
-	baseIndex = southPoleIndex - ringVertexCount;
-	
-	for(uint32 i = 0; i < sliceCount; ++i)
-	{
-		meshData.Indices32.push_back(southPoleIndex);
-		meshData.Indices32.push_back(baseIndex+i);
-		meshData.Indices32.push_back(baseIndex+i+1);
-	}
+				// Partial derivative of P with respect to theta
+				v.TangentU.x = -radius*sinf(phi)*sinf(theta);
+				v.TangentU.y = 0.0f;
+				v.TangentU.z = +radius*sinf(phi)*cosf(theta);
 
-    return meshData;
-}
- 
-void GeometryGenerator::Subdivide(MeshData& meshData)
-{
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
+				XMVECTOR T = XMLoadFloat3(&v.TangentU);
+				XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
 
+				XMVECTOR p = XMLoadFloat3(&v.Position);
+				XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
 
-	meshData.Vertices.resize(0);
-	meshData.Indices32.resize(0);
+				v.TexC.x = theta / XM_2PI;
+				v.TexC.y = phi / XM_PI;
 
-	//       v1
-	//       *
-	//      / \
-	//     /   \
-	//  m0*-----*m1
-	//   / \   / \
-	//  /   \ /   \
-	// *-----*-----*
-	// v0    m2     v2
-
-	uint32 numTris = (uint32)inputCopy.Indices32.size()/3;
-	for(uint32 i = 0; i < numTris; ++i)
-	{
-		Vertex v0 = inputCopy.Vertices[ inputCopy.Indices32[i*3+0] ];
-		Vertex v1 = inputCopy.Vertices[ inputCopy.Indices32[i*3+1] ];
-		Vertex v2 = inputCopy.Vertices[ inputCopy.Indices32[i*3+2] ];
-
-		//
-		// Generate the midpoints.
-		//
-
-        Vertex m0 = MidPoint(v0, v1);
-        Vertex m1 = MidPoint(v1, v2);
-        Vertex m2 = MidPoint(v0, v2);
-
-		//
-		// Add new geometry.
-		//
-
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
- 
-		meshData.Indices32.push_back(i*6+0);
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+5);
-
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+5);
-
-		meshData.Indices32.push_back(i*6+5);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+2);
-
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+1);
-		meshData.Indices32.push_back(i*6+4);
-	}
-}
+				WriteVertex(out, ringIndex + j, v);
+			}
 
-GeometryGenerator::Vertex GeometryGenerator::MidPoint(const Vertex& v0, const Vertex& v1)
-{
-    XMVECTOR p0 = XMLoadFloat3(&v0.Position);
-    XMVECTOR p1 = XMLoadFloat3(&v1.Position);
-
-    XMVECTOR n0 = XMLoadFloat3(&v0.Normal);
-    XMVECTOR n1 = XMLoadFloat3(&v1.Normal);
+			if(r+2 >= stackCount)
+				continue;
 
-    XMVECTOR tan0 = XMLoadFloat3(&v0.TangentU);
-    XMVECTOR tan1 = XMLoadFloat3(&v1.TangentU);
-
-    XMVECTOR tex0 = XMLoadFloat2(&v0.TexC);
-    XMVECTOR tex1 = XMLoadFloat2(&v1.TexC);
+			// Inner stacks follow the top stack's sliceCount triangles.
+			uint32 t = sliceCount + r*2*sliceCount;
+			for(uint32 j = 0; j < sliceCount; ++j, t += 2)
+			{
+				WriteTriangle(out, t, ringIndex + j, ringIndex + j+1, ringIndex + ringVertexCount + j);
+				WriteTriangle(out, t+1, ringIndex + ringVertexCount + j, ringIndex + j+1, ringIndex + ringVertexCount + j+1);
+			}
+		}
+	});
 
-    // Compute the midpoints of all the attributes.  Vectors need to be normalized
-    // since linear interpolating can make them not unit length.  
-    XMVECTOR pos = 0.5f*(p0 + p1);
-    XMVECTOR normal = XMVector3Normalize(0.5f*(n0 + n1));
-    XMVECTOR tangent = XMVector3Normalize(0.5f*(tan0+tan1));
-    XMVECTOR tex = 0.5f*(tex0 + tex1);
+	//
+	// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
+	// and connects the bottom pole to the bottom ring.
+	//
 
-    Vertex v;
-    XMStoreFloat3(&v.Position, pos);
-    XMStoreFloat3(&v.Normal, normal);
-    XMStoreFloat3(&v.TangentU, tangent);
-    XMStoreFloat2(&v.TexC, tex);
+	// Offset the indices to the index of the first vertex in the last ring.
+	baseIndex = southPoleIndex - ringVertexCount;
 
-    return v;
+	uint32 bottomTriangle = sliceCount + (stackCount-2)*2*sliceCount;
+	for(uint32 i = 0; i < sliceCount; ++i)
+		WriteTriangle(out, bottomTriangle + i, southPoleIndex, baseIndex+i, baseIndex+i+1);
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions)
 {
     MeshData meshData;
+    CreateGeosphere(radius, numSubdivisions, AllocateSpan(meshData, GeosphereSize(numSubdivisions)));
+    return meshData;
+}
 
-	// Put a cap on the number of subdivisions.
-    numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
-
+void GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions, const MeshSpan& out)
+{
 	// Approximate a sphere by tessellating an icosahedron.
 
-	const float X = 0.525731f; 
+	const float X = 0.525731f;
 	const float Z = 0.850651f;
 
-	XMFLOAT3 pos[12] = 
+	XMFLOAT3 pos[12] =
 	{
-		XMFLOAT3(-X, 0.0f, Z),  XMFLOAT3(X, 0.0f, Z),  
-		XMFLOAT3(-X, 0.0f, -Z), XMFLOAT3(X, 0.0f, -Z),    
-		XMFLOAT3(0.0f, Z, X),   XMFLOAT3(0.0f, Z, -X), 
-		XMFLOAT3(0.0f, -Z, X),  XMFLOAT3(0.0f, -Z, -X),    
-		XMFLOAT3(Z, X, 0.0f),   XMFLOAT3(-Z, X, 0.0f), 
+		XMFLOAT3(-X, 0.0f, Z),  XMFLOAT3(X, 0.0f, Z),
+		XMFLOAT3(-X, 0.0f, -Z), XMFLOAT3(X, 0.0f, -Z),
+		XMFLOAT3(0.0f, Z, X),   XMFLOAT3(0.0f, Z, -X),
+		XMFLOAT3(0.0f, -Z, X),  XMFLOAT3(0.0f, -Z, -X),
+		XMFLOAT3(Z, X, 0.0f),   XMFLOAT3(-Z, X, 0.0f),
 		XMFLOAT3(Z, -X, 0.0f),  XMFLOAT3(-Z, -X, 0.0f)
 	};
 
     uint32 k[60] =
 	{
-		1,4,0,  4,9,0,  4,5,9,  8,5,4,  1,8,4,    
-		1,10,8, 10,3,8, 8,3,5,  3,2,5,  3,7,2,    
-		3,10,7, 10,6,7, 6,11,7, 6,0,11, 6,1,0, 
-		10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7 
+		1,4,0,  4,9,0,  4,5,9,  8,5,4,  1,8,4,
+		1,10,8, 10,3,8, 8,3,5,  3,2,5,  3,7,2,
+		3,10,7, 10,6,7, 6,11,7, 6,0,11, 6,1,0,
+		10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7
 	};
 
-    meshData.Vertices.resize(12);
-    meshData.Indices32.assign(&k[0], &k[60]);
-
+	// Only the positions matter; everything else is derived from them below.
+	Vertex v[12];
 	for(uint32 i = 0; i < 12; ++i)
-		meshData.Vertices[i].Position = pos[i];
+		v[i] = Vertex(pos[i], XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT2(0.0f, 0.0f));
 
-	for(uint32 i = 0; i < numSubdivisions; ++i)
-		Subdivide(meshData);
-
-	// Project vertices onto sphere and scale.
-	for(uint32 i = 0; i < meshData.Vertices.size(); ++i)
+	WriteSubdivided(v, 12, k, 20, CapSubdivisions(numSubdivisions), out, [radius](const Vertex& vertex)
 	{
+		Vertex result;
+
 		// Project onto unit sphere.
-		XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&meshData.Vertices[i].Position));
+		XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&vertex.Position));
 
 		// Project onto sphere.
 		XMVECTOR p = radius*n;
 
-		XMStoreFloat3(&meshData.Vertices[i].Position, p);
-		XMStoreFloat3(&meshData.Vertices[i].Normal, n);
+		XMStoreFloat3(&result.Position, p);
+		XMStoreFloat3(&result.Normal, n);
 
 		// Derive texture coordinates from spherical coordinates.
-        float theta = atan2f(meshData.Vertices[i].Position.z, meshData.Vertices[i].Position.x);
+        float theta = atan2f(result.Position.z, result.Position.x);
 
         // Put in [0, 2pi].
         if(theta < 0.0f)
             theta += XM_2PI;
 
-		float phi = acosf(meshData.Vertices[i].Position.y / radius);
+		float phi = acosf(result.Position.y / radius);
 
-		meshData.Vertices[i].TexC.x = theta/XM_2PI;
-		meshData.Vertices[i].TexC.y = phi/XM_PI;
+		result.TexC.x = theta/XM_2PI;
+		result.TexC.y = phi/XM_PI;
 
 		// Partial derivative of P with respect to theta
-		meshData.Vertices[i].TangentU.x = -radius*sinf(phi)*sinf(theta);
-		meshData.Vertices[i].TangentU.y = 0.0f;
-		meshData.Vertices[i].TangentU.z = +radius*sinf(phi)*cosf(theta);
+		result.TangentU.x = -radius*sinf(phi)*sinf(theta);
+		result.TangentU.y = 0.0f;
+		result.TangentU.z = +radius*sinf(phi)*cosf(theta);
 
-		XMVECTOR T = XMLoadFloat3(&meshData.Vertices[i].TangentU);
-		XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
-	}
+		XMVECTOR T = XMLoadFloat3(&result.TangentU);
+		XMStoreFloat3(&result.TangentU, XMVector3Normalize(T));
 
-    return meshData;
+		return result;
+	});
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount)
 {
     MeshData meshData;
+    CreateCylinder(bottomRadius, topRadius, height, sliceCount, stackCount,
+        AllocateSpan(meshData, CylinderSize(sliceCount, stackCount)));
+    return meshData;
+}
 
+void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, const MeshSpan& out)
+{
 	//
 	// Build Stacks.
-	// 
+	//
 
 	float stackHeight = height / stackCount;
 
@@ -394,90 +629,90 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius
 
 	uint32 ringCount = stackCount+1;
 
-	// Compute vertices for each stack ring starting at the bottom and moving up.
-	for(uint32 i = 0; i < ringCount; ++i)
-	{
-		float y = -0.5f*height + i*stackHeight;
-		float r = bottomRadius + i*radiusStep;
-
-		// vertices of ring
-		float dTheta = 2.0f*XM_PI/sliceCount;
-		for(uint32 j = 0; j <= sliceCount; ++j)
-		{
-			Vertex vertex;
-
-			float c = cosf(j*dTheta);
-			float s = sinf(j*dTheta);
-
-			vertex.Position = XMFLOAT3(r*c, y, r*s);
-
-			vertex.TexC.x = (float)j/sliceCount;
-			vertex.TexC.y = 1.0f - (float)i/stackCount;
-
-			// Cylinder can be parameterized as follows, where we introduce v
-			// parameter that goes in the same direction as the v tex-coord
-			// so that the bitangent goes in the same direction as the v tex-coord.
-			//   Let r0 be the bottom radius and let r1 be the top radius.
-			//   y(v) = h - hv for v in [0,1].
-			//   r(v) = r1 + (r0-r1)v
-			//
-			//   x(t, v) = r(v)*cos(t)
-			//   y(t, v) = h - hv
-			//   z(t, v) = r(v)*sin(t)
-			// 
-			//  dx/dt = -r(v)*sin(t)
-			//  dy/dt = 0
-			//  dz/dt = +r(v)*cos(t)
-			//
-			//  dx/dv = (r0-r1)*cos(t)
-			//  dy/dv = -h
-			//  dz/dv = (r0-r1)*sin(t)
-
-			// This is unit length.
-			vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
-
-			float dr = bottomRadius-topRadius;
-			XMFLOAT3 bitangent(dr*c, -height, dr*s);
-
-			XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
-			XMVECTOR B = XMLoadFloat3(&bitangent);
-			XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
-			XMStoreFloat3(&vertex.Normal, N);
-
-			meshData.Vertices.push_back(vertex);
-		}
-	}
-
 	// Add one because we duplicate the first and last vertex per ring
 	// since the texture coordinates are different.
 	uint32 ringVertexCount = sliceCount+1;
 
-	// Compute indices for each stack.
-	for(uint32 i = 0; i < stackCount; ++i)
+	// Compute vertices for each stack ring starting at the bottom and moving up, together
+	// with the indices of the stack above the ring.  Large cylinders build the rings in
+	// parallel.
+	ThreadPool::Default().ParallelFor(ringCount, RowGrain(ringVertexCount), [&](uint32 begin, uint32 end)
 	{
-		for(uint32 j = 0; j < sliceCount; ++j)
+		for(uint32 i = begin; i < end; ++i)
 		{
-			meshData.Indices32.push_back(i*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j+1);
-
-			meshData.Indices32.push_back(i*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j+1);
-			meshData.Indices32.push_back(i*ringVertexCount + j+1);
+			float y = -0.5f*height + i*stackHeight;
+			float r = bottomRadius + i*radiusStep;
+
+			// vertices of ring
+			float dTheta = 2.0f*XM_PI/sliceCount;
+			for(uint32 j = 0; j <= sliceCount; ++j)
+			{
+				Vertex vertex;
+
+				float c = cosf(j*dTheta);
+				float s = sinf(j*dTheta);
+
+				vertex.Position = XMFLOAT3(r*c, y, r*s);
+
+				vertex.TexC.x = (float)j/sliceCount;
+				vertex.TexC.y = 1.0f - (float)i/stackCount;
+
+				// Cylinder can be parameterized as follows, where we introduce v
+				// parameter that goes in the same direction as the v tex-coord
+				// so that the bitangent goes in the same direction as the v tex-coord.
+				//   Let r0 be the bottom radius and let r1 be the top radius.
+				//   y(v) = h - hv for v in [0,1].
+				//   r(v) = r1 + (r0-r1)v
+				//
+				//   x(t, v) = r(v)*cos(t)
+				//   y(t, v) = h - hv
+				//   z(t, v) = r(v)*sin(t)
+				//
+				//  dx/dt = -r(v)*sin(t)
+				//  dy/dt = 0
+				//  dz/dt = +r(v)*cos(t)
+				//
+				//  dx/dv = (r0-r1)*cos(t)
+				//  dy/dv = -h
+				//  dz/dv = (r0-r1)*sin(t)
+
+				// This is unit length.
+				vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
+
+				float dr = bottomRadius-topRadius;
+				XMFLOAT3 bitangent(dr*c, -height, dr*s);
+
+				XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
+				XMVECTOR B = XMLoadFloat3(&bitangent);
+				XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
+				XMStoreFloat3(&vertex.Normal, N);
+
+				WriteVertex(out, i*ringVertexCount + j, vertex);
+			}
+
+			if(i == stackCount)
+				continue;
+
+			// Compute indices for the stack.
+			uint32 t = i*2*sliceCount;
+			for(uint32 j = 0; j < sliceCount; ++j, t += 2)
+			{
+				WriteTriangle(out, t, i*ringVertexCount + j, (i+1)*ringVertexCount + j, (i+1)*ringVertexCount + j+1);
+				WriteTriangle(out, t+1, i*ringVertexCount + j, (i+1)*ringVertexCount + j+1, i*ringVertexCount + j+1);
+			}
 		}
-	}
+	});
 
-	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
+	uint32 capIndex = ringCount*ringVertexCount;
+	uint32 capTriangle = 2*sliceCount*stackCount;
 
-    return meshData;
+	BuildCylinderTopCap(topRadius, height, sliceCount, capIndex, capTriangle, out);
+	BuildCylinderBottomCap(bottomRadius, height, sliceCount, capIndex + sliceCount+2, capTriangle + sliceCount, out);
 }
 
-void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height,
-											uint32 sliceCount, uint32 stackCount, MeshData& meshData)
+void GeometryGenerator::BuildCylinderTopCap(float topRadius, float height, uint32 sliceCount,
+											uint32 baseIndex, uint32 firstTriangle, const MeshSpan& out)
 {
-	uint32 baseIndex = (uint32)meshData.Vertices.size();
-
 	float y = 0.5f*height;
 	float dTheta = 2.0f*XM_PI/sliceCount;
 
@@ -492,31 +727,24 @@ void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius,
 		float u = x/height + 0.5f;
 		float v = z/height + 0.5f;
 
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
+		WriteVertex(out, baseIndex + i, Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
-
-	// Index of center vertex.
-	uint32 centerIndex = (uint32)meshData.Vertices.size()-1;
+	uint32 centerIndex = baseIndex + sliceCount+1;
+	WriteVertex(out, centerIndex, Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
 
 	for(uint32 i = 0; i < sliceCount; ++i)
-	{
-		meshData.Indices32.push_back(centerIndex);
-		meshData.Indices32.push_back(baseIndex + i+1);
-		meshData.Indices32.push_back(baseIndex + i);
-	}
+		WriteTriangle(out, firstTriangle + i, centerIndex, baseIndex + i+1, baseIndex + i);
 }
 
-void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, float height,
-											   uint32 sliceCount, uint32 stackCount, MeshData& meshData)
+void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float height, uint32 sliceCount,
+											   uint32 baseIndex, uint32 firstTriangle, const MeshSpan& out)
 {
-	// 
+	//
 	// Build bottom cap.
 	//
 
-	uint32 baseIndex = (uint32)meshData.Vertices.size();
 	float y = -0.5f*height;
 
 	// vertices of ring
@@ -531,34 +759,26 @@ void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadi
 		float u = x/height + 0.5f;
 		float v = z/height + 0.5f;
 
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
+		WriteVertex(out, baseIndex + i, Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
-
-	// Cache the index of center vertex.
-	uint32 centerIndex = (uint32)meshData.Vertices.size()-1;
+	uint32 centerIndex = baseIndex + sliceCount+1;
+	WriteVertex(out, centerIndex, Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
 
 	for(uint32 i = 0; i < sliceCount; ++i)
-	{
-		meshData.Indices32.push_back(centerIndex);
-		meshData.Indices32.push_back(baseIndex + i);
-		meshData.Indices32.push_back(baseIndex + i+1);
-	}
+		WriteTriangle(out, firstTriangle + i, centerIndex, baseIndex + i, baseIndex + i+1);
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n)
 {
     MeshData meshData;
+    CreateGrid(width, depth, m, n, AllocateSpan(meshData, GridSize(m, n)));
+    return meshData;
+}
 
-	uint32 vertexCount = m*n;
-	uint32 faceCount   = (m-1)*(n-1)*2;
-
-	//
-	// Create the vertices.
-	//
-
+void GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n, const MeshSpan& out)
+{
 	float halfWidth = 0.5f*width;
 	float halfDepth = 0.5f*depth;
 
@@ -568,90 +788,84 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 	float du = 1.0f / (n-1);
 	float dv = 1.0f / (m-1);
 
-	meshData.Vertices.resize(vertexCount);
-	for(uint32 i = 0; i < m; ++i)
+	// Each row writes its vertices and the quads below it, so large grids (terrain)
+	// build their rows in parallel.
+	ThreadPool::Default().ParallelFor(m, RowGrain(n), [&](uint32 begin, uint32 end)
 	{
-		float z = halfDepth - i*dz;
-		for(uint32 j = 0; j < n; ++j)
+		for(uint32 i = begin; i < end; ++i)
 		{
-			float x = -halfWidth + j*dx;
+			//
+			// Create the vertices.
+			//
 
-			meshData.Vertices[i*n+j].Position = XMFLOAT3(x, 0.0f, z);
-			meshData.Vertices[i*n+j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			meshData.Vertices[i*n+j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
+			float z = halfDepth - i*dz;
+			for(uint32 j = 0; j < n; ++j)
+			{
+				float x = -halfWidth + j*dx;
 
-			// Stretch texture over grid.
-			meshData.Vertices[i*n+j].TexC.x = j*du;
-			meshData.Vertices[i*n+j].TexC.y = i*dv;
-		}
-	}
- 
-    //
-	// Create the indices.
-	//
+				Vertex v;
+				v.Position = XMFLOAT3(x, 0.0f, z);
+				v.Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
+				v.TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
 
-	meshData.Indices32.resize(faceCount*3); // 3 indices per face
+				// Stretch texture over grid.
+				v.TexC.x = j*du;
+				v.TexC.y = i*dv;
 
-	// Iterate over each quad and compute indices.
-	uint32 k = 0;
-	for(uint32 i = 0; i < m-1; ++i)
-	{
-		for(uint32 j = 0; j < n-1; ++j)
-		{
-			meshData.Indices32[k]   = i*n+j;
-			meshData.Indices32[k+1] = i*n+j+1;
-			meshData.Indices32[k+2] = (i+1)*n+j;
+				WriteVertex(out, i*n+j, v);
+			}
 
-			meshData.Indices32[k+3] = (i+1)*n+j;
-			meshData.Indices32[k+4] = i*n+j+1;
-			meshData.Indices32[k+5] = (i+1)*n+j+1;
+			if(i == m-1)
+				continue;
 
-			k += 6; // next quad
-		}
-	}
+			//
+			// Create the indices of each quad, two triangles apiece.
+			//
 
-    return meshData;
+			uint32 t = i*(n-1)*2;
+			for(uint32 j = 0; j < n-1; ++j, t += 2)
+			{
+				WriteTriangle(out, t, i*n+j, i*n+j+1, (i+1)*n+j);
+				WriteTriangle(out, t+1, (i+1)*n+j, i*n+j+1, (i+1)*n+j+1);
+			}
+		}
+	});
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth)
 {
     MeshData meshData;
+    CreateQuad(x, y, w, h, depth, AllocateSpan(meshData, QuadSize()));
+    return meshData;
+}
 
-	meshData.Vertices.resize(4);
-	meshData.Indices32.resize(6);
-
+void GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth, const MeshSpan& out)
+{
 	// Position coordinates specified in NDC space.
-	meshData.Vertices[0] = Vertex(
+	WriteVertex(out, 0, Vertex(
         x, y - h, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
-		0.0f, 1.0f);
+		0.0f, 1.0f));
 
-	meshData.Vertices[1] = Vertex(
+	WriteVertex(out, 1, Vertex(
 		x, y, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
-		0.0f, 0.0f);
+		0.0f, 0.0f));
 
-	meshData.Vertices[2] = Vertex(
+	WriteVertex(out, 2, Vertex(
 		x+w, y, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f);
+		1.0f, 0.0f));
 
-	meshData.Vertices[3] = Vertex(
+	WriteVertex(out, 3, Vertex(
 		x+w, y-h, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
-		1.0f, 1.0f);
-
-	meshData.Indices32[0] = 0;
-	meshData.Indices32[1] = 1;
-	meshData.Indices32[2] = 2;
+		1.0f, 1.0f));
 
-	meshData.Indices32[3] = 0;
-	meshData.Indices32[4] = 2;
-	meshData.Indices32[5] = 3;
-
-    return meshData;
+	WriteTriangle(out, 0, 0, 1, 2);
+	WriteTriangle(out, 1, 0, 2, 3);
 }
@@ -10,10 +10,17 @@
 //   1. Change the Direct3D cull mode or manually reverse the winding order.
 //   2. Invert the normal.
 //   3. Update the texture coordinates and tangent vectors.
+//
+// Every shape also has an overload that writes into caller-owned memory in any vertex
+// layout, sized up front by the matching *Size function.  Grids, spheres and cylinders
+// are generated straight into it, in parallel over rows when they are large; boxes and
+// geospheres are subdivided in a scratch MeshData, with a hash map of split edges, and
+// then copied out.
 //***************************************************************************************
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <DirectXMath.h>
 #include <vector>
@@ -51,6 +58,9 @@ public:
         DirectX::XMFLOAT3 Normal;
         DirectX::XMFLOAT3 TangentU;
         DirectX::XMFLOAT2 TexC;
+
+		// Bitangent = TangentSign * cross(Normal, TangentU); -1 where the UVs are mirrored.
+		float TangentSign = 1.0f;
 	};
 
 	struct MeshData
@@ -74,23 +84,73 @@ public:
 		std::vector<uint16> mIndices16;
 	};
 
+	// Byte offsets of the attributes within a vertex of Stride bytes; the defaults are
+	// those of Vertex.  Attributes at Skip are not written.
+	struct VertexLayout
+	{
+		static const std::size_t Skip = ~std::size_t(0);
+
+		std::size_t Stride = sizeof(Vertex);
+		std::size_t Position = offsetof(Vertex, Position);
+		std::size_t Normal = offsetof(Vertex, Normal);
+		std::size_t TangentU = offsetof(Vertex, TangentU);
+		std::size_t TexC = offsetof(Vertex, TexC);
+		std::size_t TangentSign = offsetof(Vertex, TangentSign);
+	};
+
+	struct MeshSize
+	{
+		uint32 VertexCount = 0;
+		uint32 IndexCount = 0;
+	};
+
+	///<summary>
+	/// Caller-owned storage for one mesh, with room for at least the counts of the
+	/// matching *Size function.  Exactly one of Indices16 and Indices32 is set, and
+	/// BaseVertex is added to every index written; with Indices16 the sums must fit in
+	/// 16 bits, which debug builds assert.
+	///</summary>
+	struct MeshSpan
+	{
+		void* Vertices = nullptr;
+		VertexLayout Layout;
+		uint16* Indices16 = nullptr;
+		uint32* Indices32 = nullptr;
+		uint32 BaseVertex = 0;
+	};
+
+	///<summary>
+	/// The exact vertex and index counts of the shapes with these parameters.
+	///</summary>
+	static MeshSize BoxSize(uint32 numSubdivisions);
+	static MeshSize SphereSize(uint32 sliceCount, uint32 stackCount);
+	static MeshSize GeosphereSize(uint32 numSubdivisions);
+	static MeshSize CylinderSize(uint32 sliceCount, uint32 stackCount);
+	static MeshSize GridSize(uint32 m, uint32 n);
+	static MeshSize QuadSize();
+
 	///<summary>
 	/// Creates a box centered at the origin with the given dimensions, where each
     /// face has m rows and n columns of vertices.
 	///</summary>
     MeshData CreateBox(float width, float height, float depth, uint32 numSubdivisions);
+    void CreateBox(float width, float height, float depth, uint32 numSubdivisions, const MeshSpan& out);
 
 	///<summary>
 	/// Creates a sphere centered at the origin with the given radius.  The
 	/// slices and stacks parameters control the degree of tessellation.
 	///</summary>
     MeshData CreateSphere(float radius, uint32 sliceCount, uint32 stackCount);
+    void CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, const MeshSpan& out);
 
 	///<summary>
 	/// Creates a geosphere centered at the origin with the given radius.  The
-	/// depth controls the level of tessellation.
+	/// depth controls the level of tessellation.  Each subdivision shares the
+	/// midpoint of an edge between the triangles on both sides, so a depth of n
+	/// has 10*4^n + 2 vertices.
 	///</summary>
     MeshData CreateGeosphere(float radius, uint32 numSubdivisions);
+    void CreateGeosphere(float radius, uint32 numSubdivisions, const MeshSpan& out);
 
 	///<summary>
 	/// Creates a cylinder parallel to the y-axis, and centered about the origin.  
@@ -98,22 +158,23 @@ public:
 	// cylinders.  The slices and stacks parameters control the degree of tessellation.
 	///</summary>
     MeshData CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount);
+    void CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, const MeshSpan& out);
 
 	///<summary>
 	/// Creates an mxn grid in the xz-plane with m rows and n columns, centered
 	/// at the origin with the specified width and depth.
 	///</summary>
     MeshData CreateGrid(float width, float depth, uint32 m, uint32 n);
+    void CreateGrid(float width, float depth, uint32 m, uint32 n, const MeshSpan& out);
 
 	///<summary>
 	/// Creates a quad aligned with the screen.  This is useful for postprocessing and screen effects.
 	///</summary>
     MeshData CreateQuad(float x, float y, float w, float h, float depth);
+    void CreateQuad(float x, float y, float w, float h, float depth, const MeshSpan& out);
 
 private:
-	void Subdivide(MeshData& meshData);
-    Vertex MidPoint(const Vertex& v0, const Vertex& v1);
-    void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
-    void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
+    void BuildCylinderTopCap(float topRadius, float height, uint32 sliceCount, uint32 baseIndex, uint32 firstTriangle, const MeshSpan& out);
+    void BuildCylinderBottomCap(float bottomRadius, float height, uint32 sliceCount, uint32 baseIndex, uint32 firstTriangle, const MeshSpan& out);
 };
 
@@ -0,0 +1,75 @@
+//***************************************************************************************
+// Hash.h
+//
+// The non-cryptographic hashes used across the engine.  Fnv1a is plain 64-bit FNV-1a,
+// a byte at a time; it is what archive paths are stored under, so its results must never
+// change.  Fnv1aWords is an FNV style hash that takes eight bytes at a time, for large
+// inputs such as whole files.  Mix finishes a hash with the splitmix64 mixer so every
+// input bit reaches every output bit, which hash tables indexed by the low bits need.
+//
+// All of them continue from a seed, so several pieces can be hashed into one value.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+class Hash
+{
+public:
+
+	using uint64 = std::uint64_t;
+
+	static const uint64 FnvOffset = 0xcbf29ce484222325ull;
+	static const uint64 FnvPrime = 0x100000001b3ull;
+
+	///<summary>
+	/// 64-bit FNV-1a of size bytes, continuing from seed.
+	///</summary>
+	static uint64 Fnv1a(const void* data, std::size_t size, uint64 seed = FnvOffset)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+		uint64 h = seed;
+		for(std::size_t i = 0; i < size; ++i)
+			h = (h ^ bytes[i]) * FnvPrime;
+		return h;
+	}
+
+	///<summary>
+	/// FNV style hash of size bytes, eight at a time, continuing from seed.
+	///</summary>
+	static uint64 Fnv1aWords(const void* data, std::size_t size, uint64 seed = FnvOffset)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+		uint64 h = seed;
+		std::size_t i = 0;
+		for(; i + 8 <= size; i += 8)
+		{
+			uint64 word;
+			std::memcpy(&word, bytes + i, 8);
+			h ^= word * 0x9e3779b97f4a7c15ull;
+			h = ((h << 31) | (h >> 33)) * FnvPrime;
+		}
+
+		for(; i < size; ++i)
+			h = (h ^ bytes[i]) * FnvPrime;
+		return h;
+	}
+
+	///<summary>
+	/// The splitmix64 finalizer.
+	///</summary>
+	static uint64 Mix(uint64 h)
+	{
+		h ^= h >> 30;
+		h *= 0xbf58476d1ce4e5b9ull;
+		h ^= h >> 27;
+		h *= 0x94d049bb133111ebull;
+		h ^= h >> 31;
+		return h;
+	}
+};
@@ -0,0 +1,427 @@
+//***************************************************************************************
+// Inflate.cpp
+//***************************************************************************************
+
+#include "Inflate.h"
+#include <cstring>
+
+namespace
+{
+	using uint8 = std::uint8_t;
+	using uint16 = std::uint16_t;
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	const uint32 MaxCodeLength = 15;
+	const uint32 FastBits = 10;
+
+	const uint32 LiteralLengthCount = 288;
+	const uint32 DistanceCount = 32;
+
+	const uint16 LengthBase[29] = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const uint8 LengthExtra[29] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+	const uint16 DistanceBase[30] = {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const uint8 DistanceExtra[30] = {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	// Order in which the code length code lengths are stored.
+	const uint8 CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	// Bits are consumed least significant first.  Reading past the end yields zeros and
+	// is caught by Overrun, so the decoder never needs to check before each read.
+	class BitReader
+	{
+	public:
+		BitReader(const uint8* data, std::size_t size) : mData(data), mSize(size) {}
+
+		uint32 Peek(uint32 count)
+		{
+			Refill();
+			return (uint32)(mBits & ((1ull << count) - 1));
+		}
+
+		void Consume(uint32 count)
+		{
+			mBits >>= count;
+			mCount -= count;
+		}
+
+		uint32 Read(uint32 count)
+		{
+			uint32 value = Peek(count);
+			Consume(count);
+			return value;
+		}
+
+		// Drops the bits up to the next byte boundary and hands out the bytes after it.
+		const uint8* AlignedBytes(std::size_t count)
+		{
+			Consume(mCount % 8);
+			std::size_t position = BytePosition();
+			mBits = 0;
+			mCount = 0;
+
+			if(position > mSize || count > mSize - position)
+			{
+				mPosition = mSize + 1;
+				return nullptr;
+			}
+
+			mPosition = position + count;
+			return mData + position;
+		}
+
+		bool Overrun()const { return BytePosition() > mSize; }
+
+	private:
+		void Refill()
+		{
+			while(mCount <= 56)
+			{
+				uint64 byte = mPosition < mSize ? mData[mPosition] : 0;
+				mBits |= byte << mCount;
+				mCount += 8;
+				++mPosition;
+			}
+		}
+
+		// First byte that still has unconsumed bits.
+		std::size_t BytePosition()const { return mPosition - mCount / 8; }
+
+		const uint8* mData;
+		std::size_t mSize;
+		std::size_t mPosition = 0;
+		uint64 mBits = 0;
+		uint32 mCount = 0;
+	};
+
+	// A canonical Huffman code.  Fast maps the next FastBits bits of the stream to
+	// (symbol << 4) | length for codes that short; longer codes are decoded from Counts
+	// and Symbols one bit at a time.
+	struct Huffman
+	{
+		uint16 Fast[1 << FastBits];
+		uint16 Counts[MaxCodeLength + 1];
+		uint16 Symbols[LiteralLengthCount];
+	};
+
+	uint32 ReverseBits(uint32 code, uint32 length)
+	{
+		uint32 reversed = 0;
+		for(uint32 i = 0; i < length; ++i)
+		{
+			reversed = (reversed << 1) | (code & 1);
+			code >>= 1;
+		}
+
+		return reversed;
+	}
+
+	// Returns false if the lengths describe more codes than there is room for.  Incomplete
+	// codes are allowed (a distance code may have a single symbol); decoding one of the
+	// missing codes fails.
+	bool BuildHuffman(Huffman& huffman, const uint8* lengths, uint32 count)
+	{
+		std::memset(huffman.Counts, 0, sizeof(huffman.Counts));
+		for(uint32 i = 0; i < count; ++i)
+			++huffman.Counts[lengths[i]];
+		huffman.Counts[0] = 0;
+
+		int left = 1;
+		for(uint32 length = 1; length <= MaxCodeLength; ++length)
+		{
+			left = (left << 1) - huffman.Counts[length];
+			if(left < 0)
+				return false;
+		}
+
+		// Symbols sorted by code length, and by symbol within a length.
+		uint16 offsets[MaxCodeLength + 1];
+		offsets[1] = 0;
+		for(uint32 length = 1; length < MaxCodeLength; ++length)
+			offsets[length + 1] = offsets[length] + huffman.Counts[length];
+
+		for(uint32 symbol = 0; symbol < count; ++symbol)
+		{
+			if(lengths[symbol] != 0)
+				huffman.Symbols[offsets[lengths[symbol]]++] = (uint16)symbol;
+		}
+
+		std::memset(huffman.Fast, 0, sizeof(huffman.Fast));
+
+		// Codes are handed out in symbol order within each length, which is the order
+		// Symbols holds them in.
+		uint32 code = 0;
+		uint32 rank = 0;
+		for(uint32 length = 1; length <= MaxCodeLength; ++length)
+		{
+			for(uint32 i = 0; i < huffman.Counts[length]; ++i, ++code, ++rank)
+			{
+				if(length > FastBits)
+					continue;
+
+				uint16 entry = (uint16)((huffman.Symbols[rank] << 4) | length);
+				for(uint32 fill = ReverseBits(code, length); fill < (1u << FastBits); fill += 1u << length)
+					huffman.Fast[fill] = entry;
+			}
+
+			code <<= 1;
+		}
+
+		return true;
+	}
+
+	// Returns the next symbol, or -1 for a code that is not in the table.
+	int DecodeSymbol(BitReader& reader, const Huffman& huffman)
+	{
+		uint16 entry = huffman.Fast[reader.Peek(FastBits)];
+		if(entry != 0)
+		{
+			reader.Consume(entry & 15);
+			return entry >> 4;
+		}
+
+		uint32 bits = reader.Peek(MaxCodeLength);
+		int code = 0;
+		int first = 0;
+		int index = 0;
+		for(uint32 length = 1; length <= MaxCodeLength; ++length)
+		{
+			code |= (int)(bits & 1);
+			bits >>= 1;
+
+			int count = huffman.Counts[length];
+			if(code - first < count)
+			{
+				reader.Consume(length);
+				return huffman.Symbols[index + code - first];
+			}
+
+			index += count;
+			first += count;
+			first <<= 1;
+			code <<= 1;
+		}
+
+		return -1;
+	}
+
+	bool BuildFixedCodes(Huffman& literals, Huffman& distances)
+	{
+		uint8 lengths[LiteralLengthCount];
+		uint32 i = 0;
+		for(; i < 144; ++i) lengths[i] = 8;
+		for(; i < 256; ++i) lengths[i] = 9;
+		for(; i < 280; ++i) lengths[i] = 7;
+		for(; i < 288; ++i) lengths[i] = 8;
+
+		uint8 distanceLengths[DistanceCount];
+		for(i = 0; i < DistanceCount; ++i)
+			distanceLengths[i] = 5;
+
+		return BuildHuffman(literals, lengths, LiteralLengthCount) && BuildHuffman(distances, distanceLengths, DistanceCount);
+	}
+
+	bool ReadDynamicCodes(BitReader& reader, Huffman& literals, Huffman& distances)
+	{
+		uint32 literalCount = reader.Read(5) + 257;
+		uint32 distanceCount = reader.Read(5) + 1;
+		uint32 codeLengthCount = reader.Read(4) + 4;
+		if(literalCount > 286 || distanceCount > 30)
+			return false;
+
+		uint8 codeLengthLengths[19] = {};
+		for(uint32 i = 0; i < codeLengthCount; ++i)
+			codeLengthLengths[CodeLengthOrder[i]] = (uint8)reader.Read(3);
+
+		Huffman codeLengths;
+		if(!BuildHuffman(codeLengths, codeLengthLengths, 19))
+			return false;
+
+		// Literal/length and distance code lengths form one sequence; repeats may cross
+		// from one into the other.
+		uint8 lengths[286 + 30];
+		uint32 total = literalCount + distanceCount;
+		for(uint32 i = 0; i < total; )
+		{
+			int symbol = DecodeSymbol(reader, codeLengths);
+			if(symbol < 0)
+				return false;
+
+			if(symbol < 16)
+			{
+				lengths[i++] = (uint8)symbol;
+				continue;
+			}
+
+			uint8 value = 0;
+			uint32 repeat;
+			if(symbol == 16)
+			{
+				if(i == 0)
+					return false;
+				value = lengths[i - 1];
+				repeat = 3 + reader.Read(2);
+			}
+			else if(symbol == 17)
+			{
+				repeat = 3 + reader.Read(3);
+			}
+			else
+			{
+				repeat = 11 + reader.Read(7);
+			}
+
+			if(repeat > total - i)
+				return false;
+
+			for(; repeat > 0; --repeat)
+				lengths[i++] = value;
+		}
+
+		// A block without an end of block code could never finish.
+		if(lengths[256] == 0)
+			return false;
+
+		return BuildHuffman(literals, lengths, literalCount) &&
+			BuildHuffman(distances, lengths + literalCount, distanceCount);
+	}
+
+	bool InflateBlock(BitReader& reader, const Huffman& literals, const Huffman& distances,
+		uint8* data, std::size_t size, std::size_t& op)
+	{
+		for(;;)
+		{
+			int symbol = DecodeSymbol(reader, literals);
+			if(symbol < 0)
+				return false;
+
+			if(symbol < 256)
+			{
+				if(op == size)
+					return false;
+
+				data[op++] = (uint8)symbol;
+				continue;
+			}
+
+			if(symbol == 256)
+				return !reader.Overrun();
+
+			symbol -= 257;
+			if(symbol >= 29)
+				return false;
+
+			std::size_t length = LengthBase[symbol] + reader.Read(LengthExtra[symbol]);
+
+			int distanceSymbol = DecodeSymbol(reader, distances);
+			if(distanceSymbol < 0 || distanceSymbol >= 30)
+				return false;
+
+			std::size_t distance = DistanceBase[distanceSymbol] + reader.Read(DistanceExtra[distanceSymbol]);
+			if(distance > op || length > size - op)
+				return false;
+
+			// Copies may overlap their own output, which repeats the last distance bytes.
+			const uint8* match = data + op - distance;
+			if(distance >= length)
+			{
+				std::memcpy(data + op, match, length);
+			}
+			else
+			{
+				for(std::size_t i = 0; i < length; ++i)
+					data[op + i] = match[i];
+			}
+
+			op += length;
+		}
+	}
+
+	struct Crc32Table
+	{
+		uint32 Entries[256];
+
+		Crc32Table()
+		{
+			for(uint32 i = 0; i < 256; ++i)
+			{
+				uint32 crc = i;
+				for(uint32 bit = 0; bit < 8; ++bit)
+					crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1)));
+				Entries[i] = crc;
+			}
+		}
+	};
+}
+
+bool Inflate::Decompress(const std::uint8_t* compressed, std::size_t compressedSize, std::uint8_t* data, std::size_t size)
+{
+	BitReader reader(compressed, compressedSize);
+
+	// Two tables of about 3KB each; blocks reuse them.
+	Huffman literals;
+	Huffman distances;
+
+	std::size_t op = 0;
+	bool last = false;
+	while(!last)
+	{
+		last = reader.Read(1) != 0;
+		uint32 type = reader.Read(2);
+
+		if(type == 0)
+		{
+			const uint8* header = reader.AlignedBytes(4);
+			if(header == nullptr)
+				return false;
+
+			std::size_t length = header[0] | (header[1] << 8);
+			std::size_t inverse = header[2] | (header[3] << 8);
+			if(length != (~inverse & 0xffff) || length > size - op)
+				return false;
+
+			const uint8* stored = reader.AlignedBytes(length);
+			if(stored == nullptr)
+				return false;
+
+			std::memcpy(data + op, stored, length);
+			op += length;
+		}
+		else if(type == 1)
+		{
+			if(!BuildFixedCodes(literals, distances) || !InflateBlock(reader, literals, distances, data, size, op))
+				return false;
+		}
+		else if(type == 2)
+		{
+			if(!ReadDynamicCodes(reader, literals, distances) || !InflateBlock(reader, literals, distances, data, size, op))
+				return false;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return op == size && !reader.Overrun();
+}
+
+std::uint32_t Inflate::Crc32(const std::uint8_t* data, std::size_t size, std::uint32_t crc)
+{
+	static const Crc32Table table;
+
+	crc = ~crc;
+	for(std::size_t i = 0; i < size; ++i)
+		crc = table.Entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+
+	return ~crc;
+}
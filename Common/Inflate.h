@@ -0,0 +1,30 @@
+//***************************************************************************************
+// Inflate.h
+//
+// Decoder for raw DEFLATE streams (RFC 1951), the compression zip files use.  The whole
+// output is decoded straight into a buffer of the known uncompressed size, so there is
+// no sliding window to copy through.  Huffman codes of up to ten bits, which are
+// nearly all of them, are decoded with one table lookup.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+class Inflate
+{
+public:
+
+	///<summary>
+	/// Decodes the DEFLATE stream compressed into exactly size bytes at data.  Returns
+	/// false if the stream is malformed or does not decode to size bytes; reads and writes
+	/// stay in bounds either way.
+	///</summary>
+	static bool Decompress(const std::uint8_t* compressed, std::size_t compressedSize, std::uint8_t* data, std::size_t size);
+
+	///<summary>
+	/// CRC-32 of data as used by zip and gzip, continuing from crc.
+	///</summary>
+	static std::uint32_t Crc32(const std::uint8_t* data, std::size_t size, std::uint32_t crc = 0);
+};
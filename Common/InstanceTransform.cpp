@@ -0,0 +1,50 @@
+//***************************************************************************************
+// InstanceTransform.cpp
+//***************************************************************************************
+
+#include "InstanceTransform.h"
+#include "BatchMath.h"
+
+using namespace DirectX;
+
+InstanceTransform::InstanceTransform(const XMFLOAT3& translation, const XMFLOAT4& rotation, const XMFLOAT3& scale) :
+	Translation(translation),
+	Rotation(rotation),
+	Scale(scale)
+{
+}
+
+InstanceTransform InstanceTransform::FromMatrix(FXMMATRIX m)
+{
+	XMVECTOR scale, rotation, translation;
+	XMMatrixDecompose(&scale, &rotation, &translation, m);
+
+	InstanceTransform transform;
+	XMStoreFloat3(&transform.Translation, translation);
+	XMStoreFloat4(&transform.Rotation, rotation);
+	XMStoreFloat3(&transform.Scale, scale);
+	return transform;
+}
+
+XMMATRIX InstanceTransform::Matrix()const
+{
+	XMFLOAT4X4 m;
+	BatchMath::ComposeTransforms(this, 0, &m, 1);
+	return XMLoadFloat4x4(&m);
+}
+
+XMMATRIX InstanceTransform::InverseMatrix()const
+{
+	XMFLOAT4X4 m;
+	BatchMath::InverseTransforms(this, 0, &m, 1);
+	return XMLoadFloat4x4(&m);
+}
+
+InstanceTransform InstanceTransform::Lerp(const InstanceTransform& a, const InstanceTransform& b, float t)
+{
+	InstanceTransform transform;
+	XMStoreFloat3(&transform.Translation, XMVectorLerp(XMLoadFloat3(&a.Translation), XMLoadFloat3(&b.Translation), t));
+	XMStoreFloat4(&transform.Rotation, XMQuaternionSlerp(XMLoadFloat4(&a.Rotation), XMLoadFloat4(&b.Rotation), t));
+	XMStoreFloat3(&transform.Scale, XMVectorLerp(XMLoadFloat3(&a.Scale), XMLoadFloat3(&b.Scale), t));
+	return transform;
+}
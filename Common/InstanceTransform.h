@@ -0,0 +1,52 @@
+//***************************************************************************************
+// InstanceTransform.h
+//
+// Where an instance is, as a scale, a rotation (a unit quaternion) and a translation:
+// 40 bytes instead of a 64 byte matrix.  The matrix it stands for is
+// scale * rotation * translation in DirectXMath's row vector order, so its inverse has
+// a closed form (conjugate rotation, reciprocal scale) and interpolating two of them is
+// a lerp and a slerp instead of blending matrices.
+//
+// Matrices are only built where something needs one: BatchMath::ComposeTransforms and
+// InverseTransforms expand many at once, and the renderer does so when it uploads the
+// instance buffers.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+
+struct InstanceTransform
+{
+	DirectX::XMFLOAT3 Translation = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT4 Rotation = { 0.0f, 0.0f, 0.0f, 1.0f };
+	DirectX::XMFLOAT3 Scale = { 1.0f, 1.0f, 1.0f };
+
+	///<summary>
+	/// The identity.
+	///</summary>
+	InstanceTransform() = default;
+	InstanceTransform(const DirectX::XMFLOAT3& translation, const DirectX::XMFLOAT4& rotation,
+		const DirectX::XMFLOAT3& scale);
+
+	///<summary>
+	/// The scale, rotation and translation of m.  Matrices with shear, such as a rotation
+	/// followed by a non-uniform scale, have no exact decomposition and come back
+	/// approximated.
+	///</summary>
+	static InstanceTransform FromMatrix(DirectX::FXMMATRIX m);
+
+	DirectX::XMMATRIX Matrix()const;
+
+	///<summary>
+	/// The inverse of Matrix(), computed from the parts without inverting a matrix.
+	///</summary>
+	DirectX::XMMATRIX InverseMatrix()const;
+
+	///<summary>
+	/// a at t = 0 and b at t = 1; scale and translation are lerped, rotation slerped.
+	///</summary>
+	static InstanceTransform Lerp(const InstanceTransform& a, const InstanceTransform& b, float t);
+};
+
+static_assert(sizeof(InstanceTransform) == 40, "InstanceTransform is meant to stay 40 bytes");
@@ -0,0 +1,193 @@
+//***************************************************************************************
+// LzCompression.cpp
+//***************************************************************************************
+
+#include "LzCompression.h"
+#include <cstring>
+
+namespace
+{
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+
+	const std::size_t MinMatch = 4;
+
+	// The format ends every block with literals: the last match starts at least
+	// MatchSafeDistance bytes and ends at least LastLiterals bytes before the end.
+	const std::size_t LastLiterals = 5;
+	const std::size_t MatchSafeDistance = 12;
+
+	const std::size_t MaxOffset = 65535;
+	const uint32 HashBits = 16;
+	const uint32 NoPosition = 0xffffffff;
+
+	uint32 Read32(const uint8* p)
+	{
+		uint32 value;
+		std::memcpy(&value, p, 4);
+		return value;
+	}
+
+	uint32 Hash(uint32 sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - HashBits);
+	}
+
+	// Lengths that do not fit the token's four bits continue in bytes of 255 and a final
+	// byte below it.
+	void WriteLength(std::size_t length, std::vector<uint8>& out)
+	{
+		for(; length >= 255; length -= 255)
+			out.push_back(255);
+		out.push_back((uint8)length);
+	}
+
+	bool ReadLength(const uint8* in, std::size_t inSize, std::size_t& ip, std::size_t& length)
+	{
+		uint8 byte;
+		do
+		{
+			if(ip >= inSize)
+				return false;
+
+			byte = in[ip++];
+			length += byte;
+		} while(byte == 255);
+
+		return true;
+	}
+
+	void WriteSequence(const uint8* literals, std::size_t literalCount, std::size_t offset, std::size_t matchLength,
+		std::vector<uint8>& out)
+	{
+		std::size_t matchCode = matchLength - MinMatch;
+		uint8 token = (uint8)((literalCount < 15 ? literalCount : 15) << 4);
+		if(matchLength > 0)
+			token |= (uint8)(matchCode < 15 ? matchCode : 15);
+
+		out.push_back(token);
+		if(literalCount >= 15)
+			WriteLength(literalCount - 15, out);
+
+		out.insert(out.end(), literals, literals + literalCount);
+
+		// The final sequence is literals only.
+		if(matchLength == 0)
+			return;
+
+		out.push_back((uint8)(offset & 0xff));
+		out.push_back((uint8)(offset >> 8));
+		if(matchCode >= 15)
+			WriteLength(matchCode - 15, out);
+	}
+}
+
+std::size_t LzCompression::MaxCompressedSize(std::size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+void LzCompression::Compress(const std::uint8_t* data, std::size_t size, std::vector<std::uint8_t>& compressed)
+{
+	compressed.clear();
+	compressed.reserve(MaxCompressedSize(size));
+
+	std::size_t anchor = 0;
+
+	if(size > MatchSafeDistance)
+	{
+		std::vector<uint32> table((std::size_t)1 << HashBits, NoPosition);
+
+		const std::size_t matchLimit = size - LastLiterals;
+		const std::size_t searchLimit = size - MatchSafeDistance;
+
+		std::size_t ip = 0;
+		while(ip < searchLimit)
+		{
+			uint32 sequence = Read32(data + ip);
+			uint32& slot = table[Hash(sequence)];
+			std::size_t candidate = slot;
+			slot = (uint32)ip;
+
+			if(candidate == NoPosition || ip - candidate > MaxOffset || Read32(data + candidate) != sequence)
+			{
+				++ip;
+				continue;
+			}
+
+			std::size_t length = MinMatch;
+			while(ip + length < matchLimit && data[candidate + length] == data[ip + length])
+				++length;
+
+			WriteSequence(data + anchor, ip - anchor, ip - candidate, length, compressed);
+
+			ip += length;
+			anchor = ip;
+
+			// Index a position inside the match so runs of repeats are found again.
+			if(ip - 2 < searchLimit)
+				table[Hash(Read32(data + ip - 2))] = (uint32)(ip - 2);
+		}
+	}
+
+	WriteSequence(data + anchor, size - anchor, 0, 0, compressed);
+}
+
+bool LzCompression::Decompress(const std::uint8_t* compressed, std::size_t compressedSize, std::uint8_t* data, std::size_t size)
+{
+	std::size_t ip = 0;
+	std::size_t op = 0;
+
+	for(;;)
+	{
+		if(ip >= compressedSize)
+			return false;
+
+		uint8 token = compressed[ip++];
+
+		std::size_t literalCount = token >> 4;
+		if(literalCount == 15 && !ReadLength(compressed, compressedSize, ip, literalCount))
+			return false;
+
+		if(literalCount > compressedSize - ip || literalCount > size - op)
+			return false;
+
+		std::memcpy(data + op, compressed + ip, literalCount);
+		ip += literalCount;
+		op += literalCount;
+
+		// Literals without a match end the block.
+		if(ip == compressedSize)
+			return op == size;
+
+		if(compressedSize - ip < 2)
+			return false;
+
+		std::size_t offset = (std::size_t)compressed[ip] | ((std::size_t)compressed[ip + 1] << 8);
+		ip += 2;
+		if(offset == 0 || offset > op)
+			return false;
+
+		std::size_t matchLength = token & 15;
+		if(matchLength == 15 && !ReadLength(compressed, compressedSize, ip, matchLength))
+			return false;
+		matchLength += MinMatch;
+
+		if(matchLength > size - op)
+			return false;
+
+		// Matches may overlap their own output, which repeats the last offset bytes.
+		const uint8* match = data + op - offset;
+		if(offset >= matchLength)
+		{
+			std::memcpy(data + op, match, matchLength);
+		}
+		else
+		{
+			for(std::size_t i = 0; i < matchLength; ++i)
+				data[op + i] = match[i];
+		}
+
+		op += matchLength;
+	}
+}
@@ -0,0 +1,36 @@
+//***************************************************************************************
+// LzCompression.h
+//
+// Byte oriented LZ77 compression in the LZ4 block format: runs of literals alternate
+// with copies of up to 64KB back, each pair introduced by a one byte token.  Decoding is
+// a tight copy loop with no entropy stage, so it runs near memory speed and suits assets
+// that are decompressed at load time.  The compressor is greedy with a single hash
+// probe, which favors speed over ratio.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class LzCompression
+{
+public:
+
+	///<summary>
+	/// Largest possible compressed size of size bytes.
+	///</summary>
+	static std::size_t MaxCompressedSize(std::size_t size);
+
+	///<summary>
+	/// Replaces compressed with the compressed form of data.
+	///</summary>
+	static void Compress(const std::uint8_t* data, std::size_t size, std::vector<std::uint8_t>& compressed);
+
+	///<summary>
+	/// Decodes compressed into exactly size bytes at data.  Returns false if the input is
+	/// malformed or does not decode to size bytes; reads and writes stay in bounds either way.
+	///</summary>
+	static bool Decompress(const std::uint8_t* compressed, std::size_t compressedSize, std::uint8_t* data, std::size_t size);
+};
@@ -0,0 +1,92 @@
+//***************************************************************************************
+// MappedFile.cpp
+//***************************************************************************************
+
+#include "MappedFile.h"
+#include <utility>
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+MappedFile::MappedFile(MappedFile&& rhs) noexcept
+{
+	*this = std::move(rhs);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& rhs) noexcept
+{
+	if(this != &rhs)
+	{
+		Close();
+
+		std::swap(mFile, rhs.mFile);
+		std::swap(mMapping, rhs.mMapping);
+		std::swap(mData, rhs.mData);
+		std::swap(mSize, rhs.mSize);
+	}
+
+	return *this;
+}
+
+HRESULT MappedFile::Open(const wchar_t* filename)
+{
+	Close();
+
+	mFile = CreateFileW(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if(mFile == INVALID_HANDLE_VALUE)
+		return HRESULT_FROM_WIN32(GetLastError());
+
+	LARGE_INTEGER fileSize = {};
+	if(!GetFileSizeEx(mFile, &fileSize))
+	{
+		HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+		Close();
+		return hr;
+	}
+
+	// Zero length files cannot be mapped, and a 32-bit process cannot view more than 4GB.
+	if(fileSize.QuadPart == 0 || (ULONGLONG)fileSize.QuadPart > (ULONGLONG)SIZE_MAX)
+	{
+		Close();
+		return E_FAIL;
+	}
+
+	mMapping = CreateFileMappingW(mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(mMapping == nullptr)
+	{
+		HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+		Close();
+		return hr;
+	}
+
+	mData = static_cast<const std::uint8_t*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+	if(mData == nullptr)
+	{
+		HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+		Close();
+		return hr;
+	}
+
+	mSize = (std::size_t)fileSize.QuadPart;
+	return S_OK;
+}
+
+void MappedFile::Close()
+{
+	if(mData != nullptr)
+		UnmapViewOfFile(mData);
+
+	if(mMapping != nullptr)
+		CloseHandle(mMapping);
+
+	if(mFile != INVALID_HANDLE_VALUE)
+		CloseHandle(mFile);
+
+	mFile = INVALID_HANDLE_VALUE;
+	mMapping = nullptr;
+	mData = nullptr;
+	mSize = 0;
+}
@@ -0,0 +1,44 @@
+//***************************************************************************************
+// MappedFile.h
+//
+// Read-only memory mapping of a whole file.  The contents are paged in by the OS as
+// they are touched instead of being copied into a heap buffer up front, so parsers can
+// work on Data() in place.  The mapping lives until Close or destruction.
+//***************************************************************************************
+
+#pragma once
+
+#include <windows.h>
+#include <cstddef>
+#include <cstdint>
+
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile& rhs) = delete;
+	MappedFile& operator=(const MappedFile& rhs) = delete;
+
+	MappedFile(MappedFile&& rhs) noexcept;
+	MappedFile& operator=(MappedFile&& rhs) noexcept;
+
+	///<summary>
+	/// Maps filename, closing any previous mapping first.  Empty files cannot be mapped
+	/// and fail with E_FAIL.
+	///</summary>
+	HRESULT Open(const wchar_t* filename);
+
+	void Close();
+
+	bool IsOpen()const { return mData != nullptr; }
+	const std::uint8_t* Data()const { return mData; }
+	std::size_t Size()const { return mSize; }
+
+private:
+	HANDLE mFile = INVALID_HANDLE_VALUE;
+	HANDLE mMapping = nullptr;
+	const std::uint8_t* mData = nullptr;
+	std::size_t mSize = 0;
+};
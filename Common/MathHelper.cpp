@@ -35,48 +35,17 @@ float MathHelper::AngleFromXY(float x, float y)
 
 XMVECTOR MathHelper::RandUnitVec3()
 {
-	XMVECTOR One  = XMVectorSet(1.0f, 1.0f, 1.0f, 1.0f);
-	XMVECTOR Zero = XMVectorZero();
-
-	// Keep trying until we get a point on/in the hemisphere.
-	while(true)
-	{
-		// Generate random point in the cube [-1,1]^3.
-		XMVECTOR v = XMVectorSet(MathHelper::RandF(-1.0f, 1.0f), MathHelper::RandF(-1.0f, 1.0f), MathHelper::RandF(-1.0f, 1.0f), 0.0f);
-
-		// Ignore points outside the unit sphere in order to get an even distribution 
-		// over the unit sphere.  Otherwise points will clump more on the sphere near 
-		// the corners of the cube.
-
-		if( XMVector3Greater( XMVector3LengthSq(v), One) )
-			continue;
-
-		return XMVector3Normalize(v);
-	}
+	XMFLOAT3 v;
+	Random::ThreadLocal().FillUnitVectors(&v, 1);
+	return XMLoadFloat3(&v);
 }
 
 XMVECTOR MathHelper::RandHemisphereUnitVec3(XMVECTOR n)
 {
-	XMVECTOR One  = XMVectorSet(1.0f, 1.0f, 1.0f, 1.0f);
-	XMVECTOR Zero = XMVectorZero();
+	XMFLOAT3 normal;
+	XMStoreFloat3(&normal, n);
 
-	// Keep trying until we get a point on/in the hemisphere.
-	while(true)
-	{
-		// Generate random point in the cube [-1,1]^3.
-		XMVECTOR v = XMVectorSet(MathHelper::RandF(-1.0f, 1.0f), MathHelper::RandF(-1.0f, 1.0f), MathHelper::RandF(-1.0f, 1.0f), 0.0f);
-
-		// Ignore points outside the unit sphere in order to get an even distribution 
-		// over the unit sphere.  Otherwise points will clump more on the sphere near 
-		// the corners of the cube.
-		
-		if( XMVector3Greater( XMVector3LengthSq(v), One) )
-			continue;
-
-		// Ignore points in the bottom hemisphere.
-		if( XMVector3Less( XMVector3Dot(n, v), Zero ) )
-			continue;
-
-		return XMVector3Normalize(v);
-	}
-}
\ No newline at end of file
+	XMFLOAT3 v;
+	Random::ThreadLocal().FillHemisphereVectors(&v, 1, normal);
+	return XMLoadFloat3(&v);
+}
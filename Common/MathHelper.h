@@ -6,28 +6,34 @@
 
 #pragma once
 
+#ifdef _WIN32
 #include <Windows.h>
+#endif
 #include <DirectXMath.h>
 #include <cstdint>
+#include "Random.h"
 
 class MathHelper
 {
 public:
+	// Random numbers come from the calling thread's generator; see Random.h.
+
 	// Returns random float in [0, 1).
 	static float RandF()
 	{
-		return (float)(rand()) / (float)RAND_MAX;
+		return Random::ThreadLocal().NextFloat();
 	}
 
 	// Returns random float in [a, b).
 	static float RandF(float a, float b)
 	{
-		return a + RandF()*(b-a);
+		return Random::ThreadLocal().NextFloat(a, b);
 	}
 
+	// Returns random int in [a, b].
     static int Rand(int a, int b)
     {
-        return a + rand() % ((b - a) + 1);
+        return Random::ThreadLocal().NextInt(a, b);
     }
 
 	template<typename T>
@@ -0,0 +1,661 @@
+//***************************************************************************************
+// MeshOptimizer.cpp
+//***************************************************************************************
+
+#include "MeshOptimizer.h"
+#include "Hash.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace
+{
+	const std::uint32_t InvalidIndex = 0xffffffff;
+
+	// Width and height of AnalyzeOverdraw's depth buffer.
+	const int OverdrawResolution = 256;
+
+	struct Float3
+	{
+		float x, y, z;
+	};
+
+	Float3 ReadPosition(const unsigned char* vertices, std::size_t stride, std::size_t offset, std::uint32_t v)
+	{
+		Float3 p;
+		std::memcpy(&p, vertices + v * stride + offset, sizeof(Float3));
+		return p;
+	}
+
+	float Component(const Float3& p, int axis)
+	{
+		return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+	}
+
+	// Twice the signed area of (a, b, p) in the xy plane.
+	float Edge(const Float3& a, const Float3& b, float x, float y)
+	{
+		return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+	}
+
+	// Pixels exactly on an edge belong to one of the two triangles sharing it: the one
+	// that walks the edge up, or left along a horizontal edge.
+	bool Inside(const Float3& a, const Float3& b, float edge)
+	{
+		float dx = b.x - a.x;
+		float dy = b.y - a.y;
+		return edge > 0.0f || (edge == 0.0f && (dy > 0.0f || (dy == 0.0f && dx < 0.0f)));
+	}
+
+	// FIFO post-transform cache that can be flushed in O(1) by advancing the clock.
+	struct CacheSimulator
+	{
+		CacheSimulator(std::uint32_t vertexCount, std::uint32_t cacheSize) :
+			Timestamps(vertexCount, 0),
+			Size(cacheSize),
+			Time(cacheSize + 1)
+		{
+		}
+
+		// Returns true on a miss.
+		bool Access(std::uint32_t v)
+		{
+			if(Time - Timestamps[v] > Size)
+			{
+				Timestamps[v] = Time++;
+				return true;
+			}
+			return false;
+		}
+
+		void Flush()
+		{
+			Time += Size + 1;
+		}
+
+		std::vector<std::uint32_t> Timestamps;
+		std::uint32_t Size;
+		std::uint32_t Time;
+	};
+}
+
+MeshOptimizer::uint32 MeshOptimizer::GenerateWeldRemap(const void* vertices, uint32 vertexCount, std::size_t vertexStride,
+	std::vector<uint32>& remap)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(vertices);
+
+	remap.assign(vertexCount, InvalidIndex);
+
+	// Open addressing table of the first vertex seen with each value.
+	std::size_t tableSize = 1;
+	while(tableSize < (std::size_t)vertexCount * 2)
+		tableSize <<= 1;
+	std::vector<uint32> table(tableSize, InvalidIndex);
+
+	uint32 uniqueCount = 0;
+	for(uint32 i = 0; i < vertexCount; ++i)
+	{
+		const unsigned char* vertex = bytes + i * vertexStride;
+		std::size_t slot = (std::size_t)Hash::Fnv1a(vertex, vertexStride) & (tableSize - 1);
+
+		for(;;)
+		{
+			uint32 existing = table[slot];
+			if(existing == InvalidIndex)
+			{
+				table[slot] = i;
+				remap[i] = uniqueCount++;
+				break;
+			}
+			if(std::memcmp(vertex, bytes + existing * vertexStride, vertexStride) == 0)
+			{
+				remap[i] = remap[existing];
+				break;
+			}
+			slot = (slot + 1) & (tableSize - 1);
+		}
+	}
+
+	return uniqueCount;
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint32* indices, std::size_t indexCount, uint32 vertexCount,
+	uint32 cacheSize, std::vector<uint32>* clusters)
+{
+	if(clusters)
+		clusters->clear();
+
+	const std::size_t triCount = indexCount / 3;
+	if(triCount == 0)
+		return;
+
+	// Vertex -> triangle adjacency in compressed rows.  live[v] counts the triangles of v
+	// that have not been emitted yet.
+	std::vector<uint32> live(vertexCount, 0);
+	for(std::size_t i = 0; i < triCount * 3; ++i)
+		live[indices[i]]++;
+
+	std::vector<uint32> offsets(vertexCount + 1, 0);
+	for(uint32 v = 0; v < vertexCount; ++v)
+		offsets[v + 1] = offsets[v] + live[v];
+
+	std::vector<uint32> adjacency(triCount * 3);
+	{
+		std::vector<uint32> cursor(offsets.begin(), offsets.end() - 1);
+		for(std::size_t i = 0; i < triCount * 3; ++i)
+			adjacency[cursor[indices[i]]++] = (uint32)(i / 3);
+	}
+
+	std::vector<uint32> input(indices, indices + triCount * 3);
+	std::vector<uint32> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triCount, false);
+	std::vector<uint32> deadEnd;
+	std::vector<uint32> candidates;
+	deadEnd.reserve(triCount * 3);
+
+	uint32 timestamp = cacheSize + 1;
+	uint32 scanCursor = 0;
+	std::size_t outCount = 0;
+
+	if(clusters)
+		clusters->push_back(0);
+
+	int fanning = (int)input[0];
+	while(fanning >= 0)
+	{
+		candidates.clear();
+
+		// Emit every remaining triangle around the fanning vertex.
+		for(uint32 k = offsets[fanning]; k < offsets[fanning + 1]; ++k)
+		{
+			uint32 t = adjacency[k];
+			if(emitted[t])
+				continue;
+
+			for(int c = 0; c < 3; ++c)
+			{
+				uint32 v = input[t * 3 + c];
+				indices[outCount++] = v;
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+
+				if(timestamp - cacheTime[v] > cacheSize)
+					cacheTime[v] = timestamp++;
+			}
+
+			emitted[t] = true;
+		}
+
+		// Prefer the candidate that is still in the cache and will stay there while its
+		// remaining triangles are emitted; otherwise the oldest one that is still live.
+		int next = -1;
+		int bestPriority = -1;
+		for(uint32 v : candidates)
+		{
+			if(live[v] == 0)
+				continue;
+
+			int priority = 0;
+			if(timestamp - cacheTime[v] + 2 * live[v] <= cacheSize)
+				priority = (int)(timestamp - cacheTime[v]);
+
+			if(priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = (int)v;
+			}
+		}
+
+		if(next == -1)
+		{
+			// Dead end: back up through recently referenced vertices, then fall back to
+			// scanning in input order.
+			while(!deadEnd.empty())
+			{
+				uint32 v = deadEnd.back();
+				deadEnd.pop_back();
+				if(live[v] > 0)
+				{
+					next = (int)v;
+					break;
+				}
+			}
+
+			if(next == -1)
+			{
+				while(scanCursor < vertexCount && live[scanCursor] == 0)
+					++scanCursor;
+				if(scanCursor < vertexCount)
+					next = (int)scanCursor;
+			}
+
+			if(next != -1 && clusters)
+				clusters->push_back((uint32)outCount);
+		}
+
+		fanning = next;
+	}
+}
+
+void MeshOptimizer::OptimizeOverdraw(uint32* indices, std::size_t indexCount, const void* vertices,
+	uint32 vertexCount, std::size_t vertexStride, std::size_t positionOffset,
+	const std::vector<uint32>& hardClusters, uint32 cacheSize, float threshold)
+{
+	const std::size_t triCount = indexCount / 3;
+	if(triCount == 0 || hardClusters.empty())
+		return;
+
+	// Split the hard clusters further wherever the running ACMR of the piece is already
+	// within the threshold of the whole cluster's ACMR.  Each piece starts with a cold
+	// cache so this keeps the ordering loss bounded.  Pieces are kept as index offsets,
+	// like the hard clusters.
+	std::vector<uint32> softClusters;
+	CacheSimulator cache(vertexCount, cacheSize);
+
+	for(std::size_t c = 0; c < hardClusters.size(); ++c)
+	{
+		uint32 start = hardClusters[c] / 3;
+		uint32 end = (c + 1 < hardClusters.size()) ? hardClusters[c + 1] / 3 : (uint32)triCount;
+
+		cache.Flush();
+		uint32 clusterMisses = 0;
+		for(uint32 t = start; t < end; ++t)
+			for(int k = 0; k < 3; ++k)
+				clusterMisses += cache.Access(indices[t * 3 + k]) ? 1 : 0;
+
+		float clusterACMR = (float)clusterMisses / (float)(end - start);
+
+		softClusters.push_back(start * 3);
+		cache.Flush();
+
+		uint32 pieceStart = start;
+		uint32 pieceMisses = 0;
+		for(uint32 t = start; t < end; ++t)
+		{
+			for(int k = 0; k < 3; ++k)
+				pieceMisses += cache.Access(indices[t * 3 + k]) ? 1 : 0;
+
+			uint32 pieceTris = t + 1 - pieceStart;
+			if(t + 1 < end && (float)pieceMisses <= threshold * clusterACMR * (float)pieceTris)
+			{
+				softClusters.push_back((t + 1) * 3);
+				pieceStart = t + 1;
+				pieceMisses = 0;
+				cache.Flush();
+			}
+		}
+	}
+
+	SortClustersForOverdraw(indices, triCount * 3, vertices, vertexStride, positionOffset, softClusters, nullptr);
+}
+
+void MeshOptimizer::SortClustersForOverdraw(uint32* indices, std::size_t indexCount, const void* vertices,
+	std::size_t vertexStride, std::size_t positionOffset, const std::vector<uint32>& clusters,
+	std::vector<uint32>* order)
+{
+	if(order)
+		order->clear();
+
+	const uint32 triCount = (uint32)(indexCount / 3);
+	if(triCount == 0 || clusters.empty())
+		return;
+
+	const unsigned char* bytes = static_cast<const unsigned char*>(vertices);
+
+	// Area weighted centroid and normal per cluster.
+	struct ClusterInfo
+	{
+		uint32 Start;
+		uint32 End;
+		uint32 Original;
+		float Sort;
+	};
+
+	std::vector<ClusterInfo> infos(clusters.size());
+	std::vector<Float3> centroids(clusters.size());
+	std::vector<Float3> normals(clusters.size());
+	Float3 meshCentroid = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+
+	for(std::size_t c = 0; c < clusters.size(); ++c)
+	{
+		infos[c].Start = clusters[c] / 3;
+		infos[c].End = (c + 1 < clusters.size()) ? clusters[c + 1] / 3 : triCount;
+		infos[c].Original = (uint32)c;
+
+		Float3 centroid = { 0.0f, 0.0f, 0.0f };
+		Float3 normal = { 0.0f, 0.0f, 0.0f };
+		float area = 0.0f;
+
+		for(uint32 t = infos[c].Start; t < infos[c].End; ++t)
+		{
+			Float3 p0 = ReadPosition(bytes, vertexStride, positionOffset, indices[t * 3 + 0]);
+			Float3 p1 = ReadPosition(bytes, vertexStride, positionOffset, indices[t * 3 + 1]);
+			Float3 p2 = ReadPosition(bytes, vertexStride, positionOffset, indices[t * 3 + 2]);
+
+			Float3 e1 = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+			Float3 e2 = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+			Float3 n = { e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x };
+			float a = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+
+			centroid.x += (p0.x + p1.x + p2.x) * a / 3.0f;
+			centroid.y += (p0.y + p1.y + p2.y) * a / 3.0f;
+			centroid.z += (p0.z + p1.z + p2.z) * a / 3.0f;
+			normal.x += n.x;
+			normal.y += n.y;
+			normal.z += n.z;
+			area += a;
+		}
+
+		meshCentroid.x += centroid.x;
+		meshCentroid.y += centroid.y;
+		meshCentroid.z += centroid.z;
+		meshArea += area;
+
+		if(area > 0.0f)
+		{
+			centroid.x /= area;
+			centroid.y /= area;
+			centroid.z /= area;
+		}
+
+		centroids[c] = centroid;
+		normals[c] = normal;
+	}
+
+	if(meshArea > 0.0f)
+	{
+		meshCentroid.x /= meshArea;
+		meshCentroid.y /= meshArea;
+		meshCentroid.z /= meshArea;
+	}
+
+	// Clusters that face away from the center are the ones most likely to occlude the
+	// rest of the mesh, so draw them first.
+	for(std::size_t c = 0; c < infos.size(); ++c)
+	{
+		const Float3& n = normals[c];
+		float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+		float dot = (centroids[c].x - meshCentroid.x) * n.x +
+			(centroids[c].y - meshCentroid.y) * n.y +
+			(centroids[c].z - meshCentroid.z) * n.z;
+		infos[c].Sort = length > 0.0f ? dot / length : 0.0f;
+	}
+
+	std::stable_sort(infos.begin(), infos.end(),
+		[](const ClusterInfo& a, const ClusterInfo& b) { return a.Sort > b.Sort; });
+
+	std::vector<uint32> input(indices, indices + triCount * 3);
+	std::size_t outCount = 0;
+	for(const ClusterInfo& info : infos)
+	{
+		if(order)
+			order->push_back(info.Original);
+
+		for(uint32 i = info.Start * 3; i < info.End * 3; ++i)
+			indices[outCount++] = input[i];
+	}
+}
+
+void MeshOptimizer::GenerateFetchRemap(uint32* indices, uint32 vertexCount, std::vector<Submesh>& submeshes,
+	std::vector<uint32>& sourceVertex)
+{
+	std::vector<uint32> newIndex(vertexCount, InvalidIndex);
+	sourceVertex.clear();
+	sourceVertex.reserve(vertexCount);
+
+	for(Submesh& submesh : submeshes)
+	{
+		uint32 base = (uint32)sourceVertex.size();
+
+		for(uint32 i = submesh.StartIndexLocation; i < submesh.StartIndexLocation + submesh.IndexCount; ++i)
+		{
+			uint32 v = indices[i];
+
+			// Vertices first used by an earlier submesh get a copy in this submesh's range.
+			if(newIndex[v] == InvalidIndex || newIndex[v] < base)
+			{
+				newIndex[v] = (uint32)sourceVertex.size();
+				sourceVertex.push_back(v);
+			}
+
+			indices[i] = newIndex[v];
+		}
+
+		submesh.BaseVertexLocation = (int)base;
+		submesh.VertexCount = (uint32)sourceVertex.size() - base;
+	}
+}
+
+MeshOptimizer::CacheStatistics MeshOptimizer::AnalyzeVertexCache(const uint32* indices, std::size_t indexCount,
+	uint32 vertexCount, uint32 cacheSize)
+{
+	CacheStatistics stats;
+
+	CacheSimulator cache(vertexCount, cacheSize);
+	std::vector<bool> referenced(vertexCount, false);
+	uint32 referencedCount = 0;
+
+	for(std::size_t i = 0; i < indexCount; ++i)
+	{
+		uint32 v = indices[i];
+		if(cache.Access(v))
+			stats.TransformedVertices++;
+
+		if(!referenced[v])
+		{
+			referenced[v] = true;
+			referencedCount++;
+		}
+	}
+
+	if(indexCount >= 3)
+		stats.ACMR = (float)stats.TransformedVertices / (float)(indexCount / 3);
+	if(referencedCount > 0)
+		stats.ATVR = (float)stats.TransformedVertices / (float)referencedCount;
+
+	return stats;
+}
+
+MeshOptimizer::OverdrawStatistics MeshOptimizer::AnalyzeOverdraw(const uint32* indices, std::size_t indexCount,
+	const void* vertices, std::size_t vertexStride, std::size_t positionOffset)
+{
+	OverdrawStatistics stats;
+
+	const std::size_t triCount = indexCount / 3;
+	if(triCount == 0)
+		return stats;
+
+	const unsigned char* bytes = static_cast<const unsigned char*>(vertices);
+
+	Float3 lo = { FLT_MAX, FLT_MAX, FLT_MAX };
+	Float3 hi = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for(std::size_t i = 0; i < triCount * 3; ++i)
+	{
+		Float3 p = ReadPosition(bytes, vertexStride, positionOffset, indices[i]);
+		lo = { std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z) };
+		hi = { std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z) };
+	}
+
+	float extent = std::max(hi.x - lo.x, std::max(hi.y - lo.y, hi.z - lo.z));
+	if(!(extent > 0.0f))
+		return stats;
+
+	const float scale = (float)OverdrawResolution / extent;
+	std::vector<float> depth(OverdrawResolution * OverdrawResolution);
+
+	// Orthographic views looking down -x, +x, -y, +y, -z and +z, each fitted to the bounds.
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		const int u = (axis + 1) % 3;
+		const int v = (axis + 2) % 3;
+
+		for(int sign = -1; sign <= 1; sign += 2)
+		{
+			std::fill(depth.begin(), depth.end(), FLT_MAX);
+
+			for(std::size_t t = 0; t < triCount; ++t)
+			{
+				Float3 p[3];
+				for(int k = 0; k < 3; ++k)
+					p[k] = ReadPosition(bytes, vertexStride, positionOffset, indices[t * 3 + k]);
+
+				// Cull triangles whose (outward) normal does not face the viewer.
+				Float3 e1 = { p[1].x - p[0].x, p[1].y - p[0].y, p[1].z - p[0].z };
+				Float3 e2 = { p[2].x - p[0].x, p[2].y - p[0].y, p[2].z - p[0].z };
+				Float3 n = { e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x };
+				if((float)sign * Component(n, axis) >= 0.0f)
+					continue;
+
+				// Screen x and y from the other two axes, depth along the view direction.
+				Float3 s[3];
+				for(int k = 0; k < 3; ++k)
+				{
+					s[k].x = (Component(p[k], u) - Component(lo, u)) * scale;
+					s[k].y = (Component(p[k], v) - Component(lo, v)) * scale;
+					s[k].z = (float)sign * Component(p[k], axis);
+				}
+
+				float area = Edge(s[0], s[1], s[2].x, s[2].y);
+				if(area == 0.0f)
+					continue;
+				if(area < 0.0f)
+				{
+					std::swap(s[1], s[2]);
+					area = -area;
+				}
+
+				int x0 = std::max(0, (int)std::floor(std::min(s[0].x, std::min(s[1].x, s[2].x))));
+				int y0 = std::max(0, (int)std::floor(std::min(s[0].y, std::min(s[1].y, s[2].y))));
+				int x1 = std::min(OverdrawResolution - 1, (int)std::ceil(std::max(s[0].x, std::max(s[1].x, s[2].x))));
+				int y1 = std::min(OverdrawResolution - 1, (int)std::ceil(std::max(s[0].y, std::max(s[1].y, s[2].y))));
+
+				for(int y = y0; y <= y1; ++y)
+				{
+					for(int x = x0; x <= x1; ++x)
+					{
+						float px = (float)x + 0.5f;
+						float py = (float)y + 0.5f;
+						float w0 = Edge(s[1], s[2], px, py);
+						float w1 = Edge(s[2], s[0], px, py);
+						float w2 = Edge(s[0], s[1], px, py);
+						if(!Inside(s[1], s[2], w0) || !Inside(s[2], s[0], w1) || !Inside(s[0], s[1], w2))
+							continue;
+
+						float z = (w0 * s[0].z + w1 * s[1].z + w2 * s[2].z) / area;
+						float& stored = depth[y * OverdrawResolution + x];
+						if(z < stored)
+						{
+							stored = z;
+							stats.PixelsShaded++;
+						}
+					}
+				}
+			}
+
+			for(float d : depth)
+				stats.PixelsCovered += d < FLT_MAX ? 1 : 0;
+		}
+	}
+
+	if(stats.PixelsCovered > 0)
+		stats.Overdraw = (float)stats.PixelsShaded / (float)stats.PixelsCovered;
+
+	return stats;
+}
+
+bool MeshOptimizer::NarrowIndices(const std::vector<uint32>& indices, std::vector<uint16>& indices16)
+{
+	indices16.resize(indices.size());
+	for(std::size_t i = 0; i < indices.size(); ++i)
+	{
+		if(indices[i] > 0xffff)
+		{
+			indices16.clear();
+			return false;
+		}
+		indices16[i] = (uint16)indices[i];
+	}
+	return true;
+}
+
+MeshOptimizer::Report MeshOptimizer::OptimizeIndices(std::vector<unsigned char>& vertexBytes, uint32& vertexCount,
+	std::size_t vertexStride, std::size_t positionOffset, std::vector<uint32>& indices,
+	std::vector<Submesh>& submeshes, const Settings& settings)
+{
+	Report report;
+	report.VerticesBefore = vertexCount;
+
+	if(submeshes.empty())
+	{
+		Submesh all;
+		all.IndexCount = (uint32)indices.size();
+		submeshes.push_back(all);
+	}
+
+	report.Before = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount, settings.CacheSize);
+
+	if(settings.Weld)
+	{
+		std::vector<uint32> remap;
+		uint32 uniqueCount = GenerateWeldRemap(vertexBytes.data(), vertexCount, vertexStride, remap);
+
+		// New indices are handed out in first occurrence order, so remap[i] <= i and
+		// compacting in place never overwrites a vertex that is still to be read.
+		std::vector<bool> placed(uniqueCount, false);
+		for(uint32 i = 0; i < vertexCount; ++i)
+		{
+			uint32 r = remap[i];
+			if(placed[r])
+				continue;
+			if(r != i)
+				std::memmove(&vertexBytes[r * vertexStride], &vertexBytes[i * vertexStride], vertexStride);
+			placed[r] = true;
+		}
+
+		for(uint32& index : indices)
+			index = remap[index];
+
+		vertexCount = uniqueCount;
+	}
+
+	std::vector<uint32> clusters;
+	for(Submesh& submesh : submeshes)
+	{
+		uint32* first = indices.data() + submesh.StartIndexLocation;
+
+		OptimizeVertexCache(first, submesh.IndexCount, vertexCount, settings.CacheSize, &clusters);
+
+		if(settings.ReduceOverdraw)
+		{
+			OptimizeOverdraw(first, submesh.IndexCount, vertexBytes.data(), vertexCount, vertexStride,
+				positionOffset, clusters, settings.CacheSize, settings.OverdrawThreshold);
+		}
+	}
+
+	std::vector<uint32> sourceVertex;
+	GenerateFetchRemap(indices.data(), vertexCount, submeshes, sourceVertex);
+
+	std::vector<unsigned char> fetchOrdered(sourceVertex.size() * vertexStride);
+	for(std::size_t i = 0; i < sourceVertex.size(); ++i)
+		std::memcpy(&fetchOrdered[i * vertexStride], &vertexBytes[sourceVertex[i] * vertexStride], vertexStride);
+	vertexBytes.swap(fetchOrdered);
+	vertexCount = (uint32)sourceVertex.size();
+
+	report.After = AnalyzeVertexCache(indices.data(), indices.size(), vertexCount, settings.CacheSize);
+	report.VerticesAfter = vertexCount;
+
+	// Make each submesh's indices relative to its own vertex range.
+	report.Use16BitIndices = true;
+	for(const Submesh& submesh : submeshes)
+	{
+		for(uint32 i = submesh.StartIndexLocation; i < submesh.StartIndexLocation + submesh.IndexCount; ++i)
+			indices[i] -= (uint32)submesh.BaseVertexLocation;
+
+		if(submesh.VertexCount > 0xffff)
+			report.Use16BitIndices = false;
+	}
+
+	return report;
+}
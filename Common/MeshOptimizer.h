@@ -0,0 +1,200 @@
+//***************************************************************************************
+// MeshOptimizer.h
+//
+// Import/cook time optimization of indexed triangle lists.
+//   -GenerateWeldRemap merges bitwise identical vertices so a non-indexed stream becomes an
+//    indexed mesh.
+//   -OptimizeVertexCache reorders triangles for post-transform cache locality using
+//    Tipsify (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality
+//    and Reduced Overdraw", 2007).
+//   -OptimizeOverdraw reorders the clusters found by Tipsify so that triangles facing
+//    away from the mesh center are drawn first, within a bound on the ACMR loss.
+//    SortClustersForOverdraw is the ordering step alone, for clusters found some other
+//    way, such as meshlets.
+//   -AnalyzeOverdraw measures the result by rasterizing the mesh in order.
+//   -GenerateFetchRemap renumbers vertices in first use order so each submesh
+//    references a contiguous range of the vertex buffer, which also lets submeshes be
+//    drawn with 16-bit indices and a BaseVertexLocation.
+//
+// The vertex buffer itself is treated as opaque bytes; only OptimizeOverdraw needs to
+// know where the position lives inside a vertex.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+class MeshOptimizer
+{
+public:
+
+	using uint16 = std::uint16_t;
+	using uint32 = std::uint32_t;
+
+	// A range of the index buffer drawn with one DrawIndexedInstanced call.
+	struct Submesh
+	{
+		uint32 StartIndexLocation = 0;
+		uint32 IndexCount = 0;
+
+		// Written by GenerateFetchRemap: the vertices this submesh references are
+		// [BaseVertexLocation, BaseVertexLocation + VertexCount).
+		int BaseVertexLocation = 0;
+		uint32 VertexCount = 0;
+	};
+
+	// Post-transform cache statistics for a FIFO cache of the given size.
+	struct CacheStatistics
+	{
+		uint32 TransformedVertices = 0;
+
+		// Average cache miss ratio: transformed vertices per triangle (3.0 is worst).
+		float ACMR = 0.0f;
+
+		// Average transform to vertex ratio: transformed vertices per referenced vertex
+		// (1.0 is optimal).
+		float ATVR = 0.0f;
+	};
+
+	struct Settings
+	{
+		bool Weld = true;
+		bool ReduceOverdraw = true;
+
+		// Simulated post-transform cache size.  16 is a reasonable stand-in for
+		// current hardware, which does not expose a fixed FIFO.
+		uint32 CacheSize = 16;
+
+		// Clusters may be split for overdraw ordering as long as their ACMR stays within
+		// this factor of the cache optimized ACMR.
+		float OverdrawThreshold = 1.05f;
+	};
+
+	struct Report
+	{
+		uint32 VerticesBefore = 0;
+		uint32 VerticesAfter = 0;
+		CacheStatistics Before;
+		CacheStatistics After;
+
+		// True if every submesh references at most 65535 vertices, so the (rebased)
+		// index buffer can be stored as 16-bit indices.
+		bool Use16BitIndices = false;
+	};
+
+	// Pixels rasterized by AnalyzeOverdraw, summed over its views.
+	struct OverdrawStatistics
+	{
+		uint32 PixelsCovered = 0;
+		uint32 PixelsShaded = 0;
+
+		// Shaded pixels per covered pixel (1.0 is optimal).
+		float Overdraw = 0.0f;
+	};
+
+	///<summary>
+	/// Runs the full pipeline (weld, vertex cache, overdraw, vertex fetch) on vertices and
+	/// indices.  positionOffset is the byte offset of the float3 position within VertexT.
+	/// On return the indices of each submesh are relative to its BaseVertexLocation.  If
+	/// submeshes is empty the whole index buffer is treated as one submesh.
+	///</summary>
+	template<class VertexT>
+	static Report Optimize(std::vector<VertexT>& vertices, std::size_t positionOffset,
+		std::vector<uint32>& indices, std::vector<Submesh>& submeshes);
+	template<class VertexT>
+	static Report Optimize(std::vector<VertexT>& vertices, std::size_t positionOffset,
+		std::vector<uint32>& indices, std::vector<Submesh>& submeshes, const Settings& settings);
+
+	///<summary>
+	/// Builds remap[oldIndex] = newIndex so that bitwise identical vertices share a new
+	/// index.  Returns the number of unique vertices.
+	///</summary>
+	static uint32 GenerateWeldRemap(const void* vertices, uint32 vertexCount, std::size_t vertexStride,
+		std::vector<uint32>& remap);
+
+	///<summary>
+	/// Reorders the triangles of indices[0, indexCount) for post-transform cache locality.
+	/// If clusters is non-null it receives the index offsets at which Tipsify had to
+	/// restart from a dead end; these are the hard boundaries used by OptimizeOverdraw.
+	///</summary>
+	static void OptimizeVertexCache(uint32* indices, std::size_t indexCount, uint32 vertexCount,
+		uint32 cacheSize, std::vector<uint32>* clusters);
+
+	///<summary>
+	/// Reorders the clusters of a cache optimized index range front-to-back with respect to
+	/// the mesh center.  hardClusters is the output of OptimizeVertexCache.
+	///</summary>
+	static void OptimizeOverdraw(uint32* indices, std::size_t indexCount, const void* vertices,
+		uint32 vertexCount, std::size_t vertexStride, std::size_t positionOffset,
+		const std::vector<uint32>& hardClusters, uint32 cacheSize, float threshold);
+
+	///<summary>
+	/// Reorders the clusters of indices[0, indexCount), which start at the index offsets in
+	/// clusters, so that the clusters facing away from the mesh center are drawn first.
+	/// If order is non-null, order[i] receives the original position of the i-th cluster.
+	///</summary>
+	static void SortClustersForOverdraw(uint32* indices, std::size_t indexCount, const void* vertices,
+		std::size_t vertexStride, std::size_t positionOffset, const std::vector<uint32>& clusters,
+		std::vector<uint32>* order);
+
+	///<summary>
+	/// Renumbers vertices in first use order, submesh by submesh.  Vertices shared by
+	/// several submeshes are duplicated so every submesh ends up with a contiguous vertex
+	/// range.  Fills sourceVertex[newIndex] = oldIndex, rewrites indices to the new
+	/// numbering and sets BaseVertexLocation/VertexCount of each submesh.
+	///</summary>
+	static void GenerateFetchRemap(uint32* indices, uint32 vertexCount, std::vector<Submesh>& submeshes,
+		std::vector<uint32>& sourceVertex);
+
+	static CacheStatistics AnalyzeVertexCache(const uint32* indices, std::size_t indexCount,
+		uint32 vertexCount, uint32 cacheSize);
+
+	///<summary>
+	/// Rasterizes the triangles in order into a small depth buffer along each of the six
+	/// axis directions, with back faces culled, and counts the pixels that pass the depth
+	/// test against those left covered at the end.
+	///</summary>
+	static OverdrawStatistics AnalyzeOverdraw(const uint32* indices, std::size_t indexCount, const void* vertices,
+		std::size_t vertexStride, std::size_t positionOffset);
+
+	///<summary>
+	/// Narrows indices to 16 bits.  Returns false if any index does not fit.
+	///</summary>
+	static bool NarrowIndices(const std::vector<uint32>& indices, std::vector<uint16>& indices16);
+
+private:
+	static Report OptimizeIndices(std::vector<unsigned char>& vertexBytes, uint32& vertexCount,
+		std::size_t vertexStride, std::size_t positionOffset, std::vector<uint32>& indices,
+		std::vector<Submesh>& submeshes, const Settings& settings);
+};
+
+template<class VertexT>
+MeshOptimizer::Report MeshOptimizer::Optimize(std::vector<VertexT>& vertices, std::size_t positionOffset,
+	std::vector<uint32>& indices, std::vector<Submesh>& submeshes)
+{
+	return Optimize(vertices, positionOffset, indices, submeshes, Settings());
+}
+
+template<class VertexT>
+MeshOptimizer::Report MeshOptimizer::Optimize(std::vector<VertexT>& vertices, std::size_t positionOffset,
+	std::vector<uint32>& indices, std::vector<Submesh>& submeshes, const Settings& settings)
+{
+	// The implementation works on raw bytes so it is compiled once for all vertex types;
+	// VertexT is expected to be trivially copyable.
+	std::vector<unsigned char> bytes(vertices.size() * sizeof(VertexT));
+	if(!bytes.empty())
+		std::memcpy(bytes.data(), vertices.data(), bytes.size());
+
+	uint32 vertexCount = (uint32)vertices.size();
+	Report report = OptimizeIndices(bytes, vertexCount, sizeof(VertexT), positionOffset,
+		indices, submeshes, settings);
+
+	vertices.resize(vertexCount);
+	if(vertexCount > 0)
+		std::memcpy(vertices.data(), bytes.data(), vertexCount * sizeof(VertexT));
+
+	return report;
+}
@@ -0,0 +1,913 @@
+//***************************************************************************************
+// MeshSimplifier.cpp
+//***************************************************************************************
+
+#include "MeshSimplifier.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	const uint32 InvalidIndex = 0xffffffff;
+	const uint32 GrainSize = 8192;
+
+	// Border edges are kept in place by an extra quadric through the edge, perpendicular
+	// to its triangle, weighted this much more than the surface.
+	const float BorderWeight = 10.0f;
+
+	enum VertexKind : unsigned char
+	{
+		Manifold,	// May collapse onto any neighbor.
+		Border,		// On an open edge; may only collapse along it.
+		Seam,		// One of two vertices at a UV/normal seam; collapses along the seam with its twin.
+		Locked		// Anything else: never collapses, though others may collapse onto it.
+	};
+
+	struct Float3
+	{
+		float x, y, z;
+	};
+
+	Float3 operator-(const Float3& a, const Float3& b)
+	{
+		return { a.x - b.x, a.y - b.y, a.z - b.z };
+	}
+
+	float Dot(const Float3& a, const Float3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	Float3 Cross(const Float3& a, const Float3& b)
+	{
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	// Symmetric 4x4 quadric error matrix plus the accumulated weight.
+	struct Quadric
+	{
+		float a00 = 0, a11 = 0, a22 = 0;
+		float a10 = 0, a20 = 0, a21 = 0;
+		float b0 = 0, b1 = 0, b2 = 0;
+		float c = 0;
+		float w = 0;
+
+		void AddPlane(const Float3& n, float d, float weight)
+		{
+			a00 += weight * n.x * n.x;
+			a11 += weight * n.y * n.y;
+			a22 += weight * n.z * n.z;
+			a10 += weight * n.y * n.x;
+			a20 += weight * n.z * n.x;
+			a21 += weight * n.z * n.y;
+			b0 += weight * n.x * d;
+			b1 += weight * n.y * d;
+			b2 += weight * n.z * d;
+			c += weight * d * d;
+			w += weight;
+		}
+
+		void Add(const Quadric& q)
+		{
+			a00 += q.a00; a11 += q.a11; a22 += q.a22;
+			a10 += q.a10; a20 += q.a20; a21 += q.a21;
+			b0 += q.b0; b1 += q.b1; b2 += q.b2;
+			c += q.c;
+			w += q.w;
+		}
+
+		// Weighted mean squared distance of p to the accumulated planes.
+		float Error(const Float3& p)const
+		{
+			float rx = b0 + a00 * p.x + a10 * p.y + a20 * p.z;
+			float ry = b1 + a10 * p.x + a11 * p.y + a21 * p.z;
+			float rz = b2 + a20 * p.x + a21 * p.y + a22 * p.z;
+
+			float e = rx * p.x + ry * p.y + rz * p.z + b0 * p.x + b1 * p.y + b2 * p.z + c;
+			return w > 0.0f ? std::fabs(e) / w : 0.0f;
+		}
+	};
+
+	struct Collapse
+	{
+		uint32 From;
+		uint32 To;
+		float Error;
+	};
+
+	// LSD radix sort on the bits of the (non-negative) errors, which order like the floats.
+	void SortByError(std::vector<Collapse>& collapses, std::vector<Collapse>& scratch)
+	{
+		const int DigitBits = 11;
+		const uint32 DigitCount = 1 << DigitBits;
+
+		scratch.resize(collapses.size());
+		std::vector<uint32> histogram(DigitCount);
+
+		for(int shift = 0; shift < 32; shift += DigitBits)
+		{
+			std::fill(histogram.begin(), histogram.end(), 0);
+			for(const Collapse& c : collapses)
+			{
+				uint32 key;
+				std::memcpy(&key, &c.Error, sizeof(key));
+				histogram[(key >> shift) & (DigitCount - 1)]++;
+			}
+
+			uint32 sum = 0;
+			for(uint32& count : histogram)
+			{
+				uint32 start = sum;
+				sum += count;
+				count = start;
+			}
+
+			for(const Collapse& c : collapses)
+			{
+				uint32 key;
+				std::memcpy(&key, &c.Error, sizeof(key));
+				scratch[histogram[(key >> shift) & (DigitCount - 1)]++] = c;
+			}
+			collapses.swap(scratch);
+		}
+	}
+
+	// Compressed rows of the triangles (or half-edge targets) around each vertex.
+	struct Adjacency
+	{
+		std::vector<uint32> Offsets;
+		std::vector<uint32> Items;
+
+		const uint32* Begin(uint32 v)const { return Items.data() + Offsets[v]; }
+		const uint32* End(uint32 v)const { return Items.data() + Offsets[v + 1]; }
+	};
+
+	// Rows of the triangles around each vertex.
+	void BuildTriangleAdjacency(const uint32* indices, uint32 indexCount, uint32 vertexCount, Adjacency& adjacency)
+	{
+		adjacency.Offsets.assign(vertexCount + 1, 0);
+		for(uint32 i = 0; i < indexCount; ++i)
+			adjacency.Offsets[indices[i] + 1]++;
+		for(uint32 v = 0; v < vertexCount; ++v)
+			adjacency.Offsets[v + 1] += adjacency.Offsets[v];
+
+		adjacency.Items.resize(indexCount);
+		std::vector<uint32> cursor(adjacency.Offsets.begin(), adjacency.Offsets.end() - 1);
+		for(uint32 i = 0; i < indexCount; ++i)
+			adjacency.Items[cursor[indices[i]]++] = i / 3;
+	}
+
+	// Rows of the targets of the half-edges leaving (or, if incoming, entering) each vertex.
+	void BuildEdgeAdjacency(const uint32* indices, uint32 indexCount, uint32 vertexCount, bool incoming,
+		Adjacency& adjacency)
+	{
+		static const int next[3] = { 1, 2, 0 };
+
+		adjacency.Offsets.assign(vertexCount + 1, 0);
+		for(uint32 i = 0; i < indexCount; ++i)
+		{
+			uint32 a = indices[i];
+			uint32 b = indices[i - i % 3 + next[i % 3]];
+			adjacency.Offsets[(incoming ? b : a) + 1]++;
+		}
+		for(uint32 v = 0; v < vertexCount; ++v)
+			adjacency.Offsets[v + 1] += adjacency.Offsets[v];
+
+		adjacency.Items.resize(indexCount);
+		std::vector<uint32> cursor(adjacency.Offsets.begin(), adjacency.Offsets.end() - 1);
+		for(uint32 i = 0; i < indexCount; ++i)
+		{
+			uint32 a = indices[i];
+			uint32 b = indices[i - i % 3 + next[i % 3]];
+			adjacency.Items[cursor[incoming ? b : a]++] = incoming ? a : b;
+		}
+	}
+
+	bool HasEdge(const Adjacency& outgoing, uint32 a, uint32 b)
+	{
+		for(const uint32* e = outgoing.Begin(a); e != outgoing.End(a); ++e)
+		{
+			if(*e == b)
+				return true;
+		}
+		return false;
+	}
+
+	// True if some vertex at a's position has an edge to some vertex at b's position.
+	bool HasPositionEdge(const Adjacency& outgoing, const std::vector<uint32>& remap,
+		const std::vector<uint32>& wedge, uint32 a, uint32 b)
+	{
+		uint32 w = a;
+		do
+		{
+			for(const uint32* e = outgoing.Begin(w); e != outgoing.End(w); ++e)
+			{
+				if(remap[*e] == remap[b])
+					return true;
+			}
+			w = wedge[w];
+		} while(w != a);
+
+		return false;
+	}
+
+	// remap[v] is the first vertex with v's position; wedge links the vertices sharing a
+	// position into a cycle.
+	void BuildPositionRemap(const std::vector<Float3>& positions, std::vector<uint32>& remap, std::vector<uint32>& wedge)
+	{
+		const uint32 vertexCount = (uint32)positions.size();
+
+		remap.resize(vertexCount);
+		wedge.resize(vertexCount);
+
+		std::size_t tableSize = 1;
+		while(tableSize < (std::size_t)vertexCount * 2)
+			tableSize <<= 1;
+		std::vector<uint32> table(tableSize, InvalidIndex);
+
+		for(uint32 v = 0; v < vertexCount; ++v)
+		{
+			uint32 bits[3];
+			std::memcpy(bits, &positions[v], sizeof(bits));
+			uint32 h = (bits[0] * 73856093) ^ (bits[1] * 19349663) ^ (bits[2] * 83492791);
+
+			std::size_t slot = h & (tableSize - 1);
+			for(std::size_t probe = 1; ; ++probe)
+			{
+				uint32 other = table[slot];
+				if(other == InvalidIndex)
+				{
+					table[slot] = v;
+					remap[v] = v;
+					wedge[v] = v;
+					break;
+				}
+				if(std::memcmp(&positions[other], &positions[v], sizeof(Float3)) == 0)
+				{
+					remap[v] = other;
+					wedge[v] = wedge[other];
+					wedge[other] = v;
+					break;
+				}
+				slot = (slot + probe) & (tableSize - 1);
+			}
+		}
+	}
+
+	// The single open (index space) half-edge leaving v, InvalidIndex if there is none, or
+	// v itself if there are several.
+	uint32 FindOpenEdge(const Adjacency& from, const Adjacency& reverse, uint32 v)
+	{
+		uint32 result = InvalidIndex;
+		for(const uint32* e = from.Begin(v); e != from.End(v); ++e)
+		{
+			if(HasEdge(reverse, *e, v))
+				continue;
+			if(result != InvalidIndex && result != *e)
+				return v;
+			result = *e;
+		}
+		return result;
+	}
+
+	class Simplifier
+	{
+	public:
+		Simplifier(const XMFLOAT3* sourcePositions, std::size_t stride, uint32 vertexCount) :
+			mVertexCount(vertexCount),
+			mPositions(vertexCount)
+		{
+			// Work in a unit cube so the quadrics keep their precision.
+			Float3 minimum = { FLT_MAX, FLT_MAX, FLT_MAX };
+			Float3 maximum = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+			for(uint32 v = 0; v < vertexCount; ++v)
+			{
+				const XMFLOAT3& p = *reinterpret_cast<const XMFLOAT3*>(
+					reinterpret_cast<const unsigned char*>(sourcePositions) + v * stride);
+				mPositions[v] = { p.x, p.y, p.z };
+
+				minimum = { std::min(minimum.x, p.x), std::min(minimum.y, p.y), std::min(minimum.z, p.z) };
+				maximum = { std::max(maximum.x, p.x), std::max(maximum.y, p.y), std::max(maximum.z, p.z) };
+			}
+
+			mExtent = vertexCount > 0 ?
+				std::max(maximum.x - minimum.x, std::max(maximum.y - minimum.y, maximum.z - minimum.z)) : 0.0f;
+			float scale = mExtent > 0.0f ? 1.0f / mExtent : 0.0f;
+
+			// Positions are hashed and compared before rescaling so rounding cannot merge or
+			// split seam vertices.
+			BuildPositionRemap(mPositions, mRemap, mWedge);
+
+			for(auto& p : mPositions)
+				p = { (p.x - minimum.x) * scale, (p.y - minimum.y) * scale, (p.z - minimum.z) * scale };
+		}
+
+		float Extent()const { return mExtent; }
+
+		// targetError is a quadric cost in the unit cube.  Returns the measured error in
+		// normalized units.
+		float Run(std::vector<uint32>& indices, uint32 targetIndexCount, float targetError)
+		{
+			ThreadPool& pool = ThreadPool::Default();
+
+			Classify(indices, pool);
+			ComputeQuadrics(indices, pool);
+
+			// Where each input vertex ended up.
+			std::vector<uint32> finalVertex(mVertexCount);
+			for(uint32 v = 0; v < mVertexCount; ++v)
+				finalVertex[v] = v;
+
+			std::vector<uint32> collapseRemap(mVertexCount);
+			std::vector<bool> collapseLocked(mVertexCount);
+			std::vector<Collapse> candidates;
+			std::vector<Collapse> sortScratch;
+			Adjacency triangles;
+
+			while(indices.size() > targetIndexCount)
+			{
+				BuildTriangleAdjacency(indices.data(), (uint32)indices.size(), mVertexCount, triangles);
+
+				PickCollapses(indices, pool, candidates);
+				if(candidates.empty())
+					break;
+
+				SortByError(candidates, sortScratch);
+
+				for(uint32 v = 0; v < mVertexCount; ++v)
+					collapseRemap[v] = v;
+				std::fill(collapseLocked.begin(), collapseLocked.end(), false);
+
+				uint32 collapsed = PerformCollapses(indices, triangles, candidates, targetIndexCount,
+					targetError, collapseRemap, collapseLocked);
+				if(collapsed == 0)
+					break;
+
+				pool.ParallelFor(mVertexCount, GrainSize, [&](uint32 begin, uint32 end)
+				{
+					for(uint32 v = begin; v < end; ++v)
+						finalVertex[v] = collapseRemap[finalVertex[v]];
+				});
+
+				RemapEdgeLoops(mLoop, collapseRemap);
+				RemapEdgeLoops(mLoopBack, collapseRemap);
+				CompactTriangles(indices, pool, collapseRemap);
+			}
+
+			return MeasureError(indices, pool, finalVertex);
+		}
+
+	private:
+		void Classify(const std::vector<uint32>& indices, ThreadPool& pool)
+		{
+			const uint32 indexCount = (uint32)indices.size();
+
+			Adjacency outgoing;
+			Adjacency incoming;
+			BuildEdgeAdjacency(indices.data(), indexCount, mVertexCount, false, outgoing);
+			BuildEdgeAdjacency(indices.data(), indexCount, mVertexCount, true, incoming);
+
+			mLoop.assign(mVertexCount, InvalidIndex);
+			mLoopBack.assign(mVertexCount, InvalidIndex);
+			mKinds.assign(mVertexCount, Locked);
+
+			pool.ParallelFor(mVertexCount, GrainSize, [&](uint32 begin, uint32 end)
+			{
+				for(uint32 v = begin; v < end; ++v)
+				{
+					mLoop[v] = FindOpenEdge(outgoing, outgoing, v);
+					mLoopBack[v] = FindOpenEdge(incoming, incoming, v);
+				}
+			});
+
+			pool.ParallelFor(mVertexCount, GrainSize, [&](uint32 v0, uint32 v1)
+			{
+				for(uint32 v = v0; v < v1; ++v)
+					mKinds[v] = ClassifyVertex(outgoing, v);
+			});
+
+			// Open edges in position space get boundary quadrics.  A half-edge is open if
+			// no vertex at its end position leads back to its start position.
+			const uint32 triCount = indexCount / 3;
+			mOpenPositionEdge.assign(indexCount, 0);
+			pool.ParallelFor(triCount, GrainSize, [&](uint32 begin, uint32 end)
+			{
+				for(uint32 t = begin; t < end; ++t)
+				{
+					for(uint32 e = 0; e < 3; ++e)
+					{
+						uint32 a = indices[t * 3 + e];
+						uint32 b = indices[t * 3 + (e + 1) % 3];
+						mOpenPositionEdge[t * 3 + e] = HasPositionEdge(outgoing, mRemap, mWedge, b, a) ? 0 : 1;
+					}
+				}
+			});
+		}
+
+		VertexKind ClassifyVertex(const Adjacency& outgoing, uint32 v)const
+		{
+			const uint32 loop = mLoop[v];
+			const uint32 loopBack = mLoopBack[v];
+
+			if(loop == InvalidIndex && loopBack == InvalidIndex)
+				return mWedge[v] == v ? Manifold : Locked;
+
+			// Exactly one open edge in and out.
+			if(loop == InvalidIndex || loopBack == InvalidIndex || loop == v || loopBack == v)
+				return Locked;
+
+			if(mWedge[v] == v)
+				return Border;
+
+			// Seam: exactly one twin whose open edges are closed by ours in position space.
+			const uint32 twin = mWedge[v];
+			if(mWedge[twin] != v)
+				return Locked;
+
+			const uint32 twinLoop = mLoop[twin];
+			const uint32 twinLoopBack = mLoopBack[twin];
+			if(twinLoop == InvalidIndex || twinLoopBack == InvalidIndex || twinLoop == twin || twinLoopBack == twin)
+				return Locked;
+
+			if(mRemap[twinLoop] != mRemap[loopBack] || mRemap[twinLoopBack] != mRemap[loop])
+				return Locked;
+
+			return HasPositionEdge(outgoing, mRemap, mWedge, loop, v) &&
+				HasPositionEdge(outgoing, mRemap, mWedge, v, loopBack) ? Seam : Locked;
+		}
+
+		void ComputeQuadrics(const std::vector<uint32>& indices, ThreadPool& pool)
+		{
+			const uint32 indexCount = (uint32)indices.size();
+
+			Adjacency triangles;
+			BuildTriangleAdjacency(indices.data(), indexCount, mVertexCount, triangles);
+
+			// Gathered per position so no two threads write the same quadric.
+			mQuadrics.assign(mVertexCount, Quadric());
+			pool.ParallelFor(mVertexCount, GrainSize, [&](uint32 begin, uint32 end)
+			{
+				for(uint32 v = begin; v < end; ++v)
+				{
+					if(mRemap[v] != v)
+						continue;
+
+					Quadric& q = mQuadrics[v];
+					uint32 w = v;
+					do
+					{
+						for(const uint32* t = triangles.Begin(w); t != triangles.End(w); ++t)
+							AddTriangleQuadrics(indices.data(), *t, w, q);
+						w = mWedge[w];
+					} while(w != v);
+				}
+			});
+		}
+
+		// Adds the plane of triangle t, and the boundary planes of its open edges touching
+		// corner, to q.
+		void AddTriangleQuadrics(const uint32* indices, uint32 t, uint32 corner, Quadric& q)const
+		{
+			const Float3& p0 = mPositions[indices[t * 3 + 0]];
+			const Float3& p1 = mPositions[indices[t * 3 + 1]];
+			const Float3& p2 = mPositions[indices[t * 3 + 2]];
+
+			Float3 n = Cross(p1 - p0, p2 - p0);
+			float length = std::sqrt(Dot(n, n));
+			if(length <= 0.0f)
+				return;
+
+			n = { n.x / length, n.y / length, n.z / length };
+			q.AddPlane(n, -Dot(n, p0), length * 0.5f);
+
+			for(uint32 e = 0; e < 3; ++e)
+			{
+				uint32 a = indices[t * 3 + e];
+				uint32 b = indices[t * 3 + (e + 1) % 3];
+				if(!mOpenPositionEdge[t * 3 + e] || (a != corner && b != corner))
+					continue;
+
+				Float3 edge = mPositions[b] - mPositions[a];
+				float edgeLengthSq = Dot(edge, edge);
+				Float3 m = Cross(edge, n);
+				float mLength = std::sqrt(Dot(m, m));
+				if(mLength <= 0.0f)
+					continue;
+
+				m = { m.x / mLength, m.y / mLength, m.z / mLength };
+				q.AddPlane(m, -Dot(m, mPositions[a]), edgeLengthSq * BorderWeight);
+			}
+		}
+
+		bool CanCollapse(uint32 from, uint32 to)const
+		{
+			switch(mKinds[from])
+			{
+			case Manifold:
+				return true;
+			case Border:
+				return mKinds[to] == Border && (mLoop[from] == to || mLoopBack[from] == to);
+			case Seam:
+				return mKinds[to] == Seam && (mLoop[from] == to || mLoopBack[from] == to);
+			default:
+				return false;
+			}
+		}
+
+		// The twin of a seam collapse from -> to: where from's twin has to go.
+		uint32 TwinTarget(uint32 from, uint32 to)const
+		{
+			uint32 twin = mWedge[from];
+			uint32 twinTarget = mLoop[from] == to ? mLoopBack[twin] : mLoop[twin];
+			return twinTarget != InvalidIndex && mRemap[twinTarget] == mRemap[to] ? twinTarget : InvalidIndex;
+		}
+
+		void PickCollapses(const std::vector<uint32>& indices, ThreadPool& pool, std::vector<Collapse>& candidates)
+		{
+			const uint32 triCount = (uint32)indices.size() / 3;
+			const uint32 chunkCount = (triCount + GrainSize - 1) / GrainSize;
+
+			std::vector<std::vector<Collapse>> chunks(chunkCount);
+			pool.ParallelFor(triCount, GrainSize, [&](uint32 begin, uint32 end)
+			{
+				std::vector<Collapse>& chunk = chunks[begin / GrainSize];
+				for(uint32 t = begin; t < end; ++t)
+				{
+					for(uint32 e = 0; e < 3; ++e)
+					{
+						uint32 a = indices[t * 3 + e];
+						uint32 b = indices[t * 3 + (e + 1) % 3];
+
+						// Interior edges are seen from both triangles; keep one.
+						if(a > b && mLoop[a] != b)
+							continue;
+
+						bool ab = CanCollapse(a, b);
+						bool ba = CanCollapse(b, a);
+						if(!ab && !ba)
+							continue;
+
+						float errorAB = ab ? mQuadrics[mRemap[a]].Error(mPositions[b]) : FLT_MAX;
+						float errorBA = ba ? mQuadrics[mRemap[b]].Error(mPositions[a]) : FLT_MAX;
+
+						if(errorAB <= errorBA)
+							chunk.push_back({ a, b, errorAB });
+						else
+							chunk.push_back({ b, a, errorBA });
+					}
+				}
+			});
+
+			candidates.clear();
+			for(const auto& chunk : chunks)
+				candidates.insert(candidates.end(), chunk.begin(), chunk.end());
+		}
+
+		// Appends the positions (as remap indices) of the vertices sharing a triangle with
+		// any vertex at v's position.  If other is not InvalidIndex, only triangles that also
+		// touch other's position are considered.
+		void GatherNeighbors(const std::vector<uint32>& indices, const Adjacency& triangles, uint32 v,
+			uint32 other, std::vector<uint32>& neighbors)const
+		{
+			uint32 w = v;
+			do
+			{
+				for(const uint32* t = triangles.Begin(w); t != triangles.End(w); ++t)
+				{
+					uint32 corners[3] = { mRemap[indices[*t * 3 + 0]], mRemap[indices[*t * 3 + 1]], mRemap[indices[*t * 3 + 2]] };
+					if(other != InvalidIndex && corners[0] != mRemap[other] && corners[1] != mRemap[other] &&
+						corners[2] != mRemap[other])
+						continue;
+
+					for(uint32 c : corners)
+					{
+						if(c != mRemap[v] && (other == InvalidIndex || c != mRemap[other]))
+							neighbors.push_back(c);
+					}
+				}
+				w = mWedge[w];
+			} while(w != v);
+
+			std::sort(neighbors.begin(), neighbors.end());
+			neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+		}
+
+		// Link condition: the only vertices adjacent to both ends of the edge may be the
+		// ones opposite it.  Otherwise the collapse pinches the surface into a fold.
+		bool BreaksTopology(const std::vector<uint32>& indices, const Adjacency& triangles, uint32 from, uint32 to,
+			std::vector<uint32> (&scratch)[3])const
+		{
+			for(auto& list : scratch)
+				list.clear();
+
+			GatherNeighbors(indices, triangles, from, InvalidIndex, scratch[0]);
+			GatherNeighbors(indices, triangles, to, InvalidIndex, scratch[1]);
+			GatherNeighbors(indices, triangles, from, to, scratch[2]);
+
+			auto common = scratch[0].begin();
+			for(uint32 n : scratch[1])
+			{
+				if(n == mRemap[from])
+					continue;
+
+				common = std::lower_bound(common, scratch[0].end(), n);
+				if(common == scratch[0].end())
+					break;
+				if(*common == n && !std::binary_search(scratch[2].begin(), scratch[2].end(), n))
+					return true;
+			}
+			return false;
+		}
+
+		// True if moving from onto to would turn any of from's remaining triangles over or
+		// collapse them into slivers.
+		bool HasTriangleFlips(const std::vector<uint32>& indices, const Adjacency& triangles, uint32 from, uint32 to)const
+		{
+			const Float3& target = mPositions[to];
+			for(const uint32* t = triangles.Begin(from); t != triangles.End(from); ++t)
+			{
+				uint32 corner = indices[*t * 3 + 0] == from ? 0 : indices[*t * 3 + 1] == from ? 1 : 2;
+				uint32 a = indices[*t * 3 + (corner + 1) % 3];
+				uint32 b = indices[*t * 3 + (corner + 2) % 3];
+
+				// Triangles on the collapsing edge disappear.
+				if(mRemap[a] == mRemap[to] || mRemap[b] == mRemap[to])
+					continue;
+
+				const Float3& p = mPositions[from];
+				Float3 ea = mPositions[a] - target;
+				Float3 eb = mPositions[b] - target;
+				Float3 before = Cross(mPositions[a] - p, mPositions[b] - p);
+				Float3 after = Cross(ea, eb);
+
+				// Reject normals turning by more than ~75 degrees, and triangles that would
+				// become slivers (sine of the angle at the target below 1/100).
+				float afterSq = Dot(after, after);
+				if(Dot(before, after) <= 0.25f * std::sqrt(Dot(before, before) * afterSq) ||
+					afterSq <= 1e-4f * Dot(ea, ea) * Dot(eb, eb))
+					return true;
+			}
+			return false;
+		}
+
+		uint32 PerformCollapses(const std::vector<uint32>& indices, const Adjacency& triangles,
+			const std::vector<Collapse>& candidates, uint32 targetIndexCount, float targetError,
+			std::vector<uint32>& collapseRemap, std::vector<bool>& collapseLocked)
+		{
+			const uint32 triCount = (uint32)indices.size() / 3;
+			const uint32 triangleGoal = triCount - targetIndexCount / 3;
+
+			// Each collapse removes about two triangles.  Past the point where that would
+			// reach the goal, only accept collapses not much worse than the ones before it,
+			// so one pass does not trade many cheap collapses for a few expensive ones.
+			// Rejected candidates do not count, or flips that stay rejected pass after pass
+			// would eventually stall the simplification.
+			const std::size_t goalRank = triangleGoal / 2;
+			std::size_t rejected = 0;
+			auto passError = [&]()
+			{
+				std::size_t rank = std::min(candidates.size() - 1, goalRank + rejected);
+				return std::min(targetError, candidates[rank].Error * 1.5f);
+			};
+
+			std::vector<uint32> scratch[3];
+			uint32 collapseCount = 0;
+			uint32 removedTriangles = 0;
+			for(const Collapse& collapse : candidates)
+			{
+				if(collapse.Error > passError() || removedTriangles >= triangleGoal)
+					break;
+
+				const uint32 from = collapse.From;
+				const uint32 to = collapse.To;
+				if(collapseLocked[mRemap[from]] || collapseLocked[mRemap[to]])
+					continue;
+
+				uint32 twin = InvalidIndex;
+				uint32 twinTo = InvalidIndex;
+				if(mKinds[from] == Seam)
+				{
+					twin = mWedge[from];
+					twinTo = TwinTarget(from, to);
+					if(twinTo == InvalidIndex)
+					{
+						rejected++;
+						continue;
+					}
+				}
+
+				if(BreaksTopology(indices, triangles, from, to, scratch) ||
+					HasTriangleFlips(indices, triangles, from, to) ||
+					(twin != InvalidIndex && HasTriangleFlips(indices, triangles, twin, twinTo)))
+				{
+					rejected++;
+					continue;
+				}
+
+				collapseRemap[from] = to;
+				if(twin != InvalidIndex)
+					collapseRemap[twin] = twinTo;
+
+				mQuadrics[mRemap[to]].Add(mQuadrics[mRemap[from]]);
+
+				// The checks above assumed from's neighbors stay where they are, so none of
+				// them may collapse in this pass either.
+				collapseLocked[mRemap[from]] = true;
+				collapseLocked[mRemap[to]] = true;
+				for(uint32 n : scratch[0])
+					collapseLocked[n] = true;
+
+				removedTriangles += mKinds[from] == Border ? 1 : 2;
+				collapseCount++;
+			}
+
+			return collapseCount;
+		}
+
+		// The quadric costs are averages over all the planes merged into a vertex, which
+		// understates the error of large collapses.  Instead measure how far every removed
+		// vertex is from the surface around the vertex it was merged into.
+		float MeasureError(const std::vector<uint32>& indices, ThreadPool& pool,
+			const std::vector<uint32>& finalVertex)const
+		{
+			Adjacency triangles;
+			BuildTriangleAdjacency(indices.data(), (uint32)indices.size(), mVertexCount, triangles);
+
+			const uint32 chunkCount = (mVertexCount + GrainSize - 1) / GrainSize;
+			std::vector<float> chunkErrors(chunkCount, 0.0f);
+			pool.ParallelFor(mVertexCount, GrainSize, [&](uint32 begin, uint32 end)
+			{
+				float chunkError = 0.0f;
+				for(uint32 v = begin; v < end; ++v)
+				{
+					const uint32 f = finalVertex[v];
+					if(f == v || triangles.Begin(f) == triangles.End(f))
+						continue;
+
+					float distance = FLT_MAX;
+					for(const uint32* t = triangles.Begin(f); t != triangles.End(f); ++t)
+					{
+						const Float3& p0 = mPositions[indices[*t * 3 + 0]];
+						Float3 n = Cross(mPositions[indices[*t * 3 + 1]] - p0, mPositions[indices[*t * 3 + 2]] - p0);
+						float length = std::sqrt(Dot(n, n));
+						if(length > 0.0f)
+							distance = std::min(distance, std::fabs(Dot(n, mPositions[v] - p0)) / length);
+					}
+
+					if(distance != FLT_MAX)
+						chunkError = std::max(chunkError, distance);
+				}
+				chunkErrors[begin / GrainSize] = chunkError;
+			});
+
+			return chunkErrors.empty() ? 0.0f : *std::max_element(chunkErrors.begin(), chunkErrors.end());
+		}
+
+		void RemapEdgeLoops(std::vector<uint32>& loop, const std::vector<uint32>& collapseRemap)const
+		{
+			for(uint32 v = 0; v < mVertexCount; ++v)
+			{
+				if(loop[v] == InvalidIndex)
+					continue;
+
+				// v == r when the edge was collapsed against the direction of the loop.
+				uint32 l = loop[v];
+				uint32 r = collapseRemap[l];
+				loop[v] = v == r ? loop[l] : r;
+			}
+		}
+
+		void CompactTriangles(std::vector<uint32>& indices, ThreadPool& pool, const std::vector<uint32>& collapseRemap)const
+		{
+			const uint32 triCount = (uint32)indices.size() / 3;
+
+			pool.ParallelFor(triCount * 3, GrainSize * 3, [&](uint32 begin, uint32 end)
+			{
+				for(uint32 i = begin; i < end; ++i)
+					indices[i] = collapseRemap[indices[i]];
+			});
+
+			uint32 write = 0;
+			for(uint32 t = 0; t < triCount; ++t)
+			{
+				uint32 a = indices[t * 3 + 0];
+				uint32 b = indices[t * 3 + 1];
+				uint32 c = indices[t * 3 + 2];
+
+				if(mRemap[a] == mRemap[b] || mRemap[b] == mRemap[c] || mRemap[a] == mRemap[c])
+					continue;
+
+				indices[write++] = a;
+				indices[write++] = b;
+				indices[write++] = c;
+			}
+			indices.resize(write);
+		}
+
+		uint32 mVertexCount;
+		float mExtent = 0.0f;
+
+		std::vector<Float3> mPositions;
+		std::vector<uint32> mRemap;
+		std::vector<uint32> mWedge;
+		std::vector<uint32> mLoop;
+		std::vector<uint32> mLoopBack;
+		std::vector<VertexKind> mKinds;
+		std::vector<unsigned char> mOpenPositionEdge;
+		std::vector<Quadric> mQuadrics;
+	};
+}
+
+float MeshSimplifier::Simplify(const XMFLOAT3* positions, std::size_t positionStride, uint32 vertexCount,
+	const uint32* indices, uint32 indexCount, uint32 targetIndexCount, float targetError,
+	std::vector<uint32>& destination)
+{
+	destination.assign(indices, indices + indexCount - indexCount % 3);
+	if(destination.size() <= targetIndexCount)
+		return 0.0f;
+
+	Simplifier simplifier(positions, positionStride, vertexCount);
+	if(simplifier.Extent() <= 0.0f)
+		return 0.0f;
+
+	// Quadric costs are squared distances in the unit cube.
+	float normalizedError = targetError / simplifier.Extent();
+	float error = simplifier.Run(destination, targetIndexCount, normalizedError * normalizedError);
+
+	return error * simplifier.Extent();
+}
+
+void MeshSimplifier::BuildLodChain(const XMFLOAT3* positions, std::size_t positionStride, uint32 vertexCount,
+	const uint32* indices, uint32 indexCount, const std::vector<LodLevel>& levels, std::vector<Lod>& lods)
+{
+	lods.clear();
+
+	if(vertexCount == 0)
+		return;
+
+	XMVECTOR minimum = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maximum = XMVectorReplicate(-FLT_MAX);
+	for(uint32 v = 0; v < vertexCount; ++v)
+	{
+		XMVECTOR p = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(
+			reinterpret_cast<const unsigned char*>(positions) + v * positionStride));
+		minimum = XMVectorMin(minimum, p);
+		maximum = XMVectorMax(maximum, p);
+	}
+	const float diagonal = XMVectorGetX(XMVector3Length(XMVectorSubtract(maximum, minimum)));
+
+	const uint32* source = indices;
+	uint32 sourceCount = indexCount;
+	float sourceError = 0.0f;
+
+	for(const LodLevel& level : levels)
+	{
+		uint32 targetIndexCount = (uint32)(indexCount / 3 * level.TriangleRatio) * 3;
+
+		// Errors of successive levels add up, since each is simplified from the last.
+		float errorBudget = level.MaxError * diagonal - sourceError;
+		if(errorBudget <= 0.0f)
+			break;
+
+		Lod lod;
+		float error = Simplify(positions, positionStride, vertexCount, source, sourceCount, targetIndexCount,
+			errorBudget, lod.Indices);
+		lod.Error = sourceError + error;
+
+		if(lod.Indices.size() * 10 > (std::size_t)sourceCount * 9)
+			break;
+
+		lods.push_back(std::move(lod));
+		source = lods.back().Indices.data();
+		sourceCount = (uint32)lods.back().Indices.size();
+		sourceError = lods.back().Error;
+	}
+}
+
+std::vector<MeshSimplifier::LodLevel> MeshSimplifier::DefaultLevels()
+{
+	std::vector<LodLevel> levels(3);
+	levels[0].TriangleRatio = 0.5f;
+	levels[0].MaxError = 0.02f;
+	levels[1].TriangleRatio = 0.25f;
+	levels[1].MaxError = 0.05f;
+	levels[2].TriangleRatio = 0.125f;
+	levels[2].MaxError = 0.1f;
+	return levels;
+}
+
+float MeshSimplifier::ScreenSpaceError(float error, float distance, float projScaleY, float viewportHeight)
+{
+	// Inside the bounds every level is too coarse.
+	if(distance <= 0.0f)
+		return FLT_MAX;
+
+	return error * projScaleY * 0.5f * viewportHeight / distance;
+}
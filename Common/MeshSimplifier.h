@@ -0,0 +1,81 @@
+//***************************************************************************************
+// MeshSimplifier.h
+//
+// Level of detail generation by edge collapse with quadric error metrics (Garland and
+// Heckbert, "Surface Simplification Using Quadric Error Metrics", 1997).
+//
+// Vertices are never moved, only merged onto a neighbor, so every LOD indexes the
+// original vertex buffer and can be drawn from the same MeshGeometry with a different
+// index range.  Vertices that share a position but differ in their other attributes
+// (UV and normal seams, after welding) are classified up front; seam vertices may only
+// collapse along the seam and both sides collapse together, border vertices only along
+// the border, and anything more complex is locked.  This keeps texture and shading
+// discontinuities where they are.
+//
+// Collapses are done in passes: the cost of every candidate edge is evaluated in
+// parallel, the cheapest independent collapses are applied, and the index buffer is
+// compacted.  Classification, quadric accumulation and candidate evaluation run on
+// ThreadPool::Default().
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class MeshSimplifier
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	// One level of a LOD chain.  Collapses stop at whichever limit is reached first.
+	struct LodLevel
+	{
+		// Target triangle count as a fraction of the original mesh.
+		float TriangleRatio = 0.5f;
+
+		// Largest error allowed, as a fraction of the mesh's bounding box diagonal.
+		float MaxError = 0.05f;
+	};
+
+	struct Lod
+	{
+		std::vector<uint32> Indices;
+
+		// Deviation from the original surface in the mesh's units.
+		float Error = 0.0f;
+	};
+
+	///<summary>
+	/// Simplifies indices[0, indexCount), which reference vertexCount positions (strided
+	/// by positionStride bytes), to at most targetIndexCount indices while no collapse
+	/// costs more than targetError (in the mesh's units).  Writes the result to
+	/// destination and returns its error in the mesh's units.
+	///</summary>
+	static float Simplify(const DirectX::XMFLOAT3* positions, std::size_t positionStride, uint32 vertexCount,
+		const uint32* indices, uint32 indexCount, uint32 targetIndexCount, float targetError,
+		std::vector<uint32>& destination);
+
+	///<summary>
+	/// Builds one Lod per level, each simplified from the previous one.  Levels that would
+	/// not remove at least 10% of the previous level's triangles are dropped, so lods may
+	/// be shorter than levels.
+	///</summary>
+	static void BuildLodChain(const DirectX::XMFLOAT3* positions, std::size_t positionStride, uint32 vertexCount,
+		const uint32* indices, uint32 indexCount, const std::vector<LodLevel>& levels, std::vector<Lod>& lods);
+
+	///<summary>
+	/// Halving the triangle count three times, allowing 2%, 5% and 10% of the bounding
+	/// box diagonal as error.
+	///</summary>
+	static std::vector<LodLevel> DefaultLevels();
+
+	///<summary>
+	/// Projected size in pixels of an object space error seen from distance.  projScaleY
+	/// is element (1, 1) of the projection matrix, 1 / tan(fovY / 2).
+	///</summary>
+	static float ScreenSpaceError(float error, float distance, float projScaleY, float viewportHeight);
+};
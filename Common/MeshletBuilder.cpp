@@ -0,0 +1,296 @@
+//***************************************************************************************
+// MeshletBuilder.cpp
+//***************************************************************************************
+
+#include "MeshletBuilder.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	const std::uint8_t NotInMeshlet = 0xff;
+
+	const XMFLOAT3& PositionAt(const XMFLOAT3* positions, std::size_t stride, std::uint32_t v)
+	{
+		return *reinterpret_cast<const XMFLOAT3*>(reinterpret_cast<const unsigned char*>(positions) + v * stride);
+	}
+
+	// Computes the bounding sphere and normal cone of a finished meshlet.
+	void ComputeBounds(const XMFLOAT3* positions, std::size_t stride, const std::uint32_t* triangles,
+		std::uint32_t triangleCount, const std::vector<std::uint32_t>& vertices, MeshletBuilder::Meshlet& meshlet)
+	{
+		std::vector<XMFLOAT3> points(vertices.size());
+		for(std::size_t i = 0; i < vertices.size(); ++i)
+			points[i] = PositionAt(positions, stride, vertices[i]);
+
+		BoundingSphere::CreateFromPoints(meshlet.Sphere, points.size(), points.data(), sizeof(XMFLOAT3));
+
+		// Unit normals; zero for degenerate triangles.
+		std::vector<XMFLOAT3> normals(triangleCount, XMFLOAT3(0.0f, 0.0f, 0.0f));
+		XMVECTOR axis = XMVectorZero();
+		bool anyNormal = false;
+		for(std::uint32_t t = 0; t < triangleCount; ++t)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&PositionAt(positions, stride, triangles[t * 3 + 0]));
+			XMVECTOR p1 = XMLoadFloat3(&PositionAt(positions, stride, triangles[t * 3 + 1]));
+			XMVECTOR p2 = XMLoadFloat3(&PositionAt(positions, stride, triangles[t * 3 + 2]));
+
+			XMVECTOR n = XMVector3Cross(XMVectorSubtract(p1, p0), XMVectorSubtract(p2, p0));
+			float length = XMVectorGetX(XMVector3Length(n));
+			if(length <= 0.0f)
+				continue;
+
+			n = XMVectorScale(n, 1.0f / length);
+			axis = XMVectorAdd(axis, n);
+			XMStoreFloat3(&normals[t], n);
+			anyNormal = true;
+		}
+
+		meshlet.ConeAxis = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		meshlet.ConeApex = meshlet.Sphere.Center;
+		meshlet.ConeCutoff = 1.0f;
+
+		float axisLength = XMVectorGetX(XMVector3Length(axis));
+		if(!anyNormal || axisLength <= 0.0f)
+			return;
+		axis = XMVectorScale(axis, 1.0f / axisLength);
+
+		float minDot = 1.0f;
+		for(std::uint32_t t = 0; t < triangleCount; ++t)
+		{
+			XMVECTOR n = XMLoadFloat3(&normals[t]);
+			if(XMVectorGetX(XMVector3LengthSq(n)) > 0.0f)
+				minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(axis, n)));
+		}
+
+		// A cone wider than ~84 degrees rejects so little that it is not worth testing.
+		if(minDot <= 0.1f)
+			return;
+
+		// Move the apex back along the axis until it is behind every triangle's plane, so
+		// the test is conservative for eye positions close to the meshlet.
+		XMVECTOR center = XMLoadFloat3(&meshlet.Sphere.Center);
+		float maxT = 0.0f;
+		for(std::uint32_t t = 0; t < triangleCount; ++t)
+		{
+			XMVECTOR n = XMLoadFloat3(&normals[t]);
+			if(XMVectorGetX(XMVector3LengthSq(n)) <= 0.0f)
+				continue;
+
+			XMVECTOR p0 = XMLoadFloat3(&PositionAt(positions, stride, triangles[t * 3 + 0]));
+			float dc = XMVectorGetX(XMVector3Dot(XMVectorSubtract(center, p0), n));
+			float dn = XMVectorGetX(XMVector3Dot(axis, n));
+
+			// dn >= minDot > 0.1, so this never divides by zero.
+			maxT = std::max(maxT, dc / dn);
+		}
+
+		XMStoreFloat3(&meshlet.ConeAxis, axis);
+		XMStoreFloat3(&meshlet.ConeApex, XMVectorSubtract(center, XMVectorScale(axis, maxT)));
+		meshlet.ConeCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+}
+
+void MeshletBuilder::Build(const XMFLOAT3* positions, std::size_t positionStride,
+	uint32* indices, uint32 indexCount, uint32 indexBase, MeshletData& data)
+{
+	const uint32 triCount = indexCount / 3;
+	if(triCount == 0)
+		return;
+
+	uint32 vertexCount = 0;
+	for(uint32 i = 0; i < triCount * 3; ++i)
+		vertexCount = std::max(vertexCount, indices[i] + 1);
+
+	// Vertex -> triangle adjacency in compressed rows.
+	std::vector<uint32> offsets(vertexCount + 1, 0);
+	for(uint32 i = 0; i < triCount * 3; ++i)
+		offsets[indices[i] + 1]++;
+	for(uint32 v = 0; v < vertexCount; ++v)
+		offsets[v + 1] += offsets[v];
+
+	std::vector<uint32> adjacency(triCount * 3);
+	{
+		std::vector<uint32> cursor(offsets.begin(), offsets.end() - 1);
+		for(uint32 i = 0; i < triCount * 3; ++i)
+			adjacency[cursor[indices[i]]++] = i / 3;
+	}
+
+	const std::vector<uint32> input(indices, indices + triCount * 3);
+	std::vector<bool> emitted(triCount, false);
+	std::vector<uint8> localIndex(vertexCount, NotInMeshlet);
+
+	std::vector<uint32> meshletVertices;
+	std::vector<uint32> meshletTriangles;
+	meshletVertices.reserve(MaxVertices);
+	meshletTriangles.reserve(MaxTriangles * 3);
+
+	const std::size_t firstMeshlet = data.Meshlets.size();
+	uint32 outCount = 0;
+	uint32 scanCursor = 0;
+
+	auto newVertexCount = [&](uint32 t)
+	{
+		uint32 count = 0;
+		for(int c = 0; c < 3; ++c)
+			count += localIndex[input[t * 3 + c]] == NotInMeshlet ? 1 : 0;
+		return count;
+	};
+
+	auto flush = [&]()
+	{
+		if(meshletTriangles.empty())
+			return;
+
+		Meshlet meshlet;
+		meshlet.StartIndexLocation = indexBase + outCount;
+		meshlet.IndexCount = (uint32)meshletTriangles.size();
+		meshlet.VertexOffset = (uint32)data.MeshletVertices.size();
+		meshlet.VertexCount = (uint32)meshletVertices.size();
+		meshlet.TriangleOffset = (uint32)data.MeshletTriangles.size() / 3;
+		meshlet.TriangleCount = (uint32)meshletTriangles.size() / 3;
+
+		ComputeBounds(positions, positionStride, meshletTriangles.data(), meshlet.TriangleCount,
+			meshletVertices, meshlet);
+
+		for(uint32 v : meshletTriangles)
+		{
+			indices[outCount++] = v;
+			data.MeshletTriangles.push_back(localIndex[v]);
+		}
+
+		for(uint32 v : meshletVertices)
+		{
+			data.MeshletVertices.push_back(v);
+			localIndex[v] = NotInMeshlet;
+		}
+
+		data.Meshlets.push_back(meshlet);
+		meshletVertices.clear();
+		meshletTriangles.clear();
+	};
+
+	for(uint32 emittedCount = 0; emittedCount < triCount; ++emittedCount)
+	{
+		// Prefer the unemitted triangle around the current meshlet that adds the fewest
+		// new vertices; start over from the next triangle in order if there is none.
+		uint32 best = triCount;
+		uint32 bestNew = 4;
+		for(uint32 v : meshletVertices)
+		{
+			for(uint32 k = offsets[v]; k < offsets[v + 1] && bestNew > 0; ++k)
+			{
+				uint32 t = adjacency[k];
+				if(emitted[t])
+					continue;
+
+				uint32 added = newVertexCount(t);
+				if(added < bestNew || (added == bestNew && t < best))
+				{
+					best = t;
+					bestNew = added;
+				}
+			}
+		}
+
+		if(best == triCount)
+		{
+			while(emitted[scanCursor])
+				++scanCursor;
+			best = scanCursor;
+			bestNew = newVertexCount(best);
+		}
+
+		if(meshletVertices.size() + bestNew > MaxVertices || meshletTriangles.size() / 3 + 1 > MaxTriangles)
+		{
+			flush();
+		}
+
+		for(int c = 0; c < 3; ++c)
+		{
+			uint32 v = input[best * 3 + c];
+			if(localIndex[v] == NotInMeshlet)
+			{
+				localIndex[v] = (uint8)meshletVertices.size();
+				meshletVertices.push_back(v);
+			}
+			meshletTriangles.push_back(v);
+		}
+
+		emitted[best] = true;
+	}
+
+	flush();
+
+	// Order the meshlets the way MeshOptimizer::OptimizeOverdraw orders Tipsify's
+	// clusters, so the ones facing away from the submesh's center are drawn first.  Each
+	// meshlet's vertex and triangle lists stay where they are; only the index ranges move.
+	std::vector<uint32> clusters;
+	for(std::size_t m = firstMeshlet; m < data.Meshlets.size(); ++m)
+		clusters.push_back(data.Meshlets[m].StartIndexLocation - indexBase);
+
+	std::vector<uint32> order;
+	MeshOptimizer::SortClustersForOverdraw(indices, triCount * 3, positions, positionStride, 0, clusters, &order);
+
+	std::vector<Meshlet> sorted;
+	sorted.reserve(order.size());
+	uint32 start = indexBase;
+	for(uint32 o : order)
+	{
+		sorted.push_back(data.Meshlets[firstMeshlet + o]);
+		sorted.back().StartIndexLocation = start;
+		start += sorted.back().IndexCount;
+	}
+	std::copy(sorted.begin(), sorted.end(), data.Meshlets.begin() + firstMeshlet);
+}
+
+bool MeshletBuilder::IsVisible(const Meshlet& meshlet, const BoundingFrustum& localFrustum, FXMVECTOR localEye)
+{
+	if(localFrustum.Contains(meshlet.Sphere) == DISJOINT)
+		return false;
+
+	XMVECTOR toApex = XMVector3Normalize(XMVectorSubtract(XMLoadFloat3(&meshlet.ConeApex), localEye));
+	float d = XMVectorGetX(XMVector3Dot(toApex, XMLoadFloat3(&meshlet.ConeAxis)));
+
+	return d < meshlet.ConeCutoff;
+}
+
+void MeshletBuilder::AppendIndexRange(const Meshlet& meshlet, std::vector<IndexRange>& ranges)
+{
+	if(!ranges.empty() && ranges.back().StartIndexLocation + ranges.back().IndexCount == meshlet.StartIndexLocation)
+	{
+		ranges.back().IndexCount += meshlet.IndexCount;
+		return;
+	}
+
+	IndexRange range;
+	range.StartIndexLocation = meshlet.StartIndexLocation;
+	range.IndexCount = meshlet.IndexCount;
+	ranges.push_back(range);
+}
+
+MeshletBuilder::uint32 MeshletBuilder::Cull(const std::vector<Meshlet>& meshlets, uint32 first, uint32 count,
+	const LocalView* views, uint32 viewCount, std::vector<IndexRange>& ranges)
+{
+	ranges.clear();
+
+	uint32 visibleCount = 0;
+	for(uint32 i = first; i < first + count; ++i)
+	{
+		// Stops at the first view that sees the meshlet.
+		bool visible = false;
+		for(uint32 v = 0; v < viewCount && !visible; ++v)
+			visible = IsVisible(meshlets[i], views[v].Frustum, XMLoadFloat3(&views[v].Eye));
+
+		if(!visible)
+			continue;
+
+		AppendIndexRange(meshlets[i], ranges);
+		visibleCount++;
+	}
+
+	return visibleCount;
+}
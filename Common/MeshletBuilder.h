@@ -0,0 +1,112 @@
+//***************************************************************************************
+// MeshletBuilder.h
+//
+// Splits the triangles of a submesh into meshlets of at most MaxVertices vertices and
+// MaxTriangles triangles, and culls them on the CPU.
+//
+// Build reorders the submesh's index range so that every meshlet is a contiguous run of
+// indices.  Triangles are gathered by adjacency, which keeps them in cache friendly order
+// within a meshlet, and the meshlets are then sorted for overdraw the same way
+// MeshOptimizer sorts its clusters, so the split does not undo that order.  Each meshlet gets a bounding sphere and a normal cone (axis, cutoff and apex)
+// so whole clusters can be rejected when they are outside the frustum or facing away
+// from the camera.  Cull then turns the surviving meshlets into as few index ranges as
+// possible, which are drawn with one DrawIndexedInstanced call each.
+//
+// The per meshlet vertex and local triangle lists are also written so the same data can
+// feed a mesh shader path.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+class MeshletBuilder
+{
+public:
+
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+
+	static const uint32 MaxVertices = 64;
+	static const uint32 MaxTriangles = 124;
+
+	struct Meshlet
+	{
+		// Range of the (reordered) index buffer, in the same units as the submesh's
+		// StartIndexLocation.
+		uint32 StartIndexLocation = 0;
+		uint32 IndexCount = 0;
+
+		// Ranges of the meshlet vertex and triangle lists.  MeshletVertices holds vertex
+		// indices relative to the submesh's BaseVertexLocation; MeshletTriangles holds
+		// three local (0..VertexCount-1) indices per triangle.
+		uint32 VertexOffset = 0;
+		uint32 VertexCount = 0;
+		uint32 TriangleOffset = 0;
+		uint32 TriangleCount = 0;
+
+		DirectX::BoundingSphere Sphere;
+
+		// The meshlet faces away from any eye position for which
+		// dot(normalize(ConeApex - eye), ConeAxis) >= ConeCutoff.  Meshlets whose normals
+		// spread too far have ConeCutoff = 1 and a zero axis, so they are never culled.
+		DirectX::XMFLOAT3 ConeApex = { 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT3 ConeAxis = { 0.0f, 0.0f, 0.0f };
+		float ConeCutoff = 1.0f;
+	};
+
+	struct MeshletData
+	{
+		std::vector<Meshlet> Meshlets;
+		std::vector<uint32> MeshletVertices;
+		std::vector<uint8> MeshletTriangles;
+	};
+
+	struct IndexRange
+	{
+		uint32 StartIndexLocation = 0;
+		uint32 IndexCount = 0;
+	};
+
+	///<summary>
+	/// A camera as seen from one instance: the frustum and the eye position in the mesh's
+	/// local space.
+	///</summary>
+	struct LocalView
+	{
+		DirectX::BoundingFrustum Frustum;
+		DirectX::XMFLOAT3 Eye = { 0.0f, 0.0f, 0.0f };
+	};
+
+	///<summary>
+	/// Builds meshlets for indices[0, indexCount), which reference positions (strided by
+	/// positionStride bytes).  indexBase is the location of indices[0] in the full index
+	/// buffer.  The index range is rewritten in meshlet order, with the meshlets sorted
+	/// for overdraw, and the meshlets are appended to data.
+	///</summary>
+	static void Build(const DirectX::XMFLOAT3* positions, std::size_t positionStride,
+		uint32* indices, uint32 indexCount, uint32 indexBase, MeshletData& data);
+
+	///<summary>
+	/// True if the meshlet intersects localFrustum and is not entirely back facing as seen
+	/// from localEye.  Both must be in the mesh's local space.
+	///</summary>
+	static bool IsVisible(const Meshlet& meshlet, const DirectX::BoundingFrustum& localFrustum,
+		DirectX::FXMVECTOR localEye);
+
+	///<summary>
+	/// Appends the meshlet's index range, merging it with the last range if they touch.
+	///</summary>
+	static void AppendIndexRange(const Meshlet& meshlet, std::vector<IndexRange>& ranges);
+
+	///<summary>
+	/// Culls meshlets[first, first + count) against views, one per instance, and writes
+	/// the compacted index ranges of the meshlets any of them can see to ranges.  The
+	/// ranges are drawn for every instance.  Returns the number of visible meshlets.
+	///</summary>
+	static uint32 Cull(const std::vector<Meshlet>& meshlets, uint32 first, uint32 count,
+		const LocalView* views, uint32 viewCount, std::vector<IndexRange>& ranges);
+};
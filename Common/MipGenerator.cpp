@@ -0,0 +1,341 @@
+//***************************************************************************************
+// MipGenerator.cpp
+//***************************************************************************************
+
+#include "MipGenerator.h"
+#include "ThreadPool.h"
+#include <DirectXMath.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+
+	// Rows per ParallelFor chunk.
+	const uint32 GrainSize = 16;
+
+	// Half width of the Kaiser filter in texels of the level being made, and the shape of
+	// its window.
+	const float KaiserRadius = 1.5f;
+	const float KaiserAlpha = 4.0f;
+
+	// Filtered normals shorter than this, squared, count as cancelled out.  An encoded zero
+	// vector is already up to half a step of 8 bits, 0.004, off in each component.
+	const float MinNormalLengthSq = 1e-4f;
+
+	// A level at full precision, rows first.  Normal maps hold the vectors in [-1,1] and
+	// sRGB images linear colors.
+	using Level = std::vector<XMFLOAT4A>;
+
+	// A texel of the source level and its weight in a filtered texel.
+	struct Tap
+	{
+		uint32 Index;
+		float Weight;
+	};
+
+	// Modified Bessel function of the first kind, order zero, from its power series.
+	float BesselI0(float x)
+	{
+		float sum = 1.0f;
+		float term = 1.0f;
+		float halfX = 0.5f * x;
+		for(uint32 k = 1; k < 32; ++k)
+		{
+			term *= (halfX / k) * (halfX / k);
+			sum += term;
+			if(term < sum * 1e-7f)
+				break;
+		}
+
+		return sum;
+	}
+
+	float Sinc(float x)
+	{
+		if(std::abs(x) < 1e-5f)
+			return 1.0f;
+
+		x *= XM_PI;
+		return std::sin(x) / x;
+	}
+
+	// Taps of every texel along one axis when srcSize texels are filtered down to dstSize.
+	std::vector<std::vector<Tap>> BuildTaps(uint32 srcSize, uint32 dstSize, const MipGenerator::Options& options)
+	{
+		bool box = options.Filter == MipGenerator::MipFilter::Box;
+		float scale = (float)srcSize / (float)dstSize;
+		float support = (box ? 0.5f : KaiserRadius) * scale;
+		float windowNorm = 1.0f / BesselI0(KaiserAlpha);
+
+		std::vector<std::vector<Tap>> taps(dstSize);
+		for(uint32 x = 0; x < dstSize; ++x)
+		{
+			float center = (x + 0.5f) * scale;
+			int first = (int)std::floor(center - support);
+			int last = (int)std::ceil(center + support) - 1;
+
+			float sum = 0.0f;
+			for(int j = first; j <= last; ++j)
+			{
+				float weight;
+				if(box)
+				{
+					// Overlap of the source texel with the area the texel covers.
+					weight = std::min((float)j + 1.0f, center + support) - std::max((float)j, center - support);
+				}
+				else
+				{
+					float t = ((float)j + 0.5f - center) / scale;
+					float r = t / KaiserRadius;
+					weight = std::abs(r) < 1.0f ? Sinc(t) * BesselI0(KaiserAlpha * std::sqrt(1.0f - r * r)) * windowNorm : 0.0f;
+				}
+
+				if(weight == 0.0f)
+					continue;
+
+				int n = (int)srcSize;
+				int index = options.Wrap ? ((j % n) + n) % n : std::min(std::max(j, 0), n - 1);
+
+				taps[x].push_back({ (uint32)index, weight });
+				sum += weight;
+			}
+
+			for(Tap& tap : taps[x])
+				tap.Weight /= sum;
+		}
+
+		return taps;
+	}
+
+	// Filters src down to dst, rows first, then columns.
+	void Downsample(const Level& src, uint32 srcWidth, uint32 srcHeight, Level& dst, uint32 dstWidth, uint32 dstHeight,
+		const MipGenerator::Options& options)
+	{
+		std::vector<std::vector<Tap>> xTaps = BuildTaps(srcWidth, dstWidth, options);
+		std::vector<std::vector<Tap>> yTaps = BuildTaps(srcHeight, dstHeight, options);
+
+		ThreadPool& pool = ThreadPool::Default();
+
+		Level rows((std::size_t)dstWidth * srcHeight);
+		pool.ParallelFor(srcHeight, GrainSize, [&](uint32 begin, uint32 end)
+		{
+			for(uint32 y = begin; y < end; ++y)
+			{
+				const XMFLOAT4A* srcRow = &src[(std::size_t)y * srcWidth];
+				XMFLOAT4A* dstRow = &rows[(std::size_t)y * dstWidth];
+
+				for(uint32 x = 0; x < dstWidth; ++x)
+				{
+					XMVECTOR sum = XMVectorZero();
+					for(const Tap& tap : xTaps[x])
+						sum = XMVectorMultiplyAdd(XMVectorReplicate(tap.Weight), XMLoadFloat4A(&srcRow[tap.Index]), sum);
+
+					XMStoreFloat4A(&dstRow[x], sum);
+				}
+			}
+		});
+
+		dst.resize((std::size_t)dstWidth * dstHeight);
+		pool.ParallelFor(dstHeight, GrainSize, [&](uint32 begin, uint32 end)
+		{
+			for(uint32 y = begin; y < end; ++y)
+			{
+				XMFLOAT4A* dstRow = &dst[(std::size_t)y * dstWidth];
+
+				for(uint32 x = 0; x < dstWidth; ++x)
+				{
+					XMVECTOR sum = XMVectorZero();
+					for(const Tap& tap : yTaps[y])
+						sum = XMVectorMultiplyAdd(XMVectorReplicate(tap.Weight), XMLoadFloat4A(&rows[(std::size_t)tap.Index * dstWidth + x]), sum);
+
+					XMStoreFloat4A(&dstRow[x], sum);
+				}
+			}
+		});
+	}
+
+	void DecodeImage(const BlockCompressor::Image& image, const MipGenerator::Options& options, Level& level)
+	{
+		bool srgb = options.SRGB && !options.NormalMap;
+
+		level.resize((std::size_t)image.Width * image.Height);
+		ThreadPool::Default().ParallelFor(image.Height, GrainSize, [&](uint32 begin, uint32 end)
+		{
+			for(uint32 y = begin; y < end; ++y)
+			{
+				const uint8* row = image.Pixels + (std::size_t)y * image.RowPitch;
+				for(uint32 x = 0; x < image.Width; ++x)
+				{
+					const uint8* texel = row + x * 4;
+					XMVECTOR v = XMVectorScale(XMVectorSet(texel[0], texel[1], texel[2], texel[3]), 1.0f / 255.0f);
+
+					if(srgb)
+						v = XMColorSRGBToRGB(v);
+
+					if(options.NormalMap)
+						v = XMVectorSetW(XMVectorSubtract(XMVectorAdd(v, v), XMVectorSplatOne()), XMVectorGetW(v));
+
+					XMStoreFloat4A(&level[(std::size_t)y * image.Width + x], v);
+				}
+			}
+		});
+	}
+
+	// Fraction of texels whose alpha times scale passes reference.
+	float AlphaCoverage(const Level& level, float reference, float scale)
+	{
+		std::size_t passed = 0;
+		for(const XMFLOAT4A& texel : level)
+		{
+			if(texel.w * scale > reference)
+				++passed;
+		}
+
+		return (float)passed / (float)level.size();
+	}
+
+	// Scale of alpha that makes level cover about as much as coverage at reference.  The
+	// search is over the threshold that would give that coverage unscaled.
+	float AlphaCoverageScale(const Level& level, float reference, float coverage)
+	{
+		float lo = 0.0f;
+		float hi = 1.0f;
+		float threshold = reference;
+
+		for(uint32 i = 0; i < 16; ++i)
+		{
+			float levelCoverage = AlphaCoverage(level, threshold, 1.0f);
+			if(levelCoverage > coverage)
+				lo = threshold;
+			else if(levelCoverage < coverage)
+				hi = threshold;
+			else
+				break;
+
+			threshold = 0.5f * (lo + hi);
+		}
+
+		return threshold > 0.0f ? reference / threshold : 1.0f;
+	}
+
+	void EncodeLevel(const Level& level, uint32 width, uint32 height, const MipGenerator::Options& options, float alphaScale,
+		MipGenerator::Mip& mip)
+	{
+		bool srgb = options.SRGB && !options.NormalMap;
+
+		mip.Width = width;
+		mip.Height = height;
+		mip.Pixels.resize((std::size_t)width * height * 4);
+
+		ThreadPool::Default().ParallelFor(height, GrainSize, [&](uint32 begin, uint32 end)
+		{
+			for(uint32 y = begin; y < end; ++y)
+			{
+				for(uint32 x = 0; x < width; ++x)
+				{
+					std::size_t i = (std::size_t)y * width + x;
+					XMVECTOR v = XMLoadFloat4A(&level[i]);
+					float alpha = XMVectorGetW(v) * alphaScale;
+
+					if(options.NormalMap)
+					{
+						// Filtering shortens the vectors; flat regions that cancel out face up.
+						XMVECTOR n = XMVectorSetW(v, 0.0f);
+						n = XMVectorGetX(XMVector3LengthSq(n)) > MinNormalLengthSq ? XMVector3Normalize(n) : XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+						v = XMVectorMultiplyAdd(n, XMVectorReplicate(0.5f), XMVectorReplicate(0.5f));
+					}
+					else if(srgb)
+					{
+						v = XMColorRGBToSRGB(XMVectorSaturate(v));
+					}
+
+					v = XMVectorSetW(v, alpha);
+					v = XMVectorRound(XMVectorScale(XMVectorSaturate(v), 255.0f));
+
+					XMFLOAT4 q;
+					XMStoreFloat4(&q, v);
+					uint8* texel = &mip.Pixels[i * 4];
+					texel[0] = (uint8)q.x;
+					texel[1] = (uint8)q.y;
+					texel[2] = (uint8)q.z;
+					texel[3] = (uint8)q.w;
+				}
+			}
+		});
+	}
+}
+
+BlockCompressor::Image MipGenerator::Mip::View()const
+{
+	BlockCompressor::Image image;
+	image.Width = Width;
+	image.Height = Height;
+	image.RowPitch = Width * 4;
+	image.Pixels = Pixels.data();
+	return image;
+}
+
+void MipGenerator::Generate(const BlockCompressor::Image& image, const Options& options, std::vector<Mip>& mips)
+{
+	uint32 mipCount = 1;
+	while((std::max(image.Width, image.Height) >> mipCount) > 0)
+		++mipCount;
+
+	if(options.MaxMipCount > 0)
+		mipCount = std::min(mipCount, options.MaxMipCount);
+
+	mips.clear();
+	mips.resize(mipCount);
+
+	// The image itself is the first level, as is.
+	Mip& top = mips[0];
+	top.Width = image.Width;
+	top.Height = image.Height;
+	top.Pixels.resize((std::size_t)image.Width * image.Height * 4);
+	for(uint32 y = 0; y < image.Height; ++y)
+		std::memcpy(&top.Pixels[(std::size_t)y * image.Width * 4], image.Pixels + (std::size_t)y * image.RowPitch, image.Width * 4);
+
+	if(mipCount == 1)
+		return;
+
+	Level current;
+	Level next;
+	DecodeImage(image, options, current);
+
+	bool keepCoverage = options.AlphaReference > 0.0f;
+	float coverage = keepCoverage ? AlphaCoverage(current, options.AlphaReference, 1.0f) : 0.0f;
+
+	uint32 width = image.Width;
+	uint32 height = image.Height;
+	for(uint32 i = 1; i < mipCount; ++i)
+	{
+		uint32 nextWidth = std::max(width / 2, 1u);
+		uint32 nextHeight = std::max(height / 2, 1u);
+		Downsample(current, width, height, next, nextWidth, nextHeight, options);
+
+		// Only the stored level is scaled; the next one is filtered from the unscaled alpha.
+		float alphaScale = keepCoverage ? AlphaCoverageScale(next, options.AlphaReference, coverage) : 1.0f;
+		EncodeLevel(next, nextWidth, nextHeight, options, alphaScale, mips[i]);
+
+		current.swap(next);
+		width = nextWidth;
+		height = nextHeight;
+	}
+}
+
+void MipGenerator::WriteDDS(const std::vector<Mip>& mips, BlockCompressor::Format format, BlockCompressor::Quality quality,
+	bool srgb, std::vector<std::uint8_t>& file)
+{
+	std::vector<std::vector<std::uint8_t>> blocks(mips.size());
+	for(std::size_t i = 0; i < mips.size(); ++i)
+		BlockCompressor::Compress(mips[i].View(), format, quality, blocks[i]);
+
+	BlockCompressor::WriteDDS(BlockCompressor::DxgiFormat(format, srgb), mips.empty() ? 0 : mips[0].Width,
+		mips.empty() ? 0 : mips[0].Height, blocks, file);
+}
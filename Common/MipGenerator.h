@@ -0,0 +1,76 @@
+//***************************************************************************************
+// MipGenerator.h
+//
+// Builds the mip chain of an imported 8-bit RGBA image on the CPU.  Each level is filtered
+// from the previous one at full float precision with a box or a Kaiser windowed sinc
+// filter, applied separably over rows and then columns, with the texture wrapping or
+// clamping at the edges.
+//   -sRGB images are filtered in linear space.
+//   -Normal maps are filtered as vectors and renormalized.
+//   -Cutout textures can keep the fraction of texels that pass their alpha test, which
+//    otherwise shrinks with each level and makes fences and foliage fade out at distance.
+//
+// Texels are processed as one XMVECTOR each, so filtering uses SSE/NEON where available,
+// and the rows of each level are spread over ThreadPool::Default().  WriteDDS compresses
+// the chain with BlockCompressor into a DDS file.
+//***************************************************************************************
+
+#pragma once
+
+#include "BlockCompressor.h"
+#include <cstdint>
+#include <vector>
+
+class MipGenerator
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	enum class MipFilter
+	{
+		Box,	// Average of the texels each texel covers
+		Kaiser	// Sharper, with less aliasing; windowed sinc over three texels of the level
+	};
+
+	struct Options
+	{
+		MipFilter Filter = MipFilter::Kaiser;
+
+		// The color channels are sRGB encoded.
+		bool SRGB = false;
+
+		// Red, green and blue hold a unit vector encoded to [0,1].
+		bool NormalMap = false;
+
+		// Alpha test threshold of a cutout texture, whose coverage every level keeps, or
+		// zero to filter alpha like the other channels.
+		float AlphaReference = 0.0f;
+
+		// Filter across the edges as a tiling texture; otherwise the edges are clamped.
+		bool Wrap = true;
+
+		// Levels to build including the image itself, or zero for the full chain down to 1x1.
+		uint32 MaxMipCount = 0;
+	};
+
+	struct Mip
+	{
+		uint32 Width = 0;
+		uint32 Height = 0;
+		std::vector<std::uint8_t> Pixels;
+
+		BlockCompressor::Image View()const;
+	};
+
+	///<summary>
+	/// Fills mips with image followed by its mips.
+	///</summary>
+	static void Generate(const BlockCompressor::Image& image, const Options& options, std::vector<Mip>& mips);
+
+	///<summary>
+	/// Compresses every mip and lays them out as a DDS file.
+	///</summary>
+	static void WriteDDS(const std::vector<Mip>& mips, BlockCompressor::Format format, BlockCompressor::Quality quality,
+		bool srgb, std::vector<std::uint8_t>& file);
+};
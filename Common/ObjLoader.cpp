@@ -0,0 +1,422 @@
+//***************************************************************************************
+// ObjLoader.cpp
+//***************************************************************************************
+
+#include "ObjLoader.h"
+#include "Hash.h"
+#include "TangentSpace.h"
+#include "VirtualFileSystem.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+
+using namespace DirectX;
+
+namespace
+{
+	// Quantized vertex attributes used as the weld key.
+	struct WeldKey
+	{
+		std::int32_t P[3];
+		std::int32_t N[3];
+		std::int32_t T[2];
+
+		bool operator==(const WeldKey& rhs)const
+		{
+			return std::memcmp(this, &rhs, sizeof(WeldKey)) == 0;
+		}
+	};
+
+	struct WeldKeyHash
+	{
+		size_t operator()(const WeldKey& k)const
+		{
+			// Mixed so nearby grid cells spread over the buckets.
+			return (size_t)Hash::Mix(Hash::Fnv1a(&k, sizeof(WeldKey)));
+		}
+	};
+
+	inline std::int32_t Quantize(float x, float invStep)
+	{
+		return (std::int32_t)std::lround(x * invStep);
+	}
+
+	inline const char* SkipSpace(const char* s)
+	{
+		while(*s == ' ' || *s == '\t')
+			++s;
+		return s;
+	}
+
+	inline bool IsKeyword(const char* s, const char* keyword, size_t len)
+	{
+		return std::strncmp(s, keyword, len) == 0 && (s[len] == ' ' || s[len] == '\t');
+	}
+
+	// Returns the rest of the line with leading/trailing white space removed.
+	std::string TrimmedRest(const char* s)
+	{
+		s = SkipSpace(s);
+		std::string r(s);
+		while(!r.empty() && (r.back() == ' ' || r.back() == '\t' || r.back() == '\r'))
+			r.pop_back();
+		return r;
+	}
+
+	std::string DirectoryOf(const std::string& filename)
+	{
+		size_t slash = filename.find_last_of("/\\");
+		return slash == std::string::npos ? std::string() : filename.substr(0, slash + 1);
+	}
+
+	// Resolves a 1-based (or negative, relative) OBJ index against count elements.
+	inline int ResolveIndex(long i, size_t count)
+	{
+		if(i > 0)
+			return (int)i - 1;
+		if(i < 0)
+			return (int)count + (int)i;
+		return -1;
+	}
+}
+
+bool ObjLoader::Load(const std::string& filename, ObjModel& model)
+{
+	return Load(filename, model, ImportSettings());
+}
+
+bool ObjLoader::Load(const std::string& filename, ObjModel& model, const ImportSettings& settings)
+{
+	std::unique_ptr<std::istream> stream = VirtualFileSystem::Default().Open(filename);
+	if(!stream)
+		return false;
+
+	std::istream& fin = *stream;
+
+	model = ObjModel();
+
+	const float invPosStep = 1.0f / settings.PositionWeldStep;
+	const float invNormStep = 1.0f / settings.NormalWeldStep;
+	const float invTexStep = 1.0f / settings.TexCWeldStep;
+	const float zSign = settings.ConvertToLeftHanded ? -1.0f : 1.0f;
+
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT3> normals;
+	std::vector<XMFLOAT2> texCoords;
+
+	std::unordered_map<WeldKey, uint32, WeldKeyHash> weldMap;
+	std::vector<bool> needsNormal;
+
+	// Triangles are binned per material and concatenated once the file is read.
+	std::vector<std::vector<uint32>> subsetIndices;
+	std::unordered_map<std::string, size_t> subsetLookup;
+	size_t currentSubset = 0;
+	subsetIndices.emplace_back();
+	model.Subsets.emplace_back();
+
+	auto& vertices = model.Mesh.Vertices;
+
+	std::vector<uint32> polygon;
+	std::string line;
+	while(std::getline(fin, line))
+	{
+		const char* s = SkipSpace(line.c_str());
+		char* end = nullptr;
+
+		if(s[0] == 'v' && (s[1] == ' ' || s[1] == '\t'))
+		{
+			XMFLOAT3 p;
+			p.x = std::strtof(s + 1, &end);
+			p.y = std::strtof(end, &end);
+			p.z = std::strtof(end, &end) * zSign;
+			positions.push_back(p);
+		}
+		else if(s[0] == 'v' && s[1] == 'n')
+		{
+			XMFLOAT3 n;
+			n.x = std::strtof(s + 2, &end);
+			n.y = std::strtof(end, &end);
+			n.z = std::strtof(end, &end) * zSign;
+			normals.push_back(n);
+		}
+		else if(s[0] == 'v' && s[1] == 't')
+		{
+			XMFLOAT2 t;
+			t.x = std::strtof(s + 2, &end);
+			t.y = std::strtof(end, &end);
+			if(settings.FlipV)
+				t.y = 1.0f - t.y;
+			texCoords.push_back(t);
+		}
+		else if(s[0] == 'f' && (s[1] == ' ' || s[1] == '\t'))
+		{
+			polygon.clear();
+			const char* c = s + 1;
+			while(true)
+			{
+				c = SkipSpace(c);
+				if(*c == '\0' || *c == '\r' || *c == '#')
+					break;
+
+				long vi = std::strtol(c, &end, 10);
+				long ti = 0;
+				long ni = 0;
+				c = end;
+				if(*c == '/')
+				{
+					++c;
+					if(*c != '/')
+					{
+						ti = std::strtol(c, &end, 10);
+						c = end;
+					}
+					if(*c == '/')
+					{
+						ni = std::strtol(c + 1, &end, 10);
+						c = end;
+					}
+				}
+
+				int p = ResolveIndex(vi, positions.size());
+				int t = ResolveIndex(ti, texCoords.size());
+				int n = ResolveIndex(ni, normals.size());
+				if(p < 0 || p >= (int)positions.size())
+					break;
+
+				GeometryGenerator::Vertex v;
+				v.Position = positions[p];
+				v.Normal = (n >= 0 && n < (int)normals.size()) ? normals[n] : XMFLOAT3(0.0f, 0.0f, 0.0f);
+				v.TexC = (t >= 0 && t < (int)texCoords.size()) ? texCoords[t] : XMFLOAT2(0.0f, 0.0f);
+				v.TangentU = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+				WeldKey key;
+				key.P[0] = Quantize(v.Position.x, invPosStep);
+				key.P[1] = Quantize(v.Position.y, invPosStep);
+				key.P[2] = Quantize(v.Position.z, invPosStep);
+				key.N[0] = Quantize(v.Normal.x, invNormStep);
+				key.N[1] = Quantize(v.Normal.y, invNormStep);
+				key.N[2] = Quantize(v.Normal.z, invNormStep);
+				key.T[0] = Quantize(v.TexC.x, invTexStep);
+				key.T[1] = Quantize(v.TexC.y, invTexStep);
+
+				auto it = weldMap.emplace(key, (uint32)vertices.size());
+				if(it.second)
+				{
+					vertices.push_back(v);
+					needsNormal.push_back(n < 0);
+				}
+
+				polygon.push_back(it.first->second);
+			}
+
+			// Triangulate the polygon as a fan.  Reverse the winding when flipping z so
+			// triangles stay front facing under the left handed convention.
+			auto& indices = subsetIndices[currentSubset];
+			for(size_t k = 2; k < polygon.size(); ++k)
+			{
+				uint32 i0 = polygon[0];
+				uint32 i1 = polygon[k - 1];
+				uint32 i2 = polygon[k];
+				if(i0 == i1 || i1 == i2 || i0 == i2)
+					continue;
+
+				indices.push_back(i0);
+				if(settings.ConvertToLeftHanded)
+				{
+					indices.push_back(i2);
+					indices.push_back(i1);
+				}
+				else
+				{
+					indices.push_back(i1);
+					indices.push_back(i2);
+				}
+			}
+		}
+		else if(IsKeyword(s, "usemtl", 6))
+		{
+			std::string name = TrimmedRest(s + 6);
+			auto it = subsetLookup.find(name);
+			if(it != subsetLookup.end())
+			{
+				currentSubset = it->second;
+			}
+			else
+			{
+				// Reuse the implicit default subset if nothing has been put in it yet.
+				if(subsetIndices.size() == 1 && subsetIndices[0].empty() && model.Subsets[0].MaterialName.empty())
+				{
+					currentSubset = 0;
+				}
+				else
+				{
+					currentSubset = subsetIndices.size();
+					subsetIndices.emplace_back();
+					model.Subsets.emplace_back();
+				}
+				model.Subsets[currentSubset].MaterialName = name;
+				subsetLookup[name] = currentSubset;
+			}
+		}
+		else if(IsKeyword(s, "mtllib", 6))
+		{
+			LoadMaterialLibrary(DirectoryOf(filename) + TrimmedRest(s + 6), model.Materials);
+		}
+	}
+
+	//
+	// Faces without normals get smooth area weighted normals.
+	//
+
+	bool anyMissingNormals = std::find(needsNormal.begin(), needsNormal.end(), true) != needsNormal.end();
+	if(anyMissingNormals)
+	{
+		std::vector<XMFLOAT3> accum(vertices.size(), XMFLOAT3(0.0f, 0.0f, 0.0f));
+		for(auto& indices : subsetIndices)
+		{
+			for(size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				XMVECTOR p0 = XMLoadFloat3(&vertices[indices[i + 0]].Position);
+				XMVECTOR p1 = XMLoadFloat3(&vertices[indices[i + 1]].Position);
+				XMVECTOR p2 = XMLoadFloat3(&vertices[indices[i + 2]].Position);
+
+				// Unnormalized cross product is weighted by twice the triangle area.
+				XMVECTOR faceN = XMVector3Cross(p1 - p0, p2 - p0);
+				for(int k = 0; k < 3; ++k)
+				{
+					uint32 v = indices[i + k];
+					if(needsNormal[v])
+						XMStoreFloat3(&accum[v], XMLoadFloat3(&accum[v]) + faceN);
+				}
+			}
+		}
+
+		for(size_t v = 0; v < vertices.size(); ++v)
+		{
+			if(needsNormal[v])
+				XMStoreFloat3(&vertices[v].Normal, XMVector3Normalize(XMLoadFloat3(&accum[v])));
+		}
+	}
+
+	//
+	// Concatenate the per material index lists into subsets.
+	//
+
+	size_t totalIndexCount = 0;
+	for(auto& indices : subsetIndices)
+		totalIndexCount += indices.size();
+
+	model.Mesh.Indices32.reserve(totalIndexCount);
+
+	std::vector<ObjSubset> subsets;
+	for(size_t i = 0; i < subsetIndices.size(); ++i)
+	{
+		auto& indices = subsetIndices[i];
+		if(indices.empty())
+			continue;
+
+		ObjSubset subset = model.Subsets[i];
+		subset.StartIndexLocation = (uint32)model.Mesh.Indices32.size();
+		subset.IndexCount = (uint32)indices.size();
+
+		XMVECTOR vMin = XMVectorReplicate(+FLT_MAX);
+		XMVECTOR vMax = XMVectorReplicate(-FLT_MAX);
+		for(uint32 index : indices)
+		{
+			XMVECTOR P = XMLoadFloat3(&vertices[index].Position);
+			vMin = XMVectorMin(vMin, P);
+			vMax = XMVectorMax(vMax, P);
+		}
+		XMStoreFloat3(&subset.Bounds.Center, 0.5f*(vMin + vMax));
+		XMStoreFloat3(&subset.Bounds.Extents, 0.5f*(vMax - vMin));
+
+		model.Mesh.Indices32.insert(model.Mesh.Indices32.end(), indices.begin(), indices.end());
+		subsets.push_back(subset);
+	}
+	model.Subsets = std::move(subsets);
+
+	//
+	// OBJ carries no tangent frame; generate one that matches the usual bakers.  Split
+	// vertices are appended, so the subset ranges stay valid.
+	//
+
+	TangentSpace::VertexLayout tangentLayout;
+	tangentLayout.Position = offsetof(GeometryGenerator::Vertex, Position);
+	tangentLayout.Normal = offsetof(GeometryGenerator::Vertex, Normal);
+	tangentLayout.TexC = offsetof(GeometryGenerator::Vertex, TexC);
+	tangentLayout.Tangent = offsetof(GeometryGenerator::Vertex, TangentU);
+	tangentLayout.TangentSign = offsetof(GeometryGenerator::Vertex, TangentSign);
+	TangentSpace::Generate(model.Mesh.Vertices, model.Mesh.Indices32, tangentLayout);
+
+	return !model.Mesh.Indices32.empty();
+}
+
+void ObjLoader::LoadMaterialLibrary(const std::string& filename, std::vector<ObjMaterial>& materials)
+{
+	std::unique_ptr<std::istream> stream = VirtualFileSystem::Default().Open(filename);
+	if(!stream)
+		return;
+
+	std::istream& fin = *stream;
+
+	ObjMaterial* mat = nullptr;
+	std::string line;
+	while(std::getline(fin, line))
+	{
+		const char* s = SkipSpace(line.c_str());
+		char* end = nullptr;
+
+		if(IsKeyword(s, "newmtl", 6))
+		{
+			materials.emplace_back();
+			mat = &materials.back();
+			mat->Name = TrimmedRest(s + 6);
+		}
+		else if(mat == nullptr)
+		{
+			continue;
+		}
+		else if(IsKeyword(s, "Kd", 2))
+		{
+			mat->DiffuseAlbedo.x = std::strtof(s + 2, &end);
+			mat->DiffuseAlbedo.y = std::strtof(end, &end);
+			mat->DiffuseAlbedo.z = std::strtof(end, &end);
+		}
+		else if(IsKeyword(s, "Ks", 2))
+		{
+			mat->FresnelR0.x = std::strtof(s + 2, &end);
+			mat->FresnelR0.y = std::strtof(end, &end);
+			mat->FresnelR0.z = std::strtof(end, &end);
+		}
+		else if(IsKeyword(s, "Ns", 2))
+		{
+			// Map the Phong exponent onto our roughness parameter.
+			float shininess = std::strtof(s + 2, &end);
+			mat->Roughness = sqrtf(2.0f / (std::max(shininess, 0.0f) + 2.0f));
+		}
+		else if(IsKeyword(s, "d", 1))
+		{
+			mat->DiffuseAlbedo.w = std::strtof(s + 1, &end);
+		}
+		else if(IsKeyword(s, "Tr", 2))
+		{
+			mat->DiffuseAlbedo.w = 1.0f - std::strtof(s + 2, &end);
+		}
+		else if(IsKeyword(s, "map_Kd", 6))
+		{
+			mat->DiffuseMapFile = TrimmedRest(s + 6);
+		}
+		else if(IsKeyword(s, "map_Bump", 8) || IsKeyword(s, "map_bump", 8) ||
+			IsKeyword(s, "bump", 4) || IsKeyword(s, "norm", 4))
+		{
+			// The file name is the last token; earlier tokens are options such as -bm.
+			std::string rest = TrimmedRest(s + (s[0] == 'm' ? 8 : 4));
+			size_t space = rest.find_last_of(" \t");
+			mat->NormalMapFile = space == std::string::npos ? rest : rest.substr(space + 1);
+		}
+	}
+}
@@ -0,0 +1,80 @@
+//***************************************************************************************
+// ObjLoader.h
+//
+// Streaming importer for Wavefront OBJ/MTL files.
+//   -Lines are parsed one at a time from a buffered stream so the whole file is never
+//    held in memory.  Files are opened through VirtualFileSystem, so models (and their
+//    .mtl libraries) can be loaded from inside zip archives; those are decompressed
+//    into memory first.
+//   -Face corners are welded through a hash map keyed on the quantized position,
+//    normal and texture coordinate, so the output is a properly indexed mesh.
+//   -Faces are grouped into one subset per material (usemtl) so each subset can be
+//    drawn with its own SubmeshGeometry.
+//   -Tangents are generated with TangentSpace once the mesh is converted to the
+//    engine's conventions.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <DirectXCollision.h>
+#include <string>
+#include <vector>
+
+class ObjLoader
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	struct ObjMaterial
+	{
+		std::string Name;
+
+		DirectX::XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
+		DirectX::XMFLOAT3 FresnelR0 = { 0.01f, 0.01f, 0.01f };
+		float Roughness = 0.5f;
+
+		// Texture paths relative to the directory of the .obj file.
+		std::string DiffuseMapFile;
+		std::string NormalMapFile;
+	};
+
+	// A contiguous range of the index buffer that uses one material.
+	struct ObjSubset
+	{
+		std::string MaterialName;
+		uint32 StartIndexLocation = 0;
+		uint32 IndexCount = 0;
+		DirectX::BoundingBox Bounds;
+	};
+
+	struct ObjModel
+	{
+		GeometryGenerator::MeshData Mesh;
+		std::vector<ObjSubset> Subsets;
+		std::vector<ObjMaterial> Materials;
+	};
+
+	struct ImportSettings
+	{
+		// Attributes closer than these steps are considered equal when welding.
+		float PositionWeldStep = 1.0e-5f;
+		float NormalWeldStep = 1.0f / 1024.0f;
+		float TexCWeldStep = 1.0f / 8192.0f;
+
+		// OBJ is right handed with v pointing up; the engine is left handed with v down.
+		bool ConvertToLeftHanded = true;
+		bool FlipV = true;
+	};
+
+	///<summary>
+	/// Loads filename (and any referenced .mtl libraries) into model.  Returns false if
+	/// the file could not be opened or contained no faces.
+	///</summary>
+	static bool Load(const std::string& filename, ObjModel& model);
+	static bool Load(const std::string& filename, ObjModel& model, const ImportSettings& settings);
+
+private:
+	static void LoadMaterialLibrary(const std::string& filename, std::vector<ObjMaterial>& materials);
+};
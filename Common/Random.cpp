@@ -0,0 +1,298 @@
+//***************************************************************************************
+// Random.cpp
+//***************************************************************************************
+
+#include "Random.h"
+#include "BatchMath.h"
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define RANDOM_X86 1
+#include <emmintrin.h>
+#else
+#define RANDOM_X86 0
+#endif
+
+using namespace DirectX;
+
+// In RandomAvx2.cpp, and only called once BatchMath has picked the AVX2 path.
+void Avx2RandomBlocks(Random::State& state, std::uint32_t* out, std::size_t blocks);
+void Avx2RandomBlocks(Random::State& state, float* out, std::size_t blocks);
+
+namespace
+{
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	// The top 24 bits, which are the strongest bits of xoshiro128+ and all a float in
+	// [0, 1) can hold.
+	const float FloatScale = 1.0f / 16777216.0f;
+
+	float ToFloat(uint32 x)
+	{
+		return (float)(x >> 8) * FloatScale;
+	}
+
+	uint64 SplitMix64(uint64& x)
+	{
+		uint64 z = (x += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+
+	void StoreLane(uint32* p, uint32 x) { *p = x; }
+	void StoreLane(float* p, uint32 x) { *p = ToFloat(x); }
+
+	// Block b is one xoshiro128+ step of every lane, lane j going to out[8 * b + j].
+	template<class T>
+	void ScalarBlocks(Random::State& state, T* out, std::size_t blocks)
+	{
+		for(uint32 j = 0; j < Random::Lanes; ++j)
+		{
+			uint32 s0 = state.S[0][j];
+			uint32 s1 = state.S[1][j];
+			uint32 s2 = state.S[2][j];
+			uint32 s3 = state.S[3][j];
+
+			for(std::size_t b = 0; b < blocks; ++b)
+			{
+				StoreLane(out + b * Random::Lanes + j, s0 + s3);
+
+				uint32 t = s1 << 9;
+				s2 ^= s0;
+				s3 ^= s1;
+				s1 ^= s2;
+				s0 ^= s3;
+				s2 ^= t;
+				s3 = (s3 << 11) | (s3 >> 21);
+			}
+
+			state.S[0][j] = s0;
+			state.S[1][j] = s1;
+			state.S[2][j] = s2;
+			state.S[3][j] = s3;
+		}
+	}
+
+#if RANDOM_X86
+	void StoreLanes(uint32* p, __m128i x)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(p), x);
+	}
+
+	void StoreLanes(float* p, __m128i x)
+	{
+		_mm_storeu_ps(p, _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(x, 8)), _mm_set1_ps(FloatScale)));
+	}
+
+	// The same steps, lanes 0-3 and then 4-7 in one register each.
+	template<class T>
+	void SseBlocks(Random::State& state, T* out, std::size_t blocks)
+	{
+		for(uint32 half = 0; half < Random::Lanes; half += 4)
+		{
+			__m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state.S[0][half]));
+			__m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state.S[1][half]));
+			__m128i s2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state.S[2][half]));
+			__m128i s3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&state.S[3][half]));
+
+			for(std::size_t b = 0; b < blocks; ++b)
+			{
+				StoreLanes(out + b * Random::Lanes + half, _mm_add_epi32(s0, s3));
+
+				__m128i t = _mm_slli_epi32(s1, 9);
+				s2 = _mm_xor_si128(s2, s0);
+				s3 = _mm_xor_si128(s3, s1);
+				s1 = _mm_xor_si128(s1, s2);
+				s0 = _mm_xor_si128(s0, s3);
+				s2 = _mm_xor_si128(s2, t);
+				s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+			}
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&state.S[0][half]), s0);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&state.S[1][half]), s1);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&state.S[2][half]), s2);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&state.S[3][half]), s3);
+		}
+	}
+#endif
+
+	// The lanes are independent, so every path writes the same numbers.
+	template<class T>
+	void Blocks(Random::State& state, T* out, std::size_t blocks)
+	{
+		if(blocks == 0)
+			return;
+
+		switch(BatchMath::ActivePath())
+		{
+#if RANDOM_X86
+		case BatchMath::Path::Avx2:
+			Avx2RandomBlocks(state, out, blocks);
+			break;
+		case BatchMath::Path::Sse:
+			SseBlocks(state, out, blocks);
+			break;
+#endif
+		default:
+			ScalarBlocks(state, out, blocks);
+			break;
+		}
+	}
+}
+
+Random::Random(uint64 seed, uint64 stream)
+{
+	Seed(seed, stream);
+}
+
+void Random::Seed(uint64 seed, uint64 stream)
+{
+	// SplitMix64 spreads the seed and stream over the 256 bits of state, as the
+	// xoshiro authors recommend.
+	uint64 streamKey = stream;
+	uint64 x = seed ^ SplitMix64(streamKey);
+
+	for(uint32 j = 0; j < Lanes; ++j)
+	{
+		for(uint32 k = 0; k < 4; k += 2)
+		{
+			uint64 v = SplitMix64(x);
+			mState.S[k][j] = (uint32)v;
+			mState.S[k + 1][j] = (uint32)(v >> 32);
+		}
+
+		// A lane whose state is all zero would only ever return zero.
+		if((mState.S[0][j] | mState.S[1][j] | mState.S[2][j] | mState.S[3][j]) == 0)
+			mState.S[0][j] = 1;
+	}
+
+	mNext = Lanes;
+}
+
+Random& Random::ThreadLocal()
+{
+	static std::atomic<uint64> nextStream(0);
+	thread_local Random random(DefaultSeed, nextStream++);
+	return random;
+}
+
+Random::uint32 Random::NextUInt()
+{
+	if(mNext == Lanes)
+	{
+		Blocks(mState, mBuffer, 1);
+		mNext = 0;
+	}
+
+	return mBuffer[mNext++];
+}
+
+float Random::NextFloat()
+{
+	return ToFloat(NextUInt());
+}
+
+float Random::NextFloat(float a, float b)
+{
+	return a + NextFloat()*(b - a);
+}
+
+int Random::NextInt(int a, int b)
+{
+	// Scales a 32 bit number to the range with a multiply (Lemire) instead of a modulo.
+	// The bias is at most range / 2^32.
+	uint64 range = (uint64)((std::int64_t)b - a) + 1;
+	return (int)(a + (std::int64_t)(((uint64)NextUInt() * range) >> 32));
+}
+
+void Random::Fill(float* out, std::size_t count)
+{
+	// Finish the block NextUInt started, so single calls and fills share one stream.
+	std::size_t i = 0;
+	for(; i < count && mNext < Lanes; ++i)
+		out[i] = ToFloat(mBuffer[mNext++]);
+
+	std::size_t blocks = (count - i) / Lanes;
+	Blocks(mState, out + i, blocks);
+	i += blocks * Lanes;
+
+	for(; i < count; ++i)
+		out[i] = NextFloat();
+}
+
+void Random::Fill(float* out, std::size_t count, float a, float b)
+{
+	Fill(out, count);
+
+	float scale = b - a;
+	for(std::size_t i = 0; i < count; ++i)
+		out[i] = a + out[i] * scale;
+}
+
+void Random::FillUnitVectors(XMFLOAT3* out, std::size_t count)
+{
+	FillVectors(out, count, nullptr);
+}
+
+void Random::FillHemisphereVectors(XMFLOAT3* out, std::size_t count, const XMFLOAT3& n)
+{
+	FillVectors(out, count, &n);
+}
+
+void Random::FillVectors(XMFLOAT3* out, std::size_t count, const XMFLOAT3* n)
+{
+	const std::size_t Chunk = 64;
+
+	XMVECTOR one = XMVectorSplatOne();
+	XMVECTOR negOne = XMVectorNegate(one);
+	XMVECTOR normal = n != nullptr ? XMLoadFloat3(n) : XMVectorZero();
+
+	// Two uniforms per vector, z then the angle around z.  The padding lets the last
+	// group of four read past count.
+	float uniform[2 * Chunk + 4] = {};
+
+	for(std::size_t start = 0; start < count; start += Chunk)
+	{
+		std::size_t chunk = count - start < Chunk ? count - start : Chunk;
+		Fill(uniform, 2 * chunk);
+
+		for(std::size_t i = 0; i < chunk; i += 4)
+		{
+			XMVECTOR z = XMVectorMultiplyAdd(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&uniform[i])),
+				XMVectorReplicate(2.0f), negOne);
+			XMVECTOR angle = XMVectorScale(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&uniform[chunk + i])), XM_2PI);
+
+			XMVECTOR r = XMVectorSqrt(XMVectorMax(XMVectorZero(), XMVectorNegativeMultiplySubtract(z, z, one)));
+			XMVECTOR sinAngle, cosAngle;
+			XMVectorSinCos(&sinAngle, &cosAngle, angle);
+
+			XMVECTOR x = XMVectorMultiply(r, cosAngle);
+			XMVECTOR y = XMVectorMultiply(r, sinAngle);
+
+			if(n != nullptr)
+			{
+				// Mirroring keeps the distribution even: both halves map onto the same
+				// hemisphere with the same density.
+				XMVECTOR d = XMVectorMultiplyAdd(x, XMVectorSplatX(normal),
+					XMVectorMultiplyAdd(y, XMVectorSplatY(normal), XMVectorMultiply(z, XMVectorSplatZ(normal))));
+				XMVECTOR sign = XMVectorSelect(one, negOne, XMVectorLess(d, XMVectorZero()));
+				x = XMVectorMultiply(x, sign);
+				y = XMVectorMultiply(y, sign);
+				z = XMVectorMultiply(z, sign);
+			}
+
+			XMFLOAT4 xs, ys, zs;
+			XMStoreFloat4(&xs, x);
+			XMStoreFloat4(&ys, y);
+			XMStoreFloat4(&zs, z);
+
+			const float* px = &xs.x;
+			const float* py = &ys.x;
+			const float* pz = &zs.x;
+			for(std::size_t j = 0; j < 4 && i + j < chunk; ++j)
+				out[start + i + j] = XMFLOAT3(px[j], py[j], pz[j]);
+		}
+	}
+}
@@ -0,0 +1,96 @@
+//***************************************************************************************
+// Random.h
+//
+// A fast random number generator to use instead of rand(): xoshiro128+ run as eight
+// independent lanes, so one AVX2 step (or two SSE steps) makes eight numbers.  The
+// lanes are interleaved into a single stream that is the same on every path, so a seed
+// gives the same numbers on every CPU.
+//
+// Instances share nothing.  Work that runs in parallel and must be reproducible (baking,
+// particles) gives each task its own Random(seed, stream) with the task index as the
+// stream.  ThreadLocal() is the calling thread's own generator, for code that just needs
+// a few numbers; MathHelper::RandF and Rand use it.
+//
+// The batch functions fill arrays a block at a time and are much faster than a loop of
+// single calls.  Mixing the two is fine: both take their numbers from the same stream.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+
+class Random
+{
+public:
+
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	static const uint64 DefaultSeed = 0x853C49E6748FEA9BULL;
+
+	///<summary>
+	/// Stream number stream of seed.  Different streams of one seed are independent.
+	///</summary>
+	explicit Random(uint64 seed = DefaultSeed, uint64 stream = 0);
+
+	void Seed(uint64 seed, uint64 stream = 0);
+
+	///<summary>
+	/// The calling thread's generator.  Threads get streams of DefaultSeed in the order
+	/// they first call this, so a single thread sees the same numbers on every run.
+	///</summary>
+	static Random& ThreadLocal();
+
+	uint32 NextUInt();
+
+	// Returns random float in [0, 1).
+	float NextFloat();
+
+	// Returns random float in [a, b).
+	float NextFloat(float a, float b);
+
+	// Returns random int in [a, b].
+	int NextInt(int a, int b);
+
+	///<summary>
+	/// out[i] = NextFloat() or NextFloat(a, b) for count floats.
+	///</summary>
+	void Fill(float* out, std::size_t count);
+	void Fill(float* out, std::size_t count, float a, float b);
+
+	///<summary>
+	/// Unit vectors spread evenly over the sphere, four at a time: z is uniform in
+	/// [-1, 1] and the angle around z is uniform, which needs no rejection loop.
+	///</summary>
+	void FillUnitVectors(DirectX::XMFLOAT3* out, std::size_t count);
+
+	///<summary>
+	/// Unit vectors spread evenly over the hemisphere around n, which need not be
+	/// normalized.  Sphere samples below the hemisphere are mirrored into it.
+	///</summary>
+	void FillHemisphereVectors(DirectX::XMFLOAT3* out, std::size_t count, const DirectX::XMFLOAT3& n);
+
+	static const uint32 Lanes = 8;
+
+	///<summary>
+	/// The state of the eight lanes, one word of every lane per row.  Thread local and
+	/// heap storage need not honour the alignment, so the kernels load and store it
+	/// unaligned.
+	///</summary>
+	struct State
+	{
+		alignas(32) uint32 S[4][Lanes];
+	};
+
+private:
+
+	void FillVectors(DirectX::XMFLOAT3* out, std::size_t count, const DirectX::XMFLOAT3* n);
+
+	State mState;
+
+	// The rest of the last block NextUInt took, from mBuffer[mNext].
+	uint32 mBuffer[Lanes];
+	uint32 mNext = Lanes;
+};
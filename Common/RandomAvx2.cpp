@@ -0,0 +1,86 @@
+//***************************************************************************************
+// RandomAvx2.cpp
+//
+// The AVX2 path of Random: all eight lanes in one register.  Compiled for AVX2 the same
+// way as BatchMathAvx2.cpp, and only called after BatchMath has checked the CPU.
+//***************************************************************************************
+
+#include "Random.h"
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+#define RANDOM_TARGET_PRAGMA 1
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+namespace
+{
+	void StoreLanes(std::uint32_t* p, __m256i x)
+	{
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x);
+	}
+
+	void StoreLanes(float* p, __m256i x)
+	{
+		_mm256_storeu_ps(p, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(x, 8)),
+			_mm256_set1_ps(1.0f / 16777216.0f)));
+	}
+
+	template<class T>
+	void Blocks(Random::State& state, T* out, std::size_t blocks)
+	{
+		__m256i s0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state.S[0]));
+		__m256i s1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state.S[1]));
+		__m256i s2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state.S[2]));
+		__m256i s3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(state.S[3]));
+
+		for(std::size_t b = 0; b < blocks; ++b)
+		{
+			StoreLanes(out + b * Random::Lanes, _mm256_add_epi32(s0, s3));
+
+			__m256i t = _mm256_slli_epi32(s1, 9);
+			s2 = _mm256_xor_si256(s2, s0);
+			s3 = _mm256_xor_si256(s3, s1);
+			s1 = _mm256_xor_si256(s1, s2);
+			s0 = _mm256_xor_si256(s0, s3);
+			s2 = _mm256_xor_si256(s2, t);
+			s3 = _mm256_or_si256(_mm256_slli_epi32(s3, 11), _mm256_srli_epi32(s3, 21));
+		}
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(state.S[0]), s0);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(state.S[1]), s1);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(state.S[2]), s2);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(state.S[3]), s3);
+	}
+}
+
+void Avx2RandomBlocks(Random::State& state, std::uint32_t* out, std::size_t blocks)
+{
+	Blocks(state, out, blocks);
+}
+
+void Avx2RandomBlocks(Random::State& state, float* out, std::size_t blocks)
+{
+	Blocks(state, out, blocks);
+}
+
+#endif
+
+#if defined(RANDOM_TARGET_PRAGMA)
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+#endif
@@ -0,0 +1,392 @@
+//***************************************************************************************
+// ShaderCache.cpp
+//***************************************************************************************
+
+#include "ShaderCache.h"
+#include "FileUtil.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	const uint32 Magic = 0x30435348;	// "HSC0"
+	const uint32 Version = 1;
+
+#pragma pack(push, 1)
+
+	struct FileHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 EntryCount;
+		uint32 Reserved;
+	};
+
+	// Sorted by key.  Offsets are from the start of the file.
+	struct FileEntry
+	{
+		uint64 Key;
+		uint64 Offset;
+		uint64 Size;
+	};
+
+#pragma pack(pop)
+
+	std::wstring DirectoryOf(const std::wstring& filename)
+	{
+		std::size_t slash = filename.find_last_of(L"/\\");
+		return slash == std::wstring::npos ? std::wstring() : filename.substr(0, slash + 1);
+	}
+
+	bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t';
+	}
+
+	// Names of the files source #includes, in order.  Preprocessor conditions are not
+	// evaluated, so an include in a disabled block still counts toward the key.
+	std::vector<std::string> ParseIncludes(const std::vector<uint8>& source)
+	{
+		std::vector<std::string> includes;
+
+		const char* s = reinterpret_cast<const char*>(source.data());
+		const char* end = s + source.size();
+		while(s < end)
+		{
+			const char* lineEnd = std::find(s, end, '\n');
+
+			const char* p = s;
+			while(p < lineEnd && IsSpace(*p))
+				++p;
+
+			if(p < lineEnd && *p == '#')
+			{
+				++p;
+				while(p < lineEnd && IsSpace(*p))
+					++p;
+
+				if(lineEnd - p > 7 && std::strncmp(p, "include", 7) == 0)
+				{
+					p += 7;
+					while(p < lineEnd && IsSpace(*p))
+						++p;
+
+					if(p < lineEnd && (*p == '"' || *p == '<'))
+					{
+						char close = *p == '"' ? '"' : '>';
+						const char* nameEnd = std::find(p + 1, lineEnd, close);
+						if(nameEnd < lineEnd)
+							includes.emplace_back(p + 1, nameEnd);
+					}
+				}
+			}
+
+			s = lineEnd + 1;
+		}
+
+		return includes;
+	}
+
+	bool IsIdentifierChar(char c)
+	{
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+	}
+
+	// Whether name appears in source as a whole identifier.
+	bool Mentions(const std::vector<uint8>& source, const std::string& name)
+	{
+		if(name.empty())
+			return false;
+
+		const char* begin = reinterpret_cast<const char*>(source.data());
+		const char* end = begin + source.size();
+		for(const char* s = begin; ; ++s)
+		{
+			s = std::search(s, end, name.begin(), name.end());
+			if(s == end)
+				return false;
+
+			const char* after = s + name.size();
+			if((s == begin || !IsIdentifierChar(s[-1])) && (after == end || !IsIdentifierChar(*after)))
+				return true;
+		}
+	}
+}
+
+ShaderCache::ShaderCache(const std::wstring& filename, Compiler compiler) :
+	mFilename(filename),
+	mCompiler(std::move(compiler))
+{
+	// A missing or unreadable file just means every shader is compiled this time.
+	LoadFile();
+}
+
+bool ShaderCache::Compile(const std::wstring& filename, const std::vector<Define>& defines,
+	const std::string& entryPoint, const std::string& target,
+	std::vector<std::uint8_t>& bytecode, std::string& errors, bool* cached)
+{
+	errors.clear();
+	if(cached != nullptr)
+		*cached = false;
+
+	uint64 key = 0;
+	if(!Key(filename, defines, entryPoint, target, key))
+	{
+		errors = "Cannot read " + std::string(filename.begin(), filename.end()) + "\n";
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		auto it = mUsed.find(key);
+		bool hit = it != mUsed.end();
+		if(hit)
+		{
+			bytecode = it->second;
+		}
+		else if(FindStored(key, bytecode))
+		{
+			mUsed.emplace(key, bytecode);
+			hit = true;
+		}
+
+		if(hit)
+		{
+			if(cached != nullptr)
+				*cached = true;
+			return true;
+		}
+	}
+
+	// Compile outside the lock so misses on several threads overlap.
+	bytecode.clear();
+	if(!mCompiler.Compile(filename, defines, entryPoint, target, bytecode, errors))
+		return false;
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	mUsed[key] = bytecode;
+	mDirty = true;
+	return true;
+}
+
+bool ShaderCache::Save()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	if(!mDirty)
+		return true;
+
+	std::vector<uint64> keys;
+	keys.reserve(mUsed.size());
+	for(auto& used : mUsed)
+		keys.push_back(used.first);
+	std::sort(keys.begin(), keys.end());
+
+	FileHeader header;
+	header.Magic = Magic;
+	header.Version = Version;
+	header.EntryCount = (uint32)keys.size();
+	header.Reserved = 0;
+
+	std::vector<FileEntry> entries(keys.size());
+	uint64 offset = sizeof(FileHeader) + entries.size() * sizeof(FileEntry);
+	for(std::size_t i = 0; i < keys.size(); ++i)
+	{
+		entries[i].Key = keys[i];
+		entries[i].Offset = offset;
+		entries[i].Size = mUsed[keys[i]].size();
+		offset += entries[i].Size;
+	}
+
+	std::vector<FileUtil::Piece> pieces;
+	pieces.reserve(keys.size() + 2);
+	pieces.push_back({ &header, sizeof(header) });
+	pieces.push_back({ entries.data(), entries.size() * sizeof(FileEntry) });
+	for(uint64 key : keys)
+	{
+		const std::vector<uint8>& bytecode = mUsed[key];
+		pieces.push_back({ bytecode.data(), bytecode.size() });
+	}
+
+	if(!FileUtil::WriteFileAtomic(mFilename, pieces))
+		return false;
+
+	mDirty = false;
+	return true;
+}
+
+bool ShaderCache::Key(const std::wstring& filename, const std::vector<Define>& defines,
+	const std::string& entryPoint, const std::string& target, uint64& key)
+{
+	if(ReadSource(filename) == nullptr)
+		return false;
+
+	DerivedDataCache::KeyBuilder builder;
+	builder.Add(mCompiler.Version).Add(entryPoint).Add(target);
+
+	std::vector<std::wstring> visited;
+	AddIncludeClosure(filename, visited, builder);
+
+	// A define none of the files mention cannot change what the compiler sees, so
+	// permutations that differ only in those share an entry.  Order does not matter
+	// either.
+	std::vector<const Define*> used;
+	for(const Define& define : defines)
+	{
+		for(const std::wstring& path : visited)
+		{
+			const std::vector<uint8>* source = ReadSource(path);
+			if(source != nullptr && Mentions(*source, define.Name))
+			{
+				used.push_back(&define);
+				break;
+			}
+		}
+	}
+	std::stable_sort(used.begin(), used.end(), [](const Define* a, const Define* b) { return a->Name < b->Name; });
+
+	builder.Add((uint64)used.size());
+	for(const Define* define : used)
+		builder.Add(define->Name).Add(define->Value);
+
+	key = builder.Key();
+	return true;
+}
+
+bool ShaderCache::FindStored(uint64 key, std::vector<std::uint8_t>& bytecode)const
+{
+	if(mStoredCount == 0)
+		return false;
+
+	const uint8* table = mFile.data() + sizeof(FileHeader);
+
+	// Binary search the sorted table in place.
+	uint32 first = 0;
+	uint32 count = mStoredCount;
+	while(count > 0)
+	{
+		uint32 half = count / 2;
+		FileEntry entry;
+		std::memcpy(&entry, table + (std::size_t)(first + half) * sizeof(FileEntry), sizeof(entry));
+		if(entry.Key < key)
+		{
+			first += half + 1;
+			count -= half + 1;
+		}
+		else
+		{
+			count = half;
+		}
+	}
+
+	if(first == mStoredCount)
+		return false;
+
+	FileEntry entry;
+	std::memcpy(&entry, table + (std::size_t)first * sizeof(FileEntry), sizeof(entry));
+	if(entry.Key != key)
+		return false;
+
+	const uint8* data = mFile.data() + entry.Offset;
+	bytecode.assign(data, data + entry.Size);
+	return true;
+}
+
+const std::vector<std::uint8_t>* ShaderCache::ReadSource(const std::wstring& filename)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		auto it = mSources.find(filename);
+		if(it != mSources.end())
+			return &it->second;
+	}
+
+	std::vector<uint8> bytes;
+	if(!FileUtil::ReadFile(filename, bytes))
+		return nullptr;
+
+	// Two threads may read the same file; the first one stored wins.  Map nodes never
+	// move, so the pointer stays valid.
+	std::lock_guard<std::mutex> lock(mMutex);
+	return &mSources.emplace(filename, std::move(bytes)).first->second;
+}
+
+void ShaderCache::AddIncludeClosure(const std::wstring& filename, std::vector<std::wstring>& visited,
+	DerivedDataCache::KeyBuilder& key)
+{
+	// Each file counts once, like a header with an include guard.
+	if(std::find(visited.begin(), visited.end(), filename) != visited.end())
+		return;
+	visited.push_back(filename);
+
+	const std::vector<uint8>* source = ReadSource(filename);
+	if(source == nullptr)
+	{
+		// The compiler will fail on it too; the key only has to be stable.
+		key.Add(std::string("<missing>"));
+		return;
+	}
+
+	key.Add(source->data(), source->size());
+
+	// Quoted includes resolve against the including file's directory first, then the
+	// directory of the file being compiled.
+	for(const std::string& include : ParseIncludes(*source))
+	{
+		std::wstring name(include.begin(), include.end());
+		std::wstring path = DirectoryOf(filename) + name;
+		if(ReadSource(path) == nullptr)
+			path = DirectoryOf(visited.front()) + name;
+
+		AddIncludeClosure(path, visited, key);
+	}
+}
+
+bool ShaderCache::LoadFile()
+{
+	mStoredCount = 0;
+	if(!FileUtil::ReadFile(mFilename, mFile))
+	{
+		mFile.clear();
+		return false;
+	}
+
+	const uint8* data = mFile.data();
+	uint64 size = mFile.size();
+
+	FileHeader header;
+	if(size < sizeof(header))
+	{
+		mFile.clear();
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(header));
+
+	if(header.Magic != Magic || header.Version != Version ||
+		header.EntryCount > (size - sizeof(header)) / sizeof(FileEntry))
+	{
+		mFile.clear();
+		return false;
+	}
+
+	// Check every entry up front so lookups can trust the table.
+	const uint8* table = data + sizeof(header);
+	for(uint32 i = 0; i < header.EntryCount; ++i)
+	{
+		FileEntry entry;
+		std::memcpy(&entry, table + (std::size_t)i * sizeof(FileEntry), sizeof(entry));
+		if(entry.Offset > size || entry.Size > size - entry.Offset)
+		{
+			mFile.clear();
+			return false;
+		}
+	}
+
+	mStoredCount = header.EntryCount;
+	return true;
+}
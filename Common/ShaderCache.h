@@ -0,0 +1,113 @@
+//***************************************************************************************
+// ShaderCache.h
+//
+// Persistent cache of compiled shader bytecode, so launches after the first do not
+// recompile every shader.  An entry's key covers the bytes of the source file and of
+// every file it #includes (followed recursively), the defines, the entry point, the
+// target and the compiler's version string, so editing Common.hlsl, adding a define or
+// upgrading the compiler each make a new key.  Defines whose names appear in none of
+// those files are left out of the key, since they cannot change the preprocessed source;
+// permutations that differ only in such defines share one entry.
+//
+// All entries live in one file, which is read into memory when the cache is created;
+// hits are copied straight out of it.  Save rewrites the file when something was
+// compiled, keeping only the entries this run asked for, so stale bytecode does not
+// pile up.  The file goes through FileUtil, so the cache itself is platform independent.
+//
+// The compiler itself is a pluggable backend (d3dUtil::ShaderCompiler for FXC), so the
+// cache can run with any compiler, or a stub, that produces bytes from a file.
+// Compile may be called from several threads at once.
+//***************************************************************************************
+
+#pragma once
+
+#include "DerivedDataCache.h"
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ShaderCache
+{
+public:
+
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	struct Define
+	{
+		std::string Name;
+		std::string Value;
+	};
+
+	struct Compiler
+	{
+		// Names the compiler, its version and the flags it compiles with.  Part of every
+		// key, so change it whenever the compiler's output would change.
+		std::string Version;
+
+		// Compiles entryPoint of the file for target into bytecode.  errors receives the
+		// compiler's messages, warnings included, whether or not it succeeds.
+		std::function<bool(const std::wstring& filename, const std::vector<Define>& defines,
+			const std::string& entryPoint, const std::string& target,
+			std::vector<std::uint8_t>& bytecode, std::string& errors)> Compile;
+	};
+
+	///<summary>
+	/// Reads the cache file at filename if there is a valid one, otherwise starts empty.
+	///</summary>
+	ShaderCache(const std::wstring& filename, Compiler compiler);
+
+	ShaderCache(const ShaderCache& rhs) = delete;
+	ShaderCache& operator=(const ShaderCache& rhs) = delete;
+
+	///<summary>
+	/// The bytecode of entryPoint in the file, from the cache when nothing it depends on
+	/// changed, otherwise from the compiler.  Returns false if compiling fails; errors
+	/// then holds the compiler's messages.  cached is set to whether it was a hit.
+	///</summary>
+	bool Compile(const std::wstring& filename, const std::vector<Define>& defines,
+		const std::string& entryPoint, const std::string& target,
+		std::vector<std::uint8_t>& bytecode, std::string& errors, bool* cached = nullptr);
+
+	///<summary>
+	/// Writes the entries used since the cache was created back to its file, if any of
+	/// them had to be compiled.  Returns false if the file could not be written.
+	///</summary>
+	bool Save();
+
+	///<summary>
+	/// The key of a compilation: the source and its #include closure, the defines the
+	/// closure mentions, the entry point, the target and the compiler version.  Two
+	/// compilations with the same key produce the same bytecode.  Returns false if the
+	/// source file cannot be read.
+	///</summary>
+	bool Key(const std::wstring& filename, const std::vector<Define>& defines,
+		const std::string& entryPoint, const std::string& target, uint64& key);
+
+private:
+	bool FindStored(uint64 key, std::vector<std::uint8_t>& bytecode)const;
+	const std::vector<std::uint8_t>* ReadSource(const std::wstring& filename);
+	void AddIncludeClosure(const std::wstring& filename, std::vector<std::wstring>& visited,
+		DerivedDataCache::KeyBuilder& key);
+	bool LoadFile();
+
+	std::wstring mFilename;
+	Compiler mCompiler;
+
+	// The cache file as it was when the cache was created, and its number of entries
+	// (zero if it was missing or invalid).
+	std::vector<std::uint8_t> mFile;
+	uint32 mStoredCount = 0;
+
+	std::mutex mMutex;
+
+	// Bytecode used this run, hits and compiles alike, which Save writes out.
+	std::unordered_map<uint64, std::vector<std::uint8_t>> mUsed;
+	bool mDirty = false;
+
+	// Sources read for keys; headers like Common.hlsl are shared by most shaders.
+	std::unordered_map<std::wstring, std::vector<std::uint8_t>> mSources;
+};
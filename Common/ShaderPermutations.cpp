@@ -0,0 +1,140 @@
+//***************************************************************************************
+// ShaderPermutations.cpp
+//***************************************************************************************
+
+#include "ShaderPermutations.h"
+#include "ThreadPool.h"
+
+namespace
+{
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+}
+
+ShaderPermutations::ShaderPermutations(ShaderCache& cache) :
+	mCache(cache)
+{
+}
+
+void ShaderPermutations::Add(const std::string& key, const std::wstring& filename, const std::string& entryPoint,
+	const std::string& target, const std::vector<ShaderCache::Define>& defines)
+{
+	Permutation permutation;
+	permutation.Key = key;
+	permutation.Filename = filename;
+	permutation.EntryPoint = entryPoint;
+	permutation.Target = target;
+	permutation.Defines = defines;
+
+	auto it = mIndices.find(key);
+	if(it != mIndices.end())
+	{
+		mPermutations[it->second] = std::move(permutation);
+		return;
+	}
+
+	mIndices.emplace(key, (uint32)mPermutations.size());
+	mPermutations.push_back(std::move(permutation));
+}
+
+ShaderPermutations::BuildReport ShaderPermutations::Build(std::string& errors)
+{
+	errors.clear();
+	BuildReport report;
+
+	std::vector<uint32> pending;
+	for(uint32 i = 0; i < (uint32)mPermutations.size(); ++i)
+	{
+		if(mPermutations[i].Bytecode.empty())
+			pending.push_back(i);
+	}
+
+	if(pending.empty())
+		return report;
+
+	ThreadPool& pool = ThreadPool::Default();
+
+	// Keys hash the include closure of each source; headers are read once and shared.
+	std::vector<uint64> keys(pending.size());
+	std::vector<uint8> readable(pending.size());
+	pool.ParallelFor((uint32)pending.size(), 1, [&](uint32 begin, uint32 end)
+	{
+		for(uint32 i = begin; i < end; ++i)
+		{
+			const Permutation& p = mPermutations[pending[i]];
+			readable[i] = mCache.Key(p.Filename, p.Defines, p.EntryPoint, p.Target, keys[i]);
+		}
+	});
+
+	// The first permutation with a key compiles it; the others copy its bytecode.
+	std::vector<uint32> unique;
+	std::vector<uint32> source(pending.size());
+	std::unordered_map<uint64, uint32> firstWithKey;
+	for(uint32 i = 0; i < (uint32)pending.size(); ++i)
+	{
+		if(!readable[i])
+		{
+			source[i] = i;
+			unique.push_back(i);
+			continue;
+		}
+
+		auto inserted = firstWithKey.emplace(keys[i], i);
+		source[i] = inserted.first->second;
+		if(inserted.second)
+			unique.push_back(i);
+	}
+
+	// Compiles are long and uneven, so one per chunk.
+	std::vector<std::string> messages(pending.size());
+	std::vector<uint8> compiled(pending.size());
+	std::vector<uint8> cached(pending.size());
+	pool.ParallelFor((uint32)unique.size(), 1, [&](uint32 begin, uint32 end)
+	{
+		for(uint32 u = begin; u < end; ++u)
+		{
+			uint32 i = unique[u];
+			Permutation& p = mPermutations[pending[i]];
+
+			bool hit = false;
+			compiled[i] = mCache.Compile(p.Filename, p.Defines, p.EntryPoint, p.Target, p.Bytecode, messages[i], &hit);
+			cached[i] = hit;
+
+			if(!compiled[i])
+				p.Bytecode.clear();
+		}
+	});
+
+	for(uint32 i = 0; i < (uint32)pending.size(); ++i)
+	{
+		Permutation& p = mPermutations[pending[i]];
+		if(source[i] != i)
+		{
+			p.Bytecode = mPermutations[pending[source[i]]].Bytecode;
+			compiled[i] = compiled[source[i]];
+		}
+		else
+		{
+			++report.Unique;
+			if(cached[i])
+				++report.Cached;
+			if(!messages[i].empty())
+				errors += p.Key + ": " + messages[i];
+		}
+
+		if(!compiled[i])
+			++report.Failed;
+	}
+
+	return report;
+}
+
+const std::vector<std::uint8_t>* ShaderPermutations::Find(const std::string& key)const
+{
+	auto it = mIndices.find(key);
+	if(it == mIndices.end() || mPermutations[it->second].Bytecode.empty())
+		return nullptr;
+
+	return &mPermutations[it->second].Bytecode;
+}
@@ -0,0 +1,84 @@
+//***************************************************************************************
+// ShaderPermutations.h
+//
+// Compiles the shader permutations an app declares up front, all at once:
+//   -Each permutation is a file, entry point, target and define set, declared under a
+//    key the app looks its bytecode up by ("standardVS", "shadowAlphaTestedPS", ...).
+//   -Permutations that would compile the same preprocessed source are found through
+//    their ShaderCache keys, which ignore defines the source never mentions, and are
+//    compiled once.
+//   -The unique permutations are compiled in parallel on ThreadPool::Default(), through
+//    the ShaderCache, so after the first launch they are mostly cache hits.
+//
+// Declaring another feature toggle therefore costs its new unique variants spread over
+// the pool, not another serial compile per shader.
+//***************************************************************************************
+
+#pragma once
+
+#include "ShaderCache.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ShaderPermutations
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	struct Permutation
+	{
+		std::string Key;
+		std::wstring Filename;
+		std::string EntryPoint;
+		std::string Target;
+		std::vector<ShaderCache::Define> Defines;
+
+		std::vector<std::uint8_t> Bytecode;
+	};
+
+	struct BuildReport
+	{
+		// Permutations left after removing duplicates, and how many of them came from
+		// the cache.
+		uint32 Unique = 0;
+		uint32 Cached = 0;
+
+		// Declared permutations without bytecode.
+		uint32 Failed = 0;
+	};
+
+	///<summary>
+	/// cache must outlive the permutations.
+	///</summary>
+	explicit ShaderPermutations(ShaderCache& cache);
+
+	ShaderPermutations(const ShaderPermutations& rhs) = delete;
+	ShaderPermutations& operator=(const ShaderPermutations& rhs) = delete;
+
+	///<summary>
+	/// Declares the permutation key.  Declaring a key again replaces it.
+	///</summary>
+	void Add(const std::string& key, const std::wstring& filename, const std::string& entryPoint,
+		const std::string& target, const std::vector<ShaderCache::Define>& defines = {});
+
+	///<summary>
+	/// Compiles every declared permutation that has no bytecode yet.  errors receives
+	/// the messages of every compile, each prefixed with the key it belongs to.
+	///</summary>
+	BuildReport Build(std::string& errors);
+
+	///<summary>
+	/// The bytecode of key, or nullptr if it was not declared or failed to compile.
+	///</summary>
+	const std::vector<std::uint8_t>* Find(const std::string& key)const;
+
+	const std::vector<Permutation>& All()const { return mPermutations; }
+
+private:
+	ShaderCache& mCache;
+
+	std::vector<Permutation> mPermutations;
+	std::unordered_map<std::string, uint32> mIndices;
+};
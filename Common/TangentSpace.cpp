@@ -0,0 +1,362 @@
+//***************************************************************************************
+// TangentSpace.cpp
+//***************************************************************************************
+
+#include "TangentSpace.h"
+#include "Hash.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	const uint32 InvalidIndex = 0xffffffff;
+	const uint32 GrainSize = 4096;
+
+	struct Float2
+	{
+		float x, y;
+	};
+
+	struct Float3
+	{
+		float x, y, z;
+	};
+
+	Float3 operator+(const Float3& a, const Float3& b)
+	{
+		return { a.x + b.x, a.y + b.y, a.z + b.z };
+	}
+
+	Float3 operator-(const Float3& a, const Float3& b)
+	{
+		return { a.x - b.x, a.y - b.y, a.z - b.z };
+	}
+
+	Float3 operator*(const Float3& a, float s)
+	{
+		return { a.x * s, a.y * s, a.z * s };
+	}
+
+	float Dot(const Float3& a, const Float3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	Float3 Cross(const Float3& a, const Float3& b)
+	{
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	// The reference implementation's test for a usable length or area.
+	bool NotZero(float x)
+	{
+		return std::fabs(x) > FLT_MIN;
+	}
+
+	Float3 NormalizeIfNotZero(const Float3& v)
+	{
+		float length = std::sqrt(Dot(v, v));
+		return NotZero(length) ? v * (1.0f / length) : v;
+	}
+
+	// Component of v perpendicular to the unit vector n.
+	Float3 ProjectOntoPlane(const Float3& v, const Float3& n)
+	{
+		return v - n * Dot(n, v);
+	}
+
+	// Any unit vector perpendicular to n.
+	Float3 AnyPerpendicular(const Float3& n)
+	{
+		Float3 up = { 0.0f, 1.0f, 0.0f };
+		if(std::fabs(Dot(n, up)) > 1.0f - 0.001f)
+			up = { 0.0f, 0.0f, 1.0f };
+		return NormalizeIfNotZero(Cross(up, n));
+	}
+
+	class VertexReader
+	{
+	public:
+		VertexReader(const void* vertices, std::size_t stride, const TangentSpace::VertexLayout& layout) :
+			mBytes(static_cast<const unsigned char*>(vertices)), mStride(stride), mLayout(layout)
+		{
+		}
+
+		Float3 Position(uint32 v)const { return Read<Float3>(v, mLayout.Position); }
+		Float3 Normal(uint32 v)const { return Read<Float3>(v, mLayout.Normal); }
+		Float2 TexC(uint32 v)const { return Read<Float2>(v, mLayout.TexC); }
+
+	private:
+		template<class T>
+		T Read(uint32 v, std::size_t offset)const
+		{
+			T value;
+			std::memcpy(&value, mBytes + v * mStride + offset, sizeof(T));
+			return value;
+		}
+
+		const unsigned char* mBytes;
+		std::size_t mStride;
+		TangentSpace::VertexLayout mLayout;
+	};
+
+	///<summary>
+	/// Assigns every vertex the index of a group of vertices with bitwise equal position,
+	/// normal and texture coordinate.  Returns the number of groups.
+	///</summary>
+	uint32 GroupEqualVertices(const VertexReader& reader, uint32 vertexCount, std::vector<uint32>& group)
+	{
+		struct Key
+		{
+			Float3 Position;
+			Float3 Normal;
+			Float2 TexC;
+		};
+
+		auto keyOf = [&reader](uint32 v)
+		{
+			return Key{ reader.Position(v), reader.Normal(v), reader.TexC(v) };
+		};
+
+		auto hashOf = [](const Key& key)
+		{
+			return (uint32)Hash::Mix(Hash::Fnv1a(&key, sizeof(Key)));
+		};
+
+		uint32 tableSize = 1;
+		while(tableSize < vertexCount * 2)
+			tableSize *= 2;
+
+		// Open addressing; each slot holds the first vertex of a group.
+		std::vector<uint32> table(tableSize, InvalidIndex);
+		group.resize(vertexCount);
+
+		uint32 groupCount = 0;
+		for(uint32 v = 0; v < vertexCount; ++v)
+		{
+			Key key = keyOf(v);
+			uint32 slot = hashOf(key) & (tableSize - 1);
+			for(;;)
+			{
+				uint32 first = table[slot];
+				if(first == InvalidIndex)
+				{
+					table[slot] = v;
+					group[v] = groupCount++;
+					break;
+				}
+
+				Key other = keyOf(first);
+				if(std::memcmp(&key, &other, sizeof(Key)) == 0)
+				{
+					group[v] = group[first];
+					break;
+				}
+
+				slot = (slot + 1) & (tableSize - 1);
+			}
+		}
+
+		return groupCount;
+	}
+}
+
+TangentSpace::Report TangentSpace::ComputeCornerTangents(const void* vertices, uint32 vertexCount, std::size_t vertexStride,
+	const VertexLayout& layout, const uint32* indices, uint32 indexCount, std::vector<XMFLOAT4>& cornerTangents)
+{
+	Report report;
+
+	const uint32 triCount = indexCount / 3;
+	const uint32 cornerCount = triCount * 3;
+	cornerTangents.assign(cornerCount, XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+	if(cornerCount == 0)
+		return report;
+
+	VertexReader reader(vertices, vertexStride, layout);
+	ThreadPool& pool = ThreadPool::Default();
+
+	std::vector<uint32> group;
+	const uint32 groupCount = GroupEqualVertices(reader, vertexCount, group);
+
+	//
+	// Angle weighted tangent of every corner.  Handedness is +1 or -1, or 0 for triangles
+	// without texture space area, which adopt the handedness of their neighbors.
+	//
+
+	std::vector<Float3> cornerTangent(cornerCount);
+	std::vector<signed char> cornerSign(cornerCount);
+	std::atomic<uint32> degenerateTriangles(0);
+
+	pool.ParallelFor(triCount, GrainSize, [&](uint32 begin, uint32 end)
+	{
+		uint32 degenerate = 0;
+		for(uint32 t = begin; t < end; ++t)
+		{
+			const uint32* tri = indices + t * 3;
+			const Float3 p[3] = { reader.Position(tri[0]), reader.Position(tri[1]), reader.Position(tri[2]) };
+			const Float2 uv0 = reader.TexC(tri[0]);
+			const Float2 uv1 = reader.TexC(tri[1]);
+			const Float2 uv2 = reader.TexC(tri[2]);
+
+			const Float3 d1 = p[1] - p[0];
+			const Float3 d2 = p[2] - p[0];
+			const float t21x = uv1.x - uv0.x, t21y = uv1.y - uv0.y;
+			const float t31x = uv2.x - uv0.x, t31y = uv2.y - uv0.y;
+			const float signedAreaTimes2 = t21x * t31y - t21y * t31x;
+
+			if(!NotZero(signedAreaTimes2))
+			{
+				++degenerate;
+				for(uint32 k = 0; k < 3; ++k)
+				{
+					cornerTangent[t * 3 + k] = { 0.0f, 0.0f, 0.0f };
+					cornerSign[t * 3 + k] = 0;
+				}
+				continue;
+			}
+
+			// dP/du up to the (positive) area factor.
+			const float sign = signedAreaTimes2 > 0.0f ? 1.0f : -1.0f;
+			const Float3 tangent = NormalizeIfNotZero((d1 * t31y - d2 * t21y) * sign);
+
+			for(uint32 k = 0; k < 3; ++k)
+			{
+				const Float3 n = reader.Normal(tri[k]);
+				const Float3 projected = NormalizeIfNotZero(ProjectOntoPlane(tangent, n));
+
+				// Corner angle measured in the tangent plane.
+				Float3 e1 = NormalizeIfNotZero(ProjectOntoPlane(p[(k + 2) % 3] - p[k], n));
+				Float3 e2 = NormalizeIfNotZero(ProjectOntoPlane(p[(k + 1) % 3] - p[k], n));
+				float cosAngle = std::min(std::max(Dot(e1, e2), -1.0f), 1.0f);
+
+				cornerTangent[t * 3 + k] = projected * std::acos(cosAngle);
+				cornerSign[t * 3 + k] = (signed char)sign;
+			}
+		}
+		degenerateTriangles += degenerate;
+	});
+
+	report.DegenerateTriangles = degenerateTriangles.load();
+
+	//
+	// Corners of each vertex group, in counting sort order.
+	//
+
+	std::vector<uint32> groupStart(groupCount + 1, 0);
+	for(uint32 c = 0; c < cornerCount; ++c)
+		++groupStart[group[indices[c]] + 1];
+	for(uint32 g = 0; g < groupCount; ++g)
+		groupStart[g + 1] += groupStart[g];
+
+	std::vector<uint32> groupCorners(cornerCount);
+	{
+		std::vector<uint32> cursor(groupStart.begin(), groupStart.end() - 1);
+		for(uint32 c = 0; c < cornerCount; ++c)
+			groupCorners[cursor[group[indices[c]]]++] = c;
+	}
+
+	//
+	// Sum each group per handedness and hand the result back to its corners.
+	//
+
+	pool.ParallelFor(groupCount, GrainSize, [&](uint32 begin, uint32 end)
+	{
+		for(uint32 g = begin; g < end; ++g)
+		{
+			const uint32* corners = groupCorners.data() + groupStart[g];
+			const uint32 count = groupStart[g + 1] - groupStart[g];
+			if(count == 0)
+				continue;
+
+			Float3 sum[2] = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+			bool used[2] = { false, false };
+			for(uint32 i = 0; i < count; ++i)
+			{
+				uint32 c = corners[i];
+				if(cornerSign[c] == 0)
+					continue;
+
+				uint32 side = cornerSign[c] > 0 ? 0 : 1;
+				sum[side] = sum[side] + cornerTangent[c];
+				used[side] = true;
+			}
+
+			const Float3 n = reader.Normal(indices[corners[0]]);
+			Float3 tangent[2];
+			for(uint32 side = 0; side < 2; ++side)
+			{
+				tangent[side] = NormalizeIfNotZero(sum[side]);
+				if(!NotZero(Dot(tangent[side], tangent[side])))
+					tangent[side] = AnyPerpendicular(n);
+			}
+
+			// Degenerate corners join the positive side unless only the negative one exists.
+			const uint32 fallbackSide = !used[0] && used[1] ? 1 : 0;
+			for(uint32 i = 0; i < count; ++i)
+			{
+				uint32 c = corners[i];
+				uint32 side = cornerSign[c] == 0 ? fallbackSide : (cornerSign[c] > 0 ? 0 : 1);
+				const Float3& t = tangent[side];
+				cornerTangents[c] = XMFLOAT4(t.x, t.y, t.z, side == 0 ? 1.0f : -1.0f);
+			}
+		}
+	});
+
+	return report;
+}
+
+TangentSpace::Report TangentSpace::GenerateBytes(std::vector<unsigned char>& vertexBytes, uint32& vertexCount,
+	std::size_t vertexStride, const VertexLayout& layout, std::vector<uint32>& indices)
+{
+	std::vector<XMFLOAT4> cornerTangents;
+	Report report = ComputeCornerTangents(vertexBytes.data(), vertexCount, vertexStride, layout,
+		indices.data(), (uint32)indices.size(), cornerTangents);
+
+	const uint32 cornerCount = (uint32)cornerTangents.size();
+
+	// Handednesses used by the corners of each vertex: bit 0 positive, bit 1 negative.
+	std::vector<unsigned char> handedness(vertexCount, 0);
+	for(uint32 c = 0; c < cornerCount; ++c)
+		handedness[indices[c]] |= cornerTangents[c].w > 0.0f ? 1 : 2;
+
+	// The negative corners of vertices used both ways move to a copy of the vertex.
+	std::vector<uint32> twin(vertexCount, InvalidIndex);
+	uint32 newVertexCount = vertexCount;
+	for(uint32 v = 0; v < vertexCount; ++v)
+	{
+		if(handedness[v] == 3)
+			twin[v] = newVertexCount++;
+	}
+
+	report.SplitVertices = newVertexCount - vertexCount;
+	vertexBytes.resize((std::size_t)newVertexCount * vertexStride);
+	for(uint32 v = 0; v < vertexCount; ++v)
+	{
+		if(twin[v] != InvalidIndex)
+			std::memcpy(&vertexBytes[twin[v] * vertexStride], &vertexBytes[v * vertexStride], vertexStride);
+	}
+
+	// Corners of one vertex and handedness all carry the same tangent, so writing it per
+	// corner is enough.
+	for(uint32 c = 0; c < cornerCount; ++c)
+	{
+		const XMFLOAT4& t = cornerTangents[c];
+		uint32 v = indices[c];
+		if(t.w < 0.0f && twin[v] != InvalidIndex)
+			indices[c] = v = twin[v];
+
+		unsigned char* vertex = &vertexBytes[v * vertexStride];
+		std::memcpy(vertex + layout.Tangent, &t.x, sizeof(XMFLOAT3));
+		std::memcpy(vertex + layout.TangentSign, &t.w, sizeof(float));
+	}
+
+	vertexCount = newVertexCount;
+	return report;
+}
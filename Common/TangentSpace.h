@@ -0,0 +1,99 @@
+//***************************************************************************************
+// TangentSpace.h
+//
+// Import time tangent frame generation following MikkTSpace (Mikkelsen, "Simulation of
+// Wrinkled Surfaces Revisited", 2008), the convention most baking tools write normal
+// maps in, so baked maps shade without seams:
+//   -Each triangle's tangent is dP/du, from its positions and texture coordinates, and
+//    its handedness is the sign of its texture space area.
+//   -At every corner that tangent is projected onto the plane of the vertex normal and
+//    weighted by the corner angle.
+//   -Corners of vertices with equal position, normal and texture coordinate are summed
+//    per handedness and normalized.
+//   -The bitangent is TangentSign * cross(Normal, Tangent); normals are left untouched.
+//
+// A vertex only gets split where its corners disagree on handedness, which happens
+// along mirrored UV seams.  Triangles with no texture space area contribute nothing and
+// take the handedness of their neighbors; a vertex with no usable corner at all (for
+// example a mesh without texture coordinates) gets an arbitrary tangent perpendicular
+// to its normal so normal mapping still reproduces the interpolated normal.
+//
+// Unlike the reference implementation corners are grouped per vertex and handedness
+// rather than by walking connected triangle fans, which only differs for vertices whose
+// fans touch at a single point.  Triangles and vertex groups are processed in parallel
+// chunks on ThreadPool::Default().
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+class TangentSpace
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	// Byte offsets of the attributes within a vertex.  Positions, normals and tangents
+	// are float3, texture coordinates float2 and the handedness a float.
+	struct VertexLayout
+	{
+		std::size_t Position = 0;
+		std::size_t Normal = 0;
+		std::size_t TexC = 0;
+		std::size_t Tangent = 0;
+		std::size_t TangentSign = 0;
+	};
+
+	struct Report
+	{
+		// Vertices appended because their corners had both handednesses.
+		uint32 SplitVertices = 0;
+
+		// Triangles without texture space area.
+		uint32 DegenerateTriangles = 0;
+	};
+
+	///<summary>
+	/// Writes the tangent and handedness of every vertex referenced by indices.  Split
+	/// vertices are appended to vertices and the indices of the corners that use them
+	/// are rewritten, so existing index ranges stay valid.
+	///</summary>
+	template<class VertexT>
+	static Report Generate(std::vector<VertexT>& vertices, std::vector<uint32>& indices, const VertexLayout& layout);
+
+	///<summary>
+	/// Computes the tangent (xyz) and handedness (w, +1 or -1) of every corner of
+	/// indices[0, indexCount) without modifying the mesh.
+	///</summary>
+	static Report ComputeCornerTangents(const void* vertices, uint32 vertexCount, std::size_t vertexStride,
+		const VertexLayout& layout, const uint32* indices, uint32 indexCount,
+		std::vector<DirectX::XMFLOAT4>& cornerTangents);
+
+private:
+	static Report GenerateBytes(std::vector<unsigned char>& vertexBytes, uint32& vertexCount,
+		std::size_t vertexStride, const VertexLayout& layout, std::vector<uint32>& indices);
+};
+
+template<class VertexT>
+TangentSpace::Report TangentSpace::Generate(std::vector<VertexT>& vertices, std::vector<uint32>& indices,
+	const VertexLayout& layout)
+{
+	// As in MeshOptimizer the work is done on raw bytes; VertexT must be trivially copyable.
+	std::vector<unsigned char> bytes(vertices.size() * sizeof(VertexT));
+	if(!bytes.empty())
+		std::memcpy(bytes.data(), vertices.data(), bytes.size());
+
+	uint32 vertexCount = (uint32)vertices.size();
+	Report report = GenerateBytes(bytes, vertexCount, sizeof(VertexT), layout, indices);
+
+	vertices.resize(vertexCount);
+	if(vertexCount > 0)
+		std::memcpy(vertices.data(), bytes.data(), vertexCount * sizeof(VertexT));
+
+	return report;
+}
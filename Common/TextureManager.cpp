@@ -0,0 +1,717 @@
+//***************************************************************************************
+// TextureManager.cpp
+//***************************************************************************************
+
+#include "TextureManager.h"
+#include "Hash.h"
+#include <cmath>
+#include <cstring>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	// Mips no larger than this on either side are uploaded together when a texture is
+	// loaded; they are small enough that streaming them one by one would not pay off.
+	const std::uint32_t gMipTailSize = 64;
+
+	bool IsBlockCompressed(DXGI_FORMAT format)
+	{
+		return (format >= DXGI_FORMAT_BC1_TYPELESS && format <= DXGI_FORMAT_BC5_SNORM) ||
+			(format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+	}
+}
+
+TextureManager::TextureManager(ID3D12Device* device, AssetLoader& loader, uint32 slotCount, uint64 budgetBytes,
+	const AssetArchive* archive) :
+	mDevice(device),
+	mLoader(loader),
+	mArchive(archive),
+	mSlots(slotCount),
+	mBudget(budgetBytes)
+{
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = slotCount;
+	heapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	heapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	ThrowIfFailed(mDevice->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&mStagingHeap)));
+
+	mDescriptorSize = mDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+
+	for(Handle handle = 0; handle < slotCount; ++handle)
+		WriteDescriptor(handle);
+}
+
+TextureManager::Handle TextureManager::Acquire(const std::wstring& filename, Handle placeholder)
+{
+	auto it = mSlotsByFilename.find(filename);
+	if(it != mSlotsByFilename.end())
+	{
+		++mSlots[it->second].RefCount;
+		return it->second;
+	}
+
+	return AllocateSlot(filename, placeholder);
+}
+
+TextureManager::Handle TextureManager::AcquireResident(const std::wstring& filename, ID3D12GraphicsCommandList* cmdList)
+{
+	Handle handle = Acquire(filename);
+	Slot& slot = mSlots[handle];
+
+	if(slot.Texture)
+	{
+		slot.Texture->Pinned = true;
+		return handle;
+	}
+
+	LoadedFile file;
+	OpenFile(mArchive, filename, file, true);
+	AttachFile(handle, file, cmdList, true);
+
+	if(!slot.Texture || !slot.Texture->Resource)
+		throw DxException(E_FAIL, L"TextureManager::AcquireResident " + filename, AnsiToWString(__FILE__), __LINE__);
+
+	return handle;
+}
+
+void TextureManager::Release(Handle handle)
+{
+	Slot& slot = mSlots[handle];
+	assert(slot.RefCount > 0);
+
+	if(--slot.RefCount > 0)
+		return;
+
+	DetachTexture(slot);
+	mSlotsByFilename.erase(slot.Filename);
+
+	uint32 generation = slot.Generation + 1;
+	slot = Slot();
+	slot.Generation = generation;
+
+	mDescriptorsDirty = true;
+}
+
+void TextureManager::BeginFrame(UINT64 completedFence, UINT64 frameFence)
+{
+	++mFrame;
+	mFrameFence = frameFence;
+
+	auto done = std::remove_if(mRetired.begin(), mRetired.end(),
+		[this, completedFence](const RetiredResource& retired)
+		{
+			if(retired.Fence > completedFence)
+				return false;
+
+			mRetiringBytes -= retired.Bytes;
+			return true;
+		});
+	mRetired.erase(done, mRetired.end());
+}
+
+void TextureManager::MarkUsed(Handle handle, float screenSize)
+{
+	if(handle >= mSlots.size())
+		return;
+
+	Slot& slot = mSlots[handle];
+	if(slot.LastUsedFrame != mFrame)
+		slot.ScreenSize = 0.0f;
+
+	slot.LastUsedFrame = mFrame;
+	slot.ScreenSize = MathHelper::Max(slot.ScreenSize, screenSize);
+	if(slot.Texture)
+		slot.Texture->LastUsedFrame = mFrame;
+
+	// The placeholder is drawn in the meantime.
+	if(!slot.Texture && slot.Placeholder != InvalidHandle && mSlots[slot.Placeholder].Texture)
+		mSlots[slot.Placeholder].Texture->LastUsedFrame = mFrame;
+}
+
+DXGI_FORMAT TextureManager::Format(Handle handle)const
+{
+	if(handle >= mSlots.size() || !mSlots[handle].Texture)
+		return DXGI_FORMAT_UNKNOWN;
+
+	return mSlots[handle].Texture->Format;
+}
+
+void TextureManager::Update()
+{
+	// Read the files of used slots that have never been loaded.
+	for(Handle handle = 0; handle < (Handle)mSlots.size(); ++handle)
+	{
+		const Slot& slot = mSlots[handle];
+		if(slot.RefCount > 0 && slot.LastUsedFrame == mFrame && !slot.Texture && !slot.Loading && !slot.Failed)
+			LoadSlot(handle);
+	}
+
+	std::vector<std::shared_ptr<Entry>> entries = LiveEntries();
+
+	// The mip each texture needs is the most detailed one any slot of it asks for.
+	for(const auto& entry : entries)
+		entry->RequiredMip = entry->MipCount;
+
+	for(const Slot& slot : mSlots)
+	{
+		if(slot.Texture && slot.LastUsedFrame == mFrame)
+			slot.Texture->RequiredMip = MathHelper::Min(slot.Texture->RequiredMip, MipForScreenSize(*slot.Texture, slot.ScreenSize));
+	}
+
+	// Give used textures room for the mips they need, as far as it fits, then stream those
+	// mips in.  Room is only made from textures that are not in use or have more mips than
+	// they need, so used textures never take memory from each other.
+	for(const auto& entry : entries)
+	{
+		if(entry->LastUsedFrame != mFrame || entry->Busy || entry->Failed)
+			continue;
+
+		uint32 begin = MathHelper::Min(entry->RequiredMip, entry->TailMip);
+		uint32 end = MathHelper::Min(entry->TargetTopMip, entry->MaxTopMip + 1);
+		if(begin < end)
+		{
+			uint32 topMip = FittingTopMip(*entry, begin, end);
+			if(topMip < end)
+			{
+				RequestResidency(entry, topMip);
+				continue;
+			}
+		}
+
+		if(entry->Resource && entry->LoadedMip > MathHelper::Max(entry->TopMip, entry->RequiredMip))
+			RequestMip(entry);
+	}
+
+	// Enforce the cap if the budget was lowered or pinned textures took it up.
+	MakeRoom(0, nullptr, true);
+
+	if(mDescriptorsDirty)
+	{
+		for(Handle handle = 0; handle < (Handle)mSlots.size(); ++handle)
+			WriteDescriptor(handle);
+		mDescriptorsDirty = false;
+	}
+}
+
+void TextureManager::CopyDescriptors(D3D12_CPU_DESCRIPTOR_HANDLE dest)const
+{
+	mDevice->CopyDescriptorsSimple((UINT)mSlots.size(), dest,
+		mStagingHeap->GetCPUDescriptorHandleForHeapStart(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+}
+
+void TextureManager::OpenFile(const AssetArchive* archive, const std::wstring& filename, LoadedFile& file, bool hash)
+{
+	file.Valid = SUCCEEDED(file.File.Open(archive, filename)) &&
+		SUCCEEDED(DirectX::GetDDSTextureLayout12(file.File.Data(), file.File.Size(), file.Layout));
+
+	if(file.Valid && hash)
+		file.Hash = Hash::Mix(Hash::Fnv1aWords(file.File.Data(), file.File.Size(),
+			Hash::FnvOffset ^ (std::uint64_t)file.File.Size()));
+}
+
+bool TextureManager::IsSameTexture(const Entry& entry, const LoadedFile& file)
+{
+	// Files read again for more mips must still describe the texture that was created.
+	const DirectX::DDS_TEXTURE_LAYOUT12& layout = file.Layout;
+	return file.Valid && layout.format == entry.Format && layout.width == entry.Width &&
+		layout.height == entry.Height && layout.mipCount == entry.MipCount && layout.arraySize == 1;
+}
+
+TextureManager::uint32 TextureManager::MipForScreenSize(const Entry& entry, float screenSize)
+{
+	// Each mip halves the size, so the mip whose size is closest to screenSize without
+	// going under it is the whole part of log2(size / screenSize).
+	float size = (float)MathHelper::Max(entry.Width, entry.Height);
+	if(screenSize >= size)
+		return 0;
+
+	if(screenSize <= 1.0f)
+		return entry.MipCount - 1;
+
+	uint32 mip = (uint32)std::floor(std::log2(size / screenSize));
+	return MathHelper::Min(mip, entry.MipCount - 1);
+}
+
+TextureManager::Handle TextureManager::AllocateSlot(const std::wstring& filename, Handle placeholder)
+{
+	for(Handle handle = 0; handle < (Handle)mSlots.size(); ++handle)
+	{
+		Slot& slot = mSlots[handle];
+		if(slot.RefCount > 0)
+			continue;
+
+		slot.Filename = filename;
+		slot.RefCount = 1;
+		slot.Placeholder = placeholder;
+		mSlotsByFilename[filename] = handle;
+		mDescriptorsDirty = true;
+		return handle;
+	}
+
+	throw DxException(E_OUTOFMEMORY, L"TextureManager::Acquire " + filename, AnsiToWString(__FILE__), __LINE__);
+}
+
+void TextureManager::LoadSlot(Handle handle)
+{
+	Slot& slot = mSlots[handle];
+	slot.Loading = true;
+
+	auto file = std::make_shared<LoadedFile>();
+	std::wstring filename = slot.Filename;
+	uint32 generation = slot.Generation;
+
+	mLoader.Load(
+		[archive = mArchive, file, filename]()
+		{
+			OpenFile(archive, filename, *file, true);
+		},
+		[this, file, handle, generation](ID3D12GraphicsCommandList* cmdList)
+		{
+			// The slot may have been freed, and even reused, while the file was read.
+			if(mSlots[handle].Generation == generation)
+				AttachFile(handle, *file, cmdList, false);
+			file->File.Close();
+		});
+}
+
+void TextureManager::AttachFile(Handle handle, LoadedFile& file, ID3D12GraphicsCommandList* cmdList, bool pin)
+{
+	Slot& slot = mSlots[handle];
+	slot.Loading = false;
+
+	// AcquireResident got there first.
+	if(slot.Texture)
+		return;
+
+	if(!file.Valid)
+	{
+		std::wstring message = slot.Filename + L" could not be loaded, keeping its placeholder\n";
+		OutputDebugStringW(message.c_str());
+		slot.Failed = true;
+		return;
+	}
+
+	std::shared_ptr<Entry> entry;
+	auto it = mEntriesByHash.find(file.Hash);
+	if(it != mEntriesByHash.end())
+		entry = it->second.lock();
+
+	if(!entry)
+	{
+		entry = CreateEntry(slot.Filename, file);
+		if(!entry)
+		{
+			std::wstring message = slot.Filename + L" is not a single 2D texture, keeping its placeholder\n";
+			OutputDebugStringW(message.c_str());
+			slot.Failed = true;
+			return;
+		}
+
+		mEntriesByHash[file.Hash] = entry;
+	}
+
+	slot.Texture = entry;
+	++entry->SlotCount;
+	entry->LastUsedFrame = MathHelper::Max(entry->LastUsedFrame, slot.LastUsedFrame);
+	entry->Pinned = entry->Pinned || pin;
+	mDescriptorsDirty = true;
+
+	// A texture shared with another slot may already be resident, or on its way.
+	if(entry->Busy || (entry->Resource && !pin))
+		return;
+
+	// The file is mapped anyway, so upload the mip tail right away, or all of a pinned
+	// texture.  The rest streams in once Update knows which mips are needed.
+	uint32 end = pin ? 1 : entry->TailMip + 1;
+	uint32 topMip = pin ? 0 : FittingTopMip(*entry, entry->TailMip, end);
+	if(topMip == end || (topMip == entry->TopMip && entry->LoadedMip == topMip))
+		return;
+
+	SetTarget(*entry, topMip);
+	RecordResidency(*entry, topMip, &file.Layout, cmdList);
+}
+
+void TextureManager::DetachTexture(Slot& slot)
+{
+	std::shared_ptr<Entry> entry = std::move(slot.Texture);
+	if(!entry || --entry->SlotCount > 0)
+		return;
+
+	// Last slot of the texture.  Loads still scheduled for it check SlotCount.
+	SetTarget(*entry, entry->MipCount);
+	Retire(entry->Resource, entry->Resource ? entry->Bytes[entry->TopMip] : 0);
+	entry->Resource = nullptr;
+	entry->TopMip = entry->MipCount;
+	entry->LoadedMip = entry->MipCount;
+
+	auto it = mEntriesByHash.find(entry->Hash);
+	if(it != mEntriesByHash.end() && it->second.lock() == entry)
+		mEntriesByHash.erase(it);
+}
+
+std::shared_ptr<TextureManager::Entry> TextureManager::CreateEntry(const std::wstring& filename,
+	const LoadedFile& file)const
+{
+	const DirectX::DDS_TEXTURE_LAYOUT12& layout = file.Layout;
+	if(layout.dimension != D3D12_RESOURCE_DIMENSION_TEXTURE2D || layout.isCubeMap || layout.arraySize != 1)
+		return nullptr;
+
+	auto entry = std::make_shared<Entry>();
+	entry->Filename = filename;
+	entry->Hash = file.Hash;
+	entry->Format = layout.format;
+	entry->Width = (uint32)layout.width;
+	entry->Height = (uint32)layout.height;
+	entry->MipCount = (uint32)layout.mipCount;
+	entry->TopMip = entry->MipCount;
+	entry->TargetTopMip = entry->MipCount;
+	entry->LoadedMip = entry->MipCount;
+	entry->RequiredMip = entry->MipCount;
+	entry->TailMip = entry->MipCount;
+
+	bool blockCompressed = IsBlockCompressed(entry->Format);
+	for(uint32 mip = 0; mip < entry->MipCount; ++mip)
+	{
+		uint32 width = MathHelper::Max(entry->Width >> mip, 1u);
+		uint32 height = MathHelper::Max(entry->Height >> mip, 1u);
+		if(mip > 0 && blockCompressed && (width % 4 != 0 || height % 4 != 0))
+			break;
+
+		CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Tex2D(entry->Format, width, height, 1,
+			(UINT16)(entry->MipCount - mip));
+		entry->Bytes.push_back(mDevice->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes);
+		entry->MaxTopMip = mip;
+
+		if(entry->TailMip == entry->MipCount && width <= gMipTailSize && height <= gMipTailSize)
+			entry->TailMip = mip;
+	}
+
+	// Textures whose tail cannot be the top mip start from the smallest mip that can.
+	entry->TailMip = MathHelper::Min(entry->TailMip, entry->MaxTopMip);
+
+	return entry;
+}
+
+void TextureManager::SetTarget(Entry& entry, uint32 topMip)
+{
+	if(entry.TargetTopMip < entry.Bytes.size())
+		mResidentBytes -= entry.Bytes[entry.TargetTopMip];
+	if(topMip < entry.Bytes.size())
+		mResidentBytes += entry.Bytes[topMip];
+
+	entry.TargetTopMip = topMip;
+}
+
+void TextureManager::RequestResidency(const std::shared_ptr<Entry>& entry, uint32 topMip)
+{
+	assert(!entry->Busy && topMip <= entry->MaxTopMip);
+
+	SetTarget(*entry, topMip);
+	entry->Busy = true;
+
+	if(entry->Resource)
+	{
+		// Mips that stay are copied, and new ones are streamed in later.
+		mLoader.Record([this, entry, topMip](ID3D12GraphicsCommandList* cmdList)
+		{
+			entry->Busy = false;
+			if(entry->SlotCount > 0)
+				RecordResidency(*entry, topMip, nullptr, cmdList);
+		});
+		return;
+	}
+
+	// The mip tail is read from the file again.
+	auto file = std::make_shared<LoadedFile>();
+	std::wstring filename = entry->Filename;
+
+	mLoader.Load(
+		[archive = mArchive, file, filename]()
+		{
+			OpenFile(archive, filename, *file, false);
+		},
+		[this, entry, topMip, file](ID3D12GraphicsCommandList* cmdList)
+		{
+			entry->Busy = false;
+			if(entry->SlotCount == 0)
+				return;
+
+			if(IsSameTexture(*entry, *file))
+			{
+				RecordResidency(*entry, topMip, &file->Layout, cmdList);
+			}
+			else
+			{
+				std::wstring message = entry->Filename + L" could not be reloaded, keeping what is resident\n";
+				OutputDebugStringW(message.c_str());
+				SetTarget(*entry, entry->Resource ? entry->TopMip : entry->MipCount);
+				entry->Failed = true;
+			}
+
+			file->File.Close();
+		});
+}
+
+void TextureManager::RecordResidency(Entry& entry, uint32 topMip, const DirectX::DDS_TEXTURE_LAYOUT12* fileLayout,
+	ID3D12GraphicsCommandList* cmdList)
+{
+	CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Tex2D(entry.Format,
+		MathHelper::Max(entry.Width >> topMip, 1u), MathHelper::Max(entry.Height >> topMip, 1u), 1,
+		(UINT16)(entry.MipCount - topMip));
+
+	ComPtr<ID3D12Resource> texture;
+	ThrowIfFailed(mDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&desc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(&texture)));
+
+	ComPtr<ID3D12Resource> old = entry.Resource;
+	uint32 oldTopMip = entry.TopMip;
+
+	// Mips of the old texture that hold data are copied.  Given the file, the mips below
+	// them down to the tail (or all of them for a pinned texture) are uploaded from it.
+	// The mips above are left for RecordMip.
+	uint32 copyStart = old ? MathHelper::Max(entry.LoadedMip, topMip) : entry.MipCount;
+	uint32 uploadStart = copyStart;
+	if(fileLayout != nullptr)
+		uploadStart = MathHelper::Min(entry.Pinned ? topMip : MathHelper::Max(topMip, entry.TailMip), copyStart);
+
+	uint32 uploadCount = copyStart - uploadStart;
+	if(uploadCount > 0)
+	{
+		std::vector<D3D12_SUBRESOURCE_DATA> uploadData(fileLayout->subresources.begin() + uploadStart,
+			fileLayout->subresources.begin() + copyStart);
+
+		ComPtr<ID3D12Resource> uploadHeap;
+		ThrowIfFailed(mDevice->CreateCommittedResource(
+			&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+			D3D12_HEAP_FLAG_NONE,
+			&CD3DX12_RESOURCE_DESC::Buffer(GetRequiredIntermediateSize(texture.Get(), uploadStart - topMip, uploadCount)),
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(&uploadHeap)));
+
+		UpdateSubresources(cmdList, texture.Get(), uploadHeap.Get(), 0, uploadStart - topMip, uploadCount, uploadData.data());
+
+		// Upload heaps are not part of the budget.
+		Retire(uploadHeap, 0);
+	}
+
+	if(old && copyStart < entry.MipCount)
+	{
+		cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(old.Get(),
+			D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE));
+
+		for(uint32 mip = copyStart; mip < entry.MipCount; ++mip)
+		{
+			CD3DX12_TEXTURE_COPY_LOCATION dst(texture.Get(), mip - topMip);
+			CD3DX12_TEXTURE_COPY_LOCATION src(old.Get(), mip - oldTopMip);
+			cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+		}
+	}
+
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
+	if(old)
+		Retire(old, entry.Bytes[oldTopMip]);
+
+	entry.Resource = texture;
+	entry.TopMip = topMip;
+	entry.LoadedMip = uploadStart;
+	mDescriptorsDirty = true;
+}
+
+void TextureManager::RequestMip(const std::shared_ptr<Entry>& entry)
+{
+	assert(!entry->Busy && entry->Resource && entry->LoadedMip > entry->TopMip);
+
+	entry->Busy = true;
+
+	auto file = std::make_shared<LoadedFile>();
+	std::wstring filename = entry->Filename;
+	uint32 mip = entry->LoadedMip - 1;
+
+	mLoader.Load(
+		[archive = mArchive, file, filename]()
+		{
+			OpenFile(archive, filename, *file, false);
+		},
+		[this, entry, mip, file](ID3D12GraphicsCommandList* cmdList)
+		{
+			entry->Busy = false;
+			if(entry->SlotCount == 0)
+				return;
+
+			if(IsSameTexture(*entry, *file))
+			{
+				RecordMip(*entry, mip, file->Layout, cmdList);
+			}
+			else
+			{
+				std::wstring message = entry->Filename + L" could not be reloaded, keeping what is resident\n";
+				OutputDebugStringW(message.c_str());
+				entry->Failed = true;
+			}
+
+			file->File.Close();
+		});
+}
+
+void TextureManager::RecordMip(Entry& entry, uint32 mip, const DirectX::DDS_TEXTURE_LAYOUT12& fileLayout,
+	ID3D12GraphicsCommandList* cmdList)
+{
+	// Nothing else changes the texture while the load is in flight.
+	assert(entry.Resource && mip >= entry.TopMip && mip + 1 == entry.LoadedMip);
+
+	// Only the new mip changes state.  Frames in flight keep sampling the others, and
+	// their descriptors clamp this one off.
+	UINT subresource = mip - entry.TopMip;
+	D3D12_SUBRESOURCE_DATA uploadData = fileLayout.subresources[mip];
+
+	ComPtr<ID3D12Resource> uploadHeap;
+	ThrowIfFailed(mDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(GetRequiredIntermediateSize(entry.Resource.Get(), subresource, 1)),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&uploadHeap)));
+
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(entry.Resource.Get(),
+		D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST, subresource));
+
+	UpdateSubresources(cmdList, entry.Resource.Get(), uploadHeap.Get(), 0, subresource, 1, &uploadData);
+
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(entry.Resource.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, subresource));
+
+	Retire(uploadHeap, 0);
+
+	entry.LoadedMip = mip;
+	mDescriptorsDirty = true;
+}
+
+void TextureManager::Evict(Entry& entry)
+{
+	assert(!entry.Busy && !entry.Pinned);
+
+	Retire(entry.Resource, entry.Resource ? entry.Bytes[entry.TopMip] : 0);
+	SetTarget(entry, entry.MipCount);
+	entry.Resource = nullptr;
+	entry.TopMip = entry.MipCount;
+	entry.LoadedMip = entry.MipCount;
+	mDescriptorsDirty = true;
+}
+
+bool TextureManager::MakeRoom(uint64 bytes, const Entry* keep, bool includeUsed)
+{
+	while(mResidentBytes + bytes > mBudget)
+	{
+		// Least recently used texture that can give up memory.  Textures in use only give
+		// up mips they do not need, or any mip when includeUsed is set.
+		std::shared_ptr<Entry> victim;
+		for(const auto& entry : LiveEntries())
+		{
+			if(entry.get() == keep || entry->Pinned || entry->Busy || entry->TargetTopMip >= entry->MipCount)
+				continue;
+
+			bool used = entry->LastUsedFrame == mFrame;
+			bool surplus = entry->TargetTopMip < MathHelper::Min(entry->RequiredMip, entry->MaxTopMip);
+			if(used && !surplus && (!includeUsed || entry->TargetTopMip >= entry->MaxTopMip))
+				continue;
+
+			if(!victim || entry->LastUsedFrame < victim->LastUsedFrame)
+				victim = entry;
+		}
+
+		if(!victim)
+			return false;
+
+		if(victim->TargetTopMip < victim->MaxTopMip)
+			RequestResidency(victim, victim->TargetTopMip + 1);
+		else
+			Evict(*victim);
+	}
+
+	return true;
+}
+
+TextureManager::uint32 TextureManager::FittingTopMip(const Entry& entry, uint32 begin, uint32 end)
+{
+	uint64 current = entry.TargetTopMip < entry.Bytes.size() ? entry.Bytes[entry.TargetTopMip] : 0;
+
+	for(uint32 topMip = begin; topMip < end; ++topMip)
+	{
+		uint64 growth = entry.Bytes[topMip] > current ? entry.Bytes[topMip] - current : 0;
+		if(MakeRoom(growth, &entry, false))
+			return topMip;
+	}
+
+	return end;
+}
+
+std::vector<std::shared_ptr<TextureManager::Entry>> TextureManager::LiveEntries()const
+{
+	std::vector<std::shared_ptr<Entry>> entries;
+	for(const Slot& slot : mSlots)
+	{
+		if(slot.Texture && std::find(entries.begin(), entries.end(), slot.Texture) == entries.end())
+			entries.push_back(slot.Texture);
+	}
+
+	return entries;
+}
+
+void TextureManager::Retire(ComPtr<ID3D12Resource> resource, uint64 bytes)
+{
+	if(!resource)
+		return;
+
+	RetiredResource retired;
+	retired.Fence = mFrameFence;
+	retired.Bytes = bytes;
+	retired.Resource = std::move(resource);
+	mRetired.push_back(std::move(retired));
+
+	mRetiringBytes += bytes;
+}
+
+void TextureManager::WriteDescriptor(Handle handle)const
+{
+	const Slot& slot = mSlots[handle];
+
+	const Entry* texture = nullptr;
+	if(slot.RefCount > 0)
+	{
+		if(slot.Texture && slot.Texture->Resource)
+		{
+			texture = slot.Texture.get();
+		}
+		else if(slot.Placeholder != InvalidHandle)
+		{
+			const Slot& placeholder = mSlots[slot.Placeholder];
+			if(placeholder.RefCount > 0 && placeholder.Texture && placeholder.Texture->Resource)
+				texture = placeholder.Texture.get();
+		}
+	}
+
+	ID3D12Resource* resource = texture ? texture->Resource.Get() : nullptr;
+
+	// A null resource gets a null descriptor, which samples as zero.
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = resource ? resource->GetDesc().Format : DXGI_FORMAT_R8G8B8A8_UNORM;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = resource ? resource->GetDesc().MipLevels : 1;
+	// Keep sampling off the mips that have not been streamed in yet.
+	srvDesc.Texture2D.ResourceMinLODClamp = texture ? (float)(texture->LoadedMip - texture->TopMip) : 0.0f;
+
+	CD3DX12_CPU_DESCRIPTOR_HANDLE descriptor(mStagingHeap->GetCPUDescriptorHandleForHeapStart(), handle, mDescriptorSize);
+	mDevice->CreateShaderResourceView(resource, &srvDesc, descriptor);
+}
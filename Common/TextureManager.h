@@ -0,0 +1,253 @@
+//***************************************************************************************
+// TextureManager.h
+//
+// Residency of the 2D material textures that shaders index through one descriptor table
+// (gTextureMaps).  A texture is acquired by filename and referred to by its slot in that
+// table, which is what materials store.
+//   -Slots are reference counted; acquiring a filename again returns the same slot.
+//   -Files are only read once a slot is used.  Files with equal contents share one GPU
+//    texture, which is found by hashing the file on the loading worker.
+//   -A texture first gets only its smallest mips.  More detailed mips are streamed in one
+//    level per load, down to the mip the texture's screen size asks for (see MarkUsed).
+//    The texture is allocated with room for them up front, and the levels that are still
+//    empty are hidden from the shaders by the ResourceMinLODClamp of the descriptor.
+//   -Every texture's memory is tracked from its allocation size.  When the total goes
+//    over the budget, textures not used this frame, or holding more mips than they need,
+//    lose their most detailed mip (the rest is copied on the GPU into a smaller texture)
+//    or are evicted outright, least recently used first.  If that is not enough, textures
+//    in use lose mips too.
+//   -A used texture that lost mips or was evicted is loaded again once it fits.
+//   -Until a texture is resident its slot shows the slot's placeholder.
+//
+// Slot descriptors live in a CPU only heap; CopyDescriptors copies the table into the
+// shader visible heap each frame, so a texture can be swapped without waiting for the
+// frames that still read the old one.  Replaced textures are released once the frame
+// being built when they were replaced has completed on the GPU.
+//
+// Memory is counted from the moment a change is scheduled, so the budget is a hard cap
+// except for the overlap while a texture is copied into its smaller replacement.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "AssetLoader.h"
+#include "DDSTextureLoader.h"
+#include "AssetArchive.h"
+#include <cfloat>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class TextureManager
+{
+public:
+
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	// Index of a slot in the descriptor table.
+	using Handle = uint32;
+	static const Handle InvalidHandle = 0xffffffff;
+
+	///<summary>
+	/// Files found in archive (which may be null, and must outlive the manager) are read
+	/// from it instead of from disk.
+	///</summary>
+	TextureManager(ID3D12Device* device, AssetLoader& loader, uint32 slotCount, uint64 budgetBytes,
+		const AssetArchive* archive = nullptr);
+
+	TextureManager(const TextureManager& rhs) = delete;
+	TextureManager& operator=(const TextureManager& rhs) = delete;
+
+	///<summary>
+	/// Returns the slot of filename, adding a reference.  The file is loaded the first time
+	/// the slot is used; until then it shows placeholder (a null texture if invalid).
+	///</summary>
+	Handle Acquire(const std::wstring& filename, Handle placeholder = InvalidHandle);
+
+	///<summary>
+	/// Loads filename now, recording its upload into cmdList.  The texture keeps all its
+	/// mips and is never evicted, which makes it suitable as a placeholder.
+	///</summary>
+	Handle AcquireResident(const std::wstring& filename, ID3D12GraphicsCommandList* cmdList);
+
+	///<summary>
+	/// Drops a reference.  The slot and, if no other slot shares it, the texture are freed
+	/// with the last one.
+	///</summary>
+	void Release(Handle handle);
+
+	///<summary>
+	/// Starts a frame.  completedFence is the last fence value the GPU has reached and
+	/// frameFence the value that will be signaled after the frame being built.
+	///</summary>
+	void BeginFrame(UINT64 completedFence, UINT64 frameFence);
+
+	///<summary>
+	/// Marks the texture of handle as used by the frame being built.  screenSize is how many
+	/// pixels one unit of texture coordinates covers on screen.  The texture streams in mips
+	/// down to the least detailed one that is still at least the frame's largest screenSize.
+	///</summary>
+	void MarkUsed(Handle handle, float screenSize = FLT_MAX);
+
+	///<summary>
+	/// Format of the file acquired for handle, or DXGI_FORMAT_UNKNOWN until it has been read.
+	/// The slot may show its placeholder, in another format, until the texture is resident.
+	///</summary>
+	DXGI_FORMAT Format(Handle handle)const;
+
+	///<summary>
+	/// Schedules loads of used textures and enforces the budget.  Call after the frame's
+	/// MarkUsed calls and before CopyDescriptors.
+	///</summary>
+	void Update();
+
+	///<summary>
+	/// Copies the descriptor table, SlotCount descriptors, to dest.
+	///</summary>
+	void CopyDescriptors(D3D12_CPU_DESCRIPTOR_HANDLE dest)const;
+
+	void SetBudget(uint64 budgetBytes) { mBudget = budgetBytes; }
+	uint64 Budget()const { return mBudget; }
+
+	// Memory of the resident textures as scheduled, which is what the budget limits.
+	uint64 ResidentBytes()const { return mResidentBytes; }
+
+	// Memory of replaced textures that the GPU may still be reading.
+	uint64 RetiringBytes()const { return mRetiringBytes; }
+
+	uint32 SlotCount()const { return (uint32)mSlots.size(); }
+
+private:
+	// One GPU texture, shared by all slots whose files have the same contents.
+	struct Entry
+	{
+		std::wstring Filename;
+		uint64 Hash = 0;
+
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+
+		// Description of the full texture in the file.
+		DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+		uint32 Width = 0;
+		uint32 Height = 0;
+		uint32 MipCount = 0;
+
+		// Most detailed mip in Resource, and what it will be once the scheduled change has
+		// been recorded.  MipCount means not resident.
+		uint32 TopMip = 0;
+		uint32 TargetTopMip = 0;
+
+		// Most detailed mip in Resource that holds data.  The mips above it are allocated
+		// but not streamed in yet, and the descriptor clamps them off.
+		uint32 LoadedMip = 0;
+
+		// Least detailed mip that can be the top one.  Block compressed textures need a
+		// top mip whose size is a multiple of the block size.
+		uint32 MaxTopMip = 0;
+
+		// Mips from here on are uploaded together when the texture is loaded.
+		uint32 TailMip = 0;
+
+		// Most detailed mip the frame being built needs.
+		uint32 RequiredMip = 0;
+
+		// Allocation size of the texture with each top mip up to MaxTopMip.
+		std::vector<uint64> Bytes;
+
+		uint32 SlotCount = 0;
+		uint64 LastUsedFrame = 0;
+		bool Pinned = false;
+
+		// A change of resident mips is scheduled.
+		bool Busy = false;
+
+		// The file could not be read again; stay at what is resident.
+		bool Failed = false;
+	};
+
+	struct Slot
+	{
+		std::wstring Filename;
+		uint32 RefCount = 0;
+		Handle Placeholder = InvalidHandle;
+		std::shared_ptr<Entry> Texture;
+
+		uint64 LastUsedFrame = 0;
+
+		// Largest screen size passed to MarkUsed in the last frame the slot was used.
+		float ScreenSize = 0.0f;
+
+		// The file is being read to find or create Texture, or could not be used.
+		bool Loading = false;
+		bool Failed = false;
+
+		// Bumped when the slot is freed, so loads started for a previous owner are ignored.
+		uint32 Generation = 0;
+	};
+
+	// The file of a texture, mapped and parsed on a loading worker.
+	struct LoadedFile
+	{
+		AssetFile File;
+		DirectX::DDS_TEXTURE_LAYOUT12 Layout;
+		uint64 Hash = 0;
+		bool Valid = false;
+	};
+
+	static void OpenFile(const AssetArchive* archive, const std::wstring& filename, LoadedFile& file, bool hash);
+	static bool IsSameTexture(const Entry& entry, const LoadedFile& file);
+	static uint32 MipForScreenSize(const Entry& entry, float screenSize);
+
+	Handle AllocateSlot(const std::wstring& filename, Handle placeholder);
+	void LoadSlot(Handle handle);
+	void AttachFile(Handle handle, LoadedFile& file, ID3D12GraphicsCommandList* cmdList, bool pin);
+	void DetachTexture(Slot& slot);
+
+	std::shared_ptr<Entry> CreateEntry(const std::wstring& filename, const LoadedFile& file)const;
+	void SetTarget(Entry& entry, uint32 topMip);
+	void RequestResidency(const std::shared_ptr<Entry>& entry, uint32 topMip);
+	void RecordResidency(Entry& entry, uint32 topMip, const DirectX::DDS_TEXTURE_LAYOUT12* fileLayout,
+		ID3D12GraphicsCommandList* cmdList);
+	void RequestMip(const std::shared_ptr<Entry>& entry);
+	void RecordMip(Entry& entry, uint32 mip, const DirectX::DDS_TEXTURE_LAYOUT12& fileLayout,
+		ID3D12GraphicsCommandList* cmdList);
+	void Evict(Entry& entry);
+	bool MakeRoom(uint64 bytes, const Entry* keep, bool includeUsed);
+	uint32 FittingTopMip(const Entry& entry, uint32 begin, uint32 end);
+	std::vector<std::shared_ptr<Entry>> LiveEntries()const;
+
+	void Retire(Microsoft::WRL::ComPtr<ID3D12Resource> resource, uint64 bytes);
+	void WriteDescriptor(Handle handle)const;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+	AssetLoader& mLoader;
+	const AssetArchive* mArchive = nullptr;
+
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> mStagingHeap;
+	UINT mDescriptorSize = 0;
+	bool mDescriptorsDirty = true;
+
+	std::vector<Slot> mSlots;
+	std::unordered_map<std::wstring, Handle> mSlotsByFilename;
+	std::unordered_map<uint64, std::weak_ptr<Entry>> mEntriesByHash;
+
+	uint64 mBudget = 0;
+	uint64 mResidentBytes = 0;
+
+	struct RetiredResource
+	{
+		UINT64 Fence = 0;
+		uint64 Bytes = 0;
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+	};
+	std::vector<RetiredResource> mRetired;
+	uint64 mRetiringBytes = 0;
+
+	uint64 mFrame = 0;
+	UINT64 mFrameFence = 0;
+};
@@ -0,0 +1,130 @@
+//***************************************************************************************
+// TgaLoader.cpp
+//***************************************************************************************
+
+#include "TgaLoader.h"
+#include <algorithm>
+
+namespace
+{
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+
+	const std::size_t HeaderSize = 18;
+
+	const uint8 TypeTrueColor = 2;
+	const uint8 TypeTrueColorRle = 10;
+
+	// Image descriptor bits.
+	const uint8 RightToLeft = 0x10;
+	const uint8 TopToBottom = 0x20;
+
+	uint32 ReadUint16(const uint8* p)
+	{
+		return (uint32)p[0] | ((uint32)p[1] << 8);
+	}
+}
+
+BlockCompressor::Image TgaLoader::TgaImage::View()const
+{
+	BlockCompressor::Image image;
+	image.Width = Width;
+	image.Height = Height;
+	image.RowPitch = Width * 4;
+	image.Pixels = Pixels.data();
+	return image;
+}
+
+bool TgaLoader::Load(const std::uint8_t* data, std::size_t size, TgaImage& image)
+{
+	if(size < HeaderSize)
+		return false;
+
+	uint32 idLength = data[0];
+	uint32 colorMapType = data[1];
+	uint8 imageType = data[2];
+	uint32 colorMapLength = ReadUint16(data + 5);
+	uint32 colorMapBits = data[7];
+	uint32 width = ReadUint16(data + 12);
+	uint32 height = ReadUint16(data + 14);
+	uint32 bitsPerPixel = data[16];
+	uint8 descriptor = data[17];
+
+	if(imageType != TypeTrueColor && imageType != TypeTrueColorRle)
+		return false;
+	if(bitsPerPixel != 24 && bitsPerPixel != 32)
+		return false;
+	if(width == 0 || height == 0)
+		return false;
+
+	// A true color image may still carry a color map, which is skipped.
+	std::size_t offset = HeaderSize + idLength;
+	if(colorMapType != 0)
+		offset += (std::size_t)colorMapLength * ((colorMapBits + 7) / 8);
+	if(offset > size)
+		return false;
+
+	const uint32 bytesPerPixel = bitsPerPixel / 8;
+	const std::size_t pixelCount = (std::size_t)width * height;
+
+	// Texels in file order, still BGR(A).
+	std::vector<uint8> texels(pixelCount * bytesPerPixel);
+	if(imageType == TypeTrueColor)
+	{
+		if(size - offset < texels.size())
+			return false;
+
+		std::copy(data + offset, data + offset + texels.size(), texels.begin());
+	}
+	else
+	{
+		// Packets of a count byte, then either one texel repeated or count raw texels.
+		std::size_t written = 0;
+		while(written < texels.size())
+		{
+			if(offset >= size)
+				return false;
+
+			uint8 packet = data[offset++];
+			std::size_t count = (std::size_t)(packet & 0x7f) + 1;
+			bool repeat = (packet & 0x80) != 0;
+
+			std::size_t bytes = count * bytesPerPixel;
+			if(written + bytes > texels.size())
+				return false;
+
+			std::size_t stored = repeat ? bytesPerPixel : bytes;
+			if(size - offset < stored)
+				return false;
+
+			for(std::size_t i = 0; i < bytes; ++i)
+				texels[written + i] = data[offset + (repeat ? i % bytesPerPixel : i)];
+
+			offset += stored;
+			written += bytes;
+		}
+	}
+
+	image.Width = width;
+	image.Height = height;
+	image.HasAlpha = bytesPerPixel == 4;
+	image.Pixels.resize(pixelCount * 4);
+
+	for(uint32 y = 0; y < height; ++y)
+	{
+		uint32 srcY = (descriptor & TopToBottom) ? y : height - 1 - y;
+		for(uint32 x = 0; x < width; ++x)
+		{
+			uint32 srcX = (descriptor & RightToLeft) ? width - 1 - x : x;
+			const uint8* src = &texels[((std::size_t)srcY * width + srcX) * bytesPerPixel];
+			uint8* dst = &image.Pixels[((std::size_t)y * width + x) * 4];
+
+			dst[0] = src[2];
+			dst[1] = src[1];
+			dst[2] = src[0];
+			dst[3] = bytesPerPixel == 4 ? src[3] : 255;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,43 @@
+//***************************************************************************************
+// TgaLoader.h
+//
+// Reads Truevision TGA images, the raw RGBA source art that the texture importer
+// compresses.  Only true color images are read: 24 or 32 bits per pixel, uncompressed
+// or run length encoded, in any of the four origins.  The image is returned as 8-bit
+// RGBA, rows from the top, ready for BlockCompressor and MipGenerator; 24-bit images get
+// an opaque alpha.
+//***************************************************************************************
+
+#pragma once
+
+#include "BlockCompressor.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class TgaLoader
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	struct TgaImage
+	{
+		uint32 Width = 0;
+		uint32 Height = 0;
+
+		// Texels as 4 bytes each, red first, rows from the top.
+		std::vector<std::uint8_t> Pixels;
+
+		// True if the file stores an alpha channel.
+		bool HasAlpha = false;
+
+		BlockCompressor::Image View()const;
+	};
+
+	///<summary>
+	/// Parses the TGA file in data.  Returns false if it is malformed, truncated or not a
+	/// 24 or 32-bit true color image.
+	///</summary>
+	static bool Load(const std::uint8_t* data, std::size_t size, TgaImage& image);
+};
@@ -0,0 +1,126 @@
+//***************************************************************************************
+// ThreadPool.cpp
+//***************************************************************************************
+
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(uint32 threadCount)
+{
+	if(threadCount == 0)
+	{
+		uint32 hardwareThreads = std::thread::hardware_concurrency();
+		threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	mWorkers.reserve(threadCount);
+	for(uint32 i = 0; i < threadCount; ++i)
+		mWorkers.emplace_back(&ThreadPool::WorkerMain, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mWake.notify_all();
+
+	for(auto& worker : mWorkers)
+		worker.join();
+}
+
+ThreadPool& ThreadPool::Default()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+ThreadPool::uint32 ThreadPool::WorkerCount()const
+{
+	return (uint32)mWorkers.size();
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTasks.push_back(std::move(task));
+	}
+	mWake.notify_one();
+}
+
+void ThreadPool::ParallelFor(uint32 count, uint32 grainSize, const std::function<void(uint32 begin, uint32 end)>& body)
+{
+	if(count == 0)
+		return;
+
+	grainSize = std::max(grainSize, 1u);
+	const uint32 chunkCount = (count + grainSize - 1) / grainSize;
+	if(chunkCount == 1 || mWorkers.empty())
+	{
+		body(0, count);
+		return;
+	}
+
+	// Shared by the helpers, which may still be queued after this call returns.
+	struct Job
+	{
+		std::atomic<uint32> NextChunk{ 0 };
+		std::atomic<uint32> DoneChunks{ 0 };
+		std::mutex Mutex;
+		std::condition_variable Done;
+	};
+	auto job = std::make_shared<Job>();
+
+	auto runChunks = [job, chunkCount, grainSize, count, &body]()
+	{
+		for(;;)
+		{
+			uint32 chunk = job->NextChunk.fetch_add(1);
+			if(chunk >= chunkCount)
+				return;
+
+			uint32 begin = chunk * grainSize;
+			body(begin, std::min(begin + grainSize, count));
+
+			if(job->DoneChunks.fetch_add(1) + 1 == chunkCount)
+			{
+				std::lock_guard<std::mutex> lock(job->Mutex);
+				job->Done.notify_all();
+			}
+		}
+	};
+
+	// body is only referenced by helpers that still find chunks to run, and all chunks
+	// finish before this function returns.
+	uint32 helperCount = std::min(chunkCount - 1, (uint32)mWorkers.size());
+	for(uint32 i = 0; i < helperCount; ++i)
+		Submit(runChunks);
+
+	runChunks();
+
+	std::unique_lock<std::mutex> lock(job->Mutex);
+	job->Done.wait(lock, [&job, chunkCount]() { return job->DoneChunks.load() == chunkCount; });
+}
+
+void ThreadPool::WorkerMain()
+{
+	for(;;)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [this]() { return mStopping || !mTasks.empty(); });
+			if(mStopping && mTasks.empty())
+				return;
+
+			task = std::move(mTasks.front());
+			mTasks.pop_front();
+		}
+
+		task();
+	}
+}
@@ -0,0 +1,60 @@
+//***************************************************************************************
+// ThreadPool.h
+//
+// A fixed set of worker threads for import and cook time work.  Submit queues a task;
+// ParallelFor splits an index range into chunks that the workers and the calling thread
+// take from a shared counter, and returns when every chunk is done.  Because the caller
+// works on its own loop instead of only waiting, ParallelFor may be nested inside a task
+// or another ParallelFor without deadlocking.
+//***************************************************************************************
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	///<summary>
+	/// Starts threadCount workers, or one less than the number of hardware threads if
+	/// threadCount is 0 (the calling thread is expected to help in ParallelFor).
+	///</summary>
+	explicit ThreadPool(uint32 threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool& rhs) = delete;
+	ThreadPool& operator=(const ThreadPool& rhs) = delete;
+
+	///<summary>
+	/// Pool shared by the engine's importers, created on first use.
+	///</summary>
+	static ThreadPool& Default();
+
+	uint32 WorkerCount()const;
+
+	void Submit(std::function<void()> task);
+
+	///<summary>
+	/// Calls body(begin, end) for consecutive chunks of [0, count) of about grainSize
+	/// elements, in parallel, and waits for all of them.
+	///</summary>
+	void ParallelFor(uint32 count, uint32 grainSize, const std::function<void(uint32 begin, uint32 end)>& body);
+
+private:
+	void WorkerMain();
+
+	std::vector<std::thread> mWorkers;
+	std::deque<std::function<void()>> mTasks;
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	bool mStopping = false;
+};
@@ -0,0 +1,199 @@
+//***************************************************************************************
+// Transform.cpp
+//***************************************************************************************
+
+#include "Transform.h"
+#include "BatchMath.h"
+#include "MathHelper.h"
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	float Dot3(const float* a, const float* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	bool NearZero(float x, float epsilon)
+	{
+		return std::fabs(x) <= epsilon;
+	}
+
+	// Rigid, UniformScale and Affine nest; Orthographic is an affine of its own shape.
+	int AffineRank(Transform::Kind kind)
+	{
+		switch(kind)
+		{
+		case Transform::Kind::Rigid:
+			return 0;
+		case Transform::Kind::UniformScale:
+			return 1;
+		default:
+			return 2;
+		}
+	}
+
+	bool IsAffine(Transform::Kind kind)
+	{
+		return kind != Transform::Kind::Perspective && kind != Transform::Kind::General;
+	}
+}
+
+Transform::Transform() :
+	mMatrix(MathHelper::Identity4x4()),
+	mKind(Kind::Rigid)
+{
+}
+
+Transform::Transform(const XMFLOAT4X4& m, Kind kind) :
+	mMatrix(m),
+	mKind(kind)
+{
+}
+
+Transform::Transform(FXMMATRIX m, Kind kind) :
+	mKind(kind)
+{
+	XMStoreFloat4x4(&mMatrix, m);
+}
+
+Transform Transform::Classify(FXMMATRIX m, float epsilon)
+{
+	XMFLOAT4X4 f;
+	XMStoreFloat4x4(&f, m);
+
+	bool affine = NearZero(f(0, 3), epsilon) && NearZero(f(1, 3), epsilon) && NearZero(f(2, 3), epsilon) &&
+		NearZero(f(3, 3) - 1.0f, epsilon);
+
+	if(affine)
+	{
+		float lengthSq[3] = { Dot3(f.m[0], f.m[0]), Dot3(f.m[1], f.m[1]), Dot3(f.m[2], f.m[2]) };
+		float scaleSq = lengthSq[0];
+
+		bool orthogonal = NearZero(Dot3(f.m[0], f.m[1]), epsilon * scaleSq) &&
+			NearZero(Dot3(f.m[0], f.m[2]), epsilon * scaleSq) && NearZero(Dot3(f.m[1], f.m[2]), epsilon * scaleSq);
+		bool uniform = NearZero(lengthSq[1] - scaleSq, epsilon * scaleSq) && NearZero(lengthSq[2] - scaleSq, epsilon * scaleSq);
+
+		if(orthogonal && uniform && scaleSq > 0.0f)
+			return Transform(f, NearZero(scaleSq - 1.0f, epsilon) ? Kind::Rigid : Kind::UniformScale);
+
+		bool diagonal = NearZero(f(0, 1), epsilon) && NearZero(f(0, 2), epsilon) && NearZero(f(1, 0), epsilon) &&
+			NearZero(f(1, 2), epsilon) && NearZero(f(2, 0), epsilon) && NearZero(f(2, 1), epsilon);
+
+		return Transform(f, diagonal ? Kind::Orthographic : Kind::Affine);
+	}
+
+	bool perspective = NearZero(f(0, 1), epsilon) && NearZero(f(0, 2), epsilon) && NearZero(f(0, 3), epsilon) &&
+		NearZero(f(1, 0), epsilon) && NearZero(f(1, 2), epsilon) && NearZero(f(1, 3), epsilon) &&
+		NearZero(f(3, 0), epsilon) && NearZero(f(3, 1), epsilon) && NearZero(f(3, 3), epsilon) &&
+		!NearZero(f(2, 3), epsilon) && !NearZero(f(3, 2), epsilon);
+
+	return Transform(f, perspective ? Kind::Perspective : Kind::General);
+}
+
+XMMATRIX Transform::Matrix()const
+{
+	return XMLoadFloat4x4(&mMatrix);
+}
+
+Transform Transform::Inverse()const
+{
+	const XMFLOAT4X4& m = mMatrix;
+
+	switch(mKind)
+	{
+	case Kind::Rigid:
+	case Kind::UniformScale:
+	{
+		// The rows are orthogonal with equal lengths s, so the inverse of the 3x3 part is
+		// its transpose over s^2.
+		float invScaleSq = mKind == Kind::Rigid ? 1.0f : 1.0f / Dot3(m.m[0], m.m[0]);
+
+		XMFLOAT4X4 inverse;
+		for(int i = 0; i < 3; ++i)
+		{
+			for(int j = 0; j < 3; ++j)
+				inverse(i, j) = m(j, i) * invScaleSq;
+			inverse(i, 3) = 0.0f;
+		}
+
+		// Translation: -t * inverse(3x3).
+		for(int j = 0; j < 3; ++j)
+			inverse(3, j) = -(m(3, 0) * inverse(0, j) + m(3, 1) * inverse(1, j) + m(3, 2) * inverse(2, j));
+		inverse(3, 3) = 1.0f;
+
+		return Transform(inverse, mKind);
+	}
+
+	case Kind::Affine:
+	{
+		XMFLOAT4X4 inverse;
+		BatchMath::InverseAffine(&m, 0, &inverse, 1);
+		return Transform(inverse, Kind::Affine);
+	}
+
+	case Kind::Orthographic:
+	{
+		// Each axis is x' = a x + t, so x = x' / a - t / a.
+		XMFLOAT4X4 inverse = MathHelper::Identity4x4();
+		for(int i = 0; i < 3; ++i)
+		{
+			inverse(i, i) = 1.0f / m(i, i);
+			inverse(3, i) = -m(3, i) * inverse(i, i);
+		}
+		return Transform(inverse, Kind::Orthographic);
+	}
+
+	case Kind::Perspective:
+	{
+		// Clip space is X = A x + C z, Y = B y + D z, Z = Q z + R w and W = s z, which
+		// solves to z = W / s, x = (X - C z) / A, y = (Y - D z) / B and w = (Z - Q z) / R.
+		float a = m(0, 0);
+		float b = m(1, 1);
+		float c = m(2, 0);
+		float d = m(2, 1);
+		float q = m(2, 2);
+		float s = m(2, 3);
+		float r = m(3, 2);
+
+		XMFLOAT4X4 inverse(
+			1.0f / a, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f / b, 0.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f / r,
+			-c / (a * s), -d / (b * s), 1.0f / s, -q / (r * s));
+
+		return Transform(inverse, Kind::General);
+	}
+
+	default:
+		return Transform(XMMatrixInverse(nullptr, Matrix()), Kind::General);
+	}
+}
+
+Transform Transform::operator*(const Transform& rhs)const
+{
+	Kind kind = Kind::General;
+	if(mKind == Kind::Orthographic && rhs.mKind == Kind::Orthographic)
+	{
+		kind = Kind::Orthographic;
+	}
+	else if(IsAffine(mKind) && IsAffine(rhs.mKind))
+	{
+		int rank = AffineRank(mKind) > AffineRank(rhs.mKind) ? AffineRank(mKind) : AffineRank(rhs.mKind);
+		kind = rank == 0 ? Kind::Rigid : rank == 1 ? Kind::UniformScale : Kind::Affine;
+	}
+
+	return Transform(XMMatrixMultiply(Matrix(), rhs.Matrix()), kind);
+}
+
+CameraTransforms::CameraTransforms(const Transform& view, const Transform& proj) :
+	View(view),
+	InvView(view.Inverse()),
+	Proj(proj),
+	InvProj(proj.Inverse()),
+	ViewProj(view * proj),
+	InvViewProj(InvProj * InvView)
+{
+}
@@ -0,0 +1,86 @@
+//***************************************************************************************
+// Transform.h
+//
+// A 4x4 matrix (DirectXMath conventions: row vectors, translation in row 3) that knows
+// which kind of transform it is, so its inverse comes from a closed form instead of
+// the general XMMatrixInverse:
+//   Rigid         - rotation and translation; the rotation is transposed.
+//   UniformScale  - rigid with one scale factor; transposed and divided by its square.
+//   Affine        - any 3x3 part and translation; the 3x3 part is inverted through its
+//                   adjugate.
+//   Orthographic  - the XMMatrixOrthographic* layout; three reciprocals.
+//   Perspective   - the XMMatrixPerspective* layout; four reciprocals.
+//   General       - anything else, which still takes XMMatrixInverse.
+// Products keep the most specific kind both factors allow.
+//
+// CameraTransforms holds everything a pass derives from a view and a projection, so it
+// is computed once per frame and shared by whatever reads it.
+//***************************************************************************************
+
+#pragma once
+
+#include <DirectXMath.h>
+
+class Transform
+{
+public:
+
+	enum class Kind
+	{
+		Rigid,
+		UniformScale,
+		Affine,
+		Orthographic,
+		Perspective,
+		General
+	};
+
+	///<summary>
+	/// The identity.
+	///</summary>
+	Transform();
+
+	///<summary>
+	/// m, taken to be of kind without checking.
+	///</summary>
+	Transform(const DirectX::XMFLOAT4X4& m, Kind kind);
+	Transform(DirectX::FXMMATRIX m, Kind kind);
+
+	///<summary>
+	/// m, with the most specific kind it fits within epsilon.
+	///</summary>
+	static Transform Classify(DirectX::FXMMATRIX m, float epsilon = 1e-4f);
+
+	DirectX::XMMATRIX Matrix()const;
+	const DirectX::XMFLOAT4X4& Float4x4()const { return mMatrix; }
+	Kind GetKind()const { return mKind; }
+
+	Transform Inverse()const;
+
+	///<summary>
+	/// This transform followed by rhs, as XMMatrixMultiply(*this, rhs).
+	///</summary>
+	Transform operator*(const Transform& rhs)const;
+
+private:
+	DirectX::XMFLOAT4X4 mMatrix;
+	Kind mKind;
+};
+
+struct CameraTransforms
+{
+	Transform View;
+	Transform InvView;
+	Transform Proj;
+	Transform InvProj;
+	Transform ViewProj;
+	Transform InvViewProj;
+
+	CameraTransforms() = default;
+
+	///<summary>
+	/// Derives the rest from view and proj; the inverse of viewProj is invProj * invView,
+	/// so no general inverse is needed for the usual camera kinds.
+	///</summary>
+	CameraTransforms(const Transform& view, const Transform& proj);
+};
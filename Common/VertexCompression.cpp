@@ -0,0 +1,380 @@
+//***************************************************************************************
+// VertexCompression.cpp
+//***************************************************************************************
+
+#include "VertexCompression.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	template<class T>
+	const T* StreamAt(const T* stream, std::size_t stride, std::uint32_t i)
+	{
+		return reinterpret_cast<const T*>(reinterpret_cast<const unsigned char*>(stream) + i * stride);
+	}
+
+	template<class T>
+	T* StreamAt(T* stream, std::size_t stride, std::uint32_t i)
+	{
+		return reinterpret_cast<T*>(reinterpret_cast<unsigned char*>(stream) + i * stride);
+	}
+
+	// Gathers x, y and z of up to four float3s into one vector each.  Missing lanes repeat
+	// the last element.
+	void Gather3(const XMFLOAT3* stream, std::size_t stride, std::uint32_t first, std::uint32_t lanes,
+		XMVECTOR& x, XMVECTOR& y, XMVECTOR& z)
+	{
+		const XMFLOAT3* v[4];
+		for(std::uint32_t i = 0; i < 4; ++i)
+			v[i] = StreamAt(stream, stride, first + std::min(i, lanes - 1));
+
+		x = XMVectorSet(v[0]->x, v[1]->x, v[2]->x, v[3]->x);
+		y = XMVectorSet(v[0]->y, v[1]->y, v[2]->y, v[3]->y);
+		z = XMVectorSet(v[0]->z, v[1]->z, v[2]->z, v[3]->z);
+	}
+
+	// Octahedral encoding of four unit vectors (Cigolle et al. 2014).  The result is in
+	// [-1, 1]^2; zero vectors map to +z.
+	void OctahedralEncode4(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, XMVECTOR& ex, XMVECTOR& ey)
+	{
+		const XMVECTOR zero = XMVectorZero();
+		const XMVECTOR one = XMVectorSplatOne();
+		const XMVECTOR negOne = XMVectorNegate(one);
+
+		XMVECTOR l1 = XMVectorAdd(XMVectorAdd(XMVectorAbs(x), XMVectorAbs(y)), XMVectorAbs(z));
+		l1 = XMVectorSelect(l1, one, XMVectorEqual(l1, zero));
+
+		XMVECTOR px = XMVectorDivide(x, l1);
+		XMVECTOR py = XMVectorDivide(y, l1);
+
+		// The lower hemisphere is folded over the diagonals.
+		XMVECTOR signX = XMVectorSelect(one, negOne, XMVectorLess(px, zero));
+		XMVECTOR signY = XMVectorSelect(one, negOne, XMVectorLess(py, zero));
+		XMVECTOR foldX = XMVectorMultiply(XMVectorSubtract(one, XMVectorAbs(py)), signX);
+		XMVECTOR foldY = XMVectorMultiply(XMVectorSubtract(one, XMVectorAbs(px)), signY);
+
+		XMVECTOR lower = XMVectorLess(z, zero);
+		ex = XMVectorSelect(px, foldX, lower);
+		ey = XMVectorSelect(py, foldY, lower);
+	}
+
+	void OctahedralDecode4(FXMVECTOR ex, FXMVECTOR ey, XMVECTOR& x, XMVECTOR& y, XMVECTOR& z)
+	{
+		const XMVECTOR zero = XMVectorZero();
+		const XMVECTOR one = XMVectorSplatOne();
+
+		z = XMVectorSubtract(XMVectorSubtract(one, XMVectorAbs(ex)), XMVectorAbs(ey));
+		XMVECTOR t = XMVectorMax(XMVectorNegate(z), zero);
+
+		x = XMVectorSelect(XMVectorSubtract(ex, t), XMVectorAdd(ex, t), XMVectorLess(ex, zero));
+		y = XMVectorSelect(XMVectorSubtract(ey, t), XMVectorAdd(ey, t), XMVectorLess(ey, zero));
+
+		XMVECTOR lengthSq = XMVectorAdd(XMVectorAdd(XMVectorMultiply(x, x), XMVectorMultiply(y, y)), XMVectorMultiply(z, z));
+		XMVECTOR invLength = XMVectorReciprocalSqrt(lengthSq);
+		x = XMVectorMultiply(x, invLength);
+		y = XMVectorMultiply(y, invLength);
+		z = XMVectorMultiply(z, invLength);
+	}
+
+	XMVECTOR ToSNorm16(FXMVECTOR v)
+	{
+		return XMVectorRound(XMVectorScale(XMVectorClamp(v, XMVectorNegate(XMVectorSplatOne()), XMVectorSplatOne()), 32767.0f));
+	}
+
+	XMVECTOR FromSNorm16(FXMVECTOR v)
+	{
+		return XMVectorMax(XMVectorScale(v, 1.0f / 32767.0f), XMVectorNegate(XMVectorSplatOne()));
+	}
+}
+
+VertexCompression::uint32 VertexCompression::Format::Stride()const
+{
+	return TexCOffset() + (TexC == TexCEncoding::Float2 ? 8 : 4);
+}
+
+VertexCompression::uint32 VertexCompression::Format::NormalOffset()const
+{
+	return Position == PositionEncoding::Float3 ? 12 : 8;
+}
+
+VertexCompression::uint32 VertexCompression::Format::TexCOffset()const
+{
+	return NormalOffset() + (Normal == NormalEncoding::Float3 ? 28 : 8);
+}
+
+VertexCompression::Format VertexCompression::Compact()
+{
+	Format format;
+	format.Position = PositionEncoding::UNorm16x4;
+	format.Normal = NormalEncoding::Octahedral16;
+	format.TexC = TexCEncoding::Half2;
+	return format;
+}
+
+XMMATRIX VertexCompression::Dequantize::Matrix()const
+{
+	return XMMatrixMultiply(XMMatrixScaling(Scale, Scale, Scale), XMMatrixTranslation(Bias.x, Bias.y, Bias.z));
+}
+
+VertexCompression::Dequantize VertexCompression::ComputeDequantize(const BoundingBox& bounds, PositionEncoding encoding)
+{
+	Dequantize dequantize;
+
+	// A single scale for all three axes keeps the dequantization a similarity transform.
+	float maxExtent = std::max(bounds.Extents.x, std::max(bounds.Extents.y, bounds.Extents.z));
+	if(maxExtent <= 0.0f)
+		maxExtent = 1.0f;
+
+	switch(encoding)
+	{
+	case PositionEncoding::Half4:
+		// [-1, 1] around the center, where half precision is best.
+		dequantize.Bias = bounds.Center;
+		dequantize.Scale = maxExtent;
+		break;
+
+	case PositionEncoding::UNorm16x4:
+		// [0, 1] from the minimum corner.
+		dequantize.Bias = XMFLOAT3(
+			bounds.Center.x - bounds.Extents.x,
+			bounds.Center.y - bounds.Extents.y,
+			bounds.Center.z - bounds.Extents.z);
+		dequantize.Scale = 2.0f * maxExtent;
+		break;
+
+	default:
+		break;
+	}
+
+	return dequantize;
+}
+
+void VertexCompression::Encode(const SourceStreams& source, uint32 first, uint32 count, const Format& format,
+	const Dequantize& dequantize, void* dest)
+{
+	unsigned char* out = static_cast<unsigned char*>(dest);
+	const std::size_t stride = format.Stride();
+	const uint32 normalOffset = format.NormalOffset();
+	const uint32 texCOffset = format.TexCOffset();
+
+	// Positions.
+	XMVECTOR bias = XMLoadFloat3(&dequantize.Bias);
+	float invScale = 1.0f / dequantize.Scale;
+	for(uint32 i = 0; i < count; ++i)
+	{
+		const XMFLOAT3* p = StreamAt(source.Positions, source.Stride, first + i);
+		unsigned char* v = out + i * stride;
+
+		if(format.Position == PositionEncoding::Float3)
+		{
+			std::memcpy(v, p, sizeof(XMFLOAT3));
+			continue;
+		}
+
+		// w holds the tangent handedness as 1 or 0, which both encodings store exactly.
+		bool negativeSign = source.TangentSigns && *StreamAt(source.TangentSigns, source.Stride, first + i) < 0.0f;
+
+		XMVECTOR q = XMVectorScale(XMVectorSubtract(XMLoadFloat3(p), bias), invScale);
+		q = XMVectorSetW(q, negativeSign ? 0.0f : 1.0f);
+
+		if(format.Position == PositionEncoding::Half4)
+			XMStoreHalf4(reinterpret_cast<XMHALF4*>(v), q);
+		else
+			XMStoreUShortN4(reinterpret_cast<XMUSHORTN4*>(v), q);
+	}
+
+	// Normals and tangents, four vertices per step.
+	if(format.Normal == NormalEncoding::Float3)
+	{
+		const XMFLOAT3 zero(0.0f, 0.0f, 0.0f);
+		const float positive = 1.0f;
+		for(uint32 i = 0; i < count; ++i)
+		{
+			unsigned char* v = out + i * stride + normalOffset;
+			std::memcpy(v, StreamAt(source.Normals, source.Stride, first + i), sizeof(XMFLOAT3));
+			std::memcpy(v + sizeof(XMFLOAT3),
+				source.Tangents ? StreamAt(source.Tangents, source.Stride, first + i) : &zero, sizeof(XMFLOAT3));
+			std::memcpy(v + 2 * sizeof(XMFLOAT3),
+				source.TangentSigns ? StreamAt(source.TangentSigns, source.Stride, first + i) : &positive, sizeof(float));
+		}
+	}
+	else
+	{
+		for(uint32 i = 0; i < count; i += 4)
+		{
+			uint32 lanes = std::min(4u, count - i);
+
+			XMVECTOR nx, ny, nz, tx, ty, tz;
+			Gather3(source.Normals, source.Stride, first + i, lanes, nx, ny, nz);
+			if(source.Tangents)
+				Gather3(source.Tangents, source.Stride, first + i, lanes, tx, ty, tz);
+			else
+				tx = ty = tz = XMVectorZero();
+
+			XMVECTOR enx, eny, etx, ety;
+			OctahedralEncode4(nx, ny, nz, enx, eny);
+			OctahedralEncode4(tx, ty, tz, etx, ety);
+
+			XMFLOAT4 qnx, qny, qtx, qty;
+			XMStoreFloat4(&qnx, ToSNorm16(enx));
+			XMStoreFloat4(&qny, ToSNorm16(eny));
+			XMStoreFloat4(&qtx, ToSNorm16(etx));
+			XMStoreFloat4(&qty, ToSNorm16(ety));
+
+			const float* lanesNX = &qnx.x;
+			const float* lanesNY = &qny.x;
+			const float* lanesTX = &qtx.x;
+			const float* lanesTY = &qty.x;
+			for(uint32 k = 0; k < lanes; ++k)
+			{
+				std::int16_t packed[4] =
+				{
+					(std::int16_t)lanesNX[k], (std::int16_t)lanesNY[k],
+					(std::int16_t)lanesTX[k], (std::int16_t)lanesTY[k]
+				};
+				std::memcpy(out + (i + k) * stride + normalOffset, packed, sizeof(packed));
+			}
+		}
+	}
+
+	// Texture coordinates.
+	if(format.TexC == TexCEncoding::Float2)
+	{
+		for(uint32 i = 0; i < count; ++i)
+			std::memcpy(out + i * stride + texCOffset, StreamAt(source.TexCs, source.Stride, first + i), sizeof(XMFLOAT2));
+	}
+	else if(count > 0)
+	{
+		const XMFLOAT2* texC = StreamAt(source.TexCs, source.Stride, first);
+		XMConvertFloatToHalfStream(reinterpret_cast<HALF*>(out + texCOffset), stride,
+			&texC->x, source.Stride, count);
+		XMConvertFloatToHalfStream(reinterpret_cast<HALF*>(out + texCOffset + sizeof(HALF)), stride,
+			&texC->y, source.Stride, count);
+	}
+}
+
+void VertexCompression::Decode(const void* source, uint32 count, const Format& format, const Dequantize& dequantize,
+	XMFLOAT3* positions, XMFLOAT3* normals, XMFLOAT3* tangents, XMFLOAT2* texCs, std::size_t destStride,
+	float* tangentSigns)
+{
+	const unsigned char* in = static_cast<const unsigned char*>(source);
+	const std::size_t stride = format.Stride();
+	const uint32 normalOffset = format.NormalOffset();
+	const uint32 texCOffset = format.TexCOffset();
+
+	XMVECTOR bias = XMLoadFloat3(&dequantize.Bias);
+	for(uint32 i = 0; i < count; ++i)
+	{
+		const unsigned char* v = in + i * stride;
+		XMFLOAT3* p = StreamAt(positions, destStride, i);
+
+		if(format.Position == PositionEncoding::Float3)
+		{
+			std::memcpy(p, v, sizeof(XMFLOAT3));
+			if(tangentSigns && format.Normal == NormalEncoding::Octahedral16)
+				*StreamAt(tangentSigns, destStride, i) = 1.0f;
+			continue;
+		}
+
+		XMVECTOR q = format.Position == PositionEncoding::Half4 ?
+			XMLoadHalf4(reinterpret_cast<const XMHALF4*>(v)) :
+			XMLoadUShortN4(reinterpret_cast<const XMUSHORTN4*>(v));
+
+		XMStoreFloat3(p, XMVectorMultiplyAdd(q, XMVectorReplicate(dequantize.Scale), bias));
+		if(tangentSigns && format.Normal == NormalEncoding::Octahedral16)
+			*StreamAt(tangentSigns, destStride, i) = XMVectorGetW(q) > 0.5f ? 1.0f : -1.0f;
+	}
+
+	if(format.Normal == NormalEncoding::Float3)
+	{
+		for(uint32 i = 0; i < count; ++i)
+		{
+			const unsigned char* v = in + i * stride + normalOffset;
+			std::memcpy(StreamAt(normals, destStride, i), v, sizeof(XMFLOAT3));
+			std::memcpy(StreamAt(tangents, destStride, i), v + sizeof(XMFLOAT3), sizeof(XMFLOAT3));
+			if(tangentSigns)
+				std::memcpy(StreamAt(tangentSigns, destStride, i), v + 2 * sizeof(XMFLOAT3), sizeof(float));
+		}
+	}
+	else
+	{
+		for(uint32 i = 0; i < count; i += 4)
+		{
+			uint32 lanes = std::min(4u, count - i);
+
+			std::int16_t packed[4][4];
+			for(uint32 k = 0; k < 4; ++k)
+				std::memcpy(packed[k], in + (i + std::min(k, lanes - 1)) * stride + normalOffset, sizeof(packed[k]));
+
+			XMVECTOR enx = FromSNorm16(XMVectorSet(packed[0][0], packed[1][0], packed[2][0], packed[3][0]));
+			XMVECTOR eny = FromSNorm16(XMVectorSet(packed[0][1], packed[1][1], packed[2][1], packed[3][1]));
+			XMVECTOR etx = FromSNorm16(XMVectorSet(packed[0][2], packed[1][2], packed[2][2], packed[3][2]));
+			XMVECTOR ety = FromSNorm16(XMVectorSet(packed[0][3], packed[1][3], packed[2][3], packed[3][3]));
+
+			XMVECTOR nx, ny, nz, tx, ty, tz;
+			OctahedralDecode4(enx, eny, nx, ny, nz);
+			OctahedralDecode4(etx, ety, tx, ty, tz);
+
+			XMFLOAT4 lanesN[3], lanesT[3];
+			XMStoreFloat4(&lanesN[0], nx);
+			XMStoreFloat4(&lanesN[1], ny);
+			XMStoreFloat4(&lanesN[2], nz);
+			XMStoreFloat4(&lanesT[0], tx);
+			XMStoreFloat4(&lanesT[1], ty);
+			XMStoreFloat4(&lanesT[2], tz);
+
+			for(uint32 k = 0; k < lanes; ++k)
+			{
+				*StreamAt(normals, destStride, i + k) = XMFLOAT3((&lanesN[0].x)[k], (&lanesN[1].x)[k], (&lanesN[2].x)[k]);
+				*StreamAt(tangents, destStride, i + k) = XMFLOAT3((&lanesT[0].x)[k], (&lanesT[1].x)[k], (&lanesT[2].x)[k]);
+			}
+		}
+	}
+
+	if(format.TexC == TexCEncoding::Float2)
+	{
+		for(uint32 i = 0; i < count; ++i)
+			std::memcpy(StreamAt(texCs, destStride, i), in + i * stride + texCOffset, sizeof(XMFLOAT2));
+	}
+	else if(count > 0)
+	{
+		XMConvertHalfToFloatStream(&texCs->x, destStride,
+			reinterpret_cast<const HALF*>(in + texCOffset), stride, count);
+		XMConvertHalfToFloatStream(&texCs->y, destStride,
+			reinterpret_cast<const HALF*>(in + texCOffset + sizeof(HALF)), stride, count);
+	}
+}
+
+std::vector<D3D12_INPUT_ELEMENT_DESC> VertexCompression::InputLayout(const Format& format)
+{
+	std::vector<D3D12_INPUT_ELEMENT_DESC> layout;
+
+	DXGI_FORMAT positionFormat = DXGI_FORMAT_R32G32B32_FLOAT;
+	if(format.Position == PositionEncoding::Half4)
+		positionFormat = DXGI_FORMAT_R16G16B16A16_FLOAT;
+	else if(format.Position == PositionEncoding::UNorm16x4)
+		positionFormat = DXGI_FORMAT_R16G16B16A16_UNORM;
+
+	layout.push_back({ "POSITION", 0, positionFormat, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+
+	UINT offset = format.NormalOffset();
+	if(format.Normal == NormalEncoding::Float3)
+	{
+		layout.push_back({ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offset, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+		layout.push_back({ "TANGENT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, offset + 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+	}
+	else
+	{
+		layout.push_back({ "NORMAL", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, offset, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+	}
+
+	DXGI_FORMAT texCFormat = format.TexC == TexCEncoding::Float2 ? DXGI_FORMAT_R32G32_FLOAT : DXGI_FORMAT_R16G16_FLOAT;
+	layout.push_back({ "TEXCOORD", 0, texCFormat, 0, format.TexCOffset(), D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+
+	return layout;
+}
@@ -0,0 +1,116 @@
+//***************************************************************************************
+// VertexCompression.h
+//
+// Packed vertex layouts for large static meshes.  A Format picks an encoding for each
+// attribute:
+//   -Positions as half or normalized 16-bit integers relative to the bounds of the
+//    submesh they belong to.  The mapping back to local space is a uniform scale plus a
+//    bias (see Dequantize), so it can be folded into the world matrix and normals are not
+//    skewed.
+//   -Normal and tangent octahedral encoded into 16-bit snorm pairs (32 bits each).
+//   -Half precision texture coordinates.
+//   -The tangent handedness in the w of quantized positions (1 or 0 for +1 or -1), or
+//    in the w of a float4 tangent.  Float3 positions with octahedral normals have no
+//    room for it and always decode as +1.
+//
+// Encoding and decoding work on four vertices at a time with DirectXMath so they use
+// SSE/NEON where available.  InputLayout generates the matching D3D12 input elements;
+// the vertex shader only has to decode the octahedral normals (PACKED_NORMALS), the
+// input assembler converts the other formats to float.
+//***************************************************************************************
+
+#pragma once
+
+#include <d3d12.h>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <vector>
+
+class VertexCompression
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	enum class PositionEncoding
+	{
+		Float3,		// R32G32B32_FLOAT, 12 bytes
+		Half4,		// R16G16B16A16_FLOAT relative to the bounds center, 8 bytes
+		UNorm16x4	// R16G16B16A16_UNORM relative to the bounds minimum, 8 bytes
+	};
+
+	enum class NormalEncoding
+	{
+		Float3,			// Normal R32G32B32_FLOAT, tangent and handedness R32G32B32A32_FLOAT, 28 bytes
+		Octahedral16	// Normal in xy, tangent in zw of R16G16B16A16_SNORM, 8 bytes
+	};
+
+	enum class TexCEncoding
+	{
+		Float2,	// R32G32_FLOAT, 8 bytes
+		Half2	// R16G16_FLOAT, 4 bytes
+	};
+
+	struct Format
+	{
+		PositionEncoding Position = PositionEncoding::Float3;
+		NormalEncoding Normal = NormalEncoding::Float3;
+		TexCEncoding TexC = TexCEncoding::Float2;
+
+		uint32 Stride()const;
+		uint32 NormalOffset()const;
+		uint32 TexCOffset()const;
+	};
+
+	///<summary>
+	/// 20 byte layout used for large imported meshes: UNorm16x4 positions, octahedral
+	/// normal/tangent and half texture coordinates.
+	///</summary>
+	static Format Compact();
+
+	// Local space position = Bias + Scale * encoded position.
+	struct Dequantize
+	{
+		DirectX::XMFLOAT3 Bias = { 0.0f, 0.0f, 0.0f };
+		float Scale = 1.0f;
+
+		// The matrix form, to be premultiplied onto the world matrix.
+		DirectX::XMMATRIX Matrix()const;
+	};
+
+	static Dequantize ComputeDequantize(const DirectX::BoundingBox& bounds, PositionEncoding encoding);
+
+	// Strided views of the source attributes, for example into an array of the engine's
+	// Vertex struct.  Tangents may be null, in which case zero is encoded, and
+	// TangentSigns may be null, in which case +1 is encoded.
+	struct SourceStreams
+	{
+		const DirectX::XMFLOAT3* Positions = nullptr;
+		const DirectX::XMFLOAT3* Normals = nullptr;
+		const DirectX::XMFLOAT3* Tangents = nullptr;
+		const float* TangentSigns = nullptr;
+		const DirectX::XMFLOAT2* TexCs = nullptr;
+		std::size_t Stride = 0;
+	};
+
+	///<summary>
+	/// Encodes vertices [first, first + count) of source into dest, which must hold
+	/// count * format.Stride() bytes.
+	///</summary>
+	static void Encode(const SourceStreams& source, uint32 first, uint32 count, const Format& format,
+		const Dequantize& dequantize, void* dest);
+
+	///<summary>
+	/// Inverse of Encode.  The destination streams must all be non-null, except for
+	/// tangentSigns.
+	///</summary>
+	static void Decode(const void* source, uint32 count, const Format& format, const Dequantize& dequantize,
+		DirectX::XMFLOAT3* positions, DirectX::XMFLOAT3* normals, DirectX::XMFLOAT3* tangents,
+		DirectX::XMFLOAT2* texCs, std::size_t destStride, float* tangentSigns = nullptr);
+
+	///<summary>
+	/// Input elements (POSITION, NORMAL[, TANGENT], TEXCOORD) matching format in slot 0.
+	///</summary>
+	static std::vector<D3D12_INPUT_ELEMENT_DESC> InputLayout(const Format& format);
+};
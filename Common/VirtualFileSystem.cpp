@@ -0,0 +1,158 @@
+//***************************************************************************************
+// VirtualFileSystem.cpp
+//***************************************************************************************
+
+#include "VirtualFileSystem.h"
+#include "AssetArchive.h"
+#include "FileUtil.h"
+#include <fstream>
+
+namespace
+{
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+
+	// Read-only stream buffer over bytes it owns.
+	class MemoryBuffer : public std::streambuf
+	{
+	public:
+		explicit MemoryBuffer(std::vector<uint8> bytes) : mBytes(std::move(bytes))
+		{
+			char* begin = reinterpret_cast<char*>(mBytes.data());
+			setg(begin, begin, begin + mBytes.size());
+		}
+
+	private:
+		std::vector<uint8> mBytes;
+	};
+
+	class MemoryStream : public std::istream
+	{
+	public:
+		explicit MemoryStream(std::vector<uint8> bytes) : std::istream(nullptr), mBuffer(std::move(bytes))
+		{
+			rdbuf(&mBuffer);
+		}
+
+	private:
+		MemoryBuffer mBuffer;
+	};
+
+	// A file stream with a large buffer, which keeps line by line parsing from being
+	// syscall bound.
+	class BufferedFileStream : public std::ifstream
+	{
+	public:
+		explicit BufferedFileStream(const std::string& filename) : mBuffer(1 << 20)
+		{
+			// MSVC's filebuf ignores a buffer set before the file is open; after open and
+			// before the first read every implementation takes it.
+			open(filename, std::ios::in | std::ios::binary);
+			if(is_open())
+				rdbuf()->pubsetbuf(mBuffer.data(), (std::streamsize)mBuffer.size());
+		}
+
+	private:
+		std::vector<char> mBuffer;
+	};
+
+	bool IsSeparator(char c)
+	{
+		return c == '/' || c == '\\';
+	}
+}
+
+VirtualFileSystem& VirtualFileSystem::Default()
+{
+	static VirtualFileSystem fileSystem;
+	return fileSystem;
+}
+
+bool VirtualFileSystem::SplitArchivePath(const std::string& path, std::string& archive, std::string& inner)
+{
+	for(std::size_t i = 0; i + 4 < path.size(); ++i)
+	{
+		if(path[i] != '.' || !IsSeparator(path[i + 4]))
+			continue;
+
+		char z = path[i + 1] | 0x20;
+		char p = path[i + 2] | 0x20;
+		char k = path[i + 3] | 0x20;
+		if(z != 'z' || p != 'i' || k != 'p')
+			continue;
+
+		std::size_t innerStart = i + 4;
+		while(innerStart < path.size() && IsSeparator(path[innerStart]))
+			++innerStart;
+
+		archive = path.substr(0, i + 4);
+		inner = path.substr(innerStart);
+		return true;
+	}
+
+	return false;
+}
+
+bool VirtualFileSystem::ReadFile(const std::string& path, std::vector<std::uint8_t>& bytes)
+{
+	std::string archivePath;
+	std::string inner;
+	if(!SplitArchivePath(path, archivePath, inner))
+		return FileUtil::ReadFile(AnsiToWString(path), bytes);
+
+	std::shared_ptr<const ZipArchive> archive = Archive(archivePath);
+	const ZipArchive::Entry* entry = archive ? archive->Find(inner) : nullptr;
+	return entry != nullptr && archive->Read(*entry, bytes);
+}
+
+std::unique_ptr<std::istream> VirtualFileSystem::Open(const std::string& path)
+{
+	std::string archivePath;
+	std::string inner;
+	if(!SplitArchivePath(path, archivePath, inner))
+	{
+		auto stream = std::make_unique<BufferedFileStream>(path);
+		if(!*stream)
+			return nullptr;
+		return stream;
+	}
+
+	std::vector<uint8> bytes;
+	if(!ReadFile(path, bytes))
+		return nullptr;
+
+	return std::make_unique<MemoryStream>(std::move(bytes));
+}
+
+std::vector<std::string> VirtualFileSystem::ListArchive(const std::string& archivePath)
+{
+	std::vector<std::string> paths;
+
+	std::shared_ptr<const ZipArchive> archive = Archive(archivePath);
+	if(!archive)
+		return paths;
+
+	for(uint32 i = 0; i < archive->EntryCount(); ++i)
+		paths.push_back(archivePath + "//" + archive->GetEntry(i).Path);
+
+	return paths;
+}
+
+std::shared_ptr<const ZipArchive> VirtualFileSystem::Archive(const std::string& filename)
+{
+	std::string key = AssetArchive::NormalizePath(filename);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	auto it = mArchives.find(key);
+	if(it != mArchives.end())
+		return it->second;
+
+	// Failures are not remembered, so an archive that appears later is still found.
+	auto archive = std::make_shared<ZipArchive>();
+	if(FAILED(archive->Open(AnsiToWString(filename).c_str())))
+		return nullptr;
+
+	mArchives[key] = archive;
+	return archive;
+}
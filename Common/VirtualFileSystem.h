@@ -0,0 +1,66 @@
+//***************************************************************************************
+// VirtualFileSystem.h
+//
+// Lets importers open files inside zip archives as if the archive were a directory:
+// "MyModels//CrateZip.zip//Crate//Crate1.obj" is the entry Crate/Crate1.obj of
+// MyModels/CrateZip.zip.  Paths without a ".zip" component are loose files.
+//
+// An archive is opened (mapped, with its central directory read) the first time a path
+// inside it is used and stays open for the lifetime of the file system.  Entries are
+// inflated straight into the buffers handed to the importers, never to disk.  All
+// methods are thread safe.
+//***************************************************************************************
+
+#pragma once
+
+#include "ZipArchive.h"
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class VirtualFileSystem
+{
+public:
+
+	VirtualFileSystem() = default;
+
+	VirtualFileSystem(const VirtualFileSystem& rhs) = delete;
+	VirtualFileSystem& operator=(const VirtualFileSystem& rhs) = delete;
+
+	///<summary>
+	/// File system shared by the engine's importers, created on first use.
+	///</summary>
+	static VirtualFileSystem& Default();
+
+	///<summary>
+	/// Splits path at its first ".zip" component into the archive's filename and the path
+	/// inside it.  Returns false for paths outside any archive.
+	///</summary>
+	static bool SplitArchivePath(const std::string& path, std::string& archive, std::string& inner);
+
+	///<summary>
+	/// Reads the whole file into bytes.  Returns false if it does not exist or cannot be
+	/// read.
+	///</summary>
+	bool ReadFile(const std::string& path, std::vector<std::uint8_t>& bytes);
+
+	///<summary>
+	/// Opens the file as a binary stream, or returns nullptr.  Loose files are streamed
+	/// from disk; archive entries are decompressed up front and read from memory.
+	///</summary>
+	std::unique_ptr<std::istream> Open(const std::string& path);
+
+	///<summary>
+	/// The paths of the files in the archive at archivePath, usable with the other methods.
+	///</summary>
+	std::vector<std::string> ListArchive(const std::string& archivePath);
+
+private:
+	std::shared_ptr<const ZipArchive> Archive(const std::string& filename);
+
+	std::mutex mMutex;
+	std::unordered_map<std::string, std::shared_ptr<const ZipArchive>> mArchives;
+};
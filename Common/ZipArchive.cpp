@@ -0,0 +1,262 @@
+//***************************************************************************************
+// ZipArchive.cpp
+//***************************************************************************************
+
+#include "ZipArchive.h"
+#include "AssetArchive.h"
+#include "Inflate.h"
+#include <cstring>
+
+namespace
+{
+	using uint8 = std::uint8_t;
+	using uint16 = std::uint16_t;
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	const uint32 LocalHeaderSignature = 0x04034b50;
+	const uint32 CentralHeaderSignature = 0x02014b50;
+	const uint32 EndSignature = 0x06054b50;
+	const uint32 Zip64EndSignature = 0x06064b50;
+	const uint32 Zip64LocatorSignature = 0x07064b50;
+
+	const std::size_t LocalHeaderSize = 30;
+	const std::size_t CentralHeaderSize = 46;
+	const std::size_t EndSize = 22;
+	const std::size_t Zip64EndSize = 56;
+	const std::size_t Zip64LocatorSize = 20;
+	const std::size_t MaxCommentSize = 0xffff;
+
+	const uint16 Zip64ExtraId = 0x0001;
+
+	const uint32 MethodStored = 0;
+	const uint32 MethodDeflated = 8;
+
+	const uint16 FlagEncrypted = 1;
+
+	// Zip fields are little endian and unaligned.
+	uint16 Read16(const uint8* p)
+	{
+		return (uint16)(p[0] | (p[1] << 8));
+	}
+
+	uint32 Read32(const uint8* p)
+	{
+		return (uint32)p[0] | ((uint32)p[1] << 8) | ((uint32)p[2] << 16) | ((uint32)p[3] << 24);
+	}
+
+	uint64 Read64(const uint8* p)
+	{
+		return (uint64)Read32(p) | ((uint64)Read32(p + 4) << 32);
+	}
+
+	// Replaces the fields that overflowed into the zip64 extra field, which holds only
+	// those, in this order.
+	bool ReadZip64Extra(const uint8* extra, std::size_t extraSize, ZipArchive::Entry& entry,
+		bool sizeOverflow, bool compressedOverflow, bool offsetOverflow)
+	{
+		for(std::size_t p = 0; p + 4 <= extraSize; )
+		{
+			uint16 id = Read16(extra + p);
+			std::size_t size = Read16(extra + p + 2);
+			p += 4;
+			if(size > extraSize - p)
+				return false;
+
+			if(id == Zip64ExtraId)
+			{
+				const uint8* field = extra + p;
+				const uint8* end = field + size;
+
+				if(sizeOverflow)
+				{
+					if(end - field < 8)
+						return false;
+					entry.Size = Read64(field);
+					field += 8;
+				}
+				if(compressedOverflow)
+				{
+					if(end - field < 8)
+						return false;
+					entry.CompressedSize = Read64(field);
+					field += 8;
+				}
+				if(offsetOverflow)
+				{
+					if(end - field < 8)
+						return false;
+					entry.LocalHeaderOffset = Read64(field);
+				}
+
+				return true;
+			}
+
+			p += size;
+		}
+
+		return !sizeOverflow && !compressedOverflow && !offsetOverflow;
+	}
+}
+
+HRESULT ZipArchive::Open(const wchar_t* filename)
+{
+	Close();
+
+	HRESULT hr = mFile.Open(filename);
+	if(FAILED(hr))
+		return hr;
+
+	if(!ReadCentralDirectory())
+	{
+		Close();
+		return E_FAIL;
+	}
+
+	return S_OK;
+}
+
+void ZipArchive::Close()
+{
+	mFile.Close();
+	mEntries.clear();
+	mEntriesByPath.clear();
+}
+
+const ZipArchive::Entry* ZipArchive::Find(const std::string& path)const
+{
+	auto it = mEntriesByPath.find(AssetArchive::NormalizePath(path));
+	return it != mEntriesByPath.end() ? &mEntries[it->second] : nullptr;
+}
+
+bool ZipArchive::Read(const Entry& entry, std::vector<std::uint8_t>& bytes)const
+{
+	bytes.clear();
+
+	const uint8* data = mFile.Data();
+	uint64 fileSize = mFile.Size();
+
+	// The local header repeats the name, but its extra field may differ from the central
+	// directory's, so the data is found from its own lengths.
+	uint64 offset = entry.LocalHeaderOffset;
+	if(offset > fileSize || fileSize - offset < LocalHeaderSize || Read32(data + offset) != LocalHeaderSignature)
+		return false;
+
+	uint64 dataOffset = offset + LocalHeaderSize + Read16(data + offset + 26) + Read16(data + offset + 28);
+	if(dataOffset > fileSize || entry.CompressedSize > fileSize - dataOffset)
+		return false;
+
+	const uint8* compressed = data + dataOffset;
+
+	bytes.resize((std::size_t)entry.Size);
+	bool decoded = false;
+	if(entry.Method == MethodStored)
+	{
+		decoded = entry.CompressedSize == entry.Size;
+		if(decoded && !bytes.empty())
+			std::memcpy(bytes.data(), compressed, bytes.size());
+	}
+	else if(entry.Method == MethodDeflated)
+	{
+		decoded = Inflate::Decompress(compressed, (std::size_t)entry.CompressedSize, bytes.data(), bytes.size());
+	}
+
+	if(!decoded || Inflate::Crc32(bytes.data(), bytes.size()) != entry.Crc)
+	{
+		bytes.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool ZipArchive::ReadCentralDirectory()
+{
+	const uint8* data = mFile.Data();
+	uint64 fileSize = mFile.Size();
+	if(fileSize < EndSize)
+		return false;
+
+	// The end record is last, followed only by a comment of up to 64KB.
+	uint64 searchStart = fileSize > EndSize + MaxCommentSize ? fileSize - EndSize - MaxCommentSize : 0;
+	uint64 end = fileSize - EndSize + 1;
+	do
+	{
+		--end;
+		if(Read32(data + end) == EndSignature)
+			break;
+	} while(end > searchStart);
+
+	if(Read32(data + end) != EndSignature)
+		return false;
+
+	const uint8* record = data + end;
+	if(Read16(record + 4) != 0 || Read16(record + 6) != 0)
+		return false;
+
+	uint64 entryCount = Read16(record + 10);
+	uint64 directorySize = Read32(record + 12);
+	uint64 directoryOffset = Read32(record + 16);
+
+	// Counts and offsets that do not fit are in the zip64 end record, which a locator
+	// right before the end record points at.
+	if(entryCount == 0xffff || directorySize == 0xffffffff || directoryOffset == 0xffffffff)
+	{
+		if(end < Zip64LocatorSize || Read32(data + end - Zip64LocatorSize) != Zip64LocatorSignature)
+			return false;
+
+		uint64 zip64End = Read64(data + end - Zip64LocatorSize + 8);
+		if(zip64End > fileSize || fileSize - zip64End < Zip64EndSize || Read32(data + zip64End) != Zip64EndSignature)
+			return false;
+
+		entryCount = Read64(data + zip64End + 32);
+		directorySize = Read64(data + zip64End + 40);
+		directoryOffset = Read64(data + zip64End + 48);
+	}
+
+	if(directoryOffset > fileSize || directorySize > fileSize - directoryOffset ||
+		entryCount > directorySize / CentralHeaderSize)
+		return false;
+
+	mEntries.reserve((std::size_t)entryCount);
+
+	const uint8* p = data + directoryOffset;
+	const uint8* directoryEnd = p + directorySize;
+	for(uint64 i = 0; i < entryCount; ++i)
+	{
+		if(directoryEnd - p < (std::ptrdiff_t)CentralHeaderSize || Read32(p) != CentralHeaderSignature)
+			return false;
+
+		uint16 flags = Read16(p + 8);
+		std::size_t nameLength = Read16(p + 28);
+		std::size_t extraLength = Read16(p + 30);
+		std::size_t commentLength = Read16(p + 32);
+		std::size_t recordSize = CentralHeaderSize + nameLength + extraLength + commentLength;
+		if((std::size_t)(directoryEnd - p) < recordSize)
+			return false;
+
+		Entry entry;
+		entry.Method = Read16(p + 10);
+		entry.Crc = Read32(p + 16);
+		entry.CompressedSize = Read32(p + 20);
+		entry.Size = Read32(p + 24);
+		entry.LocalHeaderOffset = Read32(p + 42);
+		entry.Path.assign(reinterpret_cast<const char*>(p + CentralHeaderSize), nameLength);
+
+		if(!ReadZip64Extra(p + CentralHeaderSize + nameLength, extraLength, entry,
+			entry.Size == 0xffffffff, entry.CompressedSize == 0xffffffff, entry.LocalHeaderOffset == 0xffffffff))
+			return false;
+
+		p += recordSize;
+
+		// Directories and entries that cannot be read are left out.
+		bool directory = !entry.Path.empty() && (entry.Path.back() == '/' || entry.Path.back() == '\\');
+		if(directory || (flags & FlagEncrypted))
+			continue;
+
+		mEntriesByPath[AssetArchive::NormalizePath(entry.Path)] = (uint32)mEntries.size();
+		mEntries.push_back(std::move(entry));
+	}
+
+	return true;
+}
@@ -0,0 +1,77 @@
+//***************************************************************************************
+// ZipArchive.h
+//
+// Read-only access to a .zip file.  The file is memory mapped and its central directory
+// is read once into a table keyed by normalized path (AssetArchive::NormalizePath), so
+// entries are found without scanning.  Read inflates an entry from the mapping straight
+// into the caller's buffer, with no temporary files, and checks its CRC.  Reads are
+// independent of each other and may run on several threads at once.
+//
+// Stored and deflated entries are supported, including zip64 sizes and offsets.
+// Encrypted entries and archives split over several disks are not.
+//***************************************************************************************
+
+#pragma once
+
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ZipArchive
+{
+public:
+
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	struct Entry
+	{
+		// As stored in the archive, '/' separated.
+		std::string Path;
+
+		uint64 LocalHeaderOffset = 0;
+		uint64 CompressedSize = 0;
+		uint64 Size = 0;
+		uint32 Method = 0;
+		uint32 Crc = 0;
+	};
+
+	ZipArchive() = default;
+
+	ZipArchive(const ZipArchive& rhs) = delete;
+	ZipArchive& operator=(const ZipArchive& rhs) = delete;
+
+	///<summary>
+	/// Maps filename and reads its central directory.  Fails with E_FAIL if it is not a
+	/// zip file this reader understands.
+	///</summary>
+	HRESULT Open(const wchar_t* filename);
+
+	void Close();
+
+	bool IsOpen()const { return mFile.IsOpen(); }
+
+	///<summary>
+	/// The entry of path, compared after AssetArchive::NormalizePath, or nullptr.
+	/// Directories are not entries.
+	///</summary>
+	const Entry* Find(const std::string& path)const;
+
+	uint32 EntryCount()const { return (uint32)mEntries.size(); }
+	const Entry& GetEntry(uint32 index)const { return mEntries[index]; }
+
+	///<summary>
+	/// Decompresses the entry into bytes.  Returns false if it uses an unsupported method
+	/// or its data is corrupt.
+	///</summary>
+	bool Read(const Entry& entry, std::vector<std::uint8_t>& bytes)const;
+
+private:
+	bool ReadCentralDirectory();
+
+	MappedFile mFile;
+	std::vector<Entry> mEntries;
+	std::unordered_map<std::string, uint32> mEntriesByPath;
+};
@@ -35,6 +35,15 @@ ComPtr<ID3DBlob> d3dUtil::LoadBinary(const std::wstring& filename)
     return blob;
 }
 
+ComPtr<ID3DBlob> d3dUtil::CreateBlob(const std::vector<std::uint8_t>& bytes)
+{
+	ComPtr<ID3DBlob> blob;
+	ThrowIfFailed(D3DCreateBlob(bytes.size(), blob.GetAddressOf()));
+	CopyMemory(blob->GetBufferPointer(), bytes.data(), bytes.size());
+
+	return blob;
+}
+
 Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
     ID3D12Device* device,
     ID3D12GraphicsCommandList* cmdList,
@@ -87,16 +96,25 @@ Microsoft::WRL::ComPtr<ID3D12Resource> d3dUtil::CreateDefaultBuffer(
     return defaultBuffer;
 }
 
+namespace
+{
+	UINT ShaderCompileFlags()
+	{
+		UINT compileFlags = 0;
+#if defined(DEBUG) || defined(_DEBUG)  
+		compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#endif
+		return compileFlags;
+	}
+}
+
 ComPtr<ID3DBlob> d3dUtil::CompileShader(
 	const std::wstring& filename,
 	const D3D_SHADER_MACRO* defines,
 	const std::string& entrypoint,
 	const std::string& target)
 {
-	UINT compileFlags = 0;
-#if defined(DEBUG) || defined(_DEBUG)  
-	compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif
+	UINT compileFlags = ShaderCompileFlags();
 
 	HRESULT hr = S_OK;
 
@@ -113,6 +131,39 @@ ComPtr<ID3DBlob> d3dUtil::CompileShader(
 	return byteCode;
 }
 
+ShaderCache::Compiler d3dUtil::ShaderCompiler()
+{
+	ShaderCache::Compiler compiler;
+	compiler.Version = "fxc " + std::to_string(D3D_COMPILER_VERSION) + " flags " + std::to_string(ShaderCompileFlags());
+	compiler.Compile = [](const std::wstring& filename, const std::vector<ShaderCache::Define>& defines,
+		const std::string& entryPoint, const std::string& target,
+		std::vector<std::uint8_t>& bytecode, std::string& errors)
+	{
+		std::vector<D3D_SHADER_MACRO> macros;
+		for(const ShaderCache::Define& define : defines)
+			macros.push_back({ define.Name.c_str(), define.Value.c_str() });
+		macros.push_back({ nullptr, nullptr });
+
+		ComPtr<ID3DBlob> byteCode;
+		ComPtr<ID3DBlob> errorBlob;
+		HRESULT hr = D3DCompileFromFile(filename.c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE,
+			entryPoint.c_str(), target.c_str(), ShaderCompileFlags(), 0, &byteCode, &errorBlob);
+
+		errors.clear();
+		if(errorBlob != nullptr)
+			errors = (const char*)errorBlob->GetBufferPointer();
+
+		if(FAILED(hr))
+			return false;
+
+		const std::uint8_t* data = (const std::uint8_t*)byteCode->GetBufferPointer();
+		bytecode.assign(data, data + byteCode->GetBufferSize());
+		return true;
+	};
+
+	return compiler;
+}
+
 std::wstring DxException::ToString()const
 {
     // Get the string description of the error code.
@@ -28,6 +28,8 @@
 #include "d3dx12.h"
 #include "DDSTextureLoader.h"
 #include "MathHelper.h"
+#include "MeshletBuilder.h"
+#include "ShaderCache.h"
 
 extern const int gNumFrameResources;
 
@@ -114,6 +116,11 @@ public:
 
     static Microsoft::WRL::ComPtr<ID3DBlob> LoadBinary(const std::wstring& filename);
 
+	///<summary>
+	/// A blob holding a copy of bytes, such as bytecode from a ShaderCache.
+	///</summary>
+	static Microsoft::WRL::ComPtr<ID3DBlob> CreateBlob(const std::vector<std::uint8_t>& bytes);
+
     static Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer(
         ID3D12Device* device,
         ID3D12GraphicsCommandList* cmdList,
@@ -126,6 +133,12 @@ public:
 		const D3D_SHADER_MACRO* defines,
 		const std::string& entrypoint,
 		const std::string& target);
+
+	///<summary>
+	/// ShaderCache backend that compiles with FXC (D3DCompileFromFile) and the same flags
+	/// as CompileShader.
+	///</summary>
+	static ShaderCache::Compiler ShaderCompiler();
 };
 
 class DxException
@@ -155,6 +168,18 @@ struct SubmeshGeometry
     // Bounding box of the geometry defined by this submesh. 
     // This is used in later chapters of the book.
 	DirectX::BoundingBox Bounds;
+
+	// Maps packed vertex positions back to local space (see VertexCompression).  Identity
+	// for float positions.
+	DirectX::XMFLOAT4X4 VertexTransform = MathHelper::Identity4x4();
+
+	// Range of MeshGeometry::Meshlets.Meshlets covering this submesh, if it was split.
+	UINT MeshletOffset = 0;
+	UINT MeshletCount = 0;
+
+	// For simplified versions of a submesh (see MeshGeometry::LodChain): how far, in
+	// object space, this level may deviate from the full detail submesh.
+	float LodError = 0.0f;
 };
 
 struct MeshGeometry
@@ -184,6 +209,23 @@ struct MeshGeometry
 	// the Submeshes individually.
 	std::unordered_map<std::string, SubmeshGeometry> DrawArgs;
 
+	// Clusters of the submeshes for CPU culling; empty if none were built.
+	MeshletBuilder::MeshletData Meshlets;
+
+	// Simplified versions of a submesh are stored in DrawArgs as "<name>_lod1",
+	// "<name>_lod2", ...  Returns the submesh followed by its simplified versions, or
+	// nothing if there is no submesh called name.
+	std::vector<SubmeshGeometry> LodChain(const std::string& name)const
+	{
+		std::vector<SubmeshGeometry> chain;
+		for(auto it = DrawArgs.find(name); it != DrawArgs.end();
+			it = DrawArgs.find(name + "_lod" + std::to_string(chain.size())))
+		{
+			chain.push_back(it->second);
+		}
+		return chain;
+	}
+
 	D3D12_VERTEX_BUFFER_VIEW VertexBufferView()const
 	{
 		D3D12_VERTEX_BUFFER_VIEW vbv;
@@ -261,6 +303,10 @@ struct Material
 	DirectX::XMFLOAT3 FresnelR0 = { 0.01f, 0.01f, 0.01f };
 	float Roughness = .25f;
 	DirectX::XMFLOAT4X4 MatTransform = MathHelper::Identity4x4();
+
+	// The normal texture stores only x and y (BC5), so the shader rebuilds z.  Set from
+	// the format of the file once it has been read.
+	bool NormalMapTwoChannel = false;
 };
 
 struct Texture
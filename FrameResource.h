@@ -65,7 +65,8 @@ struct MaterialData
 
 	UINT DiffuseMapIndex = 0;
 	UINT NormalMapIndex = 0;
-	UINT MaterialPad1;
+	// The normal map is two channel (BC5); the shader rebuilds z.
+	UINT NormalMapTwoChannel = 0;
 	UINT MaterialPad2;
 };
 
@@ -94,6 +95,9 @@ struct Vertex
     DirectX::XMFLOAT3 Normal;
 	DirectX::XMFLOAT2 TexC;
 	DirectX::XMFLOAT3 TangentU;
+
+	// Bitangent = TangentSign * cross(Normal, TangentU); -1 where the UVs are mirrored.
+	float TangentSign = 1.0f;
 };
 
 // Stores the resources needed for the CPU to build the command lists
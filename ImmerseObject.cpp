@@ -15,8 +15,9 @@ ImmerseObject::ImmerseObject(std::string newName, DirectX::XMMATRIX world, Direc
 	bIs2D = false;
 	instanceBufferIndex = 0;
 	Instances.resize(1);
-	XMStoreFloat4x4(&Instances[0].World, world);
-	XMStoreFloat4x4(&Instances[0].TexTransform, texTransform);
+	Instances[0].World = InstanceTransform::FromMatrix(world);
+	Instances[0].TexScale = XMFLOAT2(TexTransform(0, 0), TexTransform(1, 1));
+	Instances[0].TexOffset = XMFLOAT2(TexTransform(3, 0), TexTransform(3, 1));
 
 }
 
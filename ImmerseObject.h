@@ -2,11 +2,14 @@
 #include "Common/d3dUtil.h"
 #include "Common/MathHelper.h"
 #include "Common/UploadBuffer.h"
+#include "Common/InstanceTransform.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
 using namespace DirectX::PackedVector;
 
+// The layout of InstanceData in Common.hlsl, with both matrices transposed.  Only the
+// upload in UpdateInstanceData builds these.
 struct InstanceData
 {
 	DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
@@ -17,6 +20,24 @@ struct InstanceData
 	UINT InstancePad2;
 };
 
+// What the CPU keeps for each instance: 60 bytes instead of InstanceData's 144.
+struct Instance
+{
+	InstanceTransform World;
+
+	// Texture coordinates are scaled by TexScale, then offset by TexOffset.
+	DirectX::XMFLOAT2 TexScale = { 1.0f, 1.0f };
+	DirectX::XMFLOAT2 TexOffset = { 0.0f, 0.0f };
+
+	UINT MaterialIndex = 0;
+
+	DirectX::XMMATRIX TexTransform()const
+	{
+		return DirectX::XMMatrixScaling(TexScale.x, TexScale.y, 1.0f) *
+			DirectX::XMMatrixTranslation(TexOffset.x, TexOffset.y, 0.0f);
+	}
+};
+
 class ImmerseObject
 {
 
@@ -31,7 +52,7 @@ public:
 	UINT instanceBufferIndex;
 	BoundingBox Bounds;
 	UINT MatIndex;
-	std::vector<InstanceData> Instances;
+	std::vector<Instance> Instances;
 
 	Material* Mat = nullptr;
 	MeshGeometry* Geo = nullptr;
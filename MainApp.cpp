@@ -4,12 +4,29 @@
 
 #include "Common/d3dApp.h"
 #include "Common/MathHelper.h"
+#include "Common/BatchMath.h"
+#include "Common/Transform.h"
 #include "Common//UploadBuffer.h"
 #include "Common/GeometryGenerator.h"
+#include "Common/ObjLoader.h"
+#include "Common/FbxLoader.h"
+#include "Common/TgaLoader.h"
+#include "Common/MipGenerator.h"
+#include "Common/MeshOptimizer.h"
+#include "Common/VertexCompression.h"
+#include "Common/MeshSimplifier.h"
+#include "Common/ThreadPool.h"
+#include "Common/TangentSpace.h"
+#include "Common/AssetLoader.h"
+#include "Common/AssetArchive.h"
+#include "Common/AssetCooker.h"
+#include "Common/VirtualFileSystem.h"
+#include "Common/TextureManager.h"
 #include "Common/Camera.h"
+#include "Common/ShaderPermutations.h"
 #include "FrameResource.h"
+#include <cstdio>
 #include <iostream>
-#include <fbxsdk.h>
 #include "Ssao.h"
 #include <string>
 #include "ShadowMap.h"
@@ -24,6 +41,21 @@ using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
+// Size of gTextureMaps in Common.hlsl, the table TextureManager hands out slots of.
+const UINT gNumTextureMaps = 12;
+
+// Where TangentSpace finds the attributes of the engine's Vertex.
+static TangentSpace::VertexLayout VertexTangentLayout()
+{
+	TangentSpace::VertexLayout layout;
+	layout.Position = offsetof(Vertex, Pos);
+	layout.Normal = offsetof(Vertex, Normal);
+	layout.TexC = offsetof(Vertex, TexC);
+	layout.Tangent = offsetof(Vertex, TangentU);
+	layout.TangentSign = offsetof(Vertex, TangentSign);
+	return layout;
+}
+
 
 struct test
 {
@@ -36,7 +68,7 @@ struct test
 	UINT instanceBufferIndex;
 	BoundingBox Bounds;
 	UINT MatIndex;
-	std::vector<InstanceData> Instances;
+	std::vector<Instance> Instances;
 
 	Material* Mat = nullptr;
 	MeshGeometry* Geo = nullptr;
@@ -64,6 +96,22 @@ struct RenderItem
     XMFLOAT4X4 World = MathHelper::Identity4x4();
 	bool bIs2D = false;
 	XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+
+	// Dequantization of packed vertex positions, premultiplied onto each instance's world
+	// matrix when it is uploaded.  Copied from SubmeshGeometry::VertexTransform.
+	XMFLOAT4X4 VertexTransform = MathHelper::Identity4x4();
+
+	// Meshlets of the submesh, copied from SubmeshGeometry.  When MeshletCount is non-zero
+	// only VisibleIndexRanges, rebuilt by UpdateInstanceData every frame, are drawn.
+	UINT MeshletOffset = 0;
+	UINT MeshletCount = 0;
+	std::vector<MeshletBuilder::IndexRange> VisibleIndexRanges;
+
+	// The full detail submesh followed by its simplified versions (MeshGeometry::LodChain),
+	// or empty for a single level.  UpdateInstanceData picks LodIndex every frame and
+	// copies its draw parameters; meshlets are only culled at level 0.
+	std::vector<SubmeshGeometry> Lods;
+	UINT LodIndex = 0;
 	
 	// Dirty flag indicating the object data has changed and we need to update the constant buffer.
 	// Because we have an object cbuffer for each FrameResource, we have to apply the
@@ -76,7 +124,7 @@ struct RenderItem
 	UINT ObjCBIndex = -1;
 
 	BoundingBox Bounds;
-	std::vector<InstanceData> Instances;
+	std::vector<Instance> Instances;
 	
 	Material* Mat = nullptr;
 	MeshGeometry* Geo = nullptr;
@@ -91,12 +139,6 @@ struct RenderItem
     int BaseVertexLocation = 0;
 };
 
-struct indiceHolder
-{
-	UINT texCIndex;
-	UINT posIndex;
-};
-
 enum class RenderLayer : int
 {
 	Opaque = 0,
@@ -104,7 +146,8 @@ enum class RenderLayer : int
 	Sky = 2,
 	Rendered = 3,
 	EditorGUI = 4,
-	Count = 5
+	OpaquePacked = 5,
+	Count = 6
 	
 };
 
@@ -124,6 +167,14 @@ public:
 
     virtual bool Initialize()override;
 
+	///<summary>
+	/// Cooks every model in MyModels, including those inside its zip archives, and every
+	/// TGA image in Textures into the derived data cache.  This is the only path that
+	/// runs the OBJ and TGA importers; the scene loads no OBJ models or TGA images at run
+	/// time.  Returns the process exit code.
+	///</summary>
+	static int CookAssets();
+
 private:
     virtual void CreateRtvAndDsvDescriptorHeaps()override;
     virtual void OnResize()override;
@@ -137,13 +188,12 @@ private:
 	virtual void OnMouseWheelScroll(WPARAM btnState)override;
 	virtual void OnEditorInteraction(std::string info)override;
 	void SelectWorldObject(int sx, int sy);
-	DirectX::BoundingBox CalculateSubmeshBounds(GeometryGenerator::MeshData meshData);
+	DirectX::BoundingBox CalculateSubmeshBounds(const Vertex* vertices, UINT vertexCount);
 
     void OnKeyboardInput(const GameTimer& gt);
 	void AnimateMaterials(const GameTimer& gt);
 	void UpdateInstanceData(const GameTimer& gt);
-	int foundSimilarVertex(Vertex temp,std::vector<Vertex> vertices);
-	bool is_near(float v1, float v2);
+	float TextureScreenSize(const DirectX::BoundingBox& bounds, DirectX::FXMMATRIX viewToLocal, DirectX::CXMMATRIX texTransform);
 		
 	
 	void UpdateMaterialBuffer(const GameTimer& gt);
@@ -155,22 +205,31 @@ private:
 
 	void SpawnObject();
 	void LoadTextures();
+	void LoadTextureAsync(const std::string& name);
+	void CreateTextureSrv(const std::string& name);
+	void PollAssets();
 	void CreatePlayerView();
     void BuildRootSignature();
 	void BuildSsaoRootSignature();
 	void BuildDescriptorHeaps();
-	HRESULT LoadFBX(std::vector<Vertex> &pOutVertexVector);
     void BuildShadersAndInputLayout();
     void BuildShapeGeometry();
     void BuildSkullGeometry();
-	void FBXFunction();
 	void BuildBoxModel();
+	static void RegisterImporters(AssetCooker& cooker);
+	std::unique_ptr<MeshGeometry> BuildOptimizedGeometry(const std::string& geoName, std::vector<Vertex>& vertices,
+		std::vector<std::uint32_t>& indices, std::vector<MeshOptimizer::Submesh>& submeshes,
+		const std::vector<std::string>& submeshNames, bool packVertices);
+	static std::unique_ptr<MeshGeometry> PrepareOptimizedGeometry(const std::string& geoName, std::vector<Vertex>& vertices,
+		std::vector<std::uint32_t>& indices, std::vector<MeshOptimizer::Submesh>& submeshes,
+		const std::vector<std::string>& submeshNames, bool packVertices);
+	void UploadGeometry(MeshGeometry* geo, ID3D12GraphicsCommandList* cmdList);
     void BuildPSOs();
     void BuildFrameResources();
     void BuildMaterials();
     void BuildRenderItems();
 	void DrawEditorGUI(ID3D12GraphicsCommandList* cmdList);
-    void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+    void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems, bool cullMeshlets = true);
 	void DrawImmerseObjects(ID3D12GraphicsCommandList* cmdList, const std::vector<ImmerseObject*>& iObjects);
     void DrawSceneToShadowMap();
 	void DrawNormalsAndDepth();
@@ -202,11 +261,39 @@ private:
 	std::vector<std::unique_ptr<MeshGeometry>> mGUIGeometries;
 	std::unordered_map<std::string, std::unique_ptr<Material>> mMaterials;
 	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
+
+	// Packed assets, mapped for the lifetime of the app when Assets.pak exists.
+	AssetArchive mAssetArchive;
+	std::unique_ptr<AssetLoader> mAssetLoader;
+
+	// Models are cooked on first load and read back from the cache after that.
+	std::unique_ptr<DerivedDataCache> mDerivedDataCache;
+
+	// Material textures.  Materials store their slots in gTextureMaps as SRV heap
+	// indices.  Each frame resource has its own copy of the table, the first one at
+	// mTextureTableHeapIndex, which is refreshed when the frame is built.
+	std::unique_ptr<TextureManager> mTextureManager;
+	std::unordered_map<std::string, TextureManager::Handle> mTextureMaps;
+	UINT mTextureTableHeapIndex = 0;
+
+	// Hard cap on the memory of the material textures.
+	UINT64 mTextureBudget = 256ull * 1024 * 1024;
+
+	// Where the SRV of each texture in mTextures lives in mSrvDescriptorHeap.
+	struct TextureSrv
+	{
+		UINT HeapIndex = 0;
+		bool Cube = false;
+	};
+	std::unordered_map<std::string, TextureSrv> mTextureSrvs;
+
+	// Textures that have been uploaded but whose SRV still shows the placeholder.
+	std::vector<std::string> mArrivedTextures;
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
 
     std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
-	FbxManager* g_pFbxSdkManager = nullptr;
+	std::vector<D3D12_INPUT_ELEMENT_DESC> mPackedInputLayout;
  
 	std::vector<ImmerseText*> mImmerseTextObjects;
 	UINT textBufferLastIndiceIndex = 0;
@@ -266,11 +353,13 @@ private:
     float mLightNearZ = 0.0f;
     float mLightFarZ = 0.0f;
     XMFLOAT3 mLightPosW;
-    XMFLOAT4X4 mLightView = MathHelper::Identity4x4();
 	XMFLOAT4X4 mSpectateView = MathHelper::Identity4x4();
-    XMFLOAT4X4 mLightProj = MathHelper::Identity4x4();
     XMFLOAT4X4 mShadowTransform = MathHelper::Identity4x4();
 
+	// View, projection, their product and the inverses of all three for the shadow light.
+	// The cameras cache their own.
+	CameraTransforms mLightTransforms;
+
     float mLightRotationAngle = 0.0f;
     XMFLOAT3 mBaseLightDirections[3] = {
         XMFLOAT3(0.57735f, -0.57735f, 0.57735f),
@@ -287,7 +376,8 @@ private:
 
 	bool mFrustumCullingEnabled = true;
 
-	BoundingFrustum mCamFrustum;
+	// Render items use the coarsest LOD whose error projects to at most this many pixels.
+	float mLodErrorPixels = 1.0f;
 
 
     POINT mLastMousePos;
@@ -303,6 +393,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 
     try
     {
+        // "-cook" runs the cooker as a batch step instead of the app.
+        if (strstr(cmdLine, "-cook") != nullptr)
+            return MainApp::CookAssets();
+
         MainApp theApp(hInstance);
         if(!theApp.Initialize())
             return 0;
@@ -353,6 +447,20 @@ bool MainApp::Initialize()
 		mCommandList.Get(),
 		mClientWidth, mClientHeight);
 	engineEditor->mScreenViewport = &mScreenViewport;
+	mAssetLoader = std::make_unique<AssetLoader>(md3dDevice.Get());
+
+	// Without a packed archive every asset is read from its loose file.
+	if (FAILED(mAssetArchive.Open(L"Assets.pak")))
+		OutputDebugStringA("Assets.pak not found, loading loose files\n");
+
+	mTextureManager = std::make_unique<TextureManager>(md3dDevice.Get(), *mAssetLoader, gNumTextureMaps, mTextureBudget,
+		mAssetArchive.IsOpen() ? &mAssetArchive : nullptr);
+
+	mDerivedDataCache = std::make_unique<DerivedDataCache>(L"DerivedDataCache");
+
+	// Textures loaded during initialization are uploaded by the command list flushed at
+	// the end, which counts as the first frame.
+	mTextureManager->BeginFrame(mFence->GetCompletedValue(), mCurrentFence + 1);
 
 
 	LoadTextures();
@@ -417,7 +525,6 @@ void MainApp::OnResize()
 	}
 	mCamera.SetLens(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
 	mSpectateCamera.SetLens(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
-	BoundingFrustum::CreateFromMatrix(mCamFrustum, mCamera.GetProj());
 
 	if (mSsao != nullptr)
 	{
@@ -463,13 +570,23 @@ void MainApp::Update(const GameTimer& gt)
         WaitForSingleObject(eventHandle, INFINITE);
         CloseHandle(eventHandle);
     }
+
+	mTextureManager->BeginFrame(mFence->GetCompletedValue(), mCurrentFence + 1);
+
+	// Hand assets that finished loading in the background over to the GPU.
+	PollAssets();
+
 	assert(engineEditor != nullptr);
 	engineEditor->Update(gt);
 
 	AnimateMaterials(gt);
-	
+
 	UpdateInstanceData(gt);
 
+	// UpdateInstanceData marked the textures of visible materials as used.
+	mTextureManager->Update();
+	mTextureManager->CopyDescriptors(GetCpuSrv(mTextureTableHeapIndex + mCurrFrameResourceIndex * gNumTextureMaps));
+
 	UpdateMaterialBuffer(gt);
     UpdateShadowTransform(gt);
 	UpdatePlayerPassCB(gt);
@@ -511,7 +628,7 @@ void MainApp::Draw(const GameTimer& gt)
     // Bind all the textures used in this scene.  Observe
     // that we only have to specify the first descriptor in the table.  
     // The root signature knows how many descriptors are expected in the table.
-    mCommandList->SetGraphicsRootDescriptorTable(4, mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+    mCommandList->SetGraphicsRootDescriptorTable(4, GetGpuSrv(mTextureTableHeapIndex + mCurrFrameResourceIndex * gNumTextureMaps));
 
     DrawSceneToShadowMap();
 
@@ -552,7 +669,7 @@ void MainApp::Draw(const GameTimer& gt)
     // Specify the buffers we are going to render to.
     mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
 
-	mCommandList->SetGraphicsRootDescriptorTable(4, mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+	mCommandList->SetGraphicsRootDescriptorTable(4, GetGpuSrv(mTextureTableHeapIndex + mCurrFrameResourceIndex * gNumTextureMaps));
 
 	mCommandList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
 
@@ -567,6 +684,9 @@ void MainApp::Draw(const GameTimer& gt)
 	
 	DrawImmerseObjects(mCommandList.Get(), mAllImmerseObjects);
 
+	mCommandList->SetPipelineState(mPSOs["opaque_packed"].Get());
+	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::OpaquePacked]);
+
    // mCommandList->SetPipelineState(mPSOs["debug"].Get());
 	//DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Debug]);
 
@@ -665,13 +785,11 @@ void MainApp::SelectWorldObject(int sx, int sy)
 	XMVECTOR rayOrigin = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
 	XMVECTOR rayDir = XMVectorSet(vx, vy, 1.0f, 0.0f);
 
-	XMMATRIX V = mCamera.GetView();
-	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(V), V);
+	XMMATRIX invView = mCamera.GetTransforms().InvView.Matrix();
 
 	for (auto object : mAllImmerseObjects)
 	{
-		XMMATRIX W = XMLoadFloat4x4(&object->World);
-		XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(W), W);
+		XMMATRIX invWorld = Transform(object->World, Transform::Kind::Affine).Inverse().Matrix();
 
 		// Tranform ray to vi space of Mesh.
 		XMMATRIX toLocal = XMMatrixMultiply(invView, invWorld);
@@ -703,7 +821,7 @@ void MainApp::SelectWorldObject(int sx, int sy)
 
 }
 
-DirectX::BoundingBox MainApp::CalculateSubmeshBounds(GeometryGenerator::MeshData meshData)
+DirectX::BoundingBox MainApp::CalculateSubmeshBounds(const Vertex* vertices, UINT vertexCount)
 {
 	XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
 	XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
@@ -711,10 +829,9 @@ DirectX::BoundingBox MainApp::CalculateSubmeshBounds(GeometryGenerator::MeshData
 	XMVECTOR vMin = XMLoadFloat3(&vMinf3);
 	XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
 	
-	for (int i = 0; i < (int)meshData.Vertices.size(); i++)
+	for (UINT i = 0; i < vertexCount; i++)
 	{
-		auto vert = meshData.Vertices[i];
-		XMVECTOR P = XMLoadFloat3(&vert.Position);
+		XMVECTOR P = XMLoadFloat3(&vertices[i].Pos);
 		vMin = XMVectorMin(vMin, P);
 		vMax = XMVectorMax(vMax, P);
 	}
@@ -792,11 +909,43 @@ void MainApp::AnimateMaterials(const GameTimer& gt)
 	
 }
 
+// Pixels one unit of texture coordinates covers on screen at the nearest point of bounds.
+// Meshes are assumed to spread 0 to 1 over their bounds, which texTransform then repeats.
+float MainApp::TextureScreenSize(const BoundingBox& bounds, FXMMATRIX viewToLocal, CXMMATRIX texTransform)
+{
+	float size = 2.0f * XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)));
+	float repeat = MathHelper::Max(XMVectorGetX(XMVector2Length(texTransform.r[0])),
+		XMVectorGetX(XMVector2Length(texTransform.r[1])));
+
+	float toCenter = XMVectorGetX(XMVector3Length(XMVectorSubtract(viewToLocal.r[3], XMLoadFloat3(&bounds.Center))));
+	float distance = MathHelper::Max(toCenter - 0.5f * size, 0.0f);
+
+	return MeshSimplifier::ScreenSpaceError(size / MathHelper::Max(repeat, 1e-4f), distance,
+		mCamera.GetProj4x4f()(1, 1), (float)mClientHeight);
+}
+
 void MainApp::UpdateInstanceData(const GameTimer & gt)
 {
 	
-	XMMATRIX view = mCamera.GetView();
-	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
+	const XMFLOAT4X4& invView = mCamera.GetTransforms().InvView.Float4x4();
+	const BatchMath::FrustumPlanes& frustumPlanes = mCamera.GetFrustumPlanes();
+	const BoundingFrustum& viewFrustum = mCamera.GetViewFrustum();
+
+	// The per instance data of one item at a time, computed in batches from the compact
+	// transforms: the world matrix, view space to the instance's local space, the world
+	// matrix the shaders see, transposed, and whether the instance's world space bounds
+	// touch the camera frustum.
+	std::vector<XMFLOAT4X4> worlds;
+	std::vector<XMFLOAT4X4> viewToLocals;
+	std::vector<XMFLOAT4X4> shaderWorlds;
+	std::vector<BoundingBox> worldBounds;
+	std::vector<std::uint8_t> instanceVisible;
+	std::vector<MeshletBuilder::LocalView> meshletViews;
+
+	// Largest texture screen size of the instances inside the frustum, by material index,
+	// or zero for materials that are not visible.  TextureManager keeps the textures of the
+	// visible materials resident at the mips this asks for.
+	std::vector<float> materialScreenSize(mMaterials.size(), 0.0f);
 
 
 			
@@ -809,26 +958,68 @@ void MainApp::UpdateInstanceData(const GameTimer & gt)
 		const auto& instanceData = e->Instances;
 		auto currInstanceBuffer = mCurrFrameResource->renderItemBuffers[e->instanceBufferIndex].get();
 		int visibleInstanceCount = 0;
+
+		// The camera as seen by each visible instance; a meshlet is drawn for every
+		// instance if any of them can see it.
+		meshletViews.clear();
+
+		// Distance from the eye to the bounds of the closest instance, in local space like
+		// the LOD errors.
+		float nearestDistance = MathHelper::Infinity;
+
+		UINT instanceCount = (UINT)instanceData.size();
+		worlds.resize(instanceCount);
+		viewToLocals.resize(instanceCount);
+		shaderWorlds.resize(instanceCount);
+		worldBounds.resize(instanceCount);
+		instanceVisible.resize(instanceCount);
+		if (instanceCount > 0)
+		{
+			const InstanceTransform* transforms = &instanceData[0].World;
+			BatchMath::ComposeTransforms(transforms, sizeof(Instance), worlds.data(), instanceCount);
+			BatchMath::InverseTransforms(transforms, sizeof(Instance), viewToLocals.data(), instanceCount);
+			BatchMath::MultiplyAffine(&invView, 0, viewToLocals.data(), sizeof(XMFLOAT4X4), viewToLocals.data(), instanceCount);
+			BatchMath::TransformBoxes(&e->Bounds, 0, worlds.data(), sizeof(XMFLOAT4X4), worldBounds.data(), instanceCount);
+			BatchMath::CullBoxes(frustumPlanes, worldBounds.data(), sizeof(BoundingBox), instanceVisible.data(), instanceCount);
+			BatchMath::MultiplyAffine(&e->VertexTransform, 0, worlds.data(), sizeof(XMFLOAT4X4), shaderWorlds.data(), instanceCount);
+			BatchMath::StoreTransposed(shaderWorlds.data(), sizeof(XMFLOAT4X4), shaderWorlds.data(), instanceCount);
+		}
 		
-		for (UINT i = 0; i < (UINT)instanceData.size(); ++i)
+		for (UINT i = 0; i < instanceCount; ++i)
 		{
 
-			XMMATRIX world = XMLoadFloat4x4(&instanceData[i].World);
-			XMMATRIX texTransform = XMLoadFloat4x4(&instanceData[i].TexTransform);
-
-			XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(world), world);
+			XMMATRIX texTransform = instanceData[i].TexTransform();
 
 			// View space to the object's local space.
-			XMMATRIX viewToLocal = XMMatrixMultiply(invView, invWorld);
+			XMMATRIX viewToLocal = XMLoadFloat4x4(&viewToLocals[i]);
 
-			// Transform the camera frustum from view space to the object's local space.
-			BoundingFrustum localSpaceFrustum;
-			mCamFrustum.Transform(localSpaceFrustum, viewToLocal);
+			UINT materialIndex = instanceData[i].MaterialIndex;
+			if (instanceVisible[i] && materialIndex < materialScreenSize.size())
+			{
+				materialScreenSize[materialIndex] = MathHelper::Max(materialScreenSize[materialIndex],
+					TextureScreenSize(e->Bounds, viewToLocal, texTransform));
+			}
 
-			// Perform the box/frustum intersection test in local space.
+			// The meshlets of visible instances are culled against the frustum and the eye
+			// position in the object's local space.
+			if (instanceVisible[i] && e->MeshletCount > 0)
+			{
+				MeshletBuilder::LocalView view;
+				viewFrustum.Transform(view.Frustum, viewToLocal);
+				XMStoreFloat3(&view.Eye, viewToLocal.r[3]);
+				meshletViews.push_back(view);
+			}
+
+			if (!e->Lods.empty())
+			{
+				const BoundingBox& bounds = e->Lods[0].Bounds;
+				float toCenter = XMVectorGetX(XMVector3Length(XMVectorSubtract(viewToLocal.r[3], XMLoadFloat3(&bounds.Center))));
+				float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&bounds.Extents)));
+				nearestDistance = MathHelper::Min(nearestDistance, MathHelper::Max(toCenter - radius, 0.0f));
+			}
 
 			InstanceData data;
-			XMStoreFloat4x4(&data.World, XMMatrixTranspose(world));
+			data.World = shaderWorlds[i];
 			XMStoreFloat4x4(&data.TexTransform, XMMatrixTranspose(texTransform));
 			data.MaterialIndex = instanceData[i].MaterialIndex;
 
@@ -841,7 +1032,28 @@ void MainApp::UpdateInstanceData(const GameTimer & gt)
 
 		e->InstanceCount = visibleInstanceCount;
 
+		if (!e->Lods.empty())
+		{
+			UINT lod = 0;
+			while (lod + 1 < (UINT)e->Lods.size() &&
+				MeshSimplifier::ScreenSpaceError(e->Lods[lod + 1].LodError, nearestDistance,
+					mCamera.GetProj4x4f()(1, 1), (float)mClientHeight) <= mLodErrorPixels)
+			{
+				++lod;
+			}
 
+			e->LodIndex = lod;
+			e->IndexCount = e->Lods[lod].IndexCount;
+			e->StartIndexLocation = e->Lods[lod].StartIndexLocation;
+			e->BaseVertexLocation = e->Lods[lod].BaseVertexLocation;
+		}
+
+		e->VisibleIndexRanges.clear();
+		if (e->MeshletCount > 0)
+		{
+			MeshletBuilder::Cull(e->Geo->Meshlets.Meshlets, e->MeshletOffset, e->MeshletCount,
+				meshletViews.data(), (UINT)meshletViews.size(), e->VisibleIndexRanges);
+		}
 	}
 
 	
@@ -852,25 +1064,40 @@ void MainApp::UpdateInstanceData(const GameTimer & gt)
 		auto currInstanceBuffer = mCurrFrameResource->ImmerseObjectBuffer.get();
 		int visibleInstanceCount = 0;
 
-		for (UINT i = 0; i < (UINT)instanceData.size(); ++i)
+		UINT instanceCount = (UINT)instanceData.size();
+		worlds.resize(instanceCount);
+		viewToLocals.resize(instanceCount);
+		shaderWorlds.resize(instanceCount);
+		worldBounds.resize(instanceCount);
+		instanceVisible.resize(instanceCount);
+		if (instanceCount > 0)
 		{
+			const InstanceTransform* transforms = &instanceData[0].World;
+			BatchMath::ComposeTransforms(transforms, sizeof(Instance), worlds.data(), instanceCount);
+			BatchMath::InverseTransforms(transforms, sizeof(Instance), viewToLocals.data(), instanceCount);
+			BatchMath::MultiplyAffine(&invView, 0, viewToLocals.data(), sizeof(XMFLOAT4X4), viewToLocals.data(), instanceCount);
+			BatchMath::TransformBoxes(&e->Bounds, 0, worlds.data(), sizeof(XMFLOAT4X4), worldBounds.data(), instanceCount);
+			BatchMath::CullBoxes(frustumPlanes, worldBounds.data(), sizeof(BoundingBox), instanceVisible.data(), instanceCount);
+			BatchMath::StoreTransposed(worlds.data(), sizeof(XMFLOAT4X4), shaderWorlds.data(), instanceCount);
+		}
 
-			XMMATRIX world = XMLoadFloat4x4(&instanceData[i].World);
-			XMMATRIX texTransform = XMLoadFloat4x4(&instanceData[i].TexTransform);
+		for (UINT i = 0; i < instanceCount; ++i)
+		{
 
-			XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(world), world);
+			XMMATRIX texTransform = instanceData[i].TexTransform();
 
 			// View space to the object's local space.
-			XMMATRIX viewToLocal = XMMatrixMultiply(invView, invWorld);
-
-			// Transform the camera frustum from view space to the object's local space.
-			BoundingFrustum localSpaceFrustum;
-			mCamFrustum.Transform(localSpaceFrustum, viewToLocal);
+			XMMATRIX viewToLocal = XMLoadFloat4x4(&viewToLocals[i]);
 
-			// Perform the box/frustum intersection test in local space.
+			UINT materialIndex = instanceData[i].MaterialIndex;
+			if (instanceVisible[i] && materialIndex < materialScreenSize.size())
+			{
+				materialScreenSize[materialIndex] = MathHelper::Max(materialScreenSize[materialIndex],
+					TextureScreenSize(e->Bounds, viewToLocal, texTransform));
+			}
 
 			InstanceData data;
-			XMStoreFloat4x4(&data.World, XMMatrixTranspose(world));
+			data.World = shaderWorlds[i];
 			XMStoreFloat4x4(&data.TexTransform, XMMatrixTranspose(texTransform));
 			data.MaterialIndex = instanceData[i].MaterialIndex;
 
@@ -885,6 +1112,22 @@ void MainApp::UpdateInstanceData(const GameTimer & gt)
 
 
 	}
+
+	for (auto& m : mMaterials)
+	{
+		Material* mat = m.second.get();
+		if (mat->MatCBIndex >= 0 && mat->MatCBIndex < (int)materialScreenSize.size() && materialScreenSize[mat->MatCBIndex] > 0.0f)
+		{
+			// The material transform repeats the texture further.
+			XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
+			float repeat = MathHelper::Max(XMVectorGetX(XMVector2Length(matTransform.r[0])),
+				XMVectorGetX(XMVector2Length(matTransform.r[1])));
+			float screenSize = materialScreenSize[mat->MatCBIndex] / MathHelper::Max(repeat, 1e-4f);
+
+			mTextureManager->MarkUsed(mat->DiffuseSrvHeapIndex, screenSize);
+			mTextureManager->MarkUsed(mat->NormalSrvHeapIndex, screenSize);
+		}
+	}
 	
 	
 
@@ -901,6 +1144,16 @@ void MainApp::UpdateMaterialBuffer(const GameTimer& gt)
 		// Only update the cbuffer data if the constants have changed.  If the cbuffer
 		// data changes, it needs to be updated for each FrameResource.
 		Material* mat = e.second.get();
+
+		// Known once the normal map's file has been read.  Rebuilding z is also right for
+		// the three channel placeholder shown until then.
+		bool twoChannel = mTextureManager->Format(mat->NormalSrvHeapIndex) == DXGI_FORMAT_BC5_UNORM;
+		if(twoChannel != mat->NormalMapTwoChannel)
+		{
+			mat->NormalMapTwoChannel = twoChannel;
+			mat->NumFramesDirty = gNumFrameResources;
+		}
+
 		if(mat->NumFramesDirty > 0)
 		{
 			XMMATRIX matTransform = XMLoadFloat4x4(&mat->MatTransform);
@@ -912,6 +1165,7 @@ void MainApp::UpdateMaterialBuffer(const GameTimer& gt)
 			XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
 			matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
 			matData.NormalMapIndex = mat->NormalSrvHeapIndex;
+			matData.NormalMapTwoChannel = mat->NormalMapTwoChannel ? 1 : 0;
 
 			currMaterialBuffer->CopyData(mat->MatCBIndex, matData);
 
@@ -958,21 +1212,22 @@ void MainApp::UpdateShadowTransform(const GameTimer& gt)
         0.5f, 0.5f, 0.0f, 1.0f);
 
     XMMATRIX S = lightView*lightProj*T;
-    XMStoreFloat4x4(&mLightView, lightView);
-    XMStoreFloat4x4(&mLightProj, lightProj);
+    mLightTransforms = CameraTransforms(Transform(lightView, Transform::Kind::Rigid),
+        Transform(lightProj, Transform::Kind::Orthographic));
     XMStoreFloat4x4(&mShadowTransform, S);
 }
 
 void MainApp::UpdateSpectatePassCB(const GameTimer& gt)
 {
 	//mSpectateCamera.UpdateViewMatrix();
-	XMMATRIX view = mSpectateCamera.GetView();
-	XMMATRIX proj = mSpectateCamera.GetProj();
+	const CameraTransforms& transforms = mSpectateCamera.GetTransforms();
+	XMMATRIX view = transforms.View.Matrix();
+	XMMATRIX proj = transforms.Proj.Matrix();
 
-	XMMATRIX viewProj = XMMatrixMultiply(view, proj);
-	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
-	XMMATRIX invProj = XMMatrixInverse(&XMMatrixDeterminant(proj), proj);
-	XMMATRIX invViewProj = XMMatrixInverse(&XMMatrixDeterminant(viewProj), viewProj);
+	XMMATRIX viewProj = transforms.ViewProj.Matrix();
+	XMMATRIX invView = transforms.InvView.Matrix();
+	XMMATRIX invProj = transforms.InvProj.Matrix();
+	XMMATRIX invViewProj = transforms.InvViewProj.Matrix();
 
 	XMMATRIX shadowTransform = XMLoadFloat4x4(&mShadowTransform);
 
@@ -1003,7 +1258,7 @@ void MainApp::UpdateSsaoCB(const GameTimer & gt)
 {
 	SsaoConstants ssaoCB;
 
-	XMMATRIX P = mCamera.GetProj();
+	XMMATRIX P = mCamera.GetTransforms().Proj.Matrix();
 
 	// Transform NDC space [-1,+1]^2 to texture space [0,1]^2
 	XMMATRIX T(
@@ -1037,13 +1292,14 @@ void MainApp::UpdateSsaoCB(const GameTimer & gt)
 
 void MainApp::UpdatePlayerPassCB(const GameTimer& gt)
 {
-	XMMATRIX view = mCamera.GetView();
-	XMMATRIX proj = mCamera.GetProj();
+	const CameraTransforms& transforms = mCamera.GetTransforms();
+	XMMATRIX view = transforms.View.Matrix();
+	XMMATRIX proj = transforms.Proj.Matrix();
 
-	XMMATRIX viewProj = XMMatrixMultiply(view, proj);
-	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
-	XMMATRIX invProj = XMMatrixInverse(&XMMatrixDeterminant(proj), proj);
-	XMMATRIX invViewProj = XMMatrixInverse(&XMMatrixDeterminant(viewProj), viewProj);
+	XMMATRIX viewProj = transforms.ViewProj.Matrix();
+	XMMATRIX invView = transforms.InvView.Matrix();
+	XMMATRIX invProj = transforms.InvProj.Matrix();
+	XMMATRIX invViewProj = transforms.InvViewProj.Matrix();
 
 	// Transform NDC space [-1,+1]^2 to texture space [0,1]^2
 	XMMATRIX T(
@@ -1083,13 +1339,13 @@ void MainApp::UpdatePlayerPassCB(const GameTimer& gt)
 
 void MainApp::UpdateShadowPassCB(const GameTimer& gt)
 {
-    XMMATRIX view = XMLoadFloat4x4(&mLightView);
-    XMMATRIX proj = XMLoadFloat4x4(&mLightProj);
+    XMMATRIX view = mLightTransforms.View.Matrix();
+    XMMATRIX proj = mLightTransforms.Proj.Matrix();
 
-    XMMATRIX viewProj = XMMatrixMultiply(view, proj);
-    XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
-    XMMATRIX invProj = XMMatrixInverse(&XMMatrixDeterminant(proj), proj);
-    XMMATRIX invViewProj = XMMatrixInverse(&XMMatrixDeterminant(viewProj), viewProj);
+    XMMATRIX viewProj = mLightTransforms.ViewProj.Matrix();
+    XMMATRIX invView = mLightTransforms.InvView.Matrix();
+    XMMATRIX invProj = mLightTransforms.InvProj.Matrix();
+    XMMATRIX invViewProj = mLightTransforms.InvViewProj.Matrix();
 
     UINT w = mShadowMap->Width();
     UINT h = mShadowMap->Height();
@@ -1153,8 +1409,8 @@ void MainApp::SpawnObject()
 		auto blah = mImmerseObjects[index].get();
 		blah->InstanceCount += 1;
 		blah->Instances.resize(blah->Instances.size() + 1);
-		XMStoreFloat4x4(&blah->Instances.back().World, XMMatrixScaling(2.0f, 2.0f, 2.0f)* DirectX::XMMatrixTranslationFromVector(mCamera.GetPosition() + XMVector3Normalize(mCamera.GetLook()) * 10.0f));
-		XMStoreFloat4x4(&blah->Instances.back().TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
+		blah->Instances.back().World = InstanceTransform::FromMatrix(XMMatrixScaling(2.0f, 2.0f, 2.0f)* DirectX::XMMatrixTranslationFromVector(mCamera.GetPosition() + XMVector3Normalize(mCamera.GetLook()) * 10.0f));
+		blah->Instances.back().TexScale = XMFLOAT2(1.0f, 1.0f);
 		blah->Instances.back().MaterialIndex = 0;
 
 	}
@@ -1163,8 +1419,8 @@ void MainApp::SpawnObject()
 	/*
 	auto test = mAllRitems[3].get();
 	test->Instances.resize(test->Instances.size() + 1);
-	XMStoreFloat4x4(&test->Instances.back().World, XMMatrixScaling(2.0f, 2.0f, 2.0f)* DirectX::XMMatrixTranslationFromVector(mCamera.GetPosition() + XMVector3Normalize(mCamera.GetLook()) * 10.0f));
-	XMStoreFloat4x4(&test->Instances.back().TexTransform, XMMatrixScaling(1.5f, 2.0f, 1.0f));
+	test->Instances.back().World = InstanceTransform::FromMatrix(XMMatrixScaling(2.0f, 2.0f, 2.0f)* DirectX::XMMatrixTranslationFromVector(mCamera.GetPosition() + XMVector3Normalize(mCamera.GetLook()) * 10.0f));
+	test->Instances.back().TexScale = XMFLOAT2(1.5f, 2.0f);
 	test->Instances.back().MaterialIndex = 0;
 
 	*/
@@ -1175,48 +1431,46 @@ void MainApp::SpawnObject()
 
 void MainApp::LoadTextures()
 {
-	std::vector<std::string> texNames = 
+	struct TextureFile
 	{
-		"bricksDiffuseMap",
-		"bricksNormalMap",
-		"tileDiffuseMap",
-		"tileNormalMap",
-		"defaultDiffuseMap",
-		"defaultNormalMap",
-		"skyCubeMap",
-		"AsphaltDiffuseMap",
-		"AsphaltNormalMap",
-		"ManDiffuseMap",
-		"ManNormalMap"
+		std::string Name;
+		std::wstring Filename;
 
+		// Drawn until the file has loaded.  Empty for the placeholders themselves, which
+		// are loaded right away and stay resident.
+		std::string Placeholder;
 	};
-	
-    std::vector<std::wstring> texFilenames =
-    {
-        L"Textures//bricks2.dds",
-        L"Textures//bricks2_nmap.dds",
-        L"Textures//tile.dds",
-        L"Textures//tile_nmap.dds",
-        L"Textures//white1x1.dds",
-        L"Textures//default_nmap.dds",
-        L"Textures//desertcube1024.dds",
-		L"Textures//Asphalt2DDS.dds",
-		L"Textures//Asphalt2DDSNorm.dds",
-		L"Textures//average_man_color1_df.dds",
-		L"Textures//average_man_nm+y.dds"
-    };
-	
-	for(int i = 0; i < (int)texNames.size(); ++i)
+
+	std::vector<TextureFile> textureFiles =
 	{
-		auto texMap = std::make_unique<Texture>();
-		texMap->Name = texNames[i];
-		texMap->Filename = texFilenames[i];
-		ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-			mCommandList.Get(), texMap->Filename.c_str(),
-			texMap->Resource, texMap->UploadHeap));
-			
-		mTextures[texMap->Name] = std::move(texMap);
+		{ "defaultDiffuseMap", L"Textures//white1x1.dds", "" },
+		{ "defaultNormalMap", L"Textures//default_nmap.dds", "" },
+		{ "bricksDiffuseMap", L"Textures//bricks2.dds", "defaultDiffuseMap" },
+		{ "bricksNormalMap", L"Textures//bricks2_nmap.dds", "defaultNormalMap" },
+		{ "tileDiffuseMap", L"Textures//tile.dds", "defaultDiffuseMap" },
+		{ "tileNormalMap", L"Textures//tile_nmap.dds", "defaultNormalMap" },
+		{ "AsphaltDiffuseMap", L"Textures//Asphalt2DDS.dds", "defaultDiffuseMap" },
+		{ "AsphaltNormalMap", L"Textures//Asphalt2DDSNorm.dds", "defaultNormalMap" },
+		{ "ManDiffuseMap", L"Textures//average_man_color1_df.dds", "defaultDiffuseMap" },
+		{ "ManNormalMap", L"Textures//average_man_nm+y.dds", "defaultNormalMap" }
+	};
+
+	// The material textures are read once a visible material uses them.
+	for(auto& file : textureFiles)
+	{
+		if(file.Placeholder.empty())
+			mTextureMaps[file.Name] = mTextureManager->AcquireResident(file.Filename, mCommandList.Get());
+		else
+			mTextureMaps[file.Name] = mTextureManager->Acquire(file.Filename, mTextureMaps[file.Placeholder]);
 	}
+
+	// The sky has a descriptor of its own and shows a null cube map until it has loaded.
+	auto skyCubeMap = std::make_unique<Texture>();
+	skyCubeMap->Name = "skyCubeMap";
+	skyCubeMap->Filename = L"Textures//desertcube1024.dds";
+	mTextures[skyCubeMap->Name] = std::move(skyCubeMap);
+	LoadTextureAsync("skyCubeMap");
+
 	engineEditor->fontTexture = std::make_unique<Texture>();
 	engineEditor->fontTexture->Name = "fontTexture";
 	engineEditor->fontTexture->Filename = L"Textures//Font1dds.dds";
@@ -1235,6 +1489,97 @@ void MainApp::LoadTextures()
 
 }
 
+void MainApp::LoadTextureAsync(const std::string& name)
+{
+	// The file is mapped (or found in the archive) and its header validated on a worker;
+	// the texture is created and its upload recorded on the render thread during
+	// PollAssets, which copies the subresources straight out of the mapping.
+	struct MappedTexture
+	{
+		AssetFile File;
+		DirectX::DDS_TEXTURE_LAYOUT12 Layout;
+		bool Valid = false;
+	};
+
+	auto mapped = std::make_shared<MappedTexture>();
+	std::wstring filename = mTextures[name]->Filename;
+
+	mAssetLoader->Load(
+		[this, mapped, filename]()
+		{
+			mapped->Valid = SUCCEEDED(mapped->File.Open(mAssetArchive.IsOpen() ? &mAssetArchive : nullptr, filename)) &&
+				SUCCEEDED(DirectX::GetDDSTextureLayout12(mapped->File.Data(), mapped->File.Size(), mapped->Layout));
+		},
+		[this, mapped, name](ID3D12GraphicsCommandList* uploadList)
+		{
+			ComPtr<ID3D12Resource> resource;
+			ComPtr<ID3D12Resource> uploadHeap;
+			bool created = mapped->Valid && SUCCEEDED(DirectX::CreateDDSTextureFromLayout12(md3dDevice.Get(),
+				uploadList, mapped->Layout, resource, uploadHeap));
+
+			// The upload heap holds its own copy of the data now.
+			mapped->File.Close();
+
+			if(!created)
+			{
+				std::string message = name + " could not be loaded, keeping its placeholder\n";
+				OutputDebugStringA(message.c_str());
+				return;
+			}
+
+			mAssetLoader->Retain(uploadHeap);
+			mTextures[name]->Resource = resource;
+			mArrivedTextures.push_back(name);
+		});
+}
+
+void MainApp::CreateTextureSrv(const std::string& name)
+{
+	const TextureSrv& slot = mTextureSrvs[name];
+	ID3D12Resource* resource = mTextures[name]->Resource.Get();
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+
+	// A null resource gets a null descriptor, which samples as zero.
+	srvDesc.Format = resource ? resource->GetDesc().Format : DXGI_FORMAT_R8G8B8A8_UNORM;
+	UINT mipLevels = resource ? resource->GetDesc().MipLevels : 1;
+
+	if(slot.Cube)
+	{
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+		srvDesc.TextureCube.MostDetailedMip = 0;
+		srvDesc.TextureCube.MipLevels = mipLevels;
+		srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
+	}
+	else
+	{
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MostDetailedMip = 0;
+		srvDesc.Texture2D.MipLevels = mipLevels;
+		srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+	}
+
+	md3dDevice->CreateShaderResourceView(resource, &srvDesc, GetCpuSrv(slot.HeapIndex));
+}
+
+void MainApp::PollAssets()
+{
+	mAssetLoader->Poll(mCommandQueue.Get());
+	if(mArrivedTextures.empty())
+		return;
+
+	// Only the sky still has its descriptor overwritten in place (material textures go
+	// through TextureManager's per frame tables), which is only allowed once no submitted
+	// frame can still read it, so its arrival costs one wait for the queue to drain.
+	if(mFence->GetCompletedValue() < mCurrentFence)
+		FlushCommandQueue();
+
+	for(const auto& name : mArrivedTextures)
+		CreateTextureSrv(name);
+	mArrivedTextures.clear();
+}
+
 void MainApp::CreatePlayerView()
 {
 	D3D12_RESOURCE_DESC texDesc;
@@ -1344,7 +1689,7 @@ void MainApp::BuildRootSignature()
 	texTable0.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 9, 0, 0);
 
 	CD3DX12_DESCRIPTOR_RANGE texTable1;
-	texTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 14, 9, 0);
+	texTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, gNumTextureMaps, 9, 0);
 
     // Root parameter can be a table, root descriptor or root constants.
     CD3DX12_ROOT_PARAMETER slotRootParameter[7];
@@ -1473,8 +1818,10 @@ void MainApp::BuildDescriptorHeaps()
 	//
 	// Create the SRV heap.
 	//
+	// Nine fixed descriptors (sky, shadow map, SSAO maps, font) followed by a material
+	// texture table per frame resource.
 	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = 19;
+	srvHeapDesc.NumDescriptors = 9 + gNumFrameResources * gNumTextureMaps;
 	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
@@ -1482,54 +1829,22 @@ void MainApp::BuildDescriptorHeaps()
 	//
 	// Fill out the heap with actual descriptors.
 	//
-	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-
-	std::vector<ComPtr<ID3D12Resource>> tex2DList = 
-	{
-		mTextures["bricksDiffuseMap"]->Resource,
-		mTextures["bricksNormalMap"]->Resource,
-		mTextures["tileDiffuseMap"]->Resource,
-		mTextures["tileNormalMap"]->Resource,
-		mTextures["defaultDiffuseMap"]->Resource,
-		mTextures["defaultNormalMap"]->Resource,
-		mTextures["AsphaltDiffuseMap"]->Resource,
-		mTextures["AsphaltNormalMap"]->Resource,
-		mTextures["ManDiffuseMap"]->Resource,
-		mTextures["ManNormalMap"]->Resource
-	};
-	
-	auto skyCubeMap = mTextures["skyCubeMap"]->Resource;
+	// The sky shows a null cube map until PollAssets rewrites its descriptor.
+	mSkyTexHeapIndex = 0;
+	mTextureSrvs["skyCubeMap"].HeapIndex = mSkyTexHeapIndex;
+	mTextureSrvs["skyCubeMap"].Cube = true;
+	CreateTextureSrv("skyCubeMap");
 
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MostDetailedMip = 0;
-	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
-	
-	for(UINT i = 0; i < (UINT)tex2DList.size(); ++i)
-	{
-		srvDesc.Format = tex2DList[i]->GetDesc().Format;
-		srvDesc.Texture2D.MipLevels = tex2DList[i]->GetDesc().MipLevels;
-		md3dDevice->CreateShaderResourceView(tex2DList[i].Get(), &srvDesc, hDescriptor);
 
-		// next descriptor
-		hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
-	}
-	
-	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
-	srvDesc.TextureCube.MostDetailedMip = 0;
-	srvDesc.TextureCube.MipLevels = skyCubeMap->GetDesc().MipLevels;
-	srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
-	srvDesc.Format = skyCubeMap->GetDesc().Format;
-	md3dDevice->CreateShaderResourceView(skyCubeMap.Get(), &srvDesc, hDescriptor);
-	
-	mSkyTexHeapIndex = (UINT)tex2DList.size();
     mShadowMapHeapIndex = mSkyTexHeapIndex + 1;
 	mSsaoHeapIndexStart = mShadowMapHeapIndex + 1;
 	mSsaoAmbientMapIndex = mSsaoHeapIndexStart + 3;
     mNullCubeSrvIndex = mSsaoHeapIndexStart + 5;
 	
     mNullTexSrvIndex1 = mNullCubeSrvIndex + 1;
+	mTextureTableHeapIndex = mNullTexSrvIndex1 + 1;
 	
 
 
@@ -1582,441 +1897,213 @@ void MainApp::BuildDescriptorHeaps()
 	
 }
 
-HRESULT MainApp::LoadFBX(std::vector<Vertex> &pOutVertexVector)
+void MainApp::BuildShadersAndInputLayout()
 {
-	if (g_pFbxSdkManager == nullptr)
-	{
-		g_pFbxSdkManager = FbxManager::Create();
+	const std::vector<ShaderCache::Define> alphaTestDefines = { { "ALPHA_TEST", "1" } };
+	const std::vector<ShaderCache::Define> packedNormalDefines = { { "PACKED_NORMALS", "1" } };
 
-		FbxIOSettings* pIOsettings = FbxIOSettings::Create(g_pFbxSdkManager, IOSROOT);
-		g_pFbxSdkManager->SetIOSettings(pIOsettings);
-	}
-	std::string pi = " Failed to set file name ";
-	std::wstring stemp = std::wstring(pi.begin(), pi.end());
-	LPCWSTR sw = stemp.c_str();
-	
-	FbxImporter* pImporter = FbxImporter::Create(g_pFbxSdkManager, "");
-	FbxScene* pFbxScene = FbxScene::Create(g_pFbxSdkManager, "");
+	// Bytecode is kept between runs and only recompiled when a shader or something it
+	// includes changes.
+	ShaderCache shaderCache(mDerivedDataCache->Directory() + L"\\Shaders.cache", d3dUtil::ShaderCompiler());
 
-	bool bSuccess = pImporter->Initialize("MyModels//man.fbx", -1, g_pFbxSdkManager->GetIOSettings());
-	if (!bSuccess)
-	{
-		
-		return E_FAIL;
-	}
-	bSuccess = pImporter->Import(pFbxScene);
-	if (!bSuccess) return E_FAIL;
+	// Every permutation is declared first and then compiled together, in parallel, with
+	// duplicates compiled once.
+	ShaderPermutations permutations(shaderCache);
 
-	pImporter->Destroy();
+	permutations.Add("standardVS", L"Shaders\\Default.hlsl", "VS", "vs_5_1");
+	permutations.Add("opaquePS", L"Shaders\\Default.hlsl", "PS", "ps_5_1");
+	permutations.Add("standardPackedVS", L"Shaders\\Default.hlsl", "VS", "vs_5_1", packedNormalDefines);
 
-	FbxNode* pFbxRootNode = pFbxScene->GetRootNode();
+	permutations.Add("shadowVS", L"Shaders\\Shadows.hlsl", "VS", "vs_5_1");
+	permutations.Add("shadowOpaquePS", L"Shaders\\Shadows.hlsl", "PS", "ps_5_1");
+	permutations.Add("shadowAlphaTestedPS", L"Shaders\\Shadows.hlsl", "PS", "ps_5_1", alphaTestDefines);
 
+	permutations.Add("debugVS", L"Shaders\\ShadowDebug.hlsl", "VS", "vs_5_1");
+	permutations.Add("debugPS", L"Shaders\\ShadowDebug.hlsl", "PS", "ps_5_1");
 
-	if (pFbxRootNode)
-	{
-		
-		for (int i = 0; i < pFbxRootNode->GetChildCount(); i++)
-		{
+	permutations.Add("drawNormalsVS", L"Shaders\\DrawNormals.hlsl", "VS", "vs_5_1");
+	permutations.Add("drawNormalsPS", L"Shaders\\DrawNormals.hlsl", "PS", "ps_5_1");
+	permutations.Add("drawNormalsPackedVS", L"Shaders\\DrawNormals.hlsl", "VS", "vs_5_1", packedNormalDefines);
 
-			FbxNode* pFbxChildNode = pFbxRootNode->GetChild(i);
-			
+	permutations.Add("ssaoVS", L"Shaders\\Ssao.hlsl", "VS", "vs_5_1");
+	permutations.Add("ssaoPS", L"Shaders\\Ssao.hlsl", "PS", "ps_5_1");
 
-			if (pFbxChildNode->GetNodeAttribute() == NULL)
-				continue;
+	permutations.Add("ssaoBlurVS", L"Shaders\\SsaoBlur.hlsl", "VS", "vs_5_1");
+	permutations.Add("ssaoBlurPS", L"Shaders\\SsaoBlur.hlsl", "PS", "ps_5_1");
 
-			FbxNodeAttribute::EType AttributeType = pFbxChildNode->GetNodeAttribute()->GetAttributeType();
+	permutations.Add("skyVS", L"Shaders\\Sky.hlsl", "VS", "vs_5_1");
+	permutations.Add("skyPS", L"Shaders\\Sky.hlsl", "PS", "ps_5_1");
 
-			if (AttributeType != FbxNodeAttribute::eMesh)
-				continue;
+	permutations.Add("editorVS", L"Shaders\\EditorGUI.hlsl", "VS", "vs_5_1");
+	permutations.Add("editorPS", L"Shaders\\EditorGUI.hlsl", "PS", "ps_5_1");
+	permutations.Add("fontVS", L"Shaders\\FontShader.hlsl", "VS", "vs_5_1");
+	permutations.Add("fontPS", L"Shaders\\FontShader.hlsl", "PS", "ps_5_1");
 
-			FbxMesh* pMesh = (FbxMesh*)pFbxChildNode->GetNodeAttribute();
-			FbxStringList lUVSetNameList;
-			pMesh->GetUVSetNames(lUVSetNameList);
-			int materialCount = pFbxChildNode->GetSrcObjectCount<FbxSurfaceMaterial>();
-			std::string nodeName(pFbxChildNode->GetName());
+	std::string errors;
+	ShaderPermutations::BuildReport report = permutations.Build(errors);
 
-			for (int index = 0; index < materialCount; index++)
-			{
+	if (!errors.empty())
+		OutputDebugStringA(errors.c_str());
 
-				
-				FbxSurfaceMaterial* material = (FbxSurfaceMaterial*)pFbxChildNode->GetSrcObject<FbxSurfaceMaterial>(index);
-				
-		
+	if (report.Failed > 0)
+		throw DxException(E_FAIL, L"ShaderPermutations::Build", AnsiToWString(__FILE__), __LINE__);
 
-				
-				if (material != NULL)
-				{
-
-					
-					// This only gets the material of type sDiffuse, you probably need to traverse all Standard Material Property by its name to get all possible textures.
-					FbxProperty prop = material->FindProperty(FbxSurfaceMaterial::sDiffuse);
-					
-					// Check if it's layeredtextures
-					int layeredTextureCount = prop.GetSrcObjectCount<FbxLayeredTexture>();
-
-					if (layeredTextureCount > 0)
-					{
-						for (int j = 0; j < layeredTextureCount; j++)
-						{
-							FbxLayeredTexture* layered_texture = FbxCast<FbxLayeredTexture>(prop.GetSrcObject<FbxLayeredTexture>(j));
-							int lcount = layered_texture->GetSrcObjectCount<FbxTexture>();
-
-							for (int k = 0; k < lcount; k++)
-							{
-								FbxTexture* texture = FbxCast<FbxTexture>(layered_texture->GetSrcObject<FbxTexture>(k));
-								
-								// Then, you can get all the properties of the texture, include its name
-								FbxFileTexture* fTexture = FbxCast<FbxFileTexture>(texture);
-								if (fTexture != NULL)
-								{	
-
-
-								}
-
-
-
-							}
-						}
-					}
-					else
-					{
-						// Directly get textures
-						int textureCount = prop.GetSrcObjectCount<FbxTexture>();
-						for (int j = 0; j < textureCount; j++)
-						{
-							FbxTexture* texture = FbxCast<FbxTexture>(prop.GetSrcObject<FbxTexture>(j));
-							FbxFileTexture* fTexture = FbxCast<FbxFileTexture>(texture);
-							if (fTexture != NULL)
-							{
-
-							}
-							
-							
-
-							
-						}
-					}
-				}
-
-			}
-			
-			
-			FbxVector4* pVertices = pMesh->GetControlPoints();
-			
-
-			for (int j = 0; j < pMesh->GetPolygonCount(); j++)
-			{
-				int iNumVertices = pMesh->GetPolygonSize(j);
-				assert(iNumVertices == 3);
-
-				for (int k = 0; k < iNumVertices; k++) {
-					int iControlPointIndex = pMesh->GetPolygonVertex(j, k);
-					FbxVector2 vecFBX;
-					
-
-					Vertex vertex;
-					vertex.Pos.x = (float)pVertices[iControlPointIndex].mData[0];
-					vertex.Pos.y = (float)pVertices[iControlPointIndex].mData[1];
-					vertex.Pos.z = (float)pVertices[iControlPointIndex].mData[2];
-					int uvElementCount = pMesh->GetElementUVCount();
-
-					for (int uvElement = 0; uvElement < uvElementCount; uvElement++)
-					{
-						FbxGeometryElementUV* geomElementUV = pMesh->GetElementUV(uvElement);
-						
-						const char* name = geomElementUV->GetName();
-						FbxLayerElement::EMappingMode mapMode = geomElementUV->GetMappingMode();
-						FbxLayerElement::EReferenceMode refMode = geomElementUV->GetReferenceMode();
-
-						int directIndex = -1;
-
-						if (FbxGeometryElement::eByControlPoint == mapMode)
-						{
-
-							if (FbxGeometryElement::eDirect == refMode)
-							{
-								directIndex = iControlPointIndex;
-							}
-							else if (FbxGeometryElement::eIndexToDirect == refMode)
-							{
-								directIndex = geomElementUV->GetIndexArray().GetAt(iControlPointIndex);
-							}
-						}
-						else if (FbxGeometryElement::eByPolygonVertex == mapMode)
-						{
-
-							if (FbxGeometryElement::eDirect == refMode || FbxGeometryElement::eIndexToDirect == refMode)
-							{
-								directIndex = pMesh->GetTextureUVIndex(j, k);
-							}
-
-						}
-
-						// If we got a UV index
-						if (directIndex != -1)
-						{
-							FbxVector2 uv = geomElementUV->GetDirectArray().GetAt(directIndex);
-							float x = static_cast<float>(uv.mData[0]);
-							float y = static_cast<float>(uv.mData[1]);
-							
-							if (x == 0.0f && y == 0.0f)
-							{
-								vertex.TexC.x = x;
-								vertex.TexC.y = 1.0f - y;
-
-							}
-							else
-							{
-								vertex.TexC.x = x;
-								vertex.TexC.y = 1.0f - y;
-							}
-							
-	
-						}
-						else
-						{
-							OutputDebugString(sw);
-						}
-					}
-					// Grab normals
-					int normElementCount = pMesh->GetElementNormalCount();
-
-					for (int normElement = 0; normElement < normElementCount; normElement++)
-					{
-						FbxGeometryElementNormal* geomElementNormal = pMesh->GetElementNormal(normElement);
-
-						FbxLayerElement::EMappingMode mapMode = geomElementNormal->GetMappingMode();
-						FbxLayerElement::EReferenceMode refMode = geomElementNormal->GetReferenceMode();
-
-						int directIndex = -1;
-
-						if (FbxGeometryElement::eByPolygonVertex == mapMode)
-						{
-							if (FbxGeometryElement::eDirect == refMode)
-							{
-								directIndex = iControlPointIndex;
-							}
-							else if (FbxGeometryElement::eIndexToDirect == refMode)
-							{
-								directIndex = geomElementNormal->GetIndexArray().GetAt(iControlPointIndex);
-							}
-						}
-
-						// If we got an index
-						if (directIndex != -1)
-						{
-							FbxVector4 norm = geomElementNormal->GetDirectArray().GetAt(directIndex);
-							vertex.Normal.x = static_cast<float>(norm[0]);
-							vertex.Normal.x = static_cast<float>(norm[1]);
-							vertex.Normal.x = static_cast<float>(norm[2]);
-							
-
-						}
-						else
-						{
-							pi = " vert has no Normal ";
-							stemp = std::wstring(pi.begin(), pi.end());
-							sw = stemp.c_str();
-							OutputDebugString(sw);
-						}
-					}
-					pOutVertexVector.push_back(vertex);
-					
-				}
-			}
-
-		}
-
-	}
-	return S_OK;
-}
-
-void MainApp::BuildShadersAndInputLayout()
-{
-	const D3D_SHADER_MACRO alphaTestDefines[] =
-	{
-		"ALPHA_TEST", "1",
-		NULL, NULL
-	};
+	for (const ShaderPermutations::Permutation& permutation : permutations.All())
+		mShaders[permutation.Key] = d3dUtil::CreateBlob(permutation.Bytecode);
 
-	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "PS", "ps_5_1");
-
-    mShaders["shadowVS"] = d3dUtil::CompileShader(L"Shaders\\Shadows.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["shadowOpaquePS"] = d3dUtil::CompileShader(L"Shaders\\Shadows.hlsl", nullptr, "PS", "ps_5_1");
-    mShaders["shadowAlphaTestedPS"] = d3dUtil::CompileShader(L"Shaders\\Shadows.hlsl", alphaTestDefines, "PS", "ps_5_1");
-	
-    mShaders["debugVS"] = d3dUtil::CompileShader(L"Shaders\\ShadowDebug.hlsl", nullptr, "VS", "vs_5_1");
-    mShaders["debugPS"] = d3dUtil::CompileShader(L"Shaders\\ShadowDebug.hlsl", nullptr, "PS", "ps_5_1");
-
-	mShaders["drawNormalsVS"] = d3dUtil::CompileShader(L"Shaders\\DrawNormals.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["drawNormalsPS"] = d3dUtil::CompileShader(L"Shaders\\DrawNormals.hlsl", nullptr, "PS", "ps_5_1");
-
-	mShaders["ssaoVS"] = d3dUtil::CompileShader(L"Shaders\\Ssao.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["ssaoPS"] = d3dUtil::CompileShader(L"Shaders\\Ssao.hlsl", nullptr, "PS", "ps_5_1");
-
-	mShaders["ssaoBlurVS"] = d3dUtil::CompileShader(L"Shaders\\SsaoBlur.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["ssaoBlurPS"] = d3dUtil::CompileShader(L"Shaders\\SsaoBlur.hlsl", nullptr, "PS", "ps_5_1");
-
-	mShaders["skyVS"] = d3dUtil::CompileShader(L"Shaders\\Sky.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["skyPS"] = d3dUtil::CompileShader(L"Shaders\\Sky.hlsl", nullptr, "PS", "ps_5_1");
-
-	mShaders["editorVS"] = d3dUtil::CompileShader(L"Shaders\\EditorGUI.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["editorPS"] = d3dUtil::CompileShader(L"Shaders\\EditorGUI.hlsl", nullptr, "PS", "ps_5_1");
-	mShaders["fontVS"] = d3dUtil::CompileShader(L"Shaders\\FontShader.hlsl", nullptr, "VS", "vs_5_1");
-	mShaders["fontPS"] = d3dUtil::CompileShader(L"Shaders\\FontShader.hlsl", nullptr, "PS", "ps_5_1");
+	// Failing to write the cache only costs the next launch a recompile.
+	shaderCache.Save();
 
     mInputLayout =
     {
         { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
         { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 32, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 32, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
     };
+
+	mPackedInputLayout = VertexCompression::InputLayout(VertexCompression::Compact());
 }
 
 void MainApp::BuildShapeGeometry()
 {
-    GeometryGenerator geoGen;
-	GeometryGenerator::MeshData box = geoGen.CreateBox(1.0f, 1.0f, 1.0f, 3);
-	GeometryGenerator::MeshData wall = geoGen.CreateBox(5.0f, 2.0f, 1.0f, 3);
-	GeometryGenerator::MeshData grid = geoGen.CreateGrid(20.0f, 30.0f, 60, 40);
-	GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 20, 20);
-	GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20);
-    GeometryGenerator::MeshData quad = geoGen.CreateQuad(0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
-    
-
-
+	// Sizes of the shapes, known before anything is generated so every shape can be
+	// written straight into its range of the shared vertex and index buffers.
+	const GeometryGenerator::MeshSize boxSize = GeometryGenerator::BoxSize(3);
+	const GeometryGenerator::MeshSize gridSize = GeometryGenerator::GridSize(60, 40);
+	const GeometryGenerator::MeshSize sphereSize = GeometryGenerator::SphereSize(20, 20);
+	const GeometryGenerator::MeshSize cylinderSize = GeometryGenerator::CylinderSize(20, 20);
+	const GeometryGenerator::MeshSize quadSize = GeometryGenerator::QuadSize();
+	const GeometryGenerator::MeshSize wallSize = GeometryGenerator::BoxSize(3);
 
 	// Cache the vertex offsets to each object in the concatenated vertex buffer.
 	UINT boxVertexOffset = 0;
-	UINT gridVertexOffset = (UINT)box.Vertices.size();
-	UINT sphereVertexOffset = gridVertexOffset + (UINT)grid.Vertices.size();
-	UINT cylinderVertexOffset = sphereVertexOffset + (UINT)sphere.Vertices.size();
-    UINT quadVertexOffset = cylinderVertexOffset + (UINT)cylinder.Vertices.size();
-	UINT wallVertexOffset = quadVertexOffset + (UINT)quad.Vertices.size();
+	UINT gridVertexOffset = boxSize.VertexCount;
+	UINT sphereVertexOffset = gridVertexOffset + gridSize.VertexCount;
+	UINT cylinderVertexOffset = sphereVertexOffset + sphereSize.VertexCount;
+	UINT quadVertexOffset = cylinderVertexOffset + cylinderSize.VertexCount;
+	UINT wallVertexOffset = quadVertexOffset + quadSize.VertexCount;
 
 	// Cache the starting index for each object in the concatenated index buffer.
 	UINT boxIndexOffset = 0;
-	UINT gridIndexOffset = (UINT)box.Indices32.size();
-	UINT sphereIndexOffset = gridIndexOffset + (UINT)grid.Indices32.size();
-	UINT cylinderIndexOffset = sphereIndexOffset + (UINT)sphere.Indices32.size();
-    UINT quadIndexOffset = cylinderIndexOffset + (UINT)cylinder.Indices32.size();
-	UINT wallIndexOffset = quadIndexOffset + (UINT)quad.Indices32.size();
+	UINT gridIndexOffset = boxSize.IndexCount;
+	UINT sphereIndexOffset = gridIndexOffset + gridSize.IndexCount;
+	UINT cylinderIndexOffset = sphereIndexOffset + sphereSize.IndexCount;
+	UINT quadIndexOffset = cylinderIndexOffset + cylinderSize.IndexCount;
+	UINT wallIndexOffset = quadIndexOffset + quadSize.IndexCount;
+
+	std::vector<Vertex> vertices(wallVertexOffset + wallSize.VertexCount);
+	std::vector<std::uint16_t> indices(wallIndexOffset + wallSize.IndexCount);
+
+	//
+	// Generate the meshes in place, in the engine's vertex layout.
+	//
+
+	GeometryGenerator::VertexLayout layout;
+	layout.Stride = sizeof(Vertex);
+	layout.Position = offsetof(Vertex, Pos);
+	layout.Normal = offsetof(Vertex, Normal);
+	layout.TangentU = offsetof(Vertex, TangentU);
+	layout.TexC = offsetof(Vertex, TexC);
+	layout.TangentSign = offsetof(Vertex, TangentSign);
+
+	auto spanAt = [&](UINT vertexOffset, UINT indexOffset)
+	{
+		GeometryGenerator::MeshSpan span;
+		span.Vertices = &vertices[vertexOffset];
+		span.Layout = layout;
+		span.Indices16 = &indices[indexOffset];
+		return span;
+	};
+
+	GeometryGenerator geoGen;
+	geoGen.CreateBox(1.0f, 1.0f, 1.0f, 3, spanAt(boxVertexOffset, boxIndexOffset));
+	geoGen.CreateGrid(20.0f, 30.0f, 60, 40, spanAt(gridVertexOffset, gridIndexOffset));
+	geoGen.CreateSphere(0.5f, 20, 20, spanAt(sphereVertexOffset, sphereIndexOffset));
+	geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20, spanAt(cylinderVertexOffset, cylinderIndexOffset));
+	geoGen.CreateQuad(0.0f, 0.0f, 1.0f, 1.0f, 0.0f, spanAt(quadVertexOffset, quadIndexOffset));
+	geoGen.CreateBox(5.0f, 2.0f, 1.0f, 3, spanAt(wallVertexOffset, wallIndexOffset));
+
+	for (UINT i = 0; i < wallSize.VertexCount; ++i)
+		vertices[wallVertexOffset + i].Normal = { 0,0,0 };
 
 	SubmeshGeometry boxSubmesh;
-	boxSubmesh.IndexCount = (UINT)box.Indices32.size();
+	boxSubmesh.IndexCount = boxSize.IndexCount;
 	boxSubmesh.StartIndexLocation = boxIndexOffset;
 	boxSubmesh.BaseVertexLocation = boxVertexOffset;
-	boxSubmesh.Bounds = CalculateSubmeshBounds(box);
+	boxSubmesh.Bounds = CalculateSubmeshBounds(&vertices[boxVertexOffset], boxSize.VertexCount);
 
 	SubmeshGeometry gridSubmesh;
-	gridSubmesh.IndexCount = (UINT)grid.Indices32.size();
+	gridSubmesh.IndexCount = gridSize.IndexCount;
 	gridSubmesh.StartIndexLocation = gridIndexOffset;
 	gridSubmesh.BaseVertexLocation = gridVertexOffset;
-	gridSubmesh.Bounds = CalculateSubmeshBounds(grid);
+	gridSubmesh.Bounds = CalculateSubmeshBounds(&vertices[gridVertexOffset], gridSize.VertexCount);
 
 	SubmeshGeometry sphereSubmesh;
-	sphereSubmesh.IndexCount = (UINT)sphere.Indices32.size();
+	sphereSubmesh.IndexCount = sphereSize.IndexCount;
 	sphereSubmesh.StartIndexLocation = sphereIndexOffset;
 	sphereSubmesh.BaseVertexLocation = sphereVertexOffset;
-	sphereSubmesh.Bounds = CalculateSubmeshBounds(sphere);
+	sphereSubmesh.Bounds = CalculateSubmeshBounds(&vertices[sphereVertexOffset], sphereSize.VertexCount);
 
 	SubmeshGeometry cylinderSubmesh;
-	cylinderSubmesh.IndexCount = (UINT)cylinder.Indices32.size();
+	cylinderSubmesh.IndexCount = cylinderSize.IndexCount;
 	cylinderSubmesh.StartIndexLocation = cylinderIndexOffset;
 	cylinderSubmesh.BaseVertexLocation = cylinderVertexOffset;
-	cylinderSubmesh.Bounds = CalculateSubmeshBounds(cylinder);
-
+	cylinderSubmesh.Bounds = CalculateSubmeshBounds(&vertices[cylinderVertexOffset], cylinderSize.VertexCount);
 
     SubmeshGeometry quadSubmesh;
-    quadSubmesh.IndexCount = (UINT)quad.Indices32.size();
+    quadSubmesh.IndexCount = quadSize.IndexCount;
     quadSubmesh.StartIndexLocation = quadIndexOffset;
     quadSubmesh.BaseVertexLocation = quadVertexOffset;
-	quadSubmesh.Bounds = CalculateSubmeshBounds(quad);
+	quadSubmesh.Bounds = CalculateSubmeshBounds(&vertices[quadVertexOffset], quadSize.VertexCount);
 
 	SubmeshGeometry wallSubmesh;
-	wallSubmesh.IndexCount = (UINT)wall.Indices32.size();
+	wallSubmesh.IndexCount = wallSize.IndexCount;
 	wallSubmesh.StartIndexLocation = wallIndexOffset;
 	wallSubmesh.BaseVertexLocation = wallVertexOffset;
-	wallSubmesh.Bounds = CalculateSubmeshBounds(wall);
-	
-
-
-
-
-	//
-	// Extract the vertex elements we are interested in and pack the
-	// vertices of all the meshes into one vertex buffer.
-	//
-
-	auto totalVertexCount =
-		box.Vertices.size() +
-		grid.Vertices.size() +
-		sphere.Vertices.size() +
-		cylinder.Vertices.size() + 
-        quad.Vertices.size() +
-		wall.Vertices.size();
+	wallSubmesh.Bounds = CalculateSubmeshBounds(&vertices[wallVertexOffset], wallSize.VertexCount);
 
-	std::vector<Vertex> vertices(totalVertexCount);
-
-	UINT k = 0;
-	for(size_t i = 0; i < box.Vertices.size(); ++i, ++k)
+	// Simplified versions of the sphere and cylinder, appended after the other shapes.
+	// They index the same vertices as the full detail meshes.
+	std::vector<std::pair<std::string, SubmeshGeometry>> lodSubmeshes;
+	struct LodShape
 	{
-		vertices[k].Pos = box.Vertices[i].Position;
-		vertices[k].Normal = box.Vertices[i].Normal;
-		vertices[k].TexC = box.Vertices[i].TexC;
-		vertices[k].TangentU = box.Vertices[i].TangentU;
-	}
-
-	for(size_t i = 0; i < grid.Vertices.size(); ++i, ++k)
+		const char* Name;
+		const SubmeshGeometry* Submesh;
+		UINT VertexCount;
+	};
+	const LodShape lodShapes[] =
 	{
-		vertices[k].Pos = grid.Vertices[i].Position;
-		vertices[k].Normal = grid.Vertices[i].Normal;
-		vertices[k].TexC = grid.Vertices[i].TexC;
-		vertices[k].TangentU = grid.Vertices[i].TangentU;
-	}
+		{ "sphere", &sphereSubmesh, sphereSize.VertexCount },
+		{ "cylinder", &cylinderSubmesh, cylinderSize.VertexCount }
+	};
 
-	for(size_t i = 0; i < sphere.Vertices.size(); ++i, ++k)
+	for (const LodShape& shape : lodShapes)
 	{
-		vertices[k].Pos = sphere.Vertices[i].Position;
-		vertices[k].Normal = sphere.Vertices[i].Normal;
-		vertices[k].TexC = sphere.Vertices[i].TexC;
-		vertices[k].TangentU = sphere.Vertices[i].TangentU;
-	}
+		const SubmeshGeometry& submesh = *shape.Submesh;
 
-	for(size_t i = 0; i < cylinder.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = cylinder.Vertices[i].Position;
-		vertices[k].Normal = cylinder.Vertices[i].Normal;
-		vertices[k].TexC = cylinder.Vertices[i].TexC;
-		vertices[k].TangentU = cylinder.Vertices[i].TangentU;
-	}
+		// The simplifier takes 32 bit indices.
+		std::vector<std::uint32_t> shapeIndices(indices.begin() + submesh.StartIndexLocation,
+			indices.begin() + submesh.StartIndexLocation + submesh.IndexCount);
 
-    for(int i = 0; i < quad.Vertices.size(); ++i, ++k)
-    {
-        vertices[k].Pos = quad.Vertices[i].Position;
-        vertices[k].Normal = quad.Vertices[i].Normal;
-        vertices[k].TexC = quad.Vertices[i].TexC;
-        vertices[k].TangentU = quad.Vertices[i].TangentU;
-    }
+		std::vector<MeshSimplifier::Lod> lods;
+		MeshSimplifier::BuildLodChain(&vertices[submesh.BaseVertexLocation].Pos, sizeof(Vertex),
+			shape.VertexCount, shapeIndices.data(), (UINT)shapeIndices.size(),
+			MeshSimplifier::DefaultLevels(), lods);
 
-	for (size_t i = 0; i < wall.Vertices.size(); ++i, ++k)
-	{
-		vertices[k].Pos = wall.Vertices[i].Position;
-		vertices[k].Normal = { 0,0,0 };//wall.Vertices[i].Normal;
-		vertices[k].TexC = wall.Vertices[i].TexC;
-		vertices[k].TangentU = wall.Vertices[i].TangentU;
+		for (size_t l = 0; l < lods.size(); ++l)
+		{
+			SubmeshGeometry lodSubmesh = submesh;
+			lodSubmesh.IndexCount = (UINT)lods[l].Indices.size();
+			lodSubmesh.StartIndexLocation = (UINT)indices.size();
+			lodSubmesh.LodError = lods[l].Error;
+			for (std::uint32_t index : lods[l].Indices)
+				indices.push_back((std::uint16_t)index);
+
+			lodSubmeshes.push_back({ std::string(shape.Name) + "_lod" + std::to_string(l + 1), lodSubmesh });
+		}
 	}
 
-	std::vector<std::uint16_t> indices;
-	indices.insert(indices.end(), std::begin(box.GetIndices16()), std::end(box.GetIndices16()));
-	indices.insert(indices.end(), std::begin(grid.GetIndices16()), std::end(grid.GetIndices16()));
-	indices.insert(indices.end(), std::begin(sphere.GetIndices16()), std::end(sphere.GetIndices16()));
-	indices.insert(indices.end(), std::begin(cylinder.GetIndices16()), std::end(cylinder.GetIndices16()));
-    indices.insert(indices.end(), std::begin(quad.GetIndices16()), std::end(quad.GetIndices16()));
-	indices.insert(indices.end(), std::begin(wall.GetIndices16()), std::end(wall.GetIndices16()));
-
     const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
     const UINT ibByteSize = (UINT)indices.size()  * sizeof(std::uint16_t);
 
@@ -2047,6 +2134,9 @@ void MainApp::BuildShapeGeometry()
     geo->DrawArgs["quad"] = quadSubmesh;
 	geo->DrawArgs["wall"] = wallSubmesh;
 
+	for (const auto& lodSubmesh : lodSubmeshes)
+		geo->DrawArgs[lodSubmesh.first] = lodSubmesh.second;
+
 	mGeometries[geo->Name] = std::move(geo);
 }
 
@@ -2081,38 +2171,13 @@ void MainApp::BuildSkullGeometry()
 		
         fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
         vertices[i].TexC = { 0.0f, 0.0f };
-
-        XMVECTOR P = XMLoadFloat3(&vertices[i].Pos);
-
-        XMVECTOR N = XMLoadFloat3(&vertices[i].Normal);
-
-        // Generate a tangent vector so normal mapping works.  We aren't applying
-        // a texture map to the skull, so we just need any tangent vector so that
-        // the math works out to give us the original interpolated vertex normal.
-        XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
-        if(fabsf(XMVectorGetX(XMVector3Dot(N, up))) < 1.0f - 0.001f)
-        {
-            XMVECTOR T = XMVector3Normalize(XMVector3Cross(up, N));
-            XMStoreFloat3(&vertices[i].TangentU, T);
-        }
-        else
-        {
-            up = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
-            XMVECTOR T = XMVector3Normalize(XMVector3Cross(N, up));
-            XMStoreFloat3(&vertices[i].TangentU, T);
-        }
-        
-
-
     }
 
-
-
     fin >> ignore;
     fin >> ignore;
     fin >> ignore;
 
-    std::vector<std::int32_t> indices(3 * tcount);
+    std::vector<std::uint32_t> indices(3 * tcount);
     for (UINT i = 0; i < tcount; ++i)
     {
         fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
@@ -2120,13 +2185,18 @@ void MainApp::BuildSkullGeometry()
 
     fin.close();
 
+    // The skull has no texture coordinates, so every vertex gets some tangent
+    // perpendicular to its normal; enough for normal mapping to reproduce the
+    // interpolated normal.
+    TangentSpace::Generate(vertices, indices, VertexTangentLayout());
+
     //
     // Pack the indices of all the meshes into one index buffer.
     //
 
     const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 
-    const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
+    const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint32_t);
 
     auto geo = std::make_unique<MeshGeometry>();
     geo->Name = "skullGeo";
@@ -2159,103 +2229,382 @@ void MainApp::BuildSkullGeometry()
     mGeometries[geo->Name] = std::move(geo);
 }
 
-void MainApp::FBXFunction()
+void MainApp::BuildBoxModel()
 {
+	// The render item orients the model itself, so the control points are kept as stored:
+	// no node transforms and no handedness conversion.  All meshes form one submesh.
+	FbxLoader::ImportSettings settings;
+	settings.ApplyNodeTransforms = false;
+	settings.ConvertToLeftHanded = false;
+
+	FbxLoader::FbxModel model;
+	if (!FbxLoader::Load("MyModels//man.fbx", model, settings))
+		OutputDebugStringA("Failed to load MyModels//man.fbx\n");
+
+	std::vector<Vertex> vertices(model.Mesh.Vertices.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		vertices[i].Pos = model.Mesh.Vertices[i].Position;
+		vertices[i].Normal = model.Mesh.Vertices[i].Normal;
+		vertices[i].TexC = model.Mesh.Vertices[i].TexC;
+		vertices[i].TangentU = model.Mesh.Vertices[i].TangentU;
+		vertices[i].TangentSign = model.Mesh.Vertices[i].TangentSign;
+	}
 
+	std::vector<MeshOptimizer::Submesh> submeshes;
+	auto geo = BuildOptimizedGeometry("boxGeo", vertices, model.Mesh.Indices32, submeshes, { "boxModel" }, true);
+	mGeometries[geo->Name] = std::move(geo);
 }
 
+void MainApp::RegisterImporters(AssetCooker& cooker)
+{
+	// Tangent generation, optimization, LOD and meshlet building of a loaded ObjModel or
+	// FbxModel.  Bump the importers' versions whenever the loaders or
+	// PrepareOptimizedGeometry change what they produce.
+	auto cookModel = [](const std::string& filename, auto& model, std::vector<std::uint8_t>& artifact)
+	{
+		std::vector<Vertex> vertices(model.Mesh.Vertices.size());
+		for (size_t i = 0; i < model.Mesh.Vertices.size(); ++i)
+		{
+			vertices[i].Pos = model.Mesh.Vertices[i].Position;
+			vertices[i].Normal = model.Mesh.Vertices[i].Normal;
+			vertices[i].TexC = model.Mesh.Vertices[i].TexC;
+			vertices[i].TangentU = model.Mesh.Vertices[i].TangentU;
+			vertices[i].TangentSign = model.Mesh.Vertices[i].TangentSign;
+		}
+
+		// One submesh per material, named after the material.  Subsets without one are
+		// left unnamed and take the geometry's name when the artifact is read.
+		std::vector<MeshOptimizer::Submesh> submeshes(model.Subsets.size());
+		std::vector<std::string> submeshNames(model.Subsets.size());
+		for (size_t i = 0; i < model.Subsets.size(); ++i)
+		{
+			submeshes[i].StartIndexLocation = model.Subsets[i].StartIndexLocation;
+			submeshes[i].IndexCount = model.Subsets[i].IndexCount;
+			submeshNames[i] = model.Subsets[i].MaterialName;
+		}
+
+		auto geo = PrepareOptimizedGeometry(filename, vertices, model.Mesh.Indices32, submeshes, submeshNames, true);
+		AssetCooker::WriteGeometry(*geo, artifact);
+	};
+
+	AssetCooker::Importer obj;
+	obj.Name = "ObjMesh";
+	obj.Version = 1;
+	obj.Cook = [cookModel](const std::string& filename, const std::vector<std::uint8_t>&, const std::string&,
+		std::vector<std::uint8_t>& artifact)
+	{
+		// ObjLoader streams the file itself.  Its .mtl libraries only contribute the
+		// subset names, so they are not part of the key.
+		ObjLoader::ObjModel model;
+		if (!ObjLoader::Load(filename, model))
+			return false;
+
+		cookModel(filename, model, artifact);
+		return true;
+	};
+	cooker.Register(".obj", obj);
+
+	AssetCooker::Importer fbx;
+	fbx.Name = "FbxMesh";
+	fbx.Version = 1;
+	fbx.Cook = [cookModel](const std::string& filename, const std::vector<std::uint8_t>& source, const std::string&,
+		std::vector<std::uint8_t>& artifact)
+	{
+		// FBX files are parsed straight from the bytes the cooker has already read.
+		FbxLoader::FbxModel model;
+		if (!FbxLoader::Load(source.data(), source.size(), model, FbxLoader::ImportSettings()))
+			return false;
+
+		cookModel(filename, model, artifact);
+		return true;
+	};
+	cooker.Register(".fbx", fbx);
+
+	// Raw RGBA source art becomes a block compressed DDS with its full mip chain, which
+	// CreateDDSTextureFromFile12 loads as is.  Files named like bricks2_nmap or
+	// Asphalt2DDSNorm are normal maps and go to BC5; the rest are sRGB color, BC3 if any
+	// texel is not opaque and BC1 otherwise.  Mips of images whose alpha is only 0 or 255
+	// keep the coverage of the shader's alpha test.
+	AssetCooker::Importer tga;
+	tga.Name = "TgaTexture";
+	tga.Version = 2;
+	tga.Cook = [](const std::string& filename, const std::vector<std::uint8_t>& source, const std::string&,
+		std::vector<std::uint8_t>& artifact)
+	{
+		TgaLoader::TgaImage image;
+		if (!TgaLoader::Load(source.data(), source.size(), image))
+			return false;
+
+		std::string stem = filename.substr(0, filename.find_last_of('.'));
+		auto endsWith = [&stem](const char* suffix)
+		{
+			size_t length = strlen(suffix);
+			return stem.size() >= length && _stricmp(stem.c_str() + stem.size() - length, suffix) == 0;
+		};
+		bool normalMap = endsWith("nmap") || endsWith("norm") || endsWith("_n") || endsWith("normal");
+
+		bool translucent = false;
+		bool cutout = true;
+		for (size_t i = 3; i < image.Pixels.size(); i += 4)
+		{
+			translucent = translucent || image.Pixels[i] != 255;
+			cutout = cutout && (image.Pixels[i] == 0 || image.Pixels[i] == 255);
+		}
 
+		BlockCompressor::Format format = normalMap ? BlockCompressor::Format::BC5 :
+			(translucent ? BlockCompressor::Format::BC3 : BlockCompressor::Format::BC1);
 
+		MipGenerator::Options options;
+		options.Filter = MipGenerator::MipFilter::Kaiser;
+		options.SRGB = !normalMap;
+		options.NormalMap = normalMap;
 
-bool MainApp::is_near(float v1, float v2) {
-	return fabs(v1 - v2) < 0.01f;
+		// Matches the clip in Default.hlsl's ALPHA_TEST.
+		if (translucent && cutout && !normalMap)
+			options.AlphaReference = 0.1f;
+
+		std::vector<MipGenerator::Mip> mips;
+		MipGenerator::Generate(image.View(), options, mips);
+		MipGenerator::WriteDDS(mips, format, BlockCompressor::Quality::High, !normalMap, artifact);
+		return true;
+	};
+	cooker.Register(".tga", tga);
 }
 
-int MainApp::foundSimilarVertex(Vertex temp, std::vector<Vertex> verts)
+int MainApp::CookAssets()
 {
-	if (verts.size() > 0)
+	DerivedDataCache cache(L"DerivedDataCache");
+	AssetCooker cooker(cache);
+	RegisterImporters(cooker);
+
+	// Models inside the zip archives are cooked straight out of them.  Textures that are
+	// already DDS files have no importer and are skipped.
+	std::vector<std::string> files = AssetCooker::ListFiles("MyModels");
+	std::vector<std::string> textures = AssetCooker::ListFiles("Textures");
+	files.insert(files.end(), textures.begin(), textures.end());
+	for (size_t i = 0, count = files.size(); i < count; ++i)
 	{
-		for (UINT i = 0; i < (UINT)verts.size(); i++)
+		if (files[i].size() > 4 && _stricmp(files[i].c_str() + files[i].size() - 4, ".zip") == 0)
 		{
-			if (
-				is_near(temp.Pos.x, verts[i].Pos.x) &&
-				is_near(temp.Pos.y, verts[i].Pos.y) &&
-				is_near(temp.Pos.z, verts[i].Pos.z) &&
-				is_near(temp.Normal.x, verts[i].Normal.x) &&
-				is_near(temp.Normal.y, verts[i].Normal.y) &&
-				is_near(temp.Normal.z, verts[i].Normal.z)
-				)
-			{
-				return i;
-			}
+			std::vector<std::string> entries = VirtualFileSystem::Default().ListArchive(files[i]);
+			files.insert(files.end(), entries.begin(), entries.end());
 		}
 	}
-	return -1;
+
+	AssetCooker::BatchReport report = cooker.CookAll(files);
+
+	char message[256];
+	sprintf_s(message, "Cooked %u, up to date %u, failed %u\n", report.Cooked, report.Cached, report.Failed);
+	OutputDebugStringA(message);
+	std::fputs(message, report.Failed == 0 ? stdout : stderr);
+	std::fflush(stdout);
+
+	return report.Failed == 0 ? 0 : 1;
 }
 
-void MainApp::BuildBoxModel()
+std::unique_ptr<MeshGeometry> MainApp::BuildOptimizedGeometry(const std::string& geoName, std::vector<Vertex>& vertices,
+	std::vector<std::uint32_t>& indices, std::vector<MeshOptimizer::Submesh>& submeshes,
+	const std::vector<std::string>& submeshNames, bool packVertices)
 {
-	std::wstring Filename = L"../../MyModels/car.obj";
+	auto geo = PrepareOptimizedGeometry(geoName, vertices, indices, submeshes, submeshNames, packVertices);
+	UploadGeometry(geo.get(), mCommandList.Get());
+	return geo;
+}
 
-	
-	std::vector<Vertex> vertices;
-	std::vector<Vertex> outVertices;
-	std::vector<Vertex> checkedVertices;
-	std::vector<XMFLOAT3> vertPos;
-	std::vector<XMFLOAT3> vertPosNorms;
-	std::vector<XMFLOAT2> vertTC;
-	UINT tCount = 12;
+std::unique_ptr<MeshGeometry> MainApp::PrepareOptimizedGeometry(const std::string& geoName, std::vector<Vertex>& vertices,
+	std::vector<std::uint32_t>& indices, std::vector<MeshOptimizer::Submesh>& submeshes,
+	const std::vector<std::string>& submeshNames, bool packVertices)
+{
+	// Overdraw of the triangles as they came in, per submesh (or of the whole mesh if
+	// there are none, as Optimize treats it), to compare with the final order below.
+	UINT coveredBefore = 0, shadedBefore = 0;
+	for (size_t i = 0; i < std::max<size_t>(submeshes.size(), 1); ++i)
+	{
+		UINT start = submeshes.empty() ? 0 : submeshes[i].StartIndexLocation;
+		UINT count = submeshes.empty() ? (UINT)indices.size() : submeshes[i].IndexCount;
+		if (count == 0)
+			continue;
+
+		MeshOptimizer::OverdrawStatistics overdraw = MeshOptimizer::AnalyzeOverdraw(&indices[start], count,
+			vertices.data(), sizeof(Vertex), offsetof(Vertex, Pos));
+		coveredBefore += overdraw.PixelsCovered;
+		shadedBefore += overdraw.PixelsShaded;
+	}
 
+	// Weld, reorder for the post-transform cache and overdraw, then reorder the vertices
+	// for fetch locality.  Afterwards each submesh's indices are relative to its
+	// BaseVertexLocation and its vertices are contiguous.
+	MeshOptimizer::Report report = MeshOptimizer::Optimize(vertices, offsetof(Vertex, Pos), indices, submeshes);
+
+	char message[256];
+
+	auto geo = std::make_unique<MeshGeometry>();
+	geo->Name = geoName;
+
+	// LOD chains of the submeshes, simplified in parallel.  A LOD indexes its submesh's
+	// vertex range, so it is appended to the index buffer and drawn with the same
+	// BaseVertexLocation.
+	std::vector<std::vector<MeshSimplifier::Lod>> lods(submeshes.size());
+	ThreadPool::Default().ParallelFor((UINT)submeshes.size(), 1, [&](UINT begin, UINT end)
+	{
+		for (UINT i = begin; i < end; ++i)
+		{
+			const MeshOptimizer::Submesh& range = submeshes[i];
+			if (range.VertexCount == 0)
+				continue;
+
+			MeshSimplifier::BuildLodChain(&vertices[range.BaseVertexLocation].Pos, sizeof(Vertex), range.VertexCount,
+				&indices[range.StartIndexLocation], range.IndexCount, MeshSimplifier::DefaultLevels(), lods[i]);
+
+			for (auto& lod : lods[i])
+				MeshOptimizer::OptimizeVertexCache(lod.Indices.data(), lod.Indices.size(), range.VertexCount, 16, nullptr);
+		}
+	});
 
-	std::vector<std::int32_t> indices;
-	std::vector<std::int32_t> normalIndices;
-	std::vector<std::int32_t> texIndices;
-	std::vector<indiceHolder> indiceHolders;
-	LoadFBX(vertices);
-	for (UINT i = 0; i < (UINT)vertices.size(); i++)
+	// Bounds, and for packed meshes the position dequantization, of each submesh's
+	// vertex range.
+	const VertexCompression::Format packedFormat = VertexCompression::Compact();
+	std::vector<VertexCompression::Dequantize> dequantize(submeshes.size());
+	for (size_t i = 0; i < submeshes.size(); ++i)
 	{
-		indices.push_back(i);
+		const MeshOptimizer::Submesh& range = submeshes[i];
+
+		SubmeshGeometry submesh;
+		submesh.IndexCount = range.IndexCount;
+		submesh.StartIndexLocation = range.StartIndexLocation;
+		submesh.BaseVertexLocation = range.BaseVertexLocation;
+
+		// Split into meshlets for culling.  This reorders the submesh's triangles, so it
+		// has to happen before the indices are uploaded.
+		if (range.VertexCount > 0)
+		{
+			submesh.MeshletOffset = (UINT)geo->Meshlets.Meshlets.size();
+			MeshletBuilder::Build(&vertices[range.BaseVertexLocation].Pos, sizeof(Vertex),
+				&indices[range.StartIndexLocation], range.IndexCount, range.StartIndexLocation, geo->Meshlets);
+			submesh.MeshletCount = (UINT)geo->Meshlets.Meshlets.size() - submesh.MeshletOffset;
+		}
+
+		if (range.VertexCount > 0)
+		{
+			BoundingBox::CreateFromPoints(submesh.Bounds, range.VertexCount,
+				&vertices[range.BaseVertexLocation].Pos, sizeof(Vertex));
+		}
+
+		if (packVertices)
+		{
+			dequantize[i] = VertexCompression::ComputeDequantize(submesh.Bounds, packedFormat.Position);
+			XMStoreFloat4x4(&submesh.VertexTransform, dequantize[i].Matrix());
+		}
+
+		const std::string& name = i < submeshNames.size() ? submeshNames[i] : geoName;
+		geo->DrawArgs[name] = submesh;
+
+		for (size_t l = 0; l < lods[i].size(); ++l)
+		{
+			SubmeshGeometry lodSubmesh = submesh;
+			lodSubmesh.IndexCount = (UINT)lods[i][l].Indices.size();
+			lodSubmesh.StartIndexLocation = (UINT)indices.size();
+			lodSubmesh.MeshletOffset = 0;
+			lodSubmesh.MeshletCount = 0;
+			lodSubmesh.LodError = lods[i][l].Error;
+			indices.insert(indices.end(), lods[i][l].Indices.begin(), lods[i][l].Indices.end());
+
+			geo->DrawArgs[name + "_lod" + std::to_string(l + 1)] = lodSubmesh;
+
+			sprintf_s(message, "%s LOD %u: %u triangles, error %f\n", name.c_str(), (UINT)(l + 1),
+				lodSubmesh.IndexCount / 3, lodSubmesh.LodError);
+			OutputDebugStringA(message);
+		}
 	}
-	
-	
-	
-	if (vertices.size() == 0)
+
+	// The meshlet split reordered the triangles again, so measure the cache behaviour and
+	// overdraw of the index buffer that is actually uploaded.
+	UINT transformed = 0, triangles = 0, coveredAfter = 0, shadedAfter = 0;
+	for (const MeshOptimizer::Submesh& range : submeshes)
 	{
-		std::string pi = "size is zero";
-		std::wstring stemp = std::wstring(pi.begin(), pi.end());
-		LPCWSTR sw = stemp.c_str();
-		OutputDebugString(sw);
+		if (range.VertexCount == 0)
+			continue;
+
+		MeshOptimizer::CacheStatistics stats = MeshOptimizer::AnalyzeVertexCache(&indices[range.StartIndexLocation],
+			range.IndexCount, range.VertexCount, 16);
+		transformed += stats.TransformedVertices;
+		triangles += range.IndexCount / 3;
+
+		MeshOptimizer::OverdrawStatistics overdraw = MeshOptimizer::AnalyzeOverdraw(&indices[range.StartIndexLocation],
+			range.IndexCount, &vertices[range.BaseVertexLocation], sizeof(Vertex), offsetof(Vertex, Pos));
+		coveredAfter += overdraw.PixelsCovered;
+		shadedAfter += overdraw.PixelsShaded;
 	}
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-	auto geo = std::make_unique<MeshGeometry>();
-	geo->Name = "boxGeo";
 
-	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+	sprintf_s(message, "%s: vertices %u -> %u, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, overdraw %.3f -> %.3f, %s indices\n",
+		geoName.c_str(), report.VerticesBefore, report.VerticesAfter,
+		report.Before.ACMR, triangles > 0 ? (float)transformed / triangles : 0.0f,
+		report.Before.ATVR, report.VerticesAfter > 0 ? (float)transformed / report.VerticesAfter : 0.0f,
+		coveredBefore > 0 ? (float)shadedBefore / coveredBefore : 0.0f,
+		coveredAfter > 0 ? (float)shadedAfter / coveredAfter : 0.0f,
+		report.Use16BitIndices ? "16-bit" : "32-bit");
+	OutputDebugStringA(message);
+
+	std::vector<std::uint8_t> vertexData;
+	UINT vertexStride = sizeof(Vertex);
+	if (packVertices && !vertices.empty())
+	{
+		vertexStride = packedFormat.Stride();
+		vertexData.resize(vertices.size() * vertexStride);
+
+		VertexCompression::SourceStreams source;
+		source.Positions = &vertices[0].Pos;
+		source.Normals = &vertices[0].Normal;
+		source.Tangents = &vertices[0].TangentU;
+		source.TangentSigns = &vertices[0].TangentSign;
+		source.TexCs = &vertices[0].TexC;
+		source.Stride = sizeof(Vertex);
+
+		for (size_t i = 0; i < submeshes.size(); ++i)
+		{
+			const MeshOptimizer::Submesh& range = submeshes[i];
+			VertexCompression::Encode(source, range.BaseVertexLocation, range.VertexCount, packedFormat,
+				dequantize[i], &vertexData[range.BaseVertexLocation * vertexStride]);
+		}
+	}
+	else
+	{
+		vertexData.resize(vertices.size() * sizeof(Vertex));
+		CopyMemory(vertexData.data(), vertices.data(), vertexData.size());
+	}
 
-	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+	std::vector<std::uint16_t> indices16;
+	if (report.Use16BitIndices)
+		MeshOptimizer::NarrowIndices(indices, indices16);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+	const void* indexData = report.Use16BitIndices ? (const void*)indices16.data() : (const void*)indices.data();
 
-	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+	const UINT vbByteSize = (UINT)vertexData.size();
+	const UINT ibByteSize = (UINT)indices.size() *
+		(report.Use16BitIndices ? sizeof(std::uint16_t) : sizeof(std::uint32_t));
 
-	geo->VertexByteStride = sizeof(Vertex);
+	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertexData.data(), vbByteSize);
+
+	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
+	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indexData, ibByteSize);
+
+	geo->VertexByteStride = vertexStride;
 	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R32_UINT;
+	geo->IndexFormat = report.Use16BitIndices ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
-	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
-	submesh.StartIndexLocation = 0;
-	submesh.BaseVertexLocation = 0;
+	return geo;
+}
 
-	geo->DrawArgs["boxModel"] = submesh;
-	mGeometries[geo->Name] = std::move(geo);
+void MainApp::UploadGeometry(MeshGeometry* geo, ID3D12GraphicsCommandList* cmdList)
+{
+	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(), cmdList,
+		geo->VertexBufferCPU->GetBufferPointer(), geo->VertexBufferByteSize, geo->VertexBufferUploader);
 
+	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(), cmdList,
+		geo->IndexBufferCPU->GetBufferPointer(), geo->IndexBufferByteSize, geo->IndexBufferUploader);
 }
 
 void MainApp::BuildPSOs()
@@ -2291,6 +2640,18 @@ void MainApp::BuildPSOs()
 	opaquePsoDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_EQUAL;
 	opaquePsoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
     ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
+
+	//
+	// PSO for opaque objects stored in the packed vertex format.
+	//
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaquePackedPsoDesc = opaquePsoDesc;
+	opaquePackedPsoDesc.InputLayout = { mPackedInputLayout.data(), (UINT)mPackedInputLayout.size() };
+	opaquePackedPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["standardPackedVS"]->GetBufferPointer()),
+		mShaders["standardPackedVS"]->GetBufferSize()
+	};
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePackedPsoDesc, IID_PPV_ARGS(&mPSOs["opaque_packed"])));
 	
 	opaquePsoDesc.DepthStencilState.DepthFunc = D3D12_COMPARISON_FUNC_LESS;
 	opaquePsoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ALL;
@@ -2315,6 +2676,15 @@ void MainApp::BuildPSOs()
 	drawNormalsPsoDesc.DSVFormat = mDepthStencilFormat;
 	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&drawNormalsPsoDesc, IID_PPV_ARGS(&mPSOs["drawNormals"])));
 
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC drawNormalsPackedPsoDesc = drawNormalsPsoDesc;
+	drawNormalsPackedPsoDesc.InputLayout = { mPackedInputLayout.data(), (UINT)mPackedInputLayout.size() };
+	drawNormalsPackedPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["drawNormalsPackedVS"]->GetBufferPointer()),
+		mShaders["drawNormalsPackedVS"]->GetBufferSize()
+	};
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&drawNormalsPackedPsoDesc, IID_PPV_ARGS(&mPSOs["drawNormals_packed"])));
+
 
 	//
 	// PSO for SSAO.
@@ -2382,6 +2752,12 @@ void MainApp::BuildPSOs()
     smapPsoDesc.NumRenderTargets = 0;
     ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&smapPsoDesc, IID_PPV_ARGS(&mPSOs["shadow_opaque"])));
 
+	// The shadow vertex shader only reads position and texture coordinates, which the
+	// input assembler converts from the packed formats, so only the layout changes.
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC smapPackedPsoDesc = smapPsoDesc;
+	smapPackedPsoDesc.InputLayout = { mPackedInputLayout.data(), (UINT)mPackedInputLayout.size() };
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&smapPackedPsoDesc, IID_PPV_ARGS(&mPSOs["shadow_opaque_packed"])));
+
     //
     // PSO for debug layer.
     //
@@ -2478,7 +2854,7 @@ void MainApp::BuildFrameResources()
     for(int i = 0; i < gNumFrameResources; ++i)
     {
         mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-            3, 200, (UINT)mMaterials.size(),4));
+            3, 200, (UINT)mMaterials.size(), (UINT)mAllRitems.size()));
     }
 
 	
@@ -2489,8 +2865,8 @@ void MainApp::BuildMaterials()
     auto bricks0 = std::make_unique<Material>();
     bricks0->Name = "bricks0";
     bricks0->MatCBIndex = 0;
-    bricks0->DiffuseSrvHeapIndex = 0;
-    bricks0->NormalSrvHeapIndex = 1;
+    bricks0->DiffuseSrvHeapIndex = mTextureMaps["bricksDiffuseMap"];
+    bricks0->NormalSrvHeapIndex = mTextureMaps["bricksNormalMap"];
     bricks0->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
     bricks0->FresnelR0 = XMFLOAT3(0.1f, 0.1f, 0.1f);
     bricks0->Roughness = 0.3f;
@@ -2498,8 +2874,8 @@ void MainApp::BuildMaterials()
     auto tile0 = std::make_unique<Material>();
     tile0->Name = "tile0";
     tile0->MatCBIndex = 1;
-    tile0->DiffuseSrvHeapIndex = 2;
-    tile0->NormalSrvHeapIndex = 3;
+    tile0->DiffuseSrvHeapIndex = mTextureMaps["tileDiffuseMap"];
+    tile0->NormalSrvHeapIndex = mTextureMaps["tileNormalMap"];
     tile0->DiffuseAlbedo = XMFLOAT4(0.9f, 0.9f, 0.9f, 1.0f);
     tile0->FresnelR0 = XMFLOAT3(0.2f, 0.2f, 0.2f);
     tile0->Roughness = 0.1f;
@@ -2507,8 +2883,8 @@ void MainApp::BuildMaterials()
     auto mirror0 = std::make_unique<Material>();
     mirror0->Name = "mirror0";
     mirror0->MatCBIndex = 2;
-    mirror0->DiffuseSrvHeapIndex = 4;
-    mirror0->NormalSrvHeapIndex = 5;
+    mirror0->DiffuseSrvHeapIndex = mTextureMaps["defaultDiffuseMap"];
+    mirror0->NormalSrvHeapIndex = mTextureMaps["defaultNormalMap"];
     mirror0->DiffuseAlbedo = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
     mirror0->FresnelR0 = XMFLOAT3(0.98f, 0.97f, 0.95f);
     mirror0->Roughness = 0.1f;
@@ -2516,8 +2892,8 @@ void MainApp::BuildMaterials()
     auto skullMat = std::make_unique<Material>();
     skullMat->Name = "skullMat";
     skullMat->MatCBIndex = 3;
-    skullMat->DiffuseSrvHeapIndex = 4;
-    skullMat->NormalSrvHeapIndex = 5;
+    skullMat->DiffuseSrvHeapIndex = mTextureMaps["defaultDiffuseMap"];
+    skullMat->NormalSrvHeapIndex = mTextureMaps["defaultNormalMap"];
     skullMat->DiffuseAlbedo = XMFLOAT4(0.3f, 0.3f, 0.3f, 1.0f);
     skullMat->FresnelR0 = XMFLOAT3(0.6f, 0.6f, 0.6f);
     skullMat->Roughness = 0.2f;
@@ -2525,8 +2901,8 @@ void MainApp::BuildMaterials()
     auto sky = std::make_unique<Material>();
     sky->Name = "sky";
     sky->MatCBIndex = 4;
-    sky->DiffuseSrvHeapIndex = 6;
-    sky->NormalSrvHeapIndex = 7;
+    sky->DiffuseSrvHeapIndex = mTextureMaps["defaultDiffuseMap"];
+    sky->NormalSrvHeapIndex = mTextureMaps["defaultNormalMap"];
     sky->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
     sky->FresnelR0 = XMFLOAT3(0.1f, 0.1f, 0.1f);
     sky->Roughness = 1.0f;
@@ -2534,8 +2910,8 @@ void MainApp::BuildMaterials()
 	auto asphalt = std::make_unique<Material>();
 	asphalt->Name = "asphalt";
 	asphalt->MatCBIndex = 5;
-	asphalt->DiffuseSrvHeapIndex = 6;
-	asphalt->NormalSrvHeapIndex = 7;
+	asphalt->DiffuseSrvHeapIndex = mTextureMaps["AsphaltDiffuseMap"];
+	asphalt->NormalSrvHeapIndex = mTextureMaps["AsphaltNormalMap"];
 	asphalt->DiffuseAlbedo = XMFLOAT4(.8f, .8f, .8f, 1.0f);
 	asphalt->FresnelR0 = XMFLOAT3(0.2f, 0.2f, 0.2f);
 	asphalt->Roughness = 1.0f;
@@ -2543,8 +2919,8 @@ void MainApp::BuildMaterials()
 	auto manMat = std::make_unique<Material>();
 	manMat->Name = "manMat";
 	manMat->MatCBIndex = 6;
-	manMat->DiffuseSrvHeapIndex = 8;
-	manMat->NormalSrvHeapIndex = 9;
+	manMat->DiffuseSrvHeapIndex = mTextureMaps["ManDiffuseMap"];
+	manMat->NormalSrvHeapIndex = mTextureMaps["ManNormalMap"];
 	manMat->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 	manMat->FresnelR0 = XMFLOAT3(0.2f, 0.2f, 0.2f);
 	manMat->Roughness = .9f;
@@ -2571,12 +2947,12 @@ void MainApp::BuildRenderItems()
 	skyRitem->IndexCount = skyRitem->Geo->DrawArgs["sphere"].IndexCount;
 	skyRitem->StartIndexLocation = skyRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
 	skyRitem->BaseVertexLocation = skyRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+	skyRitem->Lods = skyRitem->Geo->LodChain("sphere");
 	skyRitem->instanceBufferIndex = 0;
 
 	skyRitem->Instances.resize(1);
 	skyRitem->Instances[0].MaterialIndex = 4;
-	XMStoreFloat4x4(&skyRitem->Instances[0].World, XMMatrixScaling(5000.0f, 5000.0f, 5000.0f));
-	skyRitem->Instances[0].TexTransform = MathHelper::Identity4x4();
+	skyRitem->Instances[0].World = InstanceTransform::FromMatrix(XMMatrixScaling(5000.0f, 5000.0f, 5000.0f));
 	mRitemLayer[(int)RenderLayer::Sky].push_back(skyRitem.get());
 	mAllRitems.push_back(std::move(skyRitem));
 	
@@ -2597,9 +2973,8 @@ void MainApp::BuildRenderItems()
 	quadRitem->instanceBufferIndex = 1;
 	quadRitem->bIs2D = true;
 	quadRitem->Instances[0].MaterialIndex = 0;
-	quadRitem->Instances[0].TexTransform = MathHelper::Identity4x4();
 
-	XMStoreFloat4x4(&quadRitem->Instances[0].World, XMMatrixScaling(1.0f, 1.0f, 1.0f));	
+	quadRitem->Instances[0].World = InstanceTransform::FromMatrix(XMMatrixScaling(1.0f, 1.0f, 1.0f));
 	mRitemLayer[(int)RenderLayer::Debug].push_back(quadRitem.get());	
 	mAllRitems.push_back(std::move(quadRitem));
 	
@@ -2620,8 +2995,8 @@ void MainApp::BuildRenderItems()
 	boxRitem->Instances.resize(1);
 	boxRitem->Instances[0].MaterialIndex = 0;
 	
-	XMStoreFloat4x4(&boxRitem->Instances[0].TexTransform, XMMatrixScaling(1.0f, 0.5f, 1.0f));
-	XMStoreFloat4x4(&boxRitem->Instances[0].World, XMMatrixScaling(2.0f, 1.0f, 2.0f)*XMMatrixTranslation(0.0f, 0.5f, 0.0f));
+	boxRitem->Instances[0].TexScale = XMFLOAT2(1.0f, 0.5f);
+	boxRitem->Instances[0].World = InstanceTransform::FromMatrix(XMMatrixScaling(2.0f, 1.0f, 2.0f)*XMMatrixTranslation(0.0f, 0.5f, 0.0f));
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(boxRitem.get());
 	mAllRitems.push_back(std::move(boxRitem));
 	*/
@@ -2641,8 +3016,7 @@ void MainApp::BuildRenderItems()
 
 	skullRitem->Instances.resize(1);
 	skullRitem->Instances[0].MaterialIndex = 3;
-	skullRitem->Instances[0].TexTransform = MathHelper::Identity4x4();
-	XMStoreFloat4x4(&skullRitem->Instances[0].World, XMMatrixScaling(0.4f, 0.4f, 0.4f)*XMMatrixTranslation(0.0f, 1.0f, 0.0f));
+	skullRitem->Instances[0].World = InstanceTransform::FromMatrix(XMMatrixScaling(0.4f, 0.4f, 0.4f)*XMMatrixTranslation(0.0f, 1.0f, 0.0f));
     mRitemLayer[(int)RenderLayer::Opaque].push_back(skullRitem.get());
     mAllRitems.push_back(std::move(skullRitem));
 	*/
@@ -2661,8 +3035,7 @@ void MainApp::BuildRenderItems()
 	gridRitem->Bounds = gridRitem->Geo->DrawArgs["grid"].Bounds;
 	gridRitem->Instances.resize(1);
 	gridRitem->Instances[0].MaterialIndex = 5;
-	XMStoreFloat4x4(&gridRitem->Instances[0].TexTransform, XMMatrixScaling(8.0f, 8.0f, 1.0f));
-	gridRitem->Instances[0].World = MathHelper::Identity4x4();
+	gridRitem->Instances[0].TexScale = XMFLOAT2(8.0f, 8.0f);
 	
 
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(gridRitem.get());
@@ -2686,14 +3059,15 @@ void MainApp::BuildRenderItems()
 	leftCylRitem->StartIndexLocation = leftCylRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
 	leftCylRitem->BaseVertexLocation = leftCylRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
 	leftCylRitem->Bounds = leftCylRitem->Geo->DrawArgs["cylinder"].Bounds;
+	leftCylRitem->Lods = leftCylRitem->Geo->LodChain("cylinder");
 
 	leftCylRitem->Instances.resize(4);
 	leftCylRitem->InstanceCount = 4;
 	for (int i = 0; i < 4; ++i)
 	{
-		XMStoreFloat4x4(&leftCylRitem->Instances[i].World, XMMatrixTranslation(-5.0f, 1.5f, -10.0f + i*5.0f));
+		leftCylRitem->Instances[i].World = InstanceTransform::FromMatrix(XMMatrixTranslation(-5.0f, 1.5f, -10.0f + i*5.0f));
 		leftCylRitem->Instances[i].MaterialIndex = 0;
-		XMStoreFloat4x4(&leftCylRitem->Instances[i].TexTransform, XMMatrixScaling(1.5f, 2.0f, 1.0f));
+		leftCylRitem->Instances[i].TexScale = XMFLOAT2(1.5f, 2.0f);
 	}
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(leftCylRitem.get());
 	mAllRitems.push_back(std::move(leftCylRitem));
@@ -2726,8 +3100,8 @@ void MainApp::BuildRenderItems()
 	testObject->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	testObject->Instances.resize(1);
 	testObject->Instances[0].MaterialIndex = 0;
-	XMStoreFloat4x4(&testObject->Instances[0].TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-	XMStoreFloat4x4(&testObject->Instances[0].World, XMMatrixScaling(2.0f, 1.0f, 2.0f)*XMMatrixTranslation(0.0f, 0.5f, 0.0f));
+	testObject->Instances[0].TexScale = XMFLOAT2(1.0f, 1.0f);
+	testObject->Instances[0].World = InstanceTransform::FromMatrix(XMMatrixScaling(2.0f, 1.0f, 2.0f)*XMMatrixTranslation(0.0f, 0.5f, 0.0f));
 	mAllImmerseObjects.push_back(testObject.get());
 	mImmerseObjects.push_back(std::move(testObject));
 	*/
@@ -2745,23 +3119,22 @@ void MainApp::BuildRenderItems()
 	wallRitem->StartIndexLocation = wallRitem->Geo->DrawArgs["wall"].StartIndexLocation;
 	wallRitem->BaseVertexLocation = wallRitem->Geo->DrawArgs["wall"].BaseVertexLocation;
 	wallRitem->Instances.resize(wallRitem->InstanceCount);
-	XMStoreFloat4x4(&wallRitem->Instances[0].TexTransform, XMMatrixScaling(4, 3.5, 1));
-	XMStoreFloat4x4(&wallRitem->Instances[0].World, XMMatrixTranslation(0, 1, 15) * XMMatrixScaling(4,3,1));
+	wallRitem->Instances[0].TexScale = XMFLOAT2(4, 3.5);
+	wallRitem->Instances[0].World = InstanceTransform::FromMatrix(XMMatrixTranslation(0, 1, 15) * XMMatrixScaling(4,3,1));
 	wallRitem->Instances[0].MaterialIndex = 0;
-	XMStoreFloat4x4(&wallRitem->Instances[1].TexTransform, XMMatrixScaling(4, 3.5, 1));
-	XMStoreFloat4x4(&wallRitem->Instances[1].World, XMMatrixTranslation(50, 1, 0) * XMMatrixScaling(.2f, 3, 30));
+	wallRitem->Instances[1].TexScale = XMFLOAT2(4, 3.5);
+	wallRitem->Instances[1].World = InstanceTransform::FromMatrix(XMMatrixTranslation(50, 1, 0) * XMMatrixScaling(.2f, 3, 30));
 	wallRitem->Instances[1].MaterialIndex = 0;
-	XMStoreFloat4x4(&wallRitem->Instances[2].TexTransform, XMMatrixScaling(4, 3.5, 1));
-	XMStoreFloat4x4(&wallRitem->Instances[2].World, XMMatrixTranslation(-50, 1, 0) * XMMatrixScaling(.2f, 3, 30));
+	wallRitem->Instances[2].TexScale = XMFLOAT2(4, 3.5);
+	wallRitem->Instances[2].World = InstanceTransform::FromMatrix(XMMatrixTranslation(-50, 1, 0) * XMMatrixScaling(.2f, 3, 30));
 	wallRitem->Instances[2].MaterialIndex = 0;
-	XMStoreFloat4x4(&wallRitem->Instances[3].TexTransform, XMMatrixScaling(4, 3.5, 1));
-	XMStoreFloat4x4(&wallRitem->Instances[3].World, XMMatrixTranslation(0, 1, -15) * XMMatrixScaling(4, 3, 1));
+	wallRitem->Instances[3].TexScale = XMFLOAT2(4, 3.5);
+	wallRitem->Instances[3].World = InstanceTransform::FromMatrix(XMMatrixTranslation(0, 1, -15) * XMMatrixScaling(4, 3, 1));
 	wallRitem->Instances[3].MaterialIndex = 0;
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(wallRitem.get());
 	mAllRitems.push_back(std::move(wallRitem));
 	*/
 
-	/*
 	auto boxModelRitem = std::make_unique<RenderItem>();
 	boxModelRitem->World = MathHelper::Identity4x4();
 	boxModelRitem->TexTransform = MathHelper::Identity4x4();
@@ -2770,17 +3143,20 @@ void MainApp::BuildRenderItems()
 	boxModelRitem->IndexCount = boxModelRitem->Geo->DrawArgs["boxModel"].IndexCount;
 	boxModelRitem->StartIndexLocation = boxModelRitem->Geo->DrawArgs["boxModel"].StartIndexLocation;
 	boxModelRitem->BaseVertexLocation = boxModelRitem->Geo->DrawArgs["boxModel"].BaseVertexLocation;
+	boxModelRitem->VertexTransform = boxModelRitem->Geo->DrawArgs["boxModel"].VertexTransform;
+	boxModelRitem->MeshletOffset = boxModelRitem->Geo->DrawArgs["boxModel"].MeshletOffset;
+	boxModelRitem->MeshletCount = boxModelRitem->Geo->DrawArgs["boxModel"].MeshletCount;
+	boxModelRitem->Bounds = boxModelRitem->Geo->DrawArgs["boxModel"].Bounds;
+	boxModelRitem->Lods = boxModelRitem->Geo->LodChain("boxModel");
 	boxModelRitem->InstanceCount = 1;
 	boxModelRitem->instanceBufferIndex = 4;
 	boxModelRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	boxModelRitem->Instances.resize(1);
 	boxModelRitem->Instances[0].MaterialIndex = 6;
-	boxModelRitem->Instances[0].TexTransform = MathHelper::Identity4x4();
-	XMStoreFloat4x4(&boxModelRitem->Instances[0].World, XMMatrixTranslation(0, -120, 0) * XMMatrixRotationRollPitchYaw(XMConvertToRadians(-90), XMConvertToRadians(180), 0) *XMMatrixScaling(.02, .02, .02));
+	boxModelRitem->Instances[0].World = InstanceTransform::FromMatrix(XMMatrixTranslation(0, -120, 0) * XMMatrixRotationRollPitchYaw(XMConvertToRadians(-90), XMConvertToRadians(180), 0) *XMMatrixScaling(.02, .02, .02));
 	
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(boxModelRitem.get());
+	mRitemLayer[(int)RenderLayer::OpaquePacked].push_back(boxModelRitem.get());
 	mAllRitems.push_back(std::move(boxModelRitem));
-	*/
 	
 	std::string pi = "There are " + std::to_string((int)mAllRitems.size()) + " render items" ;
 	std::wstring stemp = std::wstring(pi.begin(), pi.end());
@@ -2810,7 +3186,7 @@ void MainApp::DrawEditorGUI(ID3D12GraphicsCommandList * cmdList)
 	}
 }
 
-void MainApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
+void MainApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems, bool cullMeshlets)
 {
 
 	for (size_t i = 0; i < ritems.size(); ++i)
@@ -2821,7 +3197,17 @@ void MainApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vec
 		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 		auto instanceBuffer = mCurrFrameResource->renderItemBuffers[ri->instanceBufferIndex]->Resource();
 		cmdList->SetGraphicsRootShaderResourceView(0, instanceBuffer->GetGPUVirtualAddress());
-		cmdList->DrawIndexedInstanced(ri->IndexCount, ri->InstanceCount, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+
+		if (cullMeshlets && ri->MeshletCount > 0 && ri->LodIndex == 0)
+		{
+			// Only the meshlets that survived UpdateInstanceData's culling.
+			for (const auto& range : ri->VisibleIndexRanges)
+				cmdList->DrawIndexedInstanced(range.IndexCount, ri->InstanceCount, range.StartIndexLocation, ri->BaseVertexLocation, 0);
+		}
+		else
+		{
+			cmdList->DrawIndexedInstanced(ri->IndexCount, ri->InstanceCount, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		}
 	
 	}
 	
@@ -2884,6 +3270,10 @@ void MainApp::DrawSceneToShadowMap()
     DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
 	DrawImmerseObjects(mCommandList.Get(), mAllImmerseObjects);
 
+	// Meshlets culled against the camera may still cast visible shadows.
+	mCommandList->SetPipelineState(mPSOs["shadow_opaque_packed"].Get());
+	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::OpaquePacked], false);
+
 
     // Change back to GENERIC_READ so we can read the texture in a shader.
     mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mShadowMap->Resource(),
@@ -2926,6 +3316,9 @@ void MainApp::DrawNormalsAndDepth()
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
 	DrawImmerseObjects(mCommandList.Get(), mAllImmerseObjects);
 
+	mCommandList->SetPipelineState(mPSOs["drawNormals_packed"].Get());
+	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::OpaquePacked]);
+
 	// Change back to GENERIC_READ so we can read the texture in a shader.
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(normalMap,
 		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_GENERIC_READ));
@@ -26,7 +26,7 @@ struct MaterialData
 	float4x4 MatTransform;
 	uint     DiffuseMapIndex;
 	uint     NormalMapIndex;
-	uint     MatPad0;
+	uint     NormalMapTwoChannel;
 	uint     MatPad1;
 };
 
@@ -102,17 +102,24 @@ cbuffer cbPass : register(b1)
 };
 
 //---------------------------------------------------------------------------------------
-// Transforms a normal map sample to world space.
+// Transforms a normal map sample to world space.  twoChannel is set for two channel
+// (BC5) normal maps, which store only x and y.
 //---------------------------------------------------------------------------------------
-float3 NormalSampleToWorldSpace(float3 normalMapSample, float3 unitNormalW, float3 tangentW)
+float3 NormalSampleToWorldSpace(float3 normalMapSample, float3 unitNormalW, float4 tangentW, bool twoChannel)
 {
 	// Uncompress each component from [0,1] to [-1,1].
 	float3 normalT = 2.0f*normalMapSample - 1.0f;
 
+	// Rebuild z, which is never negative in tangent space.
+	if (twoChannel)
+		normalT.z = sqrt(saturate(1.0f - dot(normalT.xy, normalT.xy)));
+
 	// Build orthonormal basis.
 	float3 N = unitNormalW;
-	float3 T = normalize(tangentW - dot(tangentW, N)*N);
-	float3 B = cross(N, T);
+	float3 T = normalize(tangentW.xyz - dot(tangentW.xyz, N)*N);
+
+	// w is the handedness, -1 where the texture is mirrored.
+	float3 B = tangentW.w*cross(N, T);
 
 	float3x3 TBN = float3x3(T, B, N);
 
@@ -122,6 +129,17 @@ float3 NormalSampleToWorldSpace(float3 normalMapSample, float3 unitNormalW, floa
 	return bumpedNormalW;
 }
 
+//---------------------------------------------------------------------------------------
+// Decodes a unit vector stored with octahedral encoding (see VertexCompression.h).
+//---------------------------------------------------------------------------------------
+float3 OctahedralDecode(float2 e)
+{
+	float3 v = float3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+	float t = saturate(-v.z);
+	v.xy += (v.xy >= 0.0f) ? -t : t;
+	return normalize(v);
+}
+
 //---------------------------------------------------------------------------------------
 // PCF for shadow mapping.
 //---------------------------------------------------------------------------------------
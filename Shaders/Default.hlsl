@@ -7,10 +7,23 @@
 
 struct VertexIn
 {
+#ifdef PACKED_NORMALS
+	// Quantized position in xyz, tangent handedness in w (1 or 0 for +1 or -1).
+	float4 PosL    : POSITION;
+#else
 	float3 PosL    : POSITION;
+#endif
+#ifdef PACKED_NORMALS
+	// Octahedral encoded normal in xy, tangent in zw.
+	float4 NormalTangentL : NORMAL;
+#else
 	float3 NormalL : NORMAL;
+#endif
 	float2 TexC    : TEXCOORD;
-	float3 TangentU : TANGENT;
+#ifndef PACKED_NORMALS
+	// Tangent in xyz, handedness in w.
+	float4 TangentU : TANGENT;
+#endif
 };
 
 struct VertexOut
@@ -20,7 +33,7 @@ struct VertexOut
 	float4 SsaoPosH   : POSITION1;
 	float3 PosW    : POSITION2;
 	float3 NormalW : NORMAL;
-	float3 TangentW : TANGENT;
+	float4 TangentW : TANGENT;
 	float2 TexC    : TEXCOORD;
 
 	nointerpolation uint MatIndex : MATINDEX;
@@ -36,6 +49,16 @@ VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
 	
 	VertexOut vout = (VertexOut)0.0f;
 	InstanceData data = gInstanceData[instanceID];
+
+#ifdef PACKED_NORMALS
+	float3 normalL = OctahedralDecode(vin.NormalTangentL.xy);
+	float3 tangentL = OctahedralDecode(vin.NormalTangentL.zw);
+	float tangentSign = vin.PosL.w * 2.0f - 1.0f;
+#else
+	float3 normalL = vin.NormalL;
+	float3 tangentL = vin.TangentU.xyz;
+	float tangentSign = vin.TangentU.w;
+#endif
 	float4x4 world = data.World;
 	float4x4 texTransform = data.TexTransform;
 	uint matIndex = data.MaterialIndex;
@@ -45,13 +68,13 @@ VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
 	MaterialData matData = gMaterialData[matIndex];
 	
 	// Transform to world space.
-	float4 posW = mul(float4(vin.PosL, 1.0f), world);
+	float4 posW = mul(float4(vin.PosL.xyz, 1.0f), world);
 	vout.PosW = posW.xyz;
 	
 	// Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-	vout.NormalW = mul(vin.NormalL, (float3x3)world);
+	vout.NormalW = mul(normalL, (float3x3)world);
 
-	vout.TangentW = mul(vin.TangentU, (float3x3)world);
+	vout.TangentW = float4(mul(tangentL, (float3x3)world), tangentSign);
 
 	// Transform to homogeneous clip space.
 	vout.PosH = mul(posW, gViewProj);
@@ -103,7 +126,8 @@ float4 PS(VertexOut pin) : SV_Target
 	pin.NormalW = normalize(pin.NormalW);
 
 	float4 normalMapSample = gTextureMaps[normalMapIndex].Sample(gsamAnisotropicWrap, pin.TexC);
-	float3 bumpedNormalW = NormalSampleToWorldSpace(normalMapSample.rgb, pin.NormalW, pin.TangentW);
+	float3 bumpedNormalW = NormalSampleToWorldSpace(normalMapSample.rgb, pin.NormalW, pin.TangentW,
+		matData.NormalMapTwoChannel != 0);
 
 	// Uncomment to turn off normal mapping.
 	//bumpedNormalW = pin.NormalW;
@@ -21,9 +21,17 @@
 struct VertexIn
 {
 	float3 PosL    : POSITION;
-    float3 NormalL : NORMAL;
+#ifdef PACKED_NORMALS
+	// Octahedral encoded normal in xy, tangent in zw.
+	float4 NormalTangentL : NORMAL;
+#else
+	float3 NormalL : NORMAL;
+#endif
 	float2 TexC    : TEXCOORD;
-	float3 TangentU : TANGENT;
+#ifndef PACKED_NORMALS
+	// Tangent in xyz, handedness in w.
+	float4 TangentU : TANGENT;
+#endif
 };
 
 struct VertexOut
@@ -40,6 +48,14 @@ VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
 {
 	VertexOut vout = (VertexOut)0.0f;
 	InstanceData data = gInstanceData[instanceID];
+
+#ifdef PACKED_NORMALS
+	float3 normalL = OctahedralDecode(vin.NormalTangentL.xy);
+	float3 tangentL = OctahedralDecode(vin.NormalTangentL.zw);
+#else
+	float3 normalL = vin.NormalL;
+	float3 tangentL = vin.TangentU.xyz;
+#endif
 	float4x4 world = data.World;
 	float4x4 texTransform = data.TexTransform;
 	uint matIndex = data.MaterialIndex;
@@ -51,8 +67,8 @@ VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
 	
 	
     // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-    vout.NormalW = mul(vin.NormalL, (float3x3)world);
-	vout.TangentW = mul(vin.TangentU, (float3x3)world);
+    vout.NormalW = mul(normalL, (float3x3)world);
+	vout.TangentW = mul(tangentL, (float3x3)world);
 
     // Transform to homogeneous clip space.
     float4 posW = mul(float4(vin.PosL, 1.0f), world);
@@ -400,17 +400,15 @@ void Ssao::BuildRandomVectorTexture(ID3D12GraphicsCommandList* cmdList)
         nullptr,
         IID_PPV_ARGS(mRandomVectorMapUploadBuffer.GetAddressOf())));
 
-    XMCOLOR initData[256 * 256];
-    for(int i = 0; i < 256; ++i)
-    {
-        for(int j = 0; j < 256; ++j)
-        {
-			// Random vector in [0,1].  We will decompress in shader to [-1,1].
-            XMFLOAT3 v(MathHelper::RandF(), MathHelper::RandF(), MathHelper::RandF());
+	// Random vectors in [0,1].  We will decompress in shader to [-1,1].  A fixed seed
+	// keeps the noise the same on every run.
+	std::vector<float> values(256 * 256 * 3);
+	Random random(Random::DefaultSeed);
+	random.Fill(values.data(), values.size());
 
-            initData[i * 256 + j] = XMCOLOR(v.x, v.y, v.z, 0.0f);
-        }
-    }
+    XMCOLOR initData[256 * 256];
+    for(int i = 0; i < 256 * 256; ++i)
+		initData[i] = XMCOLOR(values[3 * i], values[3 * i + 1], values[3 * i + 2], 0.0f);
 
     D3D12_SUBRESOURCE_DATA subResourceData = {};
     subResourceData.pData = initData;
@@ -461,10 +459,14 @@ void Ssao::BuildOffsetVectors()
 	mOffsets[12] = XMFLOAT4(0.0f, 0.0f, -1.0f, 0.0f);
 	mOffsets[13] = XMFLOAT4(0.0f, 0.0f, +1.0f, 0.0f);
 
+	// Create random lengths in [0.25, 1.0].
+	float lengths[14];
+	Random random(Random::DefaultSeed, 1);
+	random.Fill(lengths, 14, 0.25f, 1.0f);
+
     for(int i = 0; i < 14; ++i)
 	{
-		// Create random lengths in [0.25, 1.0].
-		float s = MathHelper::RandF(0.25f, 1.0f);
+		float s = lengths[i];
 		
 		XMVECTOR v = s * XMVector4Normalize(XMLoadFloat4(&mOffsets[i]));
 		
@@ -0,0 +1,570 @@
+//***************************************************************************************
+// BatchMathTests.cpp
+//
+// Checks every BatchMath kernel, on every path this CPU supports, against DirectXMath
+// over random inputs, then times each kernel per path.  Counts are chosen so the
+// vector paths also run their scalar leftovers, and the inputs are read through a
+// padded stride and through stride 0.  InverseAffine is also given badly scaled,
+// mirrored and singular matrices.
+//
+// Pass an iteration count to time longer; the default keeps a ctest run short.
+//***************************************************************************************
+
+#include "../Common/BatchMath.h"
+#include "TestHarness.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = std::uint32_t;
+
+	// Not a multiple of 8, so every path finishes on its scalar tail.
+	const uint32 Count = 1003;
+
+	std::mt19937 gRandom(20240517);
+
+	float Uniform(float a, float b)
+	{
+		return std::uniform_real_distribution<float>(a, b)(gRandom);
+	}
+
+	XMVECTOR RandomRotation()
+	{
+		XMVECTOR axis = XMVector3Normalize(XMVectorSet(Uniform(-1, 1), Uniform(-1, 1), Uniform(-1, 1) + 2.0f, 0.0f));
+		return XMQuaternionRotationAxis(axis, Uniform(-XM_PI, XM_PI));
+	}
+
+	InstanceTransform RandomInstance()
+	{
+		InstanceTransform t;
+		XMStoreFloat3(&t.Translation, XMVectorSet(Uniform(-100, 100), Uniform(-100, 100), Uniform(-100, 100), 0.0f));
+		XMStoreFloat4(&t.Rotation, RandomRotation());
+		t.Scale = XMFLOAT3(Uniform(0.1f, 10.0f), Uniform(0.1f, 10.0f), Uniform(0.1f, 10.0f));
+		return t;
+	}
+
+	XMMATRIX InstanceMatrix(const InstanceTransform& t)
+	{
+		return XMMatrixScaling(t.Scale.x, t.Scale.y, t.Scale.z) *
+			XMMatrixRotationQuaternion(XMLoadFloat4(&t.Rotation)) *
+			XMMatrixTranslation(t.Translation.x, t.Translation.y, t.Translation.z);
+	}
+
+	// A scaled, sheared, rotated and translated matrix whose fourth column is garbage,
+	// which the affine kernels must ignore.
+	XMFLOAT4X4 RandomAffine()
+	{
+		XMMATRIX shear = XMMatrixIdentity();
+		shear.r[1] = XMVectorSet(Uniform(-0.5f, 0.5f), 1.0f, 0.0f, 0.0f);
+		shear.r[2] = XMVectorSet(Uniform(-0.5f, 0.5f), Uniform(-0.5f, 0.5f), 1.0f, 0.0f);
+
+		XMFLOAT4X4 m;
+		XMStoreFloat4x4(&m, shear * InstanceMatrix(RandomInstance()));
+		for(int r = 0; r < 4; ++r)
+			m(r, 3) = Uniform(-5, 5);
+		return m;
+	}
+
+	// m with its fourth column set to (0, 0, 0, 1), as the kernels read it.
+	XMMATRIX AsAffine(const XMFLOAT4X4& m)
+	{
+		XMFLOAT4X4 a = m;
+		a(0, 3) = a(1, 3) = a(2, 3) = 0.0f;
+		a(3, 3) = 1.0f;
+		return XMLoadFloat4x4(&a);
+	}
+
+	bool Near(float expected, float actual, float tolerance, float scale = 1.0f)
+	{
+		return std::fabs(expected - actual) <= tolerance * (std::fabs(expected) > scale ? std::fabs(expected) : scale);
+	}
+
+	bool NearMatrix(FXMMATRIX expected, const XMFLOAT4X4& actual, float tolerance, float scale = 1.0f)
+	{
+		XMFLOAT4X4 e;
+		XMStoreFloat4x4(&e, expected);
+		for(int r = 0; r < 4; ++r)
+		{
+			for(int c = 0; c < 4; ++c)
+			{
+				if(!Near(e(r, c), actual(r, c), tolerance, scale))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	bool NearFloat3(const XMFLOAT3& expected, const XMFLOAT3& actual, float tolerance, float scale)
+	{
+		return Near(expected.x, actual.x, tolerance, scale) && Near(expected.y, actual.y, tolerance, scale) &&
+			Near(expected.z, actual.z, tolerance, scale);
+	}
+
+	// The largest absolute element of the 3x3 part and translation.
+	float Magnitude(const XMFLOAT4X4& m)
+	{
+		float largest = 0.0f;
+		for(int r = 0; r < 4; ++r)
+		{
+			for(int c = 0; c < 3; ++c)
+				largest = std::fmax(largest, std::fabs(m(r, c)));
+		}
+		return largest;
+	}
+
+	// The inputs each kernel reads, kept inside larger structs so the strides are not the
+	// item sizes.
+	struct PaddedMatrix
+	{
+		XMFLOAT4X4 M;
+		float Padding[3];
+	};
+
+	struct PaddedInstance
+	{
+		float Padding;
+		InstanceTransform T;
+	};
+
+	struct Inputs
+	{
+		std::vector<PaddedMatrix> A;
+		std::vector<XMFLOAT4X4> B;
+		std::vector<PaddedInstance> Instances;
+		std::vector<BoundingBox> Boxes;
+		std::vector<BoundingSphere> Spheres;
+		BatchMath::FrustumPlanes Planes;
+		XMVECTOR PlaneVectors[6];
+	};
+
+	Inputs MakeInputs()
+	{
+		Inputs in;
+		in.A.resize(Count);
+		in.B.resize(Count);
+		in.Instances.resize(Count);
+		in.Boxes.resize(Count);
+		in.Spheres.resize(Count);
+
+		for(uint32 i = 0; i < Count; ++i)
+		{
+			in.A[i].M = RandomAffine();
+			in.B[i] = RandomAffine();
+			in.Instances[i].T = RandomInstance();
+
+			in.Boxes[i].Center = XMFLOAT3(Uniform(-20, 20), Uniform(-20, 20), Uniform(-20, 20));
+			in.Boxes[i].Extents = XMFLOAT3(Uniform(0, 5), Uniform(0, 5), Uniform(0, 5));
+			in.Spheres[i].Center = in.Boxes[i].Center;
+			in.Spheres[i].Radius = Uniform(0, 5);
+		}
+
+		// A box-shaped region around the origin, at random orientations.
+		for(uint32 p = 0; p < BatchMath::FrustumPlanes::Count; ++p)
+		{
+			XMVECTOR normal = XMVector3Rotate(XMVectorSet(p % 3 == 0 ? 1.0f : 0.0f, p % 3 == 1 ? 1.0f : 0.0f,
+				p % 3 == 2 ? 1.0f : 0.0f, 0.0f), RandomRotation());
+			if(p >= 3)
+				normal = XMVectorNegate(normal);
+
+			// Inside is a x + b y + c z + d >= 0.
+			in.PlaneVectors[p] = XMVectorSetW(normal, Uniform(5, 25));
+			XMFLOAT4 plane;
+			XMStoreFloat4(&plane, in.PlaneVectors[p]);
+			in.Planes.A[p] = plane.x;
+			in.Planes.B[p] = plane.y;
+			in.Planes.C[p] = plane.z;
+			in.Planes.D[p] = plane.w;
+		}
+		for(uint32 p = BatchMath::FrustumPlanes::Count; p < 8; ++p)
+		{
+			in.Planes.A[p] = in.Planes.B[p] = in.Planes.C[p] = 0.0f;
+			in.Planes.D[p] = 1.0f;
+		}
+
+		return in;
+	}
+
+	void CheckMultiplyAffine(const Inputs& in)
+	{
+		std::vector<XMFLOAT4X4> out(Count);
+		BatchMath::MultiplyAffine(&in.A[0].M, sizeof(PaddedMatrix), in.B.data(), sizeof(XMFLOAT4X4), out.data(), Count);
+
+		int failures = 0;
+		for(uint32 i = 0; i < Count; ++i)
+		{
+			XMMATRIX expected = XMMatrixMultiply(AsAffine(in.A[i].M), AsAffine(in.B[i]));
+			failures += NearMatrix(expected, out[i], 1e-5f, Magnitude(out[i])) ? 0 : 1;
+		}
+		CHECK(failures == 0);
+
+		// Stride 0 repeats one matrix.
+		BatchMath::MultiplyAffine(&in.A[0].M, 0, in.B.data(), sizeof(XMFLOAT4X4), out.data(), Count);
+		failures = 0;
+		for(uint32 i = 0; i < Count; ++i)
+		{
+			XMMATRIX expected = XMMatrixMultiply(AsAffine(in.A[0].M), AsAffine(in.B[i]));
+			failures += NearMatrix(expected, out[i], 1e-5f, Magnitude(out[i])) ? 0 : 1;
+		}
+		CHECK(failures == 0);
+
+		// In place.
+		std::vector<XMFLOAT4X4> inPlace(in.B);
+		BatchMath::MultiplyAffine(&in.A[0].M, sizeof(PaddedMatrix), inPlace.data(), sizeof(XMFLOAT4X4), inPlace.data(), Count);
+		BatchMath::MultiplyAffine(&in.A[0].M, sizeof(PaddedMatrix), in.B.data(), sizeof(XMFLOAT4X4), out.data(), Count);
+		failures = 0;
+		for(uint32 i = 0; i < Count; ++i)
+			failures += NearMatrix(XMLoadFloat4x4(&out[i]), inPlace[i], 0.0f) ? 0 : 1;
+		CHECK(failures == 0);
+	}
+
+	bool AllFinite(const XMFLOAT4X4& m)
+	{
+		for(int r = 0; r < 4; ++r)
+		{
+			for(int c = 0; c < 4; ++c)
+			{
+				if(!std::isfinite(m(r, c)))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// Whether any element of the 3x3 part of m is an infinity or a NaN.
+	bool AnyNonFinite3x3(FXMMATRIX m)
+	{
+		XMFLOAT4X4 f;
+		XMStoreFloat4x4(&f, m);
+		for(int r = 0; r < 3; ++r)
+		{
+			for(int c = 0; c < 3; ++c)
+			{
+				if(!std::isfinite(f(r, c)))
+					return true;
+			}
+		}
+		return false;
+	}
+
+	void CheckInverseAffine(const Inputs& in)
+	{
+		std::vector<XMFLOAT4X4> out(Count);
+		BatchMath::InverseAffine(&in.A[0].M, sizeof(PaddedMatrix), out.data(), Count);
+
+		int failures = 0;
+		for(uint32 i = 0; i < Count; ++i)
+		{
+			XMMATRIX expected = XMMatrixInverse(nullptr, AsAffine(in.A[i].M));
+			failures += NearMatrix(expected, out[i], 1e-4f, Magnitude(out[i])) ? 0 : 1;
+			failures += NearMatrix(XMMatrixIdentity(), [&]()
+			{
+				XMFLOAT4X4 product;
+				XMStoreFloat4x4(&product, AsAffine(in.A[i].M) * XMLoadFloat4x4(&out[i]));
+				return product;
+			}(), 1e-4f, Magnitude(in.A[i].M)) ? 0 : 1;
+		}
+		CHECK(failures == 0);
+
+		// Invertible but badly scaled: tiny and huge scales, mirroring and far away
+		// translations.  The tolerance grows with the spread of the scales.
+		const float scales[][3] =
+		{
+			{ 1e-3f, 1.0f, 1.0f }, { 1e3f, 1e3f, 1e3f }, { 1e-3f, 1e-3f, 1e-3f }, { -1.0f, 1.0f, 1.0f },
+			{ -2.0f, -3.0f, -4.0f }, { 1e2f, 1e-2f, 1.0f }
+		};
+		const float translations[] = { 0.0f, 1e4f, -1e5f };
+		std::vector<XMFLOAT4X4> hard;
+		for(const auto& s : scales)
+		{
+			for(float t : translations)
+			{
+				XMFLOAT4X4 m;
+				XMStoreFloat4x4(&m, XMMatrixScaling(s[0], s[1], s[2]) * XMMatrixRotationQuaternion(RandomRotation()) *
+					XMMatrixTranslation(t, -t, 0.5f * t));
+				hard.push_back(m);
+			}
+		}
+
+		std::vector<XMFLOAT4X4> hardOut(hard.size());
+		BatchMath::InverseAffine(hard.data(), sizeof(XMFLOAT4X4), hardOut.data(), (uint32)hard.size());
+		for(std::size_t i = 0; i < hard.size(); ++i)
+		{
+			CHECK(AllFinite(hardOut[i]));
+
+			XMMATRIX expected = XMMatrixInverse(nullptr, XMLoadFloat4x4(&hard[i]));
+			CHECK(NearMatrix(expected, hardOut[i], 1e-3f, Magnitude(hardOut[i])));
+		}
+
+		// Singular 3x3 parts.  The entries are small integers, so the determinant comes
+		// out exactly zero on every path; like XMMatrixInverse the result is not finite.
+		const XMFLOAT4X4 singular[] =
+		{
+			// All zero.
+			XMFLOAT4X4(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 1),
+			// A zero scale on one axis.
+			XMFLOAT4X4(0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 4, 5, 6, 1),
+			// Two parallel rows.
+			XMFLOAT4X4(1, 2, 3, 0, 2, 4, 6, 0, 0, 1, 5, 0, 0, 0, 0, 1),
+			// A row that is the sum of the others.
+			XMFLOAT4X4(1, 0, 2, 0, 0, 3, 1, 0, 1, 3, 3, 0, -7, 0, 2, 1),
+			// Rank one.
+			XMFLOAT4X4(1, 2, 3, 0, 2, 4, 6, 0, -1, -2, -3, 0, 0, 0, 0, 1),
+		};
+		const uint32 singularCount = (uint32)(sizeof(singular) / sizeof(singular[0]));
+
+		// Padded to a full AVX2 batch and a tail, so both see singular matrices.
+		std::vector<XMFLOAT4X4> singularIn;
+		for(uint32 i = 0; i < 13; ++i)
+			singularIn.push_back(singular[i % singularCount]);
+
+		std::vector<XMFLOAT4X4> singularOut(singularIn.size());
+		BatchMath::InverseAffine(singularIn.data(), sizeof(XMFLOAT4X4), singularOut.data(), (uint32)singularIn.size());
+		for(std::size_t i = 0; i < singularIn.size(); ++i)
+		{
+			CHECK(AnyNonFinite3x3(XMMatrixInverse(nullptr, XMLoadFloat4x4(&singularIn[i]))));
+			CHECK(AnyNonFinite3x3(XMLoadFloat4x4(&singularOut[i])));
+
+			// The fourth column is written as (0, 0, 0, 1) regardless.
+			CHECK(singularOut[i](0, 3) == 0.0f && singularOut[i](1, 3) == 0.0f && singularOut[i](2, 3) == 0.0f &&
+				singularOut[i](3, 3) == 1.0f);
+		}
+	}
+
+	void CheckTransforms(const Inputs& in)
+	{
+		std::vector<XMFLOAT4X4> out(Count);
+		std::vector<XMFLOAT4X4> inverse(Count);
+		BatchMath::ComposeTransforms(&in.Instances[0].T, sizeof(PaddedInstance), out.data(), Count);
+		BatchMath::InverseTransforms(&in.Instances[0].T, sizeof(PaddedInstance), inverse.data(), Count);
+
+		int failures = 0;
+		for(uint32 i = 0; i < Count; ++i)
+		{
+			XMMATRIX expected = InstanceMatrix(in.Instances[i].T);
+			failures += NearMatrix(expected, out[i], 1e-5f, Magnitude(out[i])) ? 0 : 1;
+
+			XMMATRIX expectedInverse = XMMatrixInverse(nullptr, expected);
+			failures += NearMatrix(expectedInverse, inverse[i], 1e-4f, Magnitude(inverse[i])) ? 0 : 1;
+		}
+		CHECK(failures == 0);
+	}
+
+	void CheckStoreTransposed(const Inputs& in)
+	{
+		std::vector<XMFLOAT4X4> out(Count);
+		BatchMath::StoreTransposed(&in.A[0].M, sizeof(PaddedMatrix), out.data(), Count);
+
+		// A pure shuffle, so exact; unlike the other kernels all four columns are kept.
+		int failures = 0;
+		for(uint32 i = 0; i < Count; ++i)
+			failures += NearMatrix(XMMatrixTranspose(XMLoadFloat4x4(&in.A[i].M)), out[i], 0.0f) ? 0 : 1;
+		CHECK(failures == 0);
+	}
+
+	void CheckBounds(const Inputs& in)
+	{
+		std::vector<BoundingBox> boxes(Count);
+		BatchMath::TransformBoxes(in.Boxes.data(), sizeof(BoundingBox), &in.A[0].M, sizeof(PaddedMatrix), boxes.data(), Count);
+
+		int failures = 0;
+		for(uint32 i = 0; i < Count; ++i)
+		{
+			BoundingBox expected;
+			in.Boxes[i].Transform(expected, AsAffine(in.A[i].M));
+
+			float scale = Magnitude(in.A[i].M);
+			failures += NearFloat3(expected.Center, boxes[i].Center, 1e-4f, scale) ? 0 : 1;
+			failures += NearFloat3(expected.Extents, boxes[i].Extents, 1e-4f, scale) ? 0 : 1;
+		}
+		CHECK(failures == 0);
+
+		std::vector<BoundingSphere> spheres(Count);
+		BatchMath::TransformSpheres(in.Spheres.data(), sizeof(BoundingSphere), &in.A[0].M, sizeof(PaddedMatrix),
+			spheres.data(), Count);
+
+		failures = 0;
+		for(uint32 i = 0; i < Count; ++i)
+		{
+			BoundingSphere expected;
+			in.Spheres[i].Transform(expected, AsAffine(in.A[i].M));
+
+			float scale = Magnitude(in.A[i].M);
+			failures += NearFloat3(expected.Center, spheres[i].Center, 1e-4f, scale) ? 0 : 1;
+			failures += Near(expected.Radius, spheres[i].Radius, 1e-4f, scale) ? 0 : 1;
+		}
+		CHECK(failures == 0);
+	}
+
+	void CheckCullBoxes(const Inputs& in)
+	{
+		std::vector<std::uint8_t> visible(Count);
+		BatchMath::CullBoxes(in.Planes, in.Boxes.data(), sizeof(BoundingBox), visible.data(), Count);
+
+		// DirectXMath's planes face out of the volume.
+		XMVECTOR outward[6];
+		for(int p = 0; p < 6; ++p)
+			outward[p] = XMVectorNegate(in.PlaneVectors[p]);
+
+		int failures = 0;
+		int compared = 0;
+		int visibleCount = 0;
+		for(uint32 i = 0; i < Count; ++i)
+		{
+			const BoundingBox& box = in.Boxes[i];
+
+			// Boxes that just touch a plane may go either way with rounding.
+			bool borderline = false;
+			for(int p = 0; p < 6; ++p)
+			{
+				XMFLOAT4 plane;
+				XMStoreFloat4(&plane, in.PlaneVectors[p]);
+				float distance = plane.x * box.Center.x + plane.y * box.Center.y + plane.z * box.Center.z + plane.w;
+				float radius = std::fabs(plane.x) * box.Extents.x + std::fabs(plane.y) * box.Extents.y +
+					std::fabs(plane.z) * box.Extents.z;
+				if(std::fabs(distance + radius) < 1e-3f)
+					borderline = true;
+			}
+			if(borderline)
+				continue;
+
+			bool expected = box.ContainedBy(outward[0], outward[1], outward[2], outward[3], outward[4], outward[5]) != DISJOINT;
+			failures += (visible[i] != 0) == expected ? 0 : 1;
+			visibleCount += expected ? 1 : 0;
+			++compared;
+		}
+		CHECK(failures == 0);
+
+		// The inputs have to exercise both outcomes.
+		CHECK(visibleCount > compared / 10 && visibleCount < compared - compared / 10);
+	}
+
+	const char* PathName(BatchMath::Path path)
+	{
+		switch(path)
+		{
+		case BatchMath::Path::Avx2:
+			return "AVX2";
+		case BatchMath::Path::Sse:
+			return "SSE2";
+		default:
+			return "scalar";
+		}
+	}
+
+	// Nanoseconds per item of kernel, the best of several runs.
+	template<class Kernel>
+	double Time(uint32 iterations, Kernel kernel)
+	{
+		double best = 1e30;
+		for(int run = 0; run < 5; ++run)
+		{
+			auto start = std::chrono::steady_clock::now();
+			for(uint32 i = 0; i < iterations; ++i)
+				kernel();
+			std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+			best = std::fmin(best, elapsed.count() / ((double)iterations * Count));
+		}
+		return best;
+	}
+
+	void PrintTimings(const Inputs& in, const std::vector<BatchMath::Path>& paths, uint32 iterations)
+	{
+		std::vector<XMFLOAT4X4> matrices(Count);
+		std::vector<BoundingBox> boxes(Count);
+		std::vector<BoundingSphere> spheres(Count);
+		std::vector<std::uint8_t> visible(Count);
+
+		struct Row
+		{
+			const char* Name;
+			std::vector<double> Nanoseconds;
+		};
+		std::vector<Row> rows =
+		{
+			{ "MultiplyAffine", {} }, { "InverseAffine", {} }, { "ComposeTransforms", {} }, { "InverseTransforms", {} },
+			{ "StoreTransposed", {} }, { "TransformBoxes", {} }, { "TransformSpheres", {} }, { "CullBoxes", {} }
+		};
+
+		for(BatchMath::Path path : paths)
+		{
+			BatchMath::SetPath(path);
+			rows[0].Nanoseconds.push_back(Time(iterations, [&]() { BatchMath::MultiplyAffine(&in.A[0].M,
+				sizeof(PaddedMatrix), in.B.data(), sizeof(XMFLOAT4X4), matrices.data(), Count); }));
+			rows[1].Nanoseconds.push_back(Time(iterations, [&]() { BatchMath::InverseAffine(&in.A[0].M,
+				sizeof(PaddedMatrix), matrices.data(), Count); }));
+			rows[2].Nanoseconds.push_back(Time(iterations, [&]() { BatchMath::ComposeTransforms(&in.Instances[0].T,
+				sizeof(PaddedInstance), matrices.data(), Count); }));
+			rows[3].Nanoseconds.push_back(Time(iterations, [&]() { BatchMath::InverseTransforms(&in.Instances[0].T,
+				sizeof(PaddedInstance), matrices.data(), Count); }));
+			rows[4].Nanoseconds.push_back(Time(iterations, [&]() { BatchMath::StoreTransposed(&in.A[0].M,
+				sizeof(PaddedMatrix), matrices.data(), Count); }));
+			rows[5].Nanoseconds.push_back(Time(iterations, [&]() { BatchMath::TransformBoxes(in.Boxes.data(),
+				sizeof(BoundingBox), &in.A[0].M, sizeof(PaddedMatrix), boxes.data(), Count); }));
+			rows[6].Nanoseconds.push_back(Time(iterations, [&]() { BatchMath::TransformSpheres(in.Spheres.data(),
+				sizeof(BoundingSphere), &in.A[0].M, sizeof(PaddedMatrix), spheres.data(), Count); }));
+			rows[7].Nanoseconds.push_back(Time(iterations, [&]() { BatchMath::CullBoxes(in.Planes, in.Boxes.data(),
+				sizeof(BoundingBox), visible.data(), Count); }));
+		}
+
+		std::printf("\nns per item, %u items, best of 5 x %u calls\n%-20s", Count, iterations, "");
+		for(BatchMath::Path path : paths)
+			std::printf("%10s", PathName(path));
+		std::printf("\n");
+
+		for(const Row& row : rows)
+		{
+			std::printf("%-20s", row.Name);
+			for(double ns : row.Nanoseconds)
+				std::printf("%10.2f", ns);
+			std::printf("\n");
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	uint32 iterations = argc > 1 ? (uint32)std::strtoul(argv[1], nullptr, 10) : 20;
+
+#ifdef DIRECTX_MATH_VERSION
+	std::printf("DirectXMath %d\n", DIRECTX_MATH_VERSION);
+#else
+	std::printf("DirectXMath headers without DIRECTX_MATH_VERSION: not Microsoft's\n");
+#endif
+
+	const Inputs in = MakeInputs();
+
+	std::vector<BatchMath::Path> paths;
+	for(BatchMath::Path path : { BatchMath::Path::Scalar, BatchMath::Path::Sse, BatchMath::Path::Avx2 })
+	{
+		BatchMath::SetPath(path);
+		if(BatchMath::ActivePath() != path)
+		{
+			std::printf("%s: not supported here, skipped\n", PathName(path));
+			continue;
+		}
+		paths.push_back(path);
+
+		int failuresBefore = TestHarness::Failures();
+		CheckMultiplyAffine(in);
+		CheckInverseAffine(in);
+		CheckTransforms(in);
+		CheckStoreTransposed(in);
+		CheckBounds(in);
+		CheckCullBoxes(in);
+		std::printf("%s: %s\n", PathName(path), TestHarness::Failures() == failuresBefore ? "matches DirectXMath" : "FAILED");
+	}
+
+	if(iterations > 0)
+		PrintTimings(in, paths, iterations);
+
+	BatchMath::SetPath(BatchMath::BestPath());
+
+	return TestHarness::Finish("BatchMath");
+}
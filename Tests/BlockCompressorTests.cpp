@@ -0,0 +1,388 @@
+//***************************************************************************************
+// BlockCompressorTests.cpp
+//
+// Compresses fixed 4x4 blocks and decodes them again with a decoder written from the
+// format description, so the checks do not trust the encoder's own palette code:
+//   -BC1 endpoint order: the four color mode (first endpoint larger) everywhere except
+//    where the three color mode fits better, which never uses its transparent entry;
+//    BC3 color blocks never use the three color mode.
+//   -BC4 palettes: the eight value mode for ramps and the six value mode, with exact 0
+//    and 255, for blocks that have them.
+//   -BC5 round trips of normal map blocks within the error its palette allows.
+//***************************************************************************************
+
+#include "../Common/BlockCompressor.h"
+#include "TestHarness.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+	using uint8 = std::uint8_t;
+	using uint16 = std::uint16_t;
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	const BlockCompressor::Quality Qualities[] =
+	{
+		BlockCompressor::Quality::Fast, BlockCompressor::Quality::Normal, BlockCompressor::Quality::High
+	};
+
+	struct Rgba
+	{
+		uint8 R, G, B, A;
+	};
+
+	std::vector<uint8> Compress(const Rgba texels[16], BlockCompressor::Format format, BlockCompressor::Quality quality)
+	{
+		BlockCompressor::Image image;
+		image.Width = 4;
+		image.Height = 4;
+		image.RowPitch = 16;
+		image.Pixels = &texels[0].R;
+
+		std::vector<uint8> blocks;
+		BlockCompressor::Compress(image, format, quality, blocks);
+		return blocks;
+	}
+
+	struct Bc1Block
+	{
+		uint16 Color0;
+		uint16 Color1;
+		Rgba Texels[16];
+	};
+
+	Rgba Expand565(uint16 c)
+	{
+		uint32 r = (c >> 11) & 31;
+		uint32 g = (c >> 5) & 63;
+		uint32 b = c & 31;
+		return { (uint8)((r << 3) | (r >> 2)), (uint8)((g << 2) | (g >> 4)), (uint8)((b << 3) | (b >> 2)), 255 };
+	}
+
+	Rgba Blend(Rgba a, Rgba b, uint32 wa, uint32 wb)
+	{
+		uint32 sum = wa + wb;
+		return { (uint8)((a.R * wa + b.R * wb + sum / 2) / sum), (uint8)((a.G * wa + b.G * wb + sum / 2) / sum),
+			(uint8)((a.B * wa + b.B * wb + sum / 2) / sum), 255 };
+	}
+
+	Bc1Block DecodeBc1(const uint8* block)
+	{
+		Bc1Block decoded;
+		std::memcpy(&decoded.Color0, block + 0, 2);
+		std::memcpy(&decoded.Color1, block + 2, 2);
+
+		Rgba palette[4];
+		palette[0] = Expand565(decoded.Color0);
+		palette[1] = Expand565(decoded.Color1);
+		if(decoded.Color0 > decoded.Color1)
+		{
+			palette[2] = Blend(palette[0], palette[1], 2, 1);
+			palette[3] = Blend(palette[0], palette[1], 1, 2);
+		}
+		else
+		{
+			palette[2] = Blend(palette[0], palette[1], 1, 1);
+			palette[3] = { 0, 0, 0, 0 };
+		}
+
+		uint32 indices;
+		std::memcpy(&indices, block + 4, 4);
+		for(uint32 i = 0; i < 16; ++i)
+			decoded.Texels[i] = palette[(indices >> (2 * i)) & 3];
+
+		return decoded;
+	}
+
+	bool ThreeColorMode(const Bc1Block& block)
+	{
+		return block.Color0 <= block.Color1;
+	}
+
+	// Largest difference of any color channel, and of alpha, between the blocks.
+	int ColorError(const Rgba a[16], const Rgba b[16])
+	{
+		int error = 0;
+		for(uint32 i = 0; i < 16; ++i)
+		{
+			error = std::max(error, std::abs(a[i].R - b[i].R));
+			error = std::max(error, std::abs(a[i].G - b[i].G));
+			error = std::max(error, std::abs(a[i].B - b[i].B));
+			error = std::max(error, std::abs(a[i].A - b[i].A));
+		}
+		return error;
+	}
+
+	// The eight BC4 values of endpoints a0 and a1.
+	void Bc4Palette(uint32 a0, uint32 a1, uint32 palette[8])
+	{
+		palette[0] = a0;
+		palette[1] = a1;
+		if(a0 > a1)
+		{
+			for(uint32 i = 1; i < 7; ++i)
+				palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+		}
+		else
+		{
+			for(uint32 i = 1; i < 5; ++i)
+				palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	void DecodeBc4(const uint8* block, uint32 values[16])
+	{
+		uint32 palette[8];
+		Bc4Palette(block[0], block[1], palette);
+
+		uint64 indices = 0;
+		for(uint32 i = 0; i < 6; ++i)
+			indices |= (uint64)block[2 + i] << (8 * i);
+
+		for(uint32 i = 0; i < 16; ++i)
+			values[i] = palette[(indices >> (3 * i)) & 7];
+	}
+
+	bool SixValueMode(const uint8* block)
+	{
+		return block[0] <= block[1];
+	}
+
+	// A block of one channel in red, the rest zero and opaque.
+	void RedBlock(const uint32 values[16], Rgba texels[16])
+	{
+		for(uint32 i = 0; i < 16; ++i)
+			texels[i] = { (uint8)values[i], 0, 0, 255 };
+	}
+
+	// Quantized endpoints that decode exactly, and the color halfway between them.
+	const Rgba Red132 = { 132, 0, 0, 255 };		// 565 red 16
+	const Rgba Green130 = { 0, 130, 0, 255 };	// 565 green 32
+	const Rgba Blue132 = { 0, 0, 132, 255 };	// 565 blue 16
+
+	void TestBc1FourColor()
+	{
+		// A ramp in thirds lands on the four color palette exactly.
+		Rgba texels[16];
+		for(uint32 i = 0; i < 16; ++i)
+			texels[i] = Blend(Red132, Blue132, 3 - i % 4, i % 4);
+
+		for(BlockCompressor::Quality quality : Qualities)
+		{
+			Bc1Block decoded = DecodeBc1(Compress(texels, BlockCompressor::Format::BC1, quality).data());
+			CHECK(decoded.Color0 > decoded.Color1);
+			if(quality != BlockCompressor::Quality::Fast)
+				CHECK(ColorError(texels, decoded.Texels) <= 1);
+		}
+	}
+
+	void TestBc1ThreeColor()
+	{
+		// Both ends and their midpoint: the three color mode has all of them exactly,
+		// the four color mode is a sixth of the range off on the midpoints.
+		Rgba texels[16];
+		Rgba middle = Blend(Red132, Green130, 1, 1);
+		for(uint32 i = 0; i < 16; ++i)
+			texels[i] = i % 3 == 0 ? Red132 : (i % 3 == 1 ? Green130 : middle);
+
+		Bc1Block high = DecodeBc1(Compress(texels, BlockCompressor::Format::BC1, BlockCompressor::Quality::High).data());
+		CHECK(ThreeColorMode(high));
+		CHECK(ColorError(texels, high.Texels) <= 1);
+
+		// Only High tries the three color mode.
+		Bc1Block normal = DecodeBc1(Compress(texels, BlockCompressor::Format::BC1, BlockCompressor::Quality::Normal).data());
+		CHECK(!ThreeColorMode(normal));
+		CHECK(ColorError(texels, normal.Texels) > 1);
+
+		// BC3 decodes its color block in the four color mode whatever the endpoint order,
+		// so the encoder must not pick the three color mode there.
+		std::vector<uint8> bc3 = Compress(texels, BlockCompressor::Format::BC3, BlockCompressor::Quality::High);
+		Bc1Block color = DecodeBc1(bc3.data() + 8);
+		CHECK(!ThreeColorMode(color));
+	}
+
+	void TestBc1SingleColor()
+	{
+		Rgba texels[16];
+		for(uint32 i = 0; i < 16; ++i)
+			texels[i] = { 132, 130, 132, 255 };
+
+		for(BlockCompressor::Quality quality : Qualities)
+		{
+			Bc1Block decoded = DecodeBc1(Compress(texels, BlockCompressor::Format::BC1, quality).data());
+			CHECK(decoded.Color0 == decoded.Color1);
+			CHECK(ColorError(texels, decoded.Texels) == 0);
+		}
+	}
+
+	void TestBc1EndpointOrder()
+	{
+		// Whatever the block, BC1 never decodes to transparent black (the texels are
+		// opaque) and BC3's color block is in the four color mode, or one color.
+		std::mt19937 random(11);
+		int failures = 0;
+		for(int round = 0; round < 300; ++round)
+		{
+			Rgba texels[16];
+			Rgba a = { (uint8)random(), (uint8)random(), (uint8)random(), 255 };
+			Rgba b = { (uint8)random(), (uint8)random(), (uint8)random(), 255 };
+			for(uint32 i = 0; i < 16; ++i)
+			{
+				// Mostly along a line, like real blocks, with some noise.
+				uint32 wa = random() % 8;
+				uint32 wb = random() % 8 + 1;
+				Rgba c = Blend(a, b, wa, wb);
+				texels[i] = { (uint8)std::min(255, c.R + (int)(random() % 16)), c.G, (uint8)std::max(0, c.B - (int)(random() % 16)), 255 };
+			}
+
+			for(BlockCompressor::Quality quality : Qualities)
+			{
+				Bc1Block bc1 = DecodeBc1(Compress(texels, BlockCompressor::Format::BC1, quality).data());
+				for(uint32 i = 0; i < 16; ++i)
+					failures += bc1.Texels[i].A == 255 ? 0 : 1;
+
+				Bc1Block bc3 = DecodeBc1(Compress(texels, BlockCompressor::Format::BC3, quality).data() + 8);
+				if(bc3.Color0 == bc3.Color1)
+				{
+					for(uint32 i = 0; i < 16; ++i)
+						failures += std::memcmp(&bc3.Texels[i], &bc3.Texels[0], sizeof(Rgba)) == 0 ? 0 : 1;
+				}
+				else
+				{
+					failures += bc3.Color0 > bc3.Color1 ? 0 : 1;
+				}
+			}
+		}
+		CHECK(failures == 0);
+	}
+
+	void TestBc4EightValue()
+	{
+		// Sevenths of 30 to 240 are whole numbers, so the eight value palette is exact.
+		uint32 values[16];
+		for(uint32 i = 0; i < 16; ++i)
+			values[i] = 30 + (i % 8) * 30;
+
+		Rgba texels[16];
+		RedBlock(values, texels);
+
+		for(BlockCompressor::Quality quality : Qualities)
+		{
+			std::vector<uint8> block = Compress(texels, BlockCompressor::Format::BC5, quality);
+			CHECK(!SixValueMode(block.data()));
+			CHECK(block[0] == 240 && block[1] == 30);
+
+			uint32 decoded[16];
+			DecodeBc4(block.data(), decoded);
+			CHECK(std::equal(values, values + 16, decoded));
+		}
+	}
+
+	void TestBc4SixValue()
+	{
+		// Fifths of 100 to 180 plus exact 0 and 255: the six value palette holds every
+		// texel, the eight value one over 0 to 255 holds none of the middle ones.
+		uint32 values[16];
+		for(uint32 i = 0; i < 16; ++i)
+			values[i] = i % 8 == 0 ? 0 : (i % 8 == 1 ? 255 : 100 + (i % 8 - 2) * 16);
+
+		Rgba texels[16];
+		RedBlock(values, texels);
+
+		std::vector<uint8> high = Compress(texels, BlockCompressor::Format::BC5, BlockCompressor::Quality::High);
+		CHECK(SixValueMode(high.data()));
+		CHECK(high[0] == 100 && high[1] == 180);
+
+		uint32 decoded[16];
+		DecodeBc4(high.data(), decoded);
+		CHECK(std::equal(values, values + 16, decoded));
+
+		// The faster qualities stay in the eight value mode.
+		std::vector<uint8> normal = Compress(texels, BlockCompressor::Format::BC5, BlockCompressor::Quality::Normal);
+		CHECK(!SixValueMode(normal.data()));
+	}
+
+	// Round trips a normal map block through BC5.  Each channel must come back within
+	// half a palette step of the eight value mode over its range, plus rounding.
+	bool Bc5RoundTrip(const Rgba texels[16], BlockCompressor::Quality quality)
+	{
+		std::vector<uint8> block = Compress(texels, BlockCompressor::Format::BC5, quality);
+
+		uint32 red[16];
+		uint32 green[16];
+		DecodeBc4(block.data(), red);
+		DecodeBc4(block.data() + 8, green);
+
+		uint32 loR = 255, hiR = 0, loG = 255, hiG = 0;
+		for(uint32 i = 0; i < 16; ++i)
+		{
+			loR = std::min<uint32>(loR, texels[i].R);
+			hiR = std::max<uint32>(hiR, texels[i].R);
+			loG = std::min<uint32>(loG, texels[i].G);
+			hiG = std::max<uint32>(hiG, texels[i].G);
+		}
+
+		bool passed = true;
+		for(uint32 i = 0; i < 16; ++i)
+		{
+			passed = passed && std::abs((int)red[i] - texels[i].R) <= (int)(hiR - loR) / 14 + 1;
+			passed = passed && std::abs((int)green[i] - texels[i].G) <= (int)(hiG - loG) / 14 + 1;
+		}
+		return passed;
+	}
+
+	void TestBc5RoundTrip()
+	{
+		// A gentle slope, a crease where the normals flip across the block, and a flat
+		// block, all with the blue BC5 drops.
+		Rgba slope[16];
+		Rgba crease[16];
+		Rgba flat[16];
+		for(uint32 y = 0; y < 4; ++y)
+		{
+			for(uint32 x = 0; x < 4; ++x)
+			{
+				uint32 i = y * 4 + x;
+				slope[i] = { (uint8)(112 + x * 5 + y), (uint8)(140 - y * 7), 240, 255 };
+				crease[i] = { (uint8)(x < 2 ? 60 + y * 3 : 196 - y * 3), (uint8)(x < 2 ? 128 : 100 + x), 200, 255 };
+				flat[i] = { 128, 128, 255, 255 };
+			}
+		}
+
+		for(BlockCompressor::Quality quality : Qualities)
+		{
+			CHECK(Bc5RoundTrip(slope, quality));
+			CHECK(Bc5RoundTrip(crease, quality));
+			CHECK(Bc5RoundTrip(flat, quality));
+		}
+	}
+
+	void TestSizes()
+	{
+		// Edges are padded to whole blocks.
+		CHECK(BlockCompressor::CompressedSize(BlockCompressor::Format::BC1, 5, 5) == 4 * 8);
+		CHECK(BlockCompressor::CompressedSize(BlockCompressor::Format::BC5, 1, 1) == 16);
+		CHECK(BlockCompressor::CompressedSize(BlockCompressor::Format::BC3, 8, 4) == 2 * 16);
+	}
+}
+
+int main()
+{
+	TestBc1FourColor();
+	TestBc1ThreeColor();
+	TestBc1SingleColor();
+	TestBc1EndpointOrder();
+	TestBc4EightValue();
+	TestBc4SixValue();
+	TestBc5RoundTrip();
+	TestSizes();
+
+	return TestHarness::Finish("BlockCompressor");
+}
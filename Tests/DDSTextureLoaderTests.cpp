@@ -0,0 +1,311 @@
+//***************************************************************************************
+// DDSTextureLoaderTests.cpp
+//
+// GetDDSTextureLayout12 on DDS files built in memory, with the subresources it finds
+// checked against offsets and pitches worked out from the format description:
+//   -BC1 and BC3 with legacy headers and full mip chains, including sizes that are not
+//    multiples of the block size, and maxsize skipping the largest mips.
+//   -BC7 with a DX10 header, and its alpha mode.
+//   -Cube maps from both headers, and a DX10 array of uncompressed texels.
+//   -Truncated files, bad magic, missing headers and invalid DX10 fields, which have to
+//    fail with the documented errors and leave the layout empty.
+//***************************************************************************************
+
+#include "../Common/DDSTextureLoader.h"
+#include "TestHarness.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+
+	// Offsets in the file of the fields the tests set.
+	const std::size_t HeaderFlagsOffset = 8;
+	const std::size_t HeightOffset = 12;
+	const std::size_t WidthOffset = 16;
+	const std::size_t MipCountOffset = 28;
+	const std::size_t PixelFormatOffset = 76;
+	const std::size_t Caps2Offset = 112;
+	const std::size_t Dx10Offset = 128;
+
+	const std::size_t LegacyHeaderSize = 4 + 124;
+	const std::size_t Dx10HeaderSize = LegacyHeaderSize + 20;
+
+	const uint32 FlagsCapsHeightWidthPixelFormat = 0x1007;
+	const uint32 FlagsMipMapCount = 0x20000;
+	const uint32 PixelFormatFourCC = 0x4;
+	const uint32 Caps2CubeMapAllFaces = 0xfe00;
+	const uint32 MiscTextureCube = 0x4;
+	const uint32 DimensionTexture2D = 3;
+
+	uint32 FourCC(char a, char b, char c, char d)
+	{
+		return (uint32)(uint8)a | ((uint32)(uint8)b << 8) | ((uint32)(uint8)c << 16) | ((uint32)(uint8)d << 24);
+	}
+
+	void Write32(std::vector<uint8>& file, std::size_t offset, uint32 value)
+	{
+		for(int i = 0; i < 4; ++i)
+			file[offset + i] = (uint8)(value >> (8 * i));
+	}
+
+	// The header of a 2D texture in the legacy format, data not included.
+	std::vector<uint8> LegacyHeader(uint32 width, uint32 height, uint32 mipCount, uint32 fourCC)
+	{
+		std::vector<uint8> file(LegacyHeaderSize, 0);
+		Write32(file, 0, FourCC('D', 'D', 'S', ' '));
+		Write32(file, 4, 124);
+		Write32(file, HeaderFlagsOffset, FlagsCapsHeightWidthPixelFormat | FlagsMipMapCount);
+		Write32(file, HeightOffset, height);
+		Write32(file, WidthOffset, width);
+		Write32(file, MipCountOffset, mipCount);
+		Write32(file, PixelFormatOffset, 32);
+		Write32(file, PixelFormatOffset + 4, PixelFormatFourCC);
+		Write32(file, PixelFormatOffset + 8, fourCC);
+		return file;
+	}
+
+	std::vector<uint8> Dx10Header(uint32 width, uint32 height, uint32 mipCount, DXGI_FORMAT format,
+		uint32 arraySize, uint32 miscFlag = 0, uint32 miscFlags2 = 0)
+	{
+		std::vector<uint8> file = LegacyHeader(width, height, mipCount, FourCC('D', 'X', '1', '0'));
+		file.resize(Dx10HeaderSize, 0);
+		Write32(file, Dx10Offset, (uint32)format);
+		Write32(file, Dx10Offset + 4, DimensionTexture2D);
+		Write32(file, Dx10Offset + 8, miscFlag);
+		Write32(file, Dx10Offset + 12, arraySize);
+		Write32(file, Dx10Offset + 16, miscFlags2);
+		return file;
+	}
+
+	// Where a subresource is expected in the file and how it is laid out.
+	struct Expected
+	{
+		std::size_t Offset;
+		std::size_t RowPitch;
+		std::size_t SlicePitch;
+	};
+
+	// Subresources of arraySize slices of mipCount mips each, packed after headerSize
+	// bytes.  blockBytes is the size of a 4x4 block, or of a texel if not block compressed.
+	std::vector<Expected> ExpectedLayout(std::size_t headerSize, uint32 width, uint32 height, uint32 mipCount,
+		uint32 arraySize, std::size_t blockBytes, bool blockCompressed)
+	{
+		std::vector<Expected> layout;
+		std::size_t offset = headerSize;
+		for(uint32 slice = 0; slice < arraySize; ++slice)
+		{
+			for(uint32 mip = 0; mip < mipCount; ++mip)
+			{
+				std::size_t w = std::max(width >> mip, 1u);
+				std::size_t h = std::max(height >> mip, 1u);
+				std::size_t columns = blockCompressed ? std::max<std::size_t>((w + 3) / 4, 1) : w;
+				std::size_t rows = blockCompressed ? std::max<std::size_t>((h + 3) / 4, 1) : h;
+
+				Expected e = { offset, columns * blockBytes, columns * blockBytes * rows };
+				layout.push_back(e);
+				offset += e.SlicePitch;
+			}
+		}
+		return layout;
+	}
+
+	std::size_t DataSize(const std::vector<Expected>& layout)
+	{
+		return layout.empty() ? 0 : layout.back().Offset + layout.back().SlicePitch;
+	}
+
+	// The layout's subresources are exactly expected, skipping the first skip entries of
+	// each slice of mipCount + skip.
+	bool MatchesLayout(const std::vector<uint8>& file, const DDS_TEXTURE_LAYOUT12& layout,
+		const std::vector<Expected>& expected, std::size_t mipCount, std::size_t skip = 0)
+	{
+		std::size_t slices = expected.size() / (mipCount + skip);
+		if(layout.subresources.size() != slices * mipCount)
+			return false;
+
+		for(std::size_t slice = 0; slice < slices; ++slice)
+		{
+			for(std::size_t mip = 0; mip < mipCount; ++mip)
+			{
+				const D3D12_SUBRESOURCE_DATA& actual = layout.subresources[slice * mipCount + mip];
+				const Expected& e = expected[slice * (mipCount + skip) + skip + mip];
+				if((const uint8*)actual.pData != file.data() + e.Offset ||
+					(std::size_t)actual.RowPitch != e.RowPitch || (std::size_t)actual.SlicePitch != e.SlicePitch)
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	bool IsEmpty(const DDS_TEXTURE_LAYOUT12& layout)
+	{
+		return layout.format == DXGI_FORMAT_UNKNOWN && layout.subresources.empty() && layout.mipCount == 0;
+	}
+
+	void TestBc1()
+	{
+		// 64x32 down to 1x1; the last mips are smaller than a block but take a whole one.
+		std::vector<uint8> file = LegacyHeader(64, 32, 7, FourCC('D', 'X', 'T', '1'));
+		std::vector<Expected> expected = ExpectedLayout(LegacyHeaderSize, 64, 32, 7, 1, 8, true);
+		file.resize(DataSize(expected), 0xcd);
+
+		DDS_TEXTURE_LAYOUT12 layout;
+		CHECK(SUCCEEDED(GetDDSTextureLayout12(file.data(), file.size(), layout)));
+		CHECK(layout.dimension == D3D12_RESOURCE_DIMENSION_TEXTURE2D);
+		CHECK(layout.format == DXGI_FORMAT_BC1_UNORM);
+		CHECK(layout.width == 64 && layout.height == 32 && layout.depth == 1);
+		CHECK(layout.mipCount == 7 && layout.arraySize == 1 && !layout.isCubeMap);
+		CHECK(MatchesLayout(file, layout, expected, 7));
+		CHECK(expected[0].RowPitch == 16 * 8 && expected[6].SlicePitch == 8);
+
+		// Mips wider or taller than 16 are left out; the first kept one is 16x8.
+		CHECK(SUCCEEDED(GetDDSTextureLayout12(file.data(), file.size(), layout, 16)));
+		CHECK(layout.width == 16 && layout.height == 8 && layout.mipCount == 5);
+		CHECK(MatchesLayout(file, layout, expected, 5, 2));
+	}
+
+	void TestBc3()
+	{
+		// 20x12 is five by three blocks; 5x3 still takes two by one.
+		std::vector<uint8> file = LegacyHeader(20, 12, 5, FourCC('D', 'X', 'T', '5'));
+		std::vector<Expected> expected = ExpectedLayout(LegacyHeaderSize, 20, 12, 5, 1, 16, true);
+		file.resize(DataSize(expected), 0);
+
+		DDS_TEXTURE_LAYOUT12 layout;
+		CHECK(SUCCEEDED(GetDDSTextureLayout12(file.data(), file.size(), layout)));
+		CHECK(layout.format == DXGI_FORMAT_BC3_UNORM);
+		CHECK(layout.width == 20 && layout.height == 12 && layout.mipCount == 5);
+		CHECK(MatchesLayout(file, layout, expected, 5));
+		CHECK(expected[0].RowPitch == 5 * 16 && expected[0].SlicePitch == 5 * 3 * 16);
+		CHECK(expected[2].RowPitch == 2 * 16 && expected[2].SlicePitch == 2 * 16);
+		CHECK(layout.alphaMode == DDS_ALPHA_MODE_UNKNOWN);
+	}
+
+	void TestBc7Dx10()
+	{
+		std::vector<uint8> file = Dx10Header(16, 16, 5, DXGI_FORMAT_BC7_UNORM_SRGB, 1, 0, DDS_ALPHA_MODE_PREMULTIPLIED);
+		std::vector<Expected> expected = ExpectedLayout(Dx10HeaderSize, 16, 16, 5, 1, 16, true);
+		file.resize(DataSize(expected), 0);
+
+		DDS_TEXTURE_LAYOUT12 layout;
+		CHECK(SUCCEEDED(GetDDSTextureLayout12(file.data(), file.size(), layout)));
+		CHECK(layout.format == DXGI_FORMAT_BC7_UNORM_SRGB);
+		CHECK(layout.width == 16 && layout.height == 16 && layout.mipCount == 5 && layout.arraySize == 1);
+		CHECK(layout.alphaMode == DDS_ALPHA_MODE_PREMULTIPLIED);
+		CHECK(MatchesLayout(file, layout, expected, 5));
+	}
+
+	void TestCubeMaps()
+	{
+		// Six faces, each with its whole mip chain before the next face.
+		std::vector<uint8> legacy = LegacyHeader(8, 8, 4, FourCC('D', 'X', 'T', '1'));
+		Write32(legacy, Caps2Offset, Caps2CubeMapAllFaces);
+		std::vector<Expected> expected = ExpectedLayout(LegacyHeaderSize, 8, 8, 4, 6, 8, true);
+		legacy.resize(DataSize(expected), 0);
+
+		DDS_TEXTURE_LAYOUT12 layout;
+		CHECK(SUCCEEDED(GetDDSTextureLayout12(legacy.data(), legacy.size(), layout)));
+		CHECK(layout.isCubeMap && layout.arraySize == 6 && layout.mipCount == 4);
+		CHECK(MatchesLayout(legacy, layout, expected, 4));
+
+		// A cube map missing a face is not supported.
+		Write32(legacy, Caps2Offset, Caps2CubeMapAllFaces & ~0x8000u);
+		CHECK(GetDDSTextureLayout12(legacy.data(), legacy.size(), layout) == HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED));
+		CHECK(IsEmpty(layout));
+
+		// The DX10 header counts cubes, not faces.
+		std::vector<uint8> dx10 = Dx10Header(8, 8, 4, DXGI_FORMAT_BC1_UNORM, 1, MiscTextureCube);
+		expected = ExpectedLayout(Dx10HeaderSize, 8, 8, 4, 6, 8, true);
+		dx10.resize(DataSize(expected), 0);
+
+		CHECK(SUCCEEDED(GetDDSTextureLayout12(dx10.data(), dx10.size(), layout)));
+		CHECK(layout.isCubeMap && layout.arraySize == 6);
+		CHECK(MatchesLayout(dx10, layout, expected, 4));
+	}
+
+	void TestArray()
+	{
+		// Three slices of 5x3 RGBA; rows of uncompressed texels are not padded.
+		std::vector<uint8> file = Dx10Header(5, 3, 3, DXGI_FORMAT_R8G8B8A8_UNORM, 3);
+		std::vector<Expected> expected = ExpectedLayout(Dx10HeaderSize, 5, 3, 3, 3, 4, false);
+		file.resize(DataSize(expected), 0);
+
+		DDS_TEXTURE_LAYOUT12 layout;
+		CHECK(SUCCEEDED(GetDDSTextureLayout12(file.data(), file.size(), layout)));
+		CHECK(layout.format == DXGI_FORMAT_R8G8B8A8_UNORM);
+		CHECK(!layout.isCubeMap && layout.arraySize == 3 && layout.mipCount == 3);
+		CHECK(MatchesLayout(file, layout, expected, 3));
+		CHECK(expected[0].RowPitch == 20 && expected[1].RowPitch == 8 && expected[2].SlicePitch == 4);
+		CHECK(expected[3].Offset == Dx10HeaderSize + 60 + 8 + 4);
+	}
+
+	void TestErrors()
+	{
+		std::vector<uint8> file = LegacyHeader(16, 16, 5, FourCC('D', 'X', 'T', '1'));
+		std::vector<Expected> expected = ExpectedLayout(LegacyHeaderSize, 16, 16, 5, 1, 8, true);
+		file.resize(DataSize(expected), 0);
+
+		DDS_TEXTURE_LAYOUT12 layout;
+		CHECK(SUCCEEDED(GetDDSTextureLayout12(file.data(), file.size(), layout)));
+
+		// One byte short of the last mip.
+		CHECK(GetDDSTextureLayout12(file.data(), file.size() - 1, layout) == HRESULT_FROM_WIN32(ERROR_HANDLE_EOF));
+		CHECK(IsEmpty(layout));
+
+		// Cut inside the header, and no file at all.
+		CHECK(GetDDSTextureLayout12(file.data(), LegacyHeaderSize - 1, layout) == E_FAIL);
+		CHECK(IsEmpty(layout));
+		CHECK(GetDDSTextureLayout12(nullptr, file.size(), layout) == E_INVALIDARG);
+
+		std::vector<uint8> badMagic = file;
+		badMagic[0] = 'X';
+		CHECK(GetDDSTextureLayout12(badMagic.data(), badMagic.size(), layout) == E_FAIL);
+
+		std::vector<uint8> badSize = file;
+		Write32(badSize, 4, 120);
+		CHECK(GetDDSTextureLayout12(badSize.data(), badSize.size(), layout) == E_FAIL);
+
+		// Says DX10 but ends before its header.
+		std::vector<uint8> dx10 = Dx10Header(16, 16, 1, DXGI_FORMAT_BC7_UNORM, 1);
+		CHECK(GetDDSTextureLayout12(dx10.data(), LegacyHeaderSize + 10, layout) == E_FAIL);
+
+		// A DX10 header with no slices, or a format the loader cannot size.
+		dx10.resize(Dx10HeaderSize + 16, 0);
+		Write32(dx10, Dx10Offset + 12, 0);
+		CHECK(GetDDSTextureLayout12(dx10.data(), dx10.size(), layout) == HRESULT_FROM_WIN32(ERROR_INVALID_DATA));
+		Write32(dx10, Dx10Offset + 12, 1);
+		Write32(dx10, Dx10Offset, DXGI_FORMAT_P8);
+		CHECK(GetDDSTextureLayout12(dx10.data(), dx10.size(), layout) == HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED));
+		CHECK(IsEmpty(layout));
+
+		// A legacy pixel format that maps to no DXGI format.
+		std::vector<uint8> unknown = file;
+		Write32(unknown, PixelFormatOffset + 8, FourCC('A', 'B', 'C', 'D'));
+		CHECK(GetDDSTextureLayout12(unknown.data(), unknown.size(), layout) == HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED));
+
+		// More mips than any texture can have.
+		std::vector<uint8> mips = file;
+		Write32(mips, MipCountOffset, D3D12_REQ_MIP_LEVELS + 1);
+		CHECK(GetDDSTextureLayout12(mips.data(), mips.size(), layout) == HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED));
+	}
+}
+
+int main()
+{
+	TestBc1();
+	TestBc3();
+	TestBc7Dx10();
+	TestCubeMaps();
+	TestArray();
+	TestErrors();
+
+	return TestHarness::Finish("DDSTextureLoader");
+}
@@ -0,0 +1,390 @@
+//***************************************************************************************
+// MipGeneratorTests.cpp
+//
+// Builds mip chains of small images whose filtered values are known:
+//   -Chain sizes for non power of two images, halved and rounded down to 1x1.
+//   -Box filtering of 5 and 3 texel wide images, where a texel covers 2.5 and 3 texels of
+//    the level above, against the overlap weights; Kaiser filtering keeps flat images
+//    flat and ramps straight on non power of two sizes too.
+//   -sRGB images averaged in linear space, linear ones as stored.
+//   -Normal maps renormalized after filtering, with vectors that cancel facing up.
+//   -Cutout textures keeping their alpha test coverage down the chain.
+//***************************************************************************************
+
+#include "../Common/MipGenerator.h"
+#include "TestHarness.h"
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace
+{
+	using uint8 = std::uint8_t;
+	using uint32 = std::uint32_t;
+
+	const MipGenerator::MipFilter Filters[] = { MipGenerator::MipFilter::Box, MipGenerator::MipFilter::Kaiser };
+
+	// An RGBA image whose texels are given by texel(x, y, rgba).
+	template<typename TexelFunction>
+	std::vector<uint8> MakePixels(uint32 width, uint32 height, TexelFunction texel)
+	{
+		std::vector<uint8> pixels((std::size_t)width * height * 4);
+		for(uint32 y = 0; y < height; ++y)
+		{
+			for(uint32 x = 0; x < width; ++x)
+				texel(x, y, &pixels[((std::size_t)y * width + x) * 4]);
+		}
+		return pixels;
+	}
+
+	BlockCompressor::Image View(const std::vector<uint8>& pixels, uint32 width, uint32 height)
+	{
+		BlockCompressor::Image image;
+		image.Width = width;
+		image.Height = height;
+		image.RowPitch = width * 4;
+		image.Pixels = pixels.data();
+		return image;
+	}
+
+	const uint8* Texel(const MipGenerator::Mip& mip, uint32 x, uint32 y)
+	{
+		return &mip.Pixels[((std::size_t)y * mip.Width + x) * 4];
+	}
+
+	bool Near(int actual, float expected, float tolerance)
+	{
+		return std::fabs((float)actual - expected) <= tolerance;
+	}
+
+	void TestChainSizes()
+	{
+		std::vector<uint8> pixels = MakePixels(13, 7, [](uint32, uint32, uint8* t) { t[0] = t[1] = t[2] = t[3] = 255; });
+
+		MipGenerator::Options options;
+		std::vector<MipGenerator::Mip> mips;
+		MipGenerator::Generate(View(pixels, 13, 7), options, mips);
+
+		const uint32 expected[][2] = { { 13, 7 }, { 6, 3 }, { 3, 1 }, { 1, 1 } };
+		CHECK(mips.size() == 4);
+		for(std::size_t i = 0; i < mips.size() && i < 4; ++i)
+		{
+			CHECK(mips[i].Width == expected[i][0] && mips[i].Height == expected[i][1]);
+			CHECK(mips[i].Pixels.size() == (std::size_t)mips[i].Width * mips[i].Height * 4);
+		}
+
+		options.MaxMipCount = 2;
+		MipGenerator::Generate(View(pixels, 13, 7), options, mips);
+		CHECK(mips.size() == 2);
+
+		// The top level is the image as is, even when its rows are padded.
+		std::vector<uint8> padded(16 * 3, 0);
+		for(uint32 y = 0; y < 3; ++y)
+		{
+			for(uint32 i = 0; i < 12; ++i)
+				padded[y * 16 + i] = (uint8)(y * 12 + i);
+		}
+		BlockCompressor::Image image = View(padded, 3, 3);
+		image.RowPitch = 16;
+		MipGenerator::Generate(image, MipGenerator::Options(), mips);
+		CHECK(mips[0].Width == 3 && mips[0].Height == 3);
+		CHECK(Texel(mips[0], 2, 2)[3] == 35);
+		CHECK(Texel(mips[0], 0, 1)[0] == 12);
+	}
+
+	void TestBoxNonPowerOfTwo()
+	{
+		// Five texels wide, one of each value per column; each texel of the 2 wide level
+		// covers two and a half of them.
+		const uint8 columns[5] = { 0, 40, 100, 200, 250 };
+		std::vector<uint8> pixels = MakePixels(5, 4, [&columns](uint32 x, uint32, uint8* t)
+		{
+			t[0] = t[1] = t[2] = columns[x];
+			t[3] = 255;
+		});
+
+		MipGenerator::Options options;
+		options.Filter = MipGenerator::MipFilter::Box;
+		options.Wrap = false;
+		std::vector<MipGenerator::Mip> mips;
+		MipGenerator::Generate(View(pixels, 5, 4), options, mips);
+
+		float left = (columns[0] + columns[1] + 0.5f * columns[2]) / 2.5f;
+		float right = (0.5f * columns[2] + columns[3] + columns[4]) / 2.5f;
+		CHECK(mips[1].Width == 2 && mips[1].Height == 2);
+		for(uint32 y = 0; y < 2; ++y)
+		{
+			CHECK(Near(Texel(mips[1], 0, y)[0], left, 0.5f));
+			CHECK(Near(Texel(mips[1], 1, y)[1], right, 0.5f));
+			CHECK(Texel(mips[1], 0, y)[3] == 255);
+		}
+
+		// The last level averages the whole image, weighted by the levels in between.
+		CHECK(mips.size() == 3);
+		CHECK(Near(Texel(mips[2], 0, 0)[2], 0.5f * (left + right), 1.0f));
+
+		// Three texels become one: the plain average.
+		std::vector<uint8> three = MakePixels(3, 3, [](uint32 x, uint32 y, uint8* t)
+		{
+			t[0] = t[1] = t[2] = t[3] = (uint8)(x * 30 + y * 60);
+		});
+		MipGenerator::Generate(View(three, 3, 3), options, mips);
+		CHECK(mips.size() == 2);
+		CHECK(Near(Texel(mips[1], 0, 0)[0], 90.0f, 0.5f));
+		CHECK(Near(Texel(mips[1], 0, 0)[3], 90.0f, 0.5f));
+	}
+
+	void TestKaiserNonPowerOfTwo()
+	{
+		// Flat images stay flat with either filter and either edge mode.
+		std::vector<uint8> flat = MakePixels(13, 7, [](uint32, uint32, uint8* t)
+		{
+			t[0] = 30;
+			t[1] = 140;
+			t[2] = 220;
+			t[3] = 77;
+		});
+
+		int failures = 0;
+		for(MipGenerator::MipFilter filter : Filters)
+		{
+			for(bool wrap : { true, false })
+			{
+				MipGenerator::Options options;
+				options.Filter = filter;
+				options.Wrap = wrap;
+				std::vector<MipGenerator::Mip> mips;
+				MipGenerator::Generate(View(flat, 13, 7), options, mips);
+
+				for(const MipGenerator::Mip& mip : mips)
+				{
+					for(std::size_t i = 0; i < mip.Pixels.size(); i += 4)
+					{
+						if(mip.Pixels[i] != 30 || mip.Pixels[i + 1] != 140 || mip.Pixels[i + 2] != 220 || mip.Pixels[i + 3] != 77)
+							++failures;
+					}
+				}
+			}
+		}
+		CHECK(failures == 0);
+
+		// A ramp across 23 texels, clamped at the edges.  Away from them the symmetric
+		// filter puts each texel of the 11 wide level on the ramp at its center, up to the
+		// rounding of the taps that fall off the filter's support.
+		const uint32 width = 23;
+		std::vector<uint8> ramp = MakePixels(width, 4, [](uint32 x, uint32, uint8* t)
+		{
+			t[0] = t[1] = t[2] = (uint8)(x * 10);
+			t[3] = 255;
+		});
+
+		MipGenerator::Options options;
+		options.Filter = MipGenerator::MipFilter::Kaiser;
+		options.Wrap = false;
+		std::vector<MipGenerator::Mip> mips;
+		MipGenerator::Generate(View(ramp, width, 4), options, mips);
+
+		float scale = (float)width / (float)mips[1].Width;
+		for(uint32 x = 2; x + 2 < mips[1].Width; ++x)
+		{
+			float center = (x + 0.5f) * scale - 0.5f;
+			CHECK(Near(Texel(mips[1], x, 0)[0], center * 10.0f, 2.0f));
+		}
+
+		// Columns alternating black and white are a frequency no level can hold; Kaiser
+		// filters them out to gray instead of aliasing them.  The pattern tiles; clamping
+		// would weight the edge column twice.
+		std::vector<uint8> stripes = MakePixels(10, 10, [](uint32 x, uint32, uint8* t)
+		{
+			t[0] = t[1] = t[2] = x % 2 == 0 ? 0 : 255;
+			t[3] = 255;
+		});
+		options.Wrap = true;
+		MipGenerator::Generate(View(stripes, 10, 10), options, mips);
+		for(uint32 x = 0; x < mips[1].Width; ++x)
+			CHECK(Near(Texel(mips[1], x, 2)[0], 127.5f, 1.0f));
+	}
+
+	void TestSrgb()
+	{
+		// Black and white columns, the black ones transparent.
+		std::vector<uint8> pixels = MakePixels(2, 2, [](uint32 x, uint32, uint8* t)
+		{
+			t[0] = t[1] = t[2] = x == 0 ? 0 : 255;
+			t[3] = x == 0 ? 0 : 255;
+		});
+
+		for(MipGenerator::MipFilter filter : Filters)
+		{
+			MipGenerator::Options options;
+			options.Filter = filter;
+
+			// Half the light of white is stored as 188 in sRGB.
+			options.SRGB = true;
+			std::vector<MipGenerator::Mip> mips;
+			MipGenerator::Generate(View(pixels, 2, 2), options, mips);
+			CHECK(mips.size() == 2);
+			CHECK(Near(Texel(mips[1], 0, 0)[0], 188.0f, 1.0f));
+			CHECK(Near(Texel(mips[1], 0, 0)[2], 188.0f, 1.0f));
+
+			// Alpha is linear either way.
+			CHECK(Near(Texel(mips[1], 0, 0)[3], 127.5f, 0.5f));
+
+			options.SRGB = false;
+			MipGenerator::Generate(View(pixels, 2, 2), options, mips);
+			CHECK(Near(Texel(mips[1], 0, 0)[0], 127.5f, 0.5f));
+			CHECK(Near(Texel(mips[1], 0, 0)[3], 127.5f, 0.5f));
+		}
+	}
+
+	// Length of an encoded normal.
+	float DecodedLength(const uint8* t)
+	{
+		float x = t[0] / 127.5f - 1.0f;
+		float y = t[1] / 127.5f - 1.0f;
+		float z = t[2] / 127.5f - 1.0f;
+		return std::sqrt(x * x + y * y + z * z);
+	}
+
+	void TestNormalRenormalization()
+	{
+		// Normals leaning left and right average to a shorter vector straight up.
+		std::vector<uint8> lean = MakePixels(2, 2, [](uint32 x, uint32, uint8* t)
+		{
+			t[0] = x == 0 ? 51 : 204;
+			t[1] = 128;
+			t[2] = 230;
+			t[3] = 255;
+		});
+
+		// Normals that cancel out entirely.
+		std::vector<uint8> opposite = MakePixels(2, 2, [](uint32 x, uint32, uint8* t)
+		{
+			t[0] = x == 0 ? 0 : 255;
+			t[1] = 128;
+			t[2] = 128;
+			t[3] = 255;
+		});
+
+		std::mt19937 random(11);
+		std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+		std::uniform_real_distribution<float> tilt(0.0f, 1.2f);
+		std::vector<uint8> bumpy = MakePixels(19, 11, [&](uint32, uint32, uint8* t)
+		{
+			float a = angle(random);
+			float b = tilt(random);
+			t[0] = (uint8)std::lround((std::sin(b) * std::cos(a) * 0.5f + 0.5f) * 255.0f);
+			t[1] = (uint8)std::lround((std::sin(b) * std::sin(a) * 0.5f + 0.5f) * 255.0f);
+			t[2] = (uint8)std::lround((std::cos(b) * 0.5f + 0.5f) * 255.0f);
+			t[3] = 255;
+		});
+
+		for(MipGenerator::MipFilter filter : Filters)
+		{
+			MipGenerator::Options options;
+			options.Filter = filter;
+			options.NormalMap = true;
+
+			// sRGB does not apply to normal maps.
+			options.SRGB = true;
+
+			std::vector<MipGenerator::Mip> mips;
+			MipGenerator::Generate(View(lean, 2, 2), options, mips);
+			const uint8* up = Texel(mips[1], 0, 0);
+			CHECK(Near(up[0], 127.5f, 1.0f) && Near(up[1], 127.5f, 1.0f) && up[2] == 255);
+
+			MipGenerator::Generate(View(opposite, 2, 2), options, mips);
+			up = Texel(mips[1], 0, 0);
+			CHECK(Near(up[0], 127.5f, 1.0f) && Near(up[1], 127.5f, 1.0f) && up[2] == 255);
+
+			// Every filtered normal is unit length, up to the 8-bit encoding.
+			int failures = 0;
+			MipGenerator::Generate(View(bumpy, 19, 11), options, mips);
+			CHECK(mips.size() == 5);
+			for(std::size_t i = 1; i < mips.size(); ++i)
+			{
+				for(std::size_t j = 0; j < mips[i].Pixels.size(); j += 4)
+				{
+					if(std::fabs(DecodedLength(&mips[i].Pixels[j]) - 1.0f) > 0.02f)
+						++failures;
+				}
+			}
+			CHECK(failures == 0);
+		}
+	}
+
+	float Coverage(const MipGenerator::Mip& mip, float reference)
+	{
+		std::size_t passed = 0;
+		for(std::size_t i = 3; i < mip.Pixels.size(); i += 4)
+		{
+			if(mip.Pixels[i] / 255.0f > reference)
+				++passed;
+		}
+		return (float)passed / (float)(mip.Width * mip.Height);
+	}
+
+	void TestAlphaCoverage()
+	{
+		// Sparse leaves: a fifth of the texels are opaque.
+		std::mt19937 random(5);
+		std::vector<uint8> pixels = MakePixels(48, 40, [&random](uint32, uint32, uint8* t)
+		{
+			t[0] = t[1] = t[2] = 90;
+			t[3] = random() % 5 == 0 ? 255 : 0;
+		});
+
+		const float reference = 0.5f;
+		MipGenerator::Options options;
+		options.AlphaReference = reference;
+		std::vector<MipGenerator::Mip> mips;
+		MipGenerator::Generate(View(pixels, 48, 40), options, mips);
+
+		float top = Coverage(mips[0], reference);
+		for(std::size_t i = 1; i < mips.size() && mips[i].Width * mips[i].Height >= 30; ++i)
+			CHECK(std::fabs(Coverage(mips[i], reference) - top) < 0.05f);
+
+		// Without it the averaged alpha falls under the reference almost everywhere.
+		options.AlphaReference = 0.0f;
+		MipGenerator::Generate(View(pixels, 48, 40), options, mips);
+		CHECK(Coverage(mips[2], reference) < 0.5f * top);
+	}
+
+	void TestWriteDDS()
+	{
+		std::vector<uint8> pixels = MakePixels(13, 7, [](uint32 x, uint32 y, uint8* t)
+		{
+			t[0] = (uint8)(x * 19);
+			t[1] = (uint8)(y * 36);
+			t[2] = 128;
+			t[3] = 255;
+		});
+
+		std::vector<MipGenerator::Mip> mips;
+		MipGenerator::Generate(View(pixels, 13, 7), MipGenerator::Options(), mips);
+
+		std::vector<uint8> file;
+		MipGenerator::WriteDDS(mips, BlockCompressor::Format::BC1, BlockCompressor::Quality::Normal, true, file);
+
+		// Magic, header and DX10 header, then every mip padded to whole blocks.
+		std::size_t expected = 4 + 124 + 20;
+		for(const MipGenerator::Mip& mip : mips)
+			expected += BlockCompressor::CompressedSize(BlockCompressor::Format::BC1, mip.Width, mip.Height);
+		CHECK(file.size() == expected);
+		CHECK(file.size() > 4 && file[0] == 'D' && file[1] == 'D' && file[2] == 'S' && file[3] == ' ');
+	}
+}
+
+int main()
+{
+	TestChainSizes();
+	TestBoxNonPowerOfTwo();
+	TestKaiserNonPowerOfTwo();
+	TestSrgb();
+	TestNormalRenormalization();
+	TestAlphaCoverage();
+	TestWriteDDS();
+
+	return TestHarness::Finish("MipGenerator");
+}
@@ -0,0 +1,313 @@
+//***************************************************************************************
+// ShaderCacheTests.cpp
+//
+// ShaderCache against a stub compiler that "compiles" a file by concatenating its bytes
+// with the entry point, the target and the defines, so bytecode tells exactly what it
+// was compiled from and the number of compiler calls tells hits from misses.
+//***************************************************************************************
+
+#include "../Common/FileUtil.h"
+#include "../Common/ShaderCache.h"
+#include "TestHarness.h"
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+	using Bytes = std::vector<std::uint8_t>;
+
+	const std::wstring Directory = L"ShaderCacheTestFiles";
+	const std::wstring CacheFile = Directory + L"/shaders.cache";
+	const std::wstring MainFile = Directory + L"/Main.hlsl";
+	const std::wstring CommonFile = Directory + L"/Common.hlsl";
+
+	void WriteText(const std::wstring& filename, const std::string& text)
+	{
+		FileUtil::WriteFileAtomic(filename, { { text.data(), text.size() } });
+	}
+
+	struct StubCompiler
+	{
+		int Calls = 0;
+		bool Fail = false;
+
+		ShaderCache::Compiler Make(const std::string& version)
+		{
+			ShaderCache::Compiler compiler;
+			compiler.Version = version;
+			compiler.Compile = [this](const std::wstring& filename, const std::vector<ShaderCache::Define>& defines,
+				const std::string& entryPoint, const std::string& target, Bytes& bytecode, std::string& errors)
+			{
+				++Calls;
+				if(Fail)
+				{
+					errors = "stub: error X0000\n";
+					return false;
+				}
+
+				if(!FileUtil::ReadFile(filename, bytecode))
+					return false;
+
+				std::string suffix = "|" + entryPoint + "|" + target;
+				for(const ShaderCache::Define& define : defines)
+					suffix += "|" + define.Name + "=" + define.Value;
+				bytecode.insert(bytecode.end(), suffix.begin(), suffix.end());
+				return true;
+			};
+			return compiler;
+		}
+	};
+
+	void ResetFiles()
+	{
+		FileUtil::MakeDirectory(Directory);
+		FileUtil::RemoveFile(CacheFile);
+		WriteText(MainFile, "#include \"Common.hlsl\"\nfloat4 PS() : SV_Target { return USE_FOG; }\n");
+		WriteText(CommonFile, "#define COMMON 1\n#ifdef ALPHA_TEST\n#endif\n");
+	}
+
+	ShaderCache::uint64 KeyOf(ShaderCache& cache, const std::vector<ShaderCache::Define>& defines,
+		const std::string& entryPoint = "PS", const std::string& target = "ps_5_1")
+	{
+		ShaderCache::uint64 key = 0;
+		CHECK(cache.Key(MainFile, defines, entryPoint, target, key));
+		return key;
+	}
+
+	void TestKeyCoverage()
+	{
+		ResetFiles();
+		StubCompiler stub;
+		ShaderCache cache(CacheFile, stub.Make("stub 1"));
+
+		const ShaderCache::uint64 base = KeyOf(cache, { { "USE_FOG", "1" } });
+
+		// Everything that can change the output changes the key.
+		CHECK(KeyOf(cache, { { "USE_FOG", "0" } }) != base);
+		CHECK(KeyOf(cache, { { "USE_FOG", "1" } }, "VS") != base);
+		CHECK(KeyOf(cache, { { "USE_FOG", "1" } }, "PS", "ps_6_0") != base);
+		CHECK(KeyOf(cache, { { "USE_FOG", "1" }, { "ALPHA_TEST", "1" } }) != base);
+
+		StubCompiler other;
+		ShaderCache otherVersion(CacheFile, other.Make("stub 2"));
+		CHECK(KeyOf(otherVersion, { { "USE_FOG", "1" } }) != base);
+
+		// Defines no file mentions, and the order of defines, do not.
+		CHECK(KeyOf(cache, { { "USE_FOG", "1" }, { "UNUSED", "7" } }) == base);
+		CHECK(KeyOf(cache, { { "ALPHA_TEST", "1" }, { "USE_FOG", "1" } }) ==
+			KeyOf(cache, { { "USE_FOG", "1" }, { "ALPHA_TEST", "1" } }));
+
+		// Editing the source or an included file does.  Sources are read once per cache,
+		// so the edits are seen by new caches.
+		WriteText(CommonFile, "#define COMMON 2\n#ifdef ALPHA_TEST\n#endif\n");
+		ShaderCache editedInclude(CacheFile, stub.Make("stub 1"));
+		CHECK(KeyOf(editedInclude, { { "USE_FOG", "1" } }) != base);
+
+		WriteText(MainFile, "#include \"Common.hlsl\"\nfloat4 PS() : SV_Target { return 2 * USE_FOG; }\n");
+		ShaderCache editedSource(CacheFile, stub.Make("stub 1"));
+		CHECK(KeyOf(editedSource, { { "USE_FOG", "1" } }) != KeyOf(editedInclude, { { "USE_FOG", "1" } }));
+
+		// A missing source has no key.
+		ShaderCache::uint64 key = 0;
+		CHECK(!cache.Key(Directory + L"/Missing.hlsl", {}, "PS", "ps_5_1", key));
+	}
+
+	void TestHitsAndMisses()
+	{
+		ResetFiles();
+		const std::vector<ShaderCache::Define> fog = { { "USE_FOG", "1" } };
+
+		StubCompiler stub;
+		Bytes first;
+		{
+			ShaderCache cache(CacheFile, stub.Make("stub 1"));
+
+			std::string errors;
+			bool cached = true;
+			CHECK(cache.Compile(MainFile, fog, "PS", "ps_5_1", first, errors, &cached));
+			CHECK(!cached && stub.Calls == 1);
+
+			Bytes second;
+			CHECK(cache.Compile(MainFile, fog, "PS", "ps_5_1", second, errors, &cached));
+			CHECK(cached && stub.Calls == 1 && second == first);
+
+			// Only an unmentioned define differs, so it shares the entry.
+			CHECK(cache.Compile(MainFile, { { "USE_FOG", "1" }, { "UNUSED", "1" } }, "PS", "ps_5_1", second, errors, &cached));
+			CHECK(cached && stub.Calls == 1);
+
+			CHECK(cache.Compile(MainFile, fog, "VS", "vs_5_1", second, errors, &cached));
+			CHECK(!cached && stub.Calls == 2);
+
+			CHECK(cache.Save());
+		}
+
+		// A new cache serves both from the file without compiling.
+		{
+			ShaderCache cache(CacheFile, stub.Make("stub 1"));
+
+			Bytes bytecode;
+			std::string errors;
+			bool cached = false;
+			CHECK(cache.Compile(MainFile, fog, "PS", "ps_5_1", bytecode, errors, &cached));
+			CHECK(cached && stub.Calls == 2 && bytecode == first);
+
+			// Nothing was compiled, so nothing is written.
+			CHECK(cache.Save());
+		}
+
+		// Saving keeps only the entries that run used.
+		{
+			ShaderCache cache(CacheFile, stub.Make("stub 1"));
+
+			Bytes bytecode;
+			std::string errors;
+			bool cached = false;
+			CHECK(cache.Compile(MainFile, { { "USE_FOG", "0" } }, "PS", "ps_5_1", bytecode, errors, &cached));
+			CHECK(!cached && stub.Calls == 3);
+			CHECK(cache.Save());
+		}
+		{
+			ShaderCache cache(CacheFile, stub.Make("stub 1"));
+
+			Bytes bytecode;
+			std::string errors;
+			bool cached = true;
+			CHECK(cache.Compile(MainFile, fog, "VS", "vs_5_1", bytecode, errors, &cached));
+			CHECK(!cached && stub.Calls == 4);
+		}
+
+		// An edited include misses.
+		WriteText(CommonFile, "#define COMMON 3\n");
+		{
+			ShaderCache cache(CacheFile, stub.Make("stub 1"));
+
+			Bytes bytecode;
+			std::string errors;
+			bool cached = true;
+			CHECK(cache.Compile(MainFile, { { "USE_FOG", "0" } }, "PS", "ps_5_1", bytecode, errors, &cached));
+			CHECK(!cached && stub.Calls == 5);
+		}
+	}
+
+	void TestCompileFailure()
+	{
+		ResetFiles();
+
+		StubCompiler stub;
+		ShaderCache cache(CacheFile, stub.Make("stub 1"));
+
+		stub.Fail = true;
+		Bytes bytecode;
+		std::string errors;
+		CHECK(!cache.Compile(MainFile, {}, "PS", "ps_5_1", bytecode, errors));
+		CHECK(errors.find("X0000") != std::string::npos);
+
+		// Failures are not cached.
+		stub.Fail = false;
+		bool cached = true;
+		CHECK(cache.Compile(MainFile, {}, "PS", "ps_5_1", bytecode, errors, &cached));
+		CHECK(!cached && stub.Calls == 2 && errors.empty());
+
+		CHECK(!cache.Compile(Directory + L"/Missing.hlsl", {}, "PS", "ps_5_1", bytecode, errors));
+		CHECK(stub.Calls == 2 && !errors.empty());
+	}
+
+	// Saves a cache with one entry and returns the file's bytes.
+	Bytes SaveOneEntry(StubCompiler& stub)
+	{
+		ResetFiles();
+		{
+			ShaderCache cache(CacheFile, stub.Make("stub 1"));
+			Bytes bytecode;
+			std::string errors;
+			CHECK(cache.Compile(MainFile, {}, "PS", "ps_5_1", bytecode, errors));
+			CHECK(cache.Save());
+		}
+
+		Bytes file;
+		CHECK(FileUtil::ReadFile(CacheFile, file));
+		return file;
+	}
+
+	// A damaged cache file is ignored: the shader is compiled again, correctly, and Save
+	// replaces the file with a good one.
+	void CheckRecovers(StubCompiler& stub, const Bytes& damaged, const Bytes& good)
+	{
+		FileUtil::WriteFileAtomic(CacheFile, { { damaged.data(), damaged.size() } });
+
+		int calls = stub.Calls;
+		{
+			ShaderCache cache(CacheFile, stub.Make("stub 1"));
+			Bytes bytecode;
+			std::string errors;
+			bool cached = true;
+			CHECK(cache.Compile(MainFile, {}, "PS", "ps_5_1", bytecode, errors, &cached));
+			CHECK(!cached && stub.Calls == calls + 1);
+
+			Bytes expected;
+			CHECK(FileUtil::ReadFile(MainFile, expected));
+			const std::string suffix = "|PS|ps_5_1";
+			expected.insert(expected.end(), suffix.begin(), suffix.end());
+			CHECK(bytecode == expected);
+
+			CHECK(cache.Save());
+		}
+
+		Bytes file;
+		CHECK(FileUtil::ReadFile(CacheFile, file));
+		CHECK(file == good);
+	}
+
+	void TestCorruption()
+	{
+		StubCompiler stub;
+		const Bytes good = SaveOneEntry(stub);
+		CHECK(good.size() > 16 + 24);
+		if(good.size() <= 16 + 24)
+			return;
+
+		// Empty and truncated files, at every length short of the whole.
+		for(std::size_t size = 0; size < good.size(); size += 7)
+		{
+			Bytes truncated(good.begin(), good.begin() + size);
+			CheckRecovers(stub, truncated, good);
+		}
+
+		// Wrong magic and version.
+		Bytes damaged = good;
+		damaged[0] ^= 0xff;
+		CheckRecovers(stub, damaged, good);
+
+		damaged = good;
+		damaged[4] ^= 0xff;
+		CheckRecovers(stub, damaged, good);
+
+		// More entries than the file has room for.
+		damaged = good;
+		damaged[8] = 0xff;
+		CheckRecovers(stub, damaged, good);
+
+		// An entry that points past the end of the file.
+		damaged = good;
+		const std::size_t offsetField = 16 + 8;
+		std::memset(&damaged[offsetField], 0xff, 8);
+		CheckRecovers(stub, damaged, good);
+
+		damaged = good;
+		const std::size_t sizeField = 16 + 16;
+		damaged[sizeField + 4] = 0x01;
+		CheckRecovers(stub, damaged, good);
+	}
+}
+
+int main()
+{
+	TestKeyCoverage();
+	TestHitsAndMisses();
+	TestCompileFailure();
+	TestCorruption();
+
+	return TestHarness::Finish("ShaderCache");
+}
@@ -0,0 +1,50 @@
+//***************************************************************************************
+// TestHarness.h
+//
+// What the test executables share: CHECK, which reports a failed condition with its
+// file and line and counts it instead of stopping, and Finish, which main returns so a
+// failed check fails the ctest run.
+//
+//   int main()
+//   {
+//       TestSomething();
+//       return TestHarness::Finish("Something");
+//   }
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdio>
+
+class TestHarness
+{
+public:
+
+	///<summary>
+	/// The number of CHECKs that have failed so far.
+	///</summary>
+	static int& Failures()
+	{
+		static int failures = 0;
+		return failures;
+	}
+
+	///<summary>
+	/// Prints the outcome of the suite and returns main's exit code: 0 if every check
+	/// passed, otherwise 1.
+	///</summary>
+	static int Finish(const char* suite)
+	{
+		if(Failures() != 0)
+		{
+			std::printf("%s: %d checks failed\n", suite, Failures());
+			return 1;
+		}
+
+		std::printf("%s tests passed\n", suite);
+		return 0;
+	}
+};
+
+#define CHECK(condition) \
+	do { if(!(condition)) { std::printf("%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); ++TestHarness::Failures(); } } while(0)
@@ -0,0 +1,225 @@
+//***************************************************************************************
+// TransformTests.cpp
+//
+// Round trips Transform::Inverse for each kind a camera or an object produces: random
+// perspective (left and right handed, off center), orthographic, rigid and uniform
+// scale matrices, plus affine and general ones.  Inverse() * M has to come back as the
+// identity and Inverse() has to agree with XMMatrixInverse; Classify has to pick the
+// kind the matrix was built as, and CameraTransforms' InvViewProj has to match the
+// general inverse of view * proj.
+//***************************************************************************************
+
+#include "../Common/Transform.h"
+#include "TestHarness.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	const int Rounds = 500;
+
+	std::mt19937 gRandom(7);
+
+	float Uniform(float a, float b)
+	{
+		return std::uniform_real_distribution<float>(a, b)(gRandom);
+	}
+
+	XMMATRIX RandomRotation()
+	{
+		return XMMatrixRotationX(Uniform(-XM_PI, XM_PI)) * XMMatrixRotationY(Uniform(-XM_PI, XM_PI)) *
+			XMMatrixRotationZ(Uniform(-XM_PI, XM_PI));
+	}
+
+	XMMATRIX RandomTranslation()
+	{
+		return XMMatrixTranslation(Uniform(-100, 100), Uniform(-100, 100), Uniform(-100, 100));
+	}
+
+	float Magnitude(FXMMATRIX m)
+	{
+		XMFLOAT4X4 f;
+		XMStoreFloat4x4(&f, m);
+
+		float largest = 0.0f;
+		for(int r = 0; r < 4; ++r)
+		{
+			for(int c = 0; c < 4; ++c)
+				largest = std::fmax(largest, std::fabs(f(r, c)));
+		}
+		return largest;
+	}
+
+	// Every element of actual within tolerance * scale of expected.
+	bool NearMatrix(FXMMATRIX expected, CXMMATRIX actual, float tolerance, float scale)
+	{
+		XMFLOAT4X4 e;
+		XMFLOAT4X4 a;
+		XMStoreFloat4x4(&e, expected);
+		XMStoreFloat4x4(&a, actual);
+		for(int r = 0; r < 4; ++r)
+		{
+			for(int c = 0; c < 4; ++c)
+			{
+				if(!(std::fabs(e(r, c) - a(r, c)) <= tolerance * scale))
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// Builds m as kind, then checks that Classify agrees and that the inverse round trips.
+	// Returns whether every check passed, so the caller can count failures per kind.
+	bool CheckRoundTrip(FXMMATRIX m, Transform::Kind kind)
+	{
+		bool passed = Transform::Classify(m).GetKind() == kind;
+
+		Transform t(m, kind);
+		Transform inverse = t.Inverse();
+
+		XMMATRIX expected = XMMatrixInverse(nullptr, m);
+		passed = passed && NearMatrix(expected, inverse.Matrix(), 1e-4f, std::fmax(1.0f, Magnitude(expected)));
+
+		// The products carry the rounding of both factors.
+		float scale = std::fmax(1.0f, Magnitude(m) * Magnitude(expected));
+		passed = passed && NearMatrix(XMMatrixIdentity(), (inverse * t).Matrix(), 1e-4f, scale);
+		passed = passed && NearMatrix(XMMatrixIdentity(), (t * inverse).Matrix(), 1e-4f, scale);
+		return passed;
+	}
+
+	void TestPerspective()
+	{
+		int failures = 0;
+		for(int i = 0; i < Rounds; ++i)
+		{
+			float fov = Uniform(0.3f, 2.5f);
+			float aspect = Uniform(0.5f, 2.5f);
+			float nearZ = Uniform(0.05f, 5.0f);
+			float farZ = nearZ + Uniform(1.0f, 5000.0f);
+
+			failures += CheckRoundTrip(XMMatrixPerspectiveFovLH(fov, aspect, nearZ, farZ), Transform::Kind::Perspective) ? 0 : 1;
+			failures += CheckRoundTrip(XMMatrixPerspectiveFovRH(fov, aspect, nearZ, farZ), Transform::Kind::Perspective) ? 0 : 1;
+
+			float left = Uniform(-2.0f, 0.0f);
+			float bottom = Uniform(-2.0f, 0.0f);
+			XMMATRIX offCenter = XMMatrixPerspectiveOffCenterLH(left, left + Uniform(0.5f, 4.0f),
+				bottom, bottom + Uniform(0.5f, 4.0f), nearZ, farZ);
+			failures += CheckRoundTrip(offCenter, Transform::Kind::Perspective) ? 0 : 1;
+		}
+		CHECK(failures == 0);
+	}
+
+	void TestOrthographic()
+	{
+		int failures = 0;
+		for(int i = 0; i < Rounds; ++i)
+		{
+			float width = Uniform(1.0f, 500.0f);
+			float height = Uniform(1.0f, 500.0f);
+			float nearZ = Uniform(-100.0f, 10.0f);
+			float farZ = nearZ + Uniform(1.0f, 1000.0f);
+
+			failures += CheckRoundTrip(XMMatrixOrthographicLH(width, height, nearZ, farZ), Transform::Kind::Orthographic) ? 0 : 1;
+			failures += CheckRoundTrip(XMMatrixOrthographicRH(width, height, nearZ, farZ), Transform::Kind::Orthographic) ? 0 : 1;
+
+			float left = Uniform(-100.0f, 100.0f);
+			float bottom = Uniform(-100.0f, 100.0f);
+			XMMATRIX offCenter = XMMatrixOrthographicOffCenterLH(left, left + width, bottom, bottom + height, nearZ, farZ);
+			failures += CheckRoundTrip(offCenter, Transform::Kind::Orthographic) ? 0 : 1;
+		}
+		CHECK(failures == 0);
+	}
+
+	void TestRigid()
+	{
+		int failures = 0;
+		for(int i = 0; i < Rounds; ++i)
+		{
+			failures += CheckRoundTrip(RandomRotation() * RandomTranslation(), Transform::Kind::Rigid) ? 0 : 1;
+
+			XMVECTOR eye = XMVectorSet(Uniform(-100, 100), Uniform(-100, 100), Uniform(-100, 100), 1.0f);
+			XMVECTOR target = XMVectorAdd(eye, XMVectorSet(Uniform(-1, 1), Uniform(-1, 1), Uniform(0.5f, 1), 0.0f));
+			XMMATRIX view = XMMatrixLookAtLH(eye, target, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+			failures += CheckRoundTrip(view, Transform::Kind::Rigid) ? 0 : 1;
+		}
+		CHECK(failures == 0);
+	}
+
+	void TestUniformScale()
+	{
+		int failures = 0;
+		for(int i = 0; i < Rounds; ++i)
+		{
+			float scale = Uniform(0.01f, 100.0f);
+			XMMATRIX m = XMMatrixScaling(scale, scale, scale) * RandomRotation() * RandomTranslation();
+			failures += CheckRoundTrip(m, Transform::Kind::UniformScale) ? 0 : 1;
+		}
+		CHECK(failures == 0);
+	}
+
+	void TestAffineAndGeneral()
+	{
+		int failures = 0;
+		for(int i = 0; i < Rounds; ++i)
+		{
+			XMMATRIX m = XMMatrixScaling(Uniform(0.1f, 10.0f), Uniform(0.1f, 10.0f), Uniform(0.1f, 10.0f)) *
+				RandomRotation() * RandomTranslation();
+			failures += CheckRoundTrip(m, Transform::Kind::Affine) ? 0 : 1;
+		}
+		CHECK(failures == 0);
+
+		XMMATRIX general(1.0f, 2.0f, 0.0f, 0.5f, 0.0f, 1.0f, 3.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 2.0f);
+		CHECK(CheckRoundTrip(general, Transform::Kind::General));
+	}
+
+	void TestCameraTransforms()
+	{
+		int failures = 0;
+		for(int i = 0; i < Rounds; ++i)
+		{
+			XMVECTOR eye = XMVectorSet(Uniform(-100, 100), Uniform(-100, 100), Uniform(-100, 100), 1.0f);
+			XMVECTOR target = XMVectorSet(Uniform(-100, 100), Uniform(-100, 100), Uniform(-100, 100), 1.0f);
+			Transform view(XMMatrixLookAtLH(eye, target, XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)), Transform::Kind::Rigid);
+
+			float nearZ = Uniform(0.1f, 2.0f);
+			Transform proj = i % 2 == 0 ?
+				Transform(XMMatrixPerspectiveFovLH(Uniform(0.5f, 2.0f), Uniform(0.5f, 2.0f), nearZ, nearZ + Uniform(10.0f, 1000.0f)),
+					Transform::Kind::Perspective) :
+				Transform(XMMatrixOrthographicLH(Uniform(1.0f, 100.0f), Uniform(1.0f, 100.0f), nearZ, nearZ + Uniform(10.0f, 1000.0f)),
+					Transform::Kind::Orthographic);
+
+			CameraTransforms camera(view, proj);
+
+			XMMATRIX viewProj = XMMatrixMultiply(view.Matrix(), proj.Matrix());
+			XMMATRIX expected = XMMatrixInverse(nullptr, viewProj);
+			bool passed = NearMatrix(viewProj, camera.ViewProj.Matrix(), 1e-5f, std::fmax(1.0f, Magnitude(viewProj)));
+			passed = passed && NearMatrix(expected, camera.InvViewProj.Matrix(), 1e-4f, std::fmax(1.0f, Magnitude(expected)));
+			passed = passed && NearMatrix(XMMatrixInverse(nullptr, view.Matrix()), camera.InvView.Matrix(), 1e-4f, 100.0f);
+			passed = passed && NearMatrix(XMMatrixInverse(nullptr, proj.Matrix()), camera.InvProj.Matrix(), 1e-4f,
+				std::fmax(1.0f, Magnitude(camera.InvProj.Matrix())));
+			failures += passed ? 0 : 1;
+		}
+		CHECK(failures == 0);
+	}
+}
+
+int main()
+{
+#ifdef DIRECTX_MATH_VERSION
+	std::printf("DirectXMath %d\n", DIRECTX_MATH_VERSION);
+#else
+	std::printf("DirectXMath headers without DIRECTX_MATH_VERSION: not Microsoft's\n");
+#endif
+
+	TestPerspective();
+	TestOrthographic();
+	TestRigid();
+	TestUniformScale();
+	TestAffineAndGeneral();
+	TestCameraTransforms();
+
+	return TestHarness::Finish("Transform");
+}